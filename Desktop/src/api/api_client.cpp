@@ -6,6 +6,7 @@
 #include <QNetworkRequest>
 #include <QUrlQuery>
 #include "../error_handler.h"
+#include "text_codec.h"
 #include <QDebug>
 
 ApiClient::ApiClient(QObject *parent) :
@@ -49,21 +50,71 @@ QNetworkRequest ApiClient::createRequest(const QString &endpoint)
     return request;
 }
 
-void ApiClient::handleResponse(QNetworkReply *reply,
-                               const std::function<void(const QJsonDocument &)> &successCallback)
+QByteArray ApiClient::compressSyncBody(const QByteArray &body) const
 {
-    connect(reply, &QNetworkReply::finished, [=]() {
-        if (reply->error() == QNetworkReply::NoError) {
-            QByteArray response = reply->readAll();
-            QJsonDocument jsonResponse = QJsonDocument::fromJson(response);
-            successCallback(jsonResponse);
-        } else {
-            emit error(reply->errorString());
+    if (!_compressSync || !TextCodec::isSupported())
+        return QByteArray();
+
+    TextCodec &codec = TextCodec::instance();
+    const QByteArray compressed = codec.deflate(body, codec.jsonDictionary());
+    if (compressed.size() >= body.size())
+        return QByteArray();
+    return compressed;
+}
+
+void ApiClient::sendSync(const QByteArray &verb, const QString &endpoint, const QJsonObject &data,
+                         const std::function<void(QNetworkReply *)> &finished)
+{
+    const QByteArray body = QJsonDocument(data).toJson(QJsonDocument::Compact);
+    const QByteArray compressed = compressSyncBody(body);
+    QNetworkRequest request = createRequest(endpoint);
+    if (!compressed.isEmpty())
+        request.setRawHeader("Content-Encoding", TextCodec::ContentEncoding);
+    QNetworkReply *reply =
+     networkManager->sendCustomRequest(request, verb, compressed.isEmpty() ? body : compressed);
+
+    connect(reply, &QNetworkReply::finished, this, [=]() {
+        const int status = reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+        if (compressed.isEmpty() || (status != 400 && status != 415)) {
+            finished(reply);
+            return;
         }
+
+        // Сервер без распаковки тел (или с другими словарями) отвечает 400/415:
+        // повторяем без сжатия. Если так прошло - сжатие больше не используем
         reply->deleteLater();
+        QNetworkReply *retry =
+         networkManager->sendCustomRequest(createRequest(endpoint), verb, body);
+        connect(retry, &QNetworkReply::finished, this, [this, retry, finished]() {
+            if (retry->error() == QNetworkReply::NoError && _compressSync) {
+                qWarning() << "Server does not accept" << TextCodec::ContentEncoding
+                           << "bodies, sync requests are sent uncompressed";
+                _compressSync = false;
+            }
+            finished(retry);
+        });
     });
 }
 
+void ApiClient::handleResponse(QNetworkReply *reply,
+                               const std::function<void(const QJsonDocument &)> &successCallback)
+{
+    connect(reply, &QNetworkReply::finished, [=]() { handleReply(reply, successCallback); });
+}
+
+void ApiClient::handleReply(QNetworkReply *reply,
+                            const std::function<void(const QJsonDocument &)> &successCallback)
+{
+    if (reply->error() == QNetworkReply::NoError) {
+        QByteArray response = reply->readAll();
+        QJsonDocument jsonResponse = QJsonDocument::fromJson(response);
+        successCallback(jsonResponse);
+    } else {
+        emit error(reply->errorString());
+    }
+    reply->deleteLater();
+}
+
 // Аутентификация
 void ApiClient::login(const QString &username, const QString &password)
 {
@@ -270,17 +321,16 @@ void ApiClient::removeElement(const QString &workspaceTitle,
 // Синхронизация
 void ApiClient::syncWorkspace(const QString &workspaceTitle, const QJsonObject &changes)
 {
-    QNetworkRequest request = createRequest("/sync/");
     QJsonObject data;
     data["workspace_title"] = workspaceTitle;
     data["changes"] = changes;
 
-    QNetworkReply *reply = networkManager->post(request, QJsonDocument(data).toJson());
-
-    handleResponse(reply, [this](const QJsonDocument &response) {
-        if (response.isObject()) {
-            emit syncCompleted(response.object());
-        }
+    sendSync("POST", "/sync/", data, [this](QNetworkReply *reply) {
+        handleReply(reply, [this](const QJsonDocument &response) {
+            if (response.isObject()) {
+                emit syncCompleted(response.object());
+            }
+        });
     });
 }
 
@@ -338,9 +388,7 @@ void ApiClient::postUserSync(const QJsonArray &localWorkspaces)
 {
     QJsonObject data;
     data["local_workspaces"] = localWorkspaces;
-    QNetworkRequest request = createRequest("/user-sync/");
-    QNetworkReply *reply = networkManager->post(request, QJsonDocument(data).toJson());
-    connect(reply, &QNetworkReply::finished, this, [this, reply]() {
+    sendSync("POST", "/user-sync/", data, [this](QNetworkReply *reply) {
         if (reply->error() != QNetworkReply::NoError) {
             QByteArray response = reply->readAll();
             QJsonDocument doc = QJsonDocument::fromJson(response);
@@ -373,10 +421,7 @@ void ApiClient::patchUserSync(const QJsonArray &resolve, const QJsonArray &newWo
     QJsonObject data;
     data["resolve"] = resolve;
     data["new"] = newWorkspaces;
-    QNetworkRequest request = createRequest("/user-sync/");
-    QNetworkReply *reply =
-     networkManager->sendCustomRequest(request, "PATCH", QJsonDocument(data).toJson());
-    connect(reply, &QNetworkReply::finished, this, [this, reply]() {
+    sendSync("PATCH", "/user-sync/", data, [this](QNetworkReply *reply) {
         if (reply->error() != QNetworkReply::NoError) {
             QByteArray response = reply->readAll();
             QJsonDocument doc = QJsonDocument::fromJson(response);
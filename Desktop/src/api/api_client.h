@@ -101,8 +101,19 @@ private:
     QString authToken;
     QString _username;
 
+    // Сервер принимает тела синхронизации с TextCodec::ContentEncoding
+    bool _compressSync { true };
+
     QNetworkRequest createRequest(const QString &endpoint);
+    // Тело синхронизации: разметка текстов сжимается словарём TextCodec.
+    // Пустой результат - отправлять без сжатия
+    QByteArray compressSyncBody(const QByteArray &body) const;
+    // Запрос синхронизации; отвергнутое сервером сжатое тело отправляется ещё раз
+    // без сжатия. finished получает ответ на последнюю попытку
+    void sendSync(const QByteArray &verb, const QString &endpoint, const QJsonObject &data,
+                  const std::function<void(QNetworkReply *)> &finished);
     void handleResponse(QNetworkReply *reply, const std::function<void(const QJsonDocument &)> &successCallback);
+    void handleReply(QNetworkReply *reply, const std::function<void(const QJsonDocument &)> &successCallback);
 };
 
 #endif // API_CLIENT_H
@@ -1,5 +1,6 @@
 // src/auth/auth_manager.cpp
 #include "auth_manager.h"
+#include "../storage/storage_cipher.h"
 #include <QCryptographicHash>
 #include <QDebug>
 #include <QDir>
@@ -47,7 +48,7 @@ bool AuthManager::isRememberMeEnabled() const
 
 void AuthManager::login(const QString &token, const QString &username, bool rememberMe)
 {
-    qDebug() << "Login called - token:" << token << "username:" << username << "rememberMe:" << rememberMe;
+    qDebug() << "Login called - username:" << username << "rememberMe:" << rememberMe;
     _authToken = token;
     _username = username;
     _isAuthenticated = true;
@@ -64,6 +65,7 @@ void AuthManager::logout()
     _isAuthenticated = false;
     if (!_rememberMe) {
         _settings->remove("authToken");
+        _settings->remove("authTokenSealed");
         _settings->remove("username");
         _settings->remove("isAuthenticated");
         _settings->remove("rememberMe");
@@ -77,14 +79,25 @@ void AuthManager::saveAuthState()
 {
     qDebug() << "Saving auth state - rememberMe:" << _rememberMe;
     if (_rememberMe) {
-        _settings->setValue("authToken", _authToken);
+        // Токен в INI хранится зашифрованным, если сборка это поддерживает
+        QByteArray sealedToken;
+        if (StorageCipher::isSupported()
+            && StorageCipher::instance().seal(_authToken.toUtf8(), sealedToken,
+                                              StorageCipher::SharedKey, true)) {
+            _settings->setValue("authTokenSealed", QString::fromLatin1(sealedToken.toBase64()));
+            _settings->remove("authToken");
+        } else {
+            _settings->setValue("authToken", _authToken);
+            _settings->remove("authTokenSealed");
+        }
         _settings->setValue("username", _username);
         _settings->setValue("isAuthenticated", _isAuthenticated);
         _settings->setValue("rememberMe", _rememberMe);
-        qDebug() << "Saved auth state - token:" << _authToken << "username:" << _username << "isAuthenticated:" << _isAuthenticated;
+        qDebug() << "Saved auth state - username:" << _username << "isAuthenticated:" << _isAuthenticated;
     } else {
         qDebug() << "Remember me is disabled, clearing saved auth state";
         _settings->remove("authToken");
+        _settings->remove("authTokenSealed");
         _settings->remove("username");
         _settings->remove("isAuthenticated");
         _settings->remove("rememberMe");
@@ -98,9 +111,17 @@ void AuthManager::loadAuthState()
     
     if (_rememberMe) {
         _authToken = _settings->value("authToken").toString();
+        if (_settings->contains("authTokenSealed")) {
+            QByteArray token;
+            if (StorageCipher::instance().open(
+                 QByteArray::fromBase64(_settings->value("authTokenSealed").toString().toLatin1()),
+                 token)) {
+                _authToken = QString::fromUtf8(token);
+            }
+        }
         _username = _settings->value("username").toString();
-        _isAuthenticated = _settings->value("isAuthenticated", false).toBool();
-        qDebug() << "Loaded auth state - token:" << _authToken << "username:" << _username << "isAuthenticated:" << _isAuthenticated;
+        _isAuthenticated = _settings->value("isAuthenticated", false).toBool() && !_authToken.isEmpty();
+        qDebug() << "Loaded auth state - username:" << _username << "isAuthenticated:" << _isAuthenticated;
     } else {
         qDebug() << "Remember me is disabled, clearing auth state";
         _authToken.clear();
@@ -1,5 +1,6 @@
 #include "SubspaceLinkItem.h"
 #include "workspace.h"
+#include "view/icon_cache.h"
 #include <QHBoxLayout>
 #include <QLabel>
 
@@ -28,17 +29,10 @@ SubspaceLinkItem::SubspaceLinkItem(Workspace *subspace, Workspace *parent) :
     iconLabel->setFixedSize(32, 32);
     iconLabel->setSizePolicy(QSizePolicy::Preferred, QSizePolicy::Preferred);
 
-    QPixmap iconPixmap;
-    // Получаем размеры label
-    int width = iconLabel->width();
-    int height = iconLabel->height();
-
-    if (!subspace->getIcon().isNull()) {
-        iconPixmap = subspace->getIcon().pixmap(width, height);
-    } else {
-        iconPixmap = QIcon(":/icons/workspace.png").pixmap(width, height);
-    }
-    iconLabel->setPixmap(iconPixmap);
+    // Пустой digest - иконка по умолчанию
+    const QString iconDigest = subspace ? subspace->getIconDigest() : QString();
+    iconLabel->setPixmap(IconCache::instance().pixmap(iconDigest, iconLabel->size(),
+                                                      iconLabel->devicePixelRatioF()));
     iconLayout->addWidget(iconLabel, 0, Qt::AlignCenter);
 
     layout->addWidget(iconContainer, 0, Qt::AlignTop);
@@ -108,15 +102,10 @@ void SubspaceLinkItem::setLinkedWorkspace(Workspace *newLinkedWorkspace)
         // Update icon
         QLabel *iconLabel =
          qobject_cast<QLabel *>(layout()->itemAt(0)->widget()->layout()->itemAt(0)->widget());
-        int width = iconLabel->width();
-        int height = iconLabel->height();
         if (iconLabel) {
-            if (!_linkedWorkspace->getIcon().isNull()) {
-                iconLabel->setPixmap(_linkedWorkspace->getIcon().pixmap(QSize(width, height),
-                                                                        QIcon::Normal, QIcon::On));
-            } else {
-                iconLabel->setPixmap(QIcon(":/icons/workspace.png").pixmap(width, height));
-            }
+            iconLabel->setPixmap(IconCache::instance().pixmap(_linkedWorkspace->getIconDigest(),
+                                                              iconLabel->size(),
+                                                              iconLabel->devicePixelRatioF()));
         }
     }
 }
@@ -5,6 +5,7 @@
 #include <QWidget>
 #include <QString>
 #include <QJsonObject>
+#include <QUuid>
 
 class Workspace;
 
@@ -28,6 +29,19 @@ public:
     // Десериализация элемента из JSON
     virtual void deserialize(const QJsonObject &json) = 0;
 
+    // Постоянный идентификатор элемента на странице: по нему журнал находит элемент,
+    // даже если соседние элементы добавлены или удалены
+    QString elementId() const
+    {
+        if (_elementId.isEmpty())
+            _elementId = QUuid::createUuid().toString(QUuid::WithoutBraces);
+        return _elementId;
+    }
+    void setElementId(const QString &elementId)
+    {
+        _elementId = elementId;
+    }
+
 protected slots:
     virtual void createContextMenu(const QPoint &pos)
     {
@@ -51,6 +65,11 @@ public:
 
 signals:
     void itemDeleted(AbstractWorkspaceItem *item);
+    // Содержимое элемента изменилось и страницу нужно пересохранить
+    void contentChanged();
+
+private:
+    mutable QString _elementId;
 };
 
 #endif // WORKSPACEITEM_H
@@ -18,6 +18,7 @@ CheckboxItem::CheckboxItem(const QString &label, Workspace *parent) :
     resize(width(), 25);
 
     connect(_editLine, &QLineEdit::editingFinished, this, &CheckboxItem::finishEditing);
+    connect(_checkbox, &QCheckBox::toggled, this, &CheckboxItem::contentChanged);
 
     // _checkbox->setContextMenuPolicy(Qt::CustomContextMenu);
     // connect(_checkbox, &QWidget::customContextMenuRequested, this,
@@ -61,6 +62,7 @@ void CheckboxItem::finishEditing()
     _checkbox->setText(_editLine->text());
     _editLine->setVisible(false);
     _checkbox->setVisible(true);
+    emit contentChanged();
 }
 
 void CheckboxItem::addCustomContextMenuActions(QMenu *contextMenu)
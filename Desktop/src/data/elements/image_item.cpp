@@ -1,6 +1,94 @@
 #include "image_item.h"
+#include "pixmap_budget.h"
+#include "storage/blob_store.h"
+#include "storage/image_pyramid.h"
+#include "settings/settings_manager.h"
 #include <QBuffer>
+#include <QCoreApplication>
+#include <QFile>
+#include <QImageReader>
+#include <QImageWriter>
+#include <QScrollArea>
+#include <QScrollBar>
+#include <QThreadPool>
 #include <QDebug>
+#include <utility>
+
+namespace {
+// Размер с учётом поворота из EXIF, без декодирования пикселей
+QSize probeImage(const QByteArray &data, QByteArray &format)
+{
+    QBuffer buffer;
+    buffer.setData(data);
+    buffer.open(QIODevice::ReadOnly);
+    QImageReader reader(&buffer);
+    reader.setAutoTransform(true);
+    format = reader.format();
+    QSize size = reader.size();
+    if (reader.transformation() & QImageIOHandler::TransformationRotate90)
+        size.transpose();
+    return size;
+}
+
+// Пустой результат - исходный файл лучше: меньше или уже укладывается в политику
+QByteArray reencodeImage(const QByteArray &data, const ImageItem::EncodePolicy &policy,
+                         QByteArray &format)
+{
+    QBuffer buffer;
+    buffer.setData(data);
+    buffer.open(QIODevice::ReadOnly);
+    QImageReader reader(&buffer);
+    reader.setAutoTransform(true);
+
+    const QSize size = reader.size();
+    const bool downscale =
+     size.isValid() && qMax(size.width(), size.height()) > policy.maxDimension;
+    const QByteArray sourceFormat = reader.format();
+    // Без потерь и в пределах размера перекодировать нечего
+    if (!downscale && (policy.lossless || sourceFormat == "jpeg"))
+        return QByteArray();
+    if (downscale)
+        reader.setScaledSize(size.scaled(policy.maxDimension, policy.maxDimension,
+                                         Qt::KeepAspectRatio));
+
+    const QImage image = reader.read();
+    if (image.isNull()) {
+        qWarning() << "Failed to decode image for re-encoding:" << reader.errorString();
+        return QByteArray();
+    }
+
+    // JPEG не хранит прозрачность - такие изображения остаются PNG
+    format = policy.lossless || image.hasAlphaChannel() ? "png" : "jpeg";
+    QByteArray encoded;
+    QBuffer out(&encoded);
+    out.open(QIODevice::WriteOnly);
+    QImageWriter writer(&out, format);
+    if (format == "jpeg")
+        writer.setQuality(policy.quality);
+    if (!writer.write(image)) {
+        qWarning() << "Failed to re-encode image:" << writer.errorString();
+        return QByteArray();
+    }
+    return encoded.size() < data.size() ? encoded : QByteArray();
+}
+// Отдельный пул: долгие построения уровней в общем пуле не задерживают показ
+QThreadPool *decodePool()
+{
+    static QThreadPool pool;
+    return &pool;
+}
+} // namespace
+
+ImageItem::EncodePolicy ImageItem::EncodePolicy::fromSettings()
+{
+    const SettingsManager &settings = SettingsManager::instance();
+    EncodePolicy policy;
+    policy.enabled = settings.reencodeImages();
+    policy.maxDimension = settings.imageMaxDimension();
+    policy.quality = settings.imageQuality();
+    policy.lossless = settings.losslessImages();
+    return policy;
+}
 
 ImageItem::ImageItem(const QString &imagePath, Workspace *parent) :
     ResizableItem(parent),
@@ -13,16 +101,26 @@ ImageItem::ImageItem(const QString &imagePath, Workspace *parent) :
     setLayout(layout);
 
     if (!imagePath.isEmpty()) {
-        QPixmap pixmap(imagePath);
-        _originalPixmap = pixmap;
-        _imageData = imageToBase64(pixmap);
+        // Файл сохраняется байт в байт; декодируется он при первом показе
+        QFile file(imagePath);
+        const QByteArray imageData = file.open(QIODevice::ReadOnly) ? file.readAll()
+                                                                    : QByteArray();
+        if (imageData.isEmpty())
+            qWarning() << "Failed to read image:" << imagePath << file.errorString();
+        _imageSize = probeImage(imageData, _imageFormat);
 
-        // Calculate initial size while respecting minimum size
-        int initialWidth = qMax(qMin(pixmap.width(), 500), 250);
-        int initialHeight = qMax((initialWidth * pixmap.height()) / pixmap.width(), 250);
+        setFixedSize(itemSizeFor(_imageSize));
 
-        setFixedSize(initialWidth, initialHeight);
-        updateImageSize();
+        // Оригинал, который заменит перекодированная копия, в хранилище не попадает
+        const EncodePolicy policy = EncodePolicy::fromSettings();
+        if (policy.enabled && !imageData.isEmpty()) {
+            _imageDigest = BlobStore::digestOf(imageData);
+            _pendingImage = imageData;
+            reencodeInBackground(imageData, policy);
+        } else {
+            _imageDigest = BlobStore::instance().put(imageData);
+            buildPyramid(imageData);
+        }
     } else {
         setFixedSize(250, 250);
     }
@@ -30,48 +128,363 @@ ImageItem::ImageItem(const QString &imagePath, Workspace *parent) :
     _imageLabel->installEventFilter(this);
 }
 
+ImageItem::~ImageItem()
+{
+    cancelDecode();
+    PixmapBudget::instance().remove(this);
+}
+
 QString ImageItem::type() const
 {
     return "ImageItem";
 }
 
-QString ImageItem::imageToBase64(const QPixmap &pixmap) const
+QSize ImageItem::itemSizeFor(const QSize &imageSize)
+{
+    if (imageSize.isEmpty())
+        return QSize(250, 250);
+
+    // Calculate initial size while respecting minimum size
+    int initialWidth = qMax(qMin(imageSize.width(), 500), 250);
+    int initialHeight = qMax((initialWidth * imageSize.height()) / imageSize.width(), 250);
+    return QSize(initialWidth, initialHeight);
+}
+
+void ImageItem::reencodeInBackground(const QByteArray &imageData, const EncodePolicy &policy)
 {
-    QByteArray imageData;
-    QBuffer buffer(&imageData);
-    buffer.open(QIODevice::WriteOnly);
-    pixmap.save(&buffer, "PNG");
-    return QString(imageData.toBase64());
+    QPointer<ImageItem> self(this);
+    const QString sourceDigest = _imageDigest;
+    QThreadPool::globalInstance()->start([self, imageData, policy, sourceDigest]() {
+        QByteArray format;
+        const QByteArray encoded = reencodeImage(imageData, policy, format);
+        QMetaObject::invokeMethod(
+         qApp,
+         [self, encoded, format, sourceDigest]() {
+             // Элемент удалён или изображение заменено, пока шло перекодирование
+             if (!self || self->_imageDigest != sourceDigest)
+                 return;
+             const QByteArray original = std::exchange(self->_pendingImage, QByteArray());
+             if (encoded.isEmpty()) {
+                 // Оригинал лучше - сохраняем его, если ещё не сохранила страница
+                 if (!original.isEmpty())
+                     BlobStore::instance().put(original);
+                 self->buildPyramid(original.isEmpty()
+                                     ? BlobStore::instance().get(sourceDigest)
+                                     : original);
+                 return;
+             }
+             self->_imageDigest = BlobStore::instance().put(encoded);
+             self->_imageSize = probeImage(encoded, self->_imageFormat);
+             self->_pyramidFailed = false;
+             self->buildPyramid(encoded);
+             emit self->contentChanged();
+         },
+         Qt::QueuedConnection);
+    });
 }
 
-QPixmap ImageItem::base64ToImage(const QString &base64String) const
+void ImageItem::buildPyramid(const QByteArray &imageData)
 {
-    QByteArray imageData = QByteArray::fromBase64(base64String.toUtf8());
-    QPixmap pixmap;
-    pixmap.loadFromData(imageData, "PNG");
-    return pixmap;
+    // Уровни оригинала, который вот-вот заменит перекодированная копия, не нужны
+    if (_pyramidBuilding || _pyramidFailed || _releaseWhenHidden || _imageDigest.isEmpty()
+        || !_pendingImage.isEmpty() || ImagePyramid::levels(_imageSize).isEmpty()) {
+        return;
+    }
+    _pyramidBuilding = true;
+
+    QPointer<ImageItem> self(this);
+    const QString digest = _imageDigest;
+    QThreadPool::globalInstance()->start([self, imageData, digest]() {
+        const bool built = ImagePyramid::build(digest, imageData);
+        QMetaObject::invokeMethod(
+         qApp,
+         [self, digest, built]() {
+             if (!self || self->_imageDigest != digest)
+                 return;
+             // После неудачи показ остаётся на оригинале до следующего открытия
+             self->_pyramidBuilding = false;
+             self->_pyramidFailed = !built;
+             // Полноразмерный снимок заменяется уровнем, как только тот готов
+             if (built && self->_pixmapLevel == 0 && self->isOnScreen()
+                 && self->wantedLevel() > 0) {
+                 self->loadImage();
+             }
+         },
+         Qt::QueuedConnection);
+    });
 }
 
 QJsonObject ImageItem::serialize() const
 {
+    // Страница сохраняется раньше, чем закончилось перекодирование: ссылка на
+    // оригинал должна вести к записанным данным
+    if (!_pendingImage.isEmpty())
+        BlobStore::instance().put(std::exchange(_pendingImage, QByteArray()));
+
     QJsonObject json;
     json["type"] = type();
-    json["imageData"] = _imageData;
+    json["imageDigest"] = _imageDigest;
+    if (!_imageFormat.isEmpty())
+        json["imageFormat"] = QString::fromLatin1(_imageFormat);
+    if (_imageSize.isValid()) {
+        json["imageWidth"] = _imageSize.width();
+        json["imageHeight"] = _imageSize.height();
+    }
     return json;
 }
 
 void ImageItem::deserialize(const QJsonObject &json)
 {
-    if (json.contains("imageData")) {
-        _imageData = json["imageData"].toString();
-        _originalPixmap = base64ToImage(_imageData);
-        updateImageSize();
+    if (json.contains("imageDigest")) {
+        // Декодируется при первом показе: страница с множеством изображений
+        // открывается без декодирования тех, что не видны
+        _imageDigest = json["imageDigest"].toString();
+        _imageFormat = json["imageFormat"].toString().toLatin1();
+        // Без размера (элементы до пирамиды) он узнаётся при первом декодировании
+        _imageSize = QSize(json["imageWidth"].toInt(-1), json["imageHeight"].toInt(-1));
+    } else if (json.contains("imageData")) {
+        // Старый формат и данные с сервера: base64 прямо в элементе
+        QByteArray imageData = QByteArray::fromBase64(json["imageData"].toString().toUtf8());
+        _imageDigest = BlobStore::instance().put(imageData);
+        _imageSize = probeImage(imageData, _imageFormat);
+    } else {
+        return;
+    }
+
+    cancelDecode();
+    releasePixmap();
+    _pendingImage.clear();
+    _decodeFailed = false;
+    _pyramidBuilding = false;
+    _pyramidFailed = false;
+    // Место под изображение занято сразу, страница не прыгает после декодирования
+    if (_imageSize.isValid())
+        setFixedSize(itemSizeFor(_imageSize));
+    if (isOnScreen())
+        loadImage();
+}
+
+void ImageItem::setReleaseWhenHidden(bool release)
+{
+    _releaseWhenHidden = release;
+}
+
+void ImageItem::showEvent(QShowEvent *event)
+{
+    // Элементы за краем области прокрутки начнут декодирование при первой отрисовке
+    if (_pixmap.isNull() && !_imageDigest.isEmpty() && isOnScreen())
+        loadImage();
+    ResizableItem::showEvent(event);
+}
+
+void ImageItem::hideEvent(QHideEvent *event)
+{
+    // Декодировать то, что уже не видно, незачем: при показе начнётся заново
+    cancelDecode();
+    if (_releaseWhenHidden && !_imageDigest.isEmpty())
+        releasePixmap();
+    ResizableItem::hideEvent(event);
+}
+
+bool ImageItem::isOnScreen() const
+{
+    // В области прокрутки скрытый за краем элемент остаётся isVisible(), но без
+    // видимой области
+    return isVisible() && !visibleRegion().isEmpty();
+}
+
+void ImageItem::releasePixmap()
+{
+    PixmapBudget::instance().remove(this);
+    if (_pixmap.isNull())
+        return;
+    _pixmap = QPixmap();
+    _pixmapLevel = -1;
+    // Label держит свою копию pixmap - её тоже нужно отпустить
+    showPlaceholder();
+}
+
+bool ImageItem::eventFilter(QObject *watched, QEvent *event)
+{
+    if (watched == _imageLabel && event->type() == QEvent::Paint) {
+        if (!_pixmap.isNull()) {
+            PixmapBudget::instance().touch(this);
+        } else if (!_imageDigest.isEmpty() && !_decodeCancelled && !_decodeFailed) {
+            // Изображение освобождено бюджетом, а элемент снова на экране.
+            // Не из отрисовки: loadImage меняет label
+            QMetaObject::invokeMethod(
+             this,
+             [this]() {
+                 if (_pixmap.isNull() && !_decodeCancelled && isOnScreen())
+                     loadImage();
+             },
+             Qt::QueuedConnection);
+        }
+    }
+    return ResizableItem::eventFilter(watched, event);
+}
+
+int ImageItem::wantedLevel() const
+{
+    // В режиме просмотра уровней нет: оригинал декодируется сразу в размер элемента
+    if (_releaseWhenHidden)
+        return 0;
+    return ImagePyramid::levelFor(_imageSize, size() * devicePixelRatioF());
+}
+
+QSize ImageItem::targetSize() const
+{
+    return size() * devicePixelRatioF();
+}
+
+void ImageItem::loadImage()
+{
+    cancelDecode();
+    if (_imageDigest.isEmpty())
+        return;
+    if (_pixmap.isNull())
+        showPlaceholder();
+
+    auto cancelled = std::make_shared<std::atomic_bool>(false);
+    _decodeCancelled = cancelled;
+
+    QPointer<ImageItem> self(this);
+    const QString digest = _imageDigest;
+    const QByteArray pending = _pendingImage;
+    const int level = wantedLevel();
+    const QSize target = targetSize();
+    decodePool()->start([self, digest, pending, level, target, cancelled]() {
+        if (*cancelled)
+            return;
+
+        Decoded decoded;
+        decoded.level = level;
+        if (level > 0)
+            decoded.image = ImagePyramid::load(digest, level);
+
+        if (decoded.image.isNull() && !*cancelled) {
+            // Нужного уровня нет - оригинал (в режиме просмотра - копия из файла);
+            // пока идёт перекодирование, оригинал есть только в элементе
+            decoded.level = 0;
+            decoded.imageData = pending.isEmpty() ? BlobStore::instance().get(digest) : pending;
+            QBuffer buffer(&decoded.imageData);
+            buffer.open(QIODevice::ReadOnly);
+            QImageReader reader(&buffer);
+            reader.setAutoTransform(true);
+
+            const bool rotated = reader.transformation() & QImageIOHandler::TransformationRotate90;
+            const QSize raw = reader.size();
+            decoded.imageSize = rotated ? raw.transposed() : raw;
+
+            // Сразу в размер показа: JPEG уменьшается при декодировании, и в памяти
+            // только пиксели, которые видны на экране
+            if (raw.isValid() && !target.isEmpty()) {
+                const QSize shown = raw.scaled(rotated ? target.transposed() : target,
+                                               Qt::KeepAspectRatioByExpanding);
+                if (shown.width() < raw.width())
+                    reader.setScaledSize(shown);
+            }
+            if (!*cancelled) {
+                decoded.image = reader.read();
+                if (decoded.image.isNull())
+                    qWarning() << "Failed to decode image" << digest << ":"
+                               << reader.errorString();
+            }
+        }
+        if (*cancelled)
+            return;
+
+        QMetaObject::invokeMethod(
+         qApp,
+         [self, digest, cancelled, decoded]() {
+             if (self && !*cancelled && self->_imageDigest == digest)
+                 self->applyDecoded(decoded);
+         },
+         Qt::QueuedConnection);
+    });
+    watchViewport();
+}
+
+void ImageItem::watchViewport()
+{
+    // Прокрутка не скрывает элемент: декодирование того, что ушло за край
+    // области, отменяется по её полосам прокрутки
+    QWidget *parent = parentWidget();
+    while (parent && !qobject_cast<QScrollArea *>(parent)) parent = parent->parentWidget();
+    QScrollArea *scrollArea = qobject_cast<QScrollArea *>(parent);
+    if (!scrollArea)
+        return;
+
+    const auto cancelOffScreen = [this]() {
+        if (!isOnScreen())
+            cancelDecode();
+    };
+    _viewportWatch << connect(scrollArea->verticalScrollBar(), &QScrollBar::valueChanged, this,
+                              cancelOffScreen)
+                   << connect(scrollArea->horizontalScrollBar(), &QScrollBar::valueChanged,
+                              this, cancelOffScreen);
+}
+
+void ImageItem::unwatchViewport()
+{
+    for (const QMetaObject::Connection &connection : std::as_const(_viewportWatch))
+        disconnect(connection);
+    _viewportWatch.clear();
+}
+
+void ImageItem::cancelDecode()
+{
+    unwatchViewport();
+    if (_decodeCancelled) {
+        *_decodeCancelled = true;
+        _decodeCancelled.reset();
     }
 }
 
+void ImageItem::applyDecoded(const Decoded &decoded)
+{
+    unwatchViewport();
+    _decodeCancelled.reset();
+    _decodeFailed = decoded.image.isNull();
+    if (_decodeFailed)
+        return;
+    if (!_imageSize.isValid())
+        _imageSize = decoded.imageSize;
+
+    _imageLabel->setStyleSheet(QString());
+    _pixmap = QPixmap::fromImage(decoded.image);
+    _pixmapLevel = decoded.level;
+    updateImageSize();
+    PixmapBudget::instance().add(this, qint64(_pixmap.width()) * _pixmap.height()
+                                        * _pixmap.depth() / 8);
+
+    // Нужного уровня нет (изображение старое или уровни ещё строятся)
+    if (decoded.level == 0 && wantedLevel() > 0)
+        buildPyramid(decoded.imageData);
+}
+
+void ImageItem::showPlaceholder()
+{
+    _imageLabel->clear();
+    _imageLabel->setFixedSize(width(), height());
+    _imageLabel->setStyleSheet("background-color: palette(midlight);");
+}
+
 void ImageItem::resizeEvent(QResizeEvent *event)
 {
-    if (!_imageData.isEmpty()) {
+    if (!_pixmap.isNull()) {
+        // Перечитываем при смене уровня (пока уровни строятся, остаётся оригинал)
+        // и когда декодированный в размер оригинал стал меньше элемента
+        const int level = wantedLevel();
+        const bool noLevels = _pyramidBuilding || _pyramidFailed;
+        const QSize target = targetSize();
+        const bool undersized = _pixmapLevel == 0 && level == 0
+                                && (_pixmap.width() < qMin(target.width(), _imageSize.width())
+                                    || _pixmap.height() < qMin(target.height(),
+                                                               _imageSize.height()));
+        const bool levelChanged = level != _pixmapLevel && !(_pixmapLevel == 0 && noLevels);
+        if ((levelChanged || undersized) && isOnScreen() && !_decodeCancelled)
+            loadImage();
         updateImageSize();
     }
     ResizableItem::resizeEvent(event);
@@ -79,8 +492,8 @@ void ImageItem::resizeEvent(QResizeEvent *event)
 
 void ImageItem::updateImageSize()
 {
-    if (!_originalPixmap.isNull()) {
-        _imageLabel->setPixmap(_originalPixmap);
+    if (!_pixmap.isNull()) {
+        _imageLabel->setPixmap(_pixmap);
         _imageLabel->setFixedSize(width(), height());
         _imageLabel->setAlignment(Qt::AlignCenter);
         _imageLabel->setScaledContents(true);
@@ -5,34 +5,107 @@
 
 #include <QLabel>
 #include <QVBoxLayout>
+#include <QImage>
+#include <QList>
 #include <QPixmap>
 #include <QPointer>
+#include <atomic>
+#include <memory>
 
+// Изображение хранится в BlobStore в исходном виде (байты и формат файла) и
+// декодируется только для показа. Перекодирование при вставке - по настройкам
+// (EncodePolicy), в пуле потоков; пока оно идёт, элемент держит исходный файл в памяти.
+// Для показа берётся наименьший уровень ImagePyramid, покрывающий размер элемента;
+// оригинал декодируется, только пока уровней нет или элемент больше верхнего уровня.
+// Декодирование идёт в пуле потоков сразу в размер показа; до его конца элемент
+// занимает место изображения. Декодирование начинается, только когда элемент на экране,
+// и отменяется, когда он скрыт или прокручен за край области.
+// Память декодированных изображений ограничена PixmapBudget: изображение элемента за
+// пределами экрана может быть освобождено и декодируется снова при следующей отрисовке.
 class ImageItem : public ResizableItem
 {
     Q_OBJECT
 
 public:
+    struct EncodePolicy
+    {
+        bool enabled { false };
+        int maxDimension { 2048 }; // по большей стороне
+        int quality { 85 }; // для сжатия с потерями
+        bool lossless { false };
+
+        static EncodePolicy fromSettings();
+    };
+
     explicit ImageItem(const QString &imagePath = QString(), Workspace *parent = nullptr);
+    ~ImageItem() override;
 
     QString type() const override;
 
     QJsonObject serialize() const override;
     void deserialize(const QJsonObject &json) override;
 
+    // Режим просмотра: изображение декодируется в размер элемента и освобождается,
+    // когда элемент скрыт
+    void setReleaseWhenHidden(bool release);
+
+    // Для PixmapBudget: хоть часть элемента видна на экране
+    bool isOnScreen() const;
+    // Освобождает декодированное изображение, на его месте остаётся заглушка
+    void releasePixmap();
+
 protected:
+    bool eventFilter(QObject *watched, QEvent *event) override;
+    void showEvent(QShowEvent *event) override;
+    void hideEvent(QHideEvent *event) override;
     void resizeEvent(QResizeEvent *event) override;
     void addCustomContextMenuActions(QMenu *contextMenu) override;
 
 private:
+    struct Decoded
+    {
+        QImage image;
+        int level { 0 };
+        QSize imageSize;
+        QByteArray imageData; // оригинал, если декодировался он - для построения уровней
+    };
+
+    static QSize itemSizeFor(const QSize &imageSize);
+
+    void loadImage();
+    void cancelDecode();
+    void watchViewport();
+    void unwatchViewport();
+    void applyDecoded(const Decoded &decoded);
+    void showPlaceholder();
     void updateImageSize();
-    QString imageToBase64(const QPixmap &pixmap) const;
-    QPixmap base64ToImage(const QString &base64String) const;
+    int wantedLevel() const;
+    QSize targetSize() const;
+    void reencodeInBackground(const QByteArray &imageData, const EncodePolicy &policy);
+    void buildPyramid(const QByteArray &imageData);
 
     QPointer<QLabel> _imageLabel;
     QString _imagePath;
-    QPixmap _originalPixmap;
-    QString _imageData;
+    // Показанный уровень пирамиды (0 - оригинал, -1 - ничего не загружено)
+    QPixmap _pixmap;
+    int _pixmapLevel { -1 };
+    QSize _imageSize;
+    bool _pyramidBuilding { false };
+    bool _pyramidFailed { false };
+    // Не декодировалось - при отрисовке заглушки повторно не пытаемся
+    bool _decodeFailed { false };
+    // Флаг отмены текущего декодирования; общий с задачей в пуле потоков
+    std::shared_ptr<std::atomic_bool> _decodeCancelled;
+    // Полосы прокрутки области, пока идёт декодирование
+    QList<QMetaObject::Connection> _viewportWatch;
+    // Ключ изображения в BlobStore, сами данные в элементе не хранятся
+    QString _imageDigest;
+    // Оригинал, пока идёт перекодирование: в BlobStore он попадает, только если
+    // перекодирование не выиграло или страницу сохранили раньше его конца
+    mutable QByteArray _pendingImage;
+    // "jpeg", "png", ... - как определил QImageReader
+    QByteArray _imageFormat;
+    bool _releaseWhenHidden { false };
 };
 
 #endif // IMAGEITEM_H
@@ -30,6 +30,7 @@ void ListItem::addItemToList(const QString &text)
     } else {
         _listWidget->addItem(text);
     }
+    emit contentChanged();
 }
 
 QJsonObject ListItem::serialize() const
@@ -70,6 +71,7 @@ void ListItem::removeItemFromList(int index)
                 _listWidget->item(i)->setText(QString::number(i + 1) + ". " + itemText);
             }
         }
+        emit contentChanged();
     }
 }
 
@@ -93,6 +95,7 @@ void ListItem::editItemInList(int index)
             } else {
                 _listWidget->item(index)->setText(newText);
             }
+            emit contentChanged();
         }
     }
 }
@@ -0,0 +1,92 @@
+#include "pixmap_budget.h"
+#include "image_item.h"
+#include "settings/settings_manager.h"
+
+#include <QCoreApplication>
+#include <QList>
+#include <QDebug>
+
+namespace {
+qint64 capacityFromSettings()
+{
+    const int megabytes = SettingsManager::instance().imageMemoryBudget();
+    return qint64(megabytes > 0 ? megabytes : PixmapBudget::DefaultCapacityMb) * 1024 * 1024;
+}
+} // namespace
+
+PixmapBudget &PixmapBudget::instance()
+{
+    static PixmapBudget budget;
+    return budget;
+}
+
+PixmapBudget::PixmapBudget() : _capacity(capacityFromSettings())
+{
+    QObject::connect(&SettingsManager::instance(), &SettingsManager::storageSettingsChanged, qApp,
+                     []() { PixmapBudget::instance().setCapacity(capacityFromSettings()); });
+}
+
+void PixmapBudget::setCapacity(qint64 bytes)
+{
+    if (bytes <= 0 || bytes == _capacity)
+        return;
+    _capacity = bytes;
+    evict();
+}
+
+qint64 PixmapBudget::capacity() const
+{
+    return _capacity;
+}
+
+qint64 PixmapBudget::used() const
+{
+    return _used;
+}
+
+void PixmapBudget::add(ImageItem *item, qint64 cost)
+{
+    remove(item);
+    _entries.push_front({ item, cost });
+    _index.insert(item, _entries.begin());
+    _used += cost;
+    evict();
+}
+
+void PixmapBudget::touch(ImageItem *item)
+{
+    const auto it = _index.constFind(item);
+    if (it != _index.constEnd())
+        _entries.splice(_entries.begin(), _entries, it.value());
+}
+
+void PixmapBudget::remove(ImageItem *item)
+{
+    const auto it = _index.constFind(item);
+    if (it == _index.constEnd())
+        return;
+    _used -= it.value()->cost;
+    _entries.erase(it.value());
+    _index.erase(it);
+}
+
+void PixmapBudget::evict()
+{
+    if (_used <= _capacity)
+        return;
+
+    // Сначала выбираем, потом освобождаем: releasePixmap() убирает элемент из списка
+    QList<ImageItem *> victims;
+    qint64 remaining = _used;
+    for (auto it = _entries.rbegin(); it != _entries.rend() && remaining > _capacity; ++it) {
+        if (it->item->isOnScreen())
+            continue;
+        victims.append(it->item);
+        remaining -= it->cost;
+    }
+    for (ImageItem *item : victims) item->releasePixmap();
+
+    if (!victims.isEmpty())
+        qDebug() << "Pixmap budget: released" << victims.size() << "images, in use"
+                 << _used / 1024 << "of" << _capacity / 1024 << "KB";
+}
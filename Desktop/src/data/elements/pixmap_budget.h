@@ -0,0 +1,49 @@
+#ifndef PIXMAP_BUDGET_H
+#define PIXMAP_BUDGET_H
+
+#include <QHash>
+#include <QtGlobal>
+#include <list>
+
+class ImageItem;
+
+// Общий предел памяти под декодированные изображения всех открытых страниц.
+// Элементы учитываются в порядке последнего показа (LRU); при превышении предела
+// изображения давно не показанных и невидимых сейчас элементов освобождаются.
+// Сжатые данные остаются в BlobStore - при прокрутке к элементу он декодирует их снова.
+// Видимые элементы не освобождаются, даже если предел превышен. Только поток интерфейса.
+class PixmapBudget
+{
+public:
+    static constexpr int DefaultCapacityMb = 512;
+
+    static PixmapBudget &instance();
+
+    void setCapacity(qint64 bytes);
+    qint64 capacity() const;
+    qint64 used() const;
+
+    // item показал изображение размером cost байт
+    void add(ImageItem *item, qint64 cost);
+    // item снова показан - становится последним использованным
+    void touch(ImageItem *item);
+    void remove(ImageItem *item);
+
+private:
+    struct Entry
+    {
+        ImageItem *item;
+        qint64 cost;
+    };
+
+    PixmapBudget();
+    void evict();
+
+    // От последнего показанного к давно не показанному
+    std::list<Entry> _entries;
+    QHash<ImageItem *, std::list<Entry>::iterator> _index;
+    qint64 _capacity;
+    qint64 _used { 0 };
+};
+
+#endif // PIXMAP_BUDGET_H
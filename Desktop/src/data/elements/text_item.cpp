@@ -35,6 +35,7 @@ TextItem::TextItem(const QString &text, Workspace *parent) :
     connect(italicAction, &QAction::triggered, this, &TextItem::toggleItalic);
     connect(unorderedListAction, &QAction::triggered, this, &TextItem::insertUnorderedList);
     connect(orderedListAction, &QAction::triggered, this, &TextItem::insertOrderedList);
+    connect(_textEdit, &QTextEdit::textChanged, this, &TextItem::contentChanged);
 
     // Устанавливаем макет
     QVBoxLayout *layout = new QVBoxLayout(this);
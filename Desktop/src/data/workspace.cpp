@@ -6,6 +6,8 @@
 #include "text_item.h"
 #include "title_item.h"
 #include "elements/SubspaceLinkItem.h"
+#include "storage/blob_store.h"
+#include "view/icon_cache.h"
 
 #include <QScrollArea>
 #include <QMenu>
@@ -15,13 +17,60 @@
 #include <QPushButton>
 #include <QDebug>
 #include <QBuffer>
+#include <QHash>
 #include <QJsonObject>
 #include <QJsonArray>
 #include <QDateTime>
 #include <QJsonDocument>
+#include <QUuid>
+#include <QSignalBlocker>
+
+// --- ICON SERIALIZATION UTILS ---
+static QByteArray iconToPng(const QIcon &icon, int size = 64)
+{
+    if (icon.isNull())
+        return QByteArray();
+    QPixmap pixmap = icon.pixmap(size, size);
+    QByteArray ba;
+    QBuffer buffer(&ba);
+    buffer.open(QIODevice::WriteOnly);
+    pixmap.save(&buffer, "PNG");
+    return ba;
+}
+
+static QIcon defaultIcon()
+{
+    static const QIcon icon(":/icons/workspace.png");
+    return icon;
+}
+
+// digest иконки по QIcon::cacheKey: копии одного QIcon не кодируются в PNG повторно.
+// contains() заодно отмечает blob как используемый, и сборка мусора его не удалит.
+// Только поток интерфейса.
+static QHash<qint64, QString> &iconDigests()
+{
+    static QHash<qint64, QString> digests;
+    return digests;
+}
+
+static QString iconDigestOf(const QIcon &icon)
+{
+    QString &digest = iconDigests()[icon.cacheKey()];
+    if (digest.isEmpty() || !BlobStore::instance().contains(digest))
+        digest = BlobStore::instance().put(iconToPng(icon));
+    return digest;
+}
+
+static QIcon pngToIcon(const QByteArray &ba)
+{
+    QPixmap pixmap;
+    pixmap.loadFromData(ba, "PNG");
+    return QIcon(pixmap);
+}
 
 Workspace::Workspace(const QString &title, QWidget *parent) :
     QWidget(parent),
+    _id(QUuid::createUuid().toString(QUuid::WithoutBraces)),
     _title(title),
     _status(Status::NotStarted),
     _createdAt(QDateTime::currentDateTime().toString(Qt::ISODate)),
@@ -81,6 +130,7 @@ Workspace::Workspace(const QString &title, QWidget *parent) :
     headerLayout->addWidget(_iconLabel);
 
     QToolButton *menuButton = new QToolButton(this);
+    _menuButton = menuButton;
     menuButton->setIcon(QIcon::fromTheme("menu"));
     // menuButton->setStyleSheet("border: none;");
     menuButton->setToolTip("Добавить элемент");
@@ -151,25 +201,31 @@ QIcon Workspace::getIcon() const
     return _icon;
 }
 
-void Workspace::setIcon(const QIcon &icon)
+QString Workspace::getIconDigest() const
+{
+    return _iconDigest;
+}
+
+void Workspace::setIcon(const QIcon &icon, const QString &iconDigest)
 {
-    if (!icon.isNull()) {
-        _icon = icon;
+    // Иконка по умолчанию, если пользовательская не задана
+    _icon = !icon.isNull() ? icon : defaultIcon();
+
+    // Если digest уже известен (например, иконка унаследована), повторно не кодируем
+    if (!icon.isNull() && !iconDigest.isEmpty()) {
+        _iconDigest = iconDigest;
+        iconDigests().insert(_icon.cacheKey(), iconDigest);
     } else {
-        // Устанавливаем иконку по умолчанию, если пользовательская иконка не задана
-        _icon = QIcon(":/icons/workspace.png");
+        _iconDigest = iconDigestOf(_icon);
     }
-    // Получаем размеры label
-    int width = _iconLabel->width();
-    int height = _iconLabel->height();
-
-    // Масштабируем pixmap с сохранением пропорций
-    QPixmap pixmap = _icon.pixmap(width, height);
-    QPixmap scaledPixmap =
-     pixmap.scaled(width, height, Qt::KeepAspectRatio, Qt::SmoothTransformation);
 
-    _iconLabel->setPixmap(scaledPixmap);
+    // Растровая копия под размер label общая с деревом и ссылками на подпространства
+    _iconLabel->setPixmap(!_iconDigest.isEmpty()
+                           ? IconCache::instance().pixmap(_iconDigest, _iconLabel->size(),
+                                                          _iconLabel->devicePixelRatioF())
+                           : _icon.pixmap(_iconLabel->size()));
     _iconLabel->setAlignment(Qt::AlignCenter); // Центрируем иконку в label
+    markDirty();
 }
 
 void Workspace::addItemByType(const QString &type)
@@ -218,6 +274,7 @@ void Workspace::setTitle(const QString &title)
     if (_titleLabel) {
         _titleLabel->setText(title);
     }
+    markDirty();
 }
 
 Workspace::Status Workspace::getStatus() const
@@ -228,6 +285,7 @@ Workspace::Status Workspace::getStatus() const
 void Workspace::setStatus(Status status)
 {
     _status = status;
+    markDirty();
 }
 
 QString Workspace::getStatusString() const
@@ -253,6 +311,7 @@ void Workspace::setStatusFromString(const QString &status)
     } else if (status == "completed") {
         _status = Status::Completed;
     }
+    markDirty();
 }
 
 QString Workspace::getCreatedAt() const
@@ -263,6 +322,7 @@ QString Workspace::getCreatedAt() const
 void Workspace::setCreatedAt(const QString &createdAt)
 {
     _createdAt = createdAt;
+    markDirty();
 }
 
 void Workspace::addItem(AbstractWorkspaceItem *item)
@@ -280,7 +340,12 @@ void Workspace::addItem(AbstractWorkspaceItem *item)
 
     item->setMinimumHeight(25);
 
+    if (_readOnly)
+        applyReadOnly(item);
+
     connect(item, &AbstractWorkspaceItem::itemDeleted, this, &Workspace::removeItem);
+    connect(item, &AbstractWorkspaceItem::contentChanged, this,
+            [this, item]() { onItemContentChanged(item); });
     _layout->addWidget(item);
 
     updateContentSize();
@@ -288,6 +353,7 @@ void Workspace::addItem(AbstractWorkspaceItem *item)
     _spacerItem = new QSpacerItem(20, _contentWidget->height() - _contentWidget->minimumHeight(),
                                   QSizePolicy::Minimum, QSizePolicy::Fixed);
     _layout->addItem(_spacerItem);
+    markDirty();
 }
 
 void Workspace::removeItem(AbstractWorkspaceItem *item)
@@ -296,6 +362,7 @@ void Workspace::removeItem(AbstractWorkspaceItem *item)
     _layout->removeWidget(item);
     item->deleteLater();
     updateContentSize();
+    markDirty();
 }
 
 QJsonObject Workspace::serialize() const
@@ -308,7 +375,7 @@ QJsonObject Workspace::serialize() const
     // Сериализация элементов
     QJsonArray itemsArray;
     for (const auto &item : _items) {
-        itemsArray.append(item->serialize());
+        itemsArray.append(serializeItem(item));
     }
     json["elements"] = itemsArray;
 
@@ -355,6 +422,13 @@ void Workspace::deserialize(const QJsonObject &json)
     }
 }
 
+QJsonObject Workspace::serializeItem(const AbstractWorkspaceItem *item)
+{
+    QJsonObject json = item->serialize();
+    json["elementId"] = item->elementId();
+    return json;
+}
+
 void Workspace::deserializeItems(const QJsonArray &itemsArray)
 {
     for (const QJsonValue &itemVal : itemsArray) {
@@ -380,6 +454,7 @@ void Workspace::deserializeItems(const QJsonArray &itemsArray)
 
         if (item) {
             item->deserialize(itemObj);
+            item->setElementId(itemObj["elementId"].toString());
             addItem(item);
         }
     }
@@ -428,30 +503,38 @@ void Workspace::addSubWorkspace(Workspace *sub)
     if (!_subWorkspaces.contains(sub)) {
         _subWorkspaces.append(sub);
         sub->setParentWorkspace(this);
-        // Добавляем ссылку-элемент, если его нет
-        bool hasLink = false;
-        for (auto *item : _items) {
-            if (item->type() == "SubspaceLinkItem") {
-                auto *link = static_cast<SubspaceLinkItem *>(item);
-                if (link->getLinkedWorkspace() == sub) {
-                    hasLink = true;
-                    break;
-                }
-            }
-        }
-        if (!hasLink) {
-            auto *linkItem = new SubspaceLinkItem(sub, this);
-            connect(linkItem, &SubspaceLinkItem::subspaceLinkClicked, this,
-                    &Workspace::subWorkspaceClicked);
-            addItem(linkItem);
+        connect(sub, &Workspace::pageChanged, this, &Workspace::pageChanged);
+        connect(sub, &Workspace::itemChanged, this, &Workspace::itemChanged);
+        connect(sub, &Workspace::pageRemoved, this, &Workspace::pageRemoved);
+        addSubspaceLink(sub);
+    }
+}
+
+void Workspace::addSubspaceLink(Workspace *sub)
+{
+    // Добавляем ссылку-элемент, если его нет
+    for (auto *item : _items) {
+        if (item->type() == "SubspaceLinkItem") {
+            auto *link = static_cast<SubspaceLinkItem *>(item);
+            if (link->getLinkedWorkspace() == sub)
+                return;
         }
     }
+    auto *linkItem = new SubspaceLinkItem(sub, this);
+    connect(linkItem, &SubspaceLinkItem::subspaceLinkClicked, this, &Workspace::subWorkspaceClicked);
+    addItem(linkItem);
 }
 void Workspace::removeSubWorkspace(Workspace *sub)
 {
-    _subWorkspaces.removeOne(sub);
+    if (!_subWorkspaces.removeOne(sub))
+        return;
     if (sub->getParentWorkspace() == this)
         sub->setParentWorkspace(nullptr);
+    disconnect(sub, &Workspace::pageChanged, this, &Workspace::pageChanged);
+    disconnect(sub, &Workspace::itemChanged, this, &Workspace::itemChanged);
+    disconnect(sub, &Workspace::pageRemoved, this, &Workspace::pageRemoved);
+    emit pageRemoved(sub->getId());
+    markDirty();
 }
 bool Workspace::hasSubWorkspaceWithTitle(const QString &title) const
 {
@@ -480,6 +563,77 @@ QString Workspace::getPath() const
     return names.join("/");
 }
 
+QString Workspace::getId() const
+{
+    return _id;
+}
+
+void Workspace::setId(const QString &id)
+{
+    if (!id.isEmpty())
+        _id = id;
+}
+
+void Workspace::setReadOnly(bool readOnly)
+{
+    _readOnly = readOnly;
+    if (_menuButton)
+        _menuButton->setVisible(!readOnly);
+    for (AbstractWorkspaceItem *item : _items) applyReadOnly(item);
+}
+
+bool Workspace::isReadOnly() const
+{
+    return _readOnly;
+}
+
+void Workspace::setUnreadable(bool unreadable)
+{
+    _unreadable = unreadable;
+    setReadOnly(unreadable);
+}
+
+bool Workspace::isUnreadable() const
+{
+    return _unreadable;
+}
+
+void Workspace::applyReadOnly(AbstractWorkspaceItem *item)
+{
+    // Ссылки на подпространства остаются кликабельными - по ним идёт навигация
+    if (item->type() == "SubspaceLinkItem")
+        return;
+    item->setAttribute(Qt::WA_TransparentForMouseEvents, _readOnly);
+    if (auto *image = qobject_cast<ImageItem *>(item))
+        image->setReleaseWhenHidden(_readOnly);
+}
+
+bool Workspace::isDirty() const
+{
+    return _dirty;
+}
+
+void Workspace::markDirty()
+{
+    _dirty = true;
+    emit pageChanged(this);
+}
+
+void Workspace::onItemContentChanged(AbstractWorkspaceItem *item)
+{
+    // Правка внутри элемента журналируется одним элементом, а не всей страницей
+    _dirty = true;
+    emit itemChanged(this, item);
+}
+
+void Workspace::clearDirty(bool recursive)
+{
+    _dirty = false;
+    if (recursive) {
+        for (Workspace *sub : _subWorkspaces) sub->clearDirty(true);
+    }
+}
+
 QString Workspace::getVersion() const
 {
     return _version;
@@ -509,28 +663,11 @@ void Workspace::setOwner(const QString &owner)
     _owner = owner;
 }
 
-// --- ICON SERIALIZATION UTILS ---
-QString iconToBase64(const QIcon& icon, int size = 64) {
-    if (icon.isNull()) return QString();
-    QPixmap pixmap = icon.pixmap(size, size);
-    QByteArray ba;
-    QBuffer buffer(&ba);
-    buffer.open(QIODevice::WriteOnly);
-    pixmap.save(&buffer, "PNG");
-    return QString::fromLatin1(ba.toBase64());
-}
-
-QIcon base64ToIcon(const QString& base64) {
-    QByteArray ba = QByteArray::fromBase64(base64.toLatin1());
-    QPixmap pixmap;
-    pixmap.loadFromData(ba, "PNG");
-    return QIcon(pixmap);
-}
-
 // --- BACKEND SERIALIZATION ---
-QJsonObject Workspace::serializeBackend(bool isMain) const
+QJsonObject Workspace::serializePage(bool isMain) const
 {
     QJsonObject json;
+    json["id"] = _id;
     json["title"] = _title;
     json["status"] = (_status == NotStarted   ? "not_started"
                       : _status == InProgress ? "in_progress"
@@ -539,17 +676,24 @@ QJsonObject Workspace::serializeBackend(bool isMain) const
     json["is_main"] = isMain;
 
     // --- ICON ---
-    if (!_icon.isNull()) {
-        json["icon"] = iconToBase64(_icon);
+    if (!_iconDigest.isEmpty()) {
+        json["iconDigest"] = _iconDigest;
     }
 
     // Сериализация элементов (items) как elements
     QJsonArray elementsArray;
     for (const AbstractWorkspaceItem *item : _items) {
-        elementsArray.append(item->serialize());
+        elementsArray.append(serializeItem(item));
     }
     json["elements"] = elementsArray;
 
+    return json;
+}
+
+QJsonObject Workspace::serializeBackend(bool isMain) const
+{
+    QJsonObject json = serializePage(isMain);
+
     // Сериализация вложенных страниц (subWorkspaces) как pages
     QJsonArray pagesArray;
     for (const Workspace *sub : _subWorkspaces) {
@@ -560,8 +704,28 @@ QJsonObject Workspace::serializeBackend(bool isMain) const
     return json;
 }
 
-void Workspace::deserializeBackend(const QJsonObject &json, bool isMain)
+void Workspace::reloadPage(const QJsonObject &json)
 {
+    // Страницу переписали на диске: это не правка пользователя, журналировать
+    // её и помечать страницу изменённой не нужно
+    const QSignalBlocker blocker(this);
+
+    for (AbstractWorkspaceItem *item : std::as_const(_items)) {
+        _layout->removeWidget(item);
+        item->deleteLater();
+    }
+    _items.clear();
+
+    deserializePage(json);
+    for (Workspace *sub : std::as_const(_subWorkspaces)) addSubspaceLink(sub);
+    updateContentSize();
+    _dirty = false;
+}
+
+void Workspace::deserializePage(const QJsonObject &json)
+{
+    if (json.contains("id"))
+        setId(json["id"].toString());
     if (json.contains("title"))
         setTitle(json["title"].toString());
     if (json.contains("status")) {
@@ -577,8 +741,12 @@ void Workspace::deserializeBackend(const QJsonObject &json, bool isMain)
         _createdAt = json["created_at"].toString();
 
     // --- ICON ---
-    if (json.contains("icon")) {
-        setIcon(base64ToIcon(json["icon"].toString()));
+    if (json.contains("iconDigest")) {
+        QString digest = json["iconDigest"].toString();
+        setIcon(QIcon(IconCache::instance().source(digest)), digest);
+    } else if (json.contains("icon")) {
+        // Старый формат и данные с сервера: base64 прямо в странице
+        setIcon(pngToIcon(QByteArray::fromBase64(json["icon"].toString().toLatin1())));
     }
 
     // is_main можно использовать для логики, если нужно
@@ -588,6 +756,11 @@ void Workspace::deserializeBackend(const QJsonObject &json, bool isMain)
         QJsonArray elementsArray = json["elements"].toArray();
         deserializeItems(elementsArray);
     }
+}
+
+void Workspace::deserializeBackend(const QJsonObject &json, bool isMain)
+{
+    deserializePage(json);
 
     // Десериализация вложенных страниц
     if (json.contains("pages")) {
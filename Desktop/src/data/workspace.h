@@ -11,6 +11,7 @@
 #include <QPointer>
 #include <QLabel>
 #include <QScrollArea>
+#include <QToolButton>
 
 class Workspace : public QWidget
 {
@@ -29,14 +30,17 @@ public:
     void deserialize(const QJsonObject &json);
 
     void deserializeItems(const QJsonArray &itemsArray);
+    // JSON элемента вместе с его elementId
+    static QJsonObject serializeItem(const AbstractWorkspaceItem *item);
 
     QList<AbstractWorkspaceItem *> getItems() const;
 
     void addItemByType(const QString &type);
 
-    void setIcon(const QIcon &icon);
+    void setIcon(const QIcon &icon, const QString &iconDigest = QString());
     QLabel *getIconLabel();
     QIcon getIcon() const;
+    QString getIconDigest() const;
 
     // --- ВЛОЖЕННОСТЬ ---
     Workspace *getParentWorkspace() const;
@@ -50,6 +54,24 @@ public:
 
     QString getPath() const;
 
+    // Постоянный идентификатор страницы (имя шарда в хранилище)
+    QString getId() const;
+    void setId(const QString &id);
+
+    // Просмотр без редактирования: меню добавления скрыто, элементы не принимают ввод
+    void setReadOnly(bool readOnly);
+    bool isReadOnly() const;
+
+    // Содержимое страницы не прочитано из хранилища: она только для чтения
+    // и не сохраняется, чтобы не затереть то, что ещё можно восстановить
+    void setUnreadable(bool unreadable);
+    bool isUnreadable() const;
+
+    // Страница изменилась с момента последнего сохранения
+    bool isDirty() const;
+    void markDirty();
+    void clearDirty(bool recursive = false);
+
     // Version management
     QString getVersion() const;
     void setVersion(const QString &version);
@@ -71,15 +93,30 @@ public:
     QJsonObject serializeBackend(bool isMain = false) const;
     void deserializeBackend(const QJsonObject &json, bool isMain = false);
 
+    // Одна страница без вложенных "pages" (для постраничного хранения)
+    QJsonObject serializePage(bool isMain = false) const;
+    void deserializePage(const QJsonObject &json);
+    // Заменяет содержимое страницы версией с диска, не трогая подстраницы
+    void reloadPage(const QJsonObject &json);
+
 public slots:
     Workspace *getRootWorkspace();
 signals:
     void subWorkspaceClicked(Workspace *subspace);
     void addSubspaceRequested();
 
+    // Изменения для журнала хранилища; сигналы подстраниц пробрасываются до корня
+    void pageChanged(Workspace *page);
+    void itemChanged(Workspace *page, AbstractWorkspaceItem *item);
+    void pageRemoved(const QString &pageId);
+
 private:
     void updateContentSize();
+    void onItemContentChanged(AbstractWorkspaceItem *item);
+    void addSubspaceLink(Workspace *sub);
+    void applyReadOnly(AbstractWorkspaceItem *item);
 
+    QString _id;
     QString _title;
     QString _version;
     QString _owner;
@@ -89,7 +126,9 @@ private:
     QPointer<QWidget> _contentWidget;
     QPointer<QLabel> _titleLabel;
     QPointer<QLabel> _iconLabel;
+    QPointer<QToolButton> _menuButton;
     QIcon _icon;
+    QString _iconDigest;
 
     QList<AbstractWorkspaceItem *> _items;
     QSpacerItem *_spacerItem { nullptr };
@@ -99,6 +138,11 @@ private:
 
     Status _status = NotStarted;
     QString _createdAt;
+
+    // Новая страница ещё ни разу не записана
+    bool _dirty { true };
+    bool _readOnly { false };
+    bool _unreadable { false };
 };
 
 #endif // WORKSPACE_H
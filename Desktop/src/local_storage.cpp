@@ -1,19 +1,213 @@
 #include "local_storage.h"
+#include "storage/blob_store.h"
+#include "storage/workspace_directory.h"
+#include "storage/workspace_archive.h"
+#include "storage/storage_verifier.h"
+#include "storage/page_locks.h"
+#include "storage/workspace_history.h"
+#include "storage/storage_cipher.h"
+#include "storage/workspace_bundle.h"
+#include "storage/storage_backup.h"
+#include "storage/storage_engine.h"
+#include "storage/storage_watcher.h"
+#include "settings/settings_manager.h"
 #include <QJsonDocument>
+#include <QHash>
+#include <QThreadPool>
 #include <QFile>
+#include <QSaveFile>
+#include <QFileInfo>
+#include <QSet>
+#include <QUuid>
 #include <qapplication.h>
 #include <qbuffer.h>
 #include <QDebug>
 #include <QMessageBox>
+#include <algorithm>
+#include <functional>
 
-LocalStorage::LocalStorage(QObject *parent) : QObject(parent)
+namespace {
+// Сколько копятся правки до записи в журнал одной пачкой
+constexpr int JournalFlushDelayMs = 300;
+
+// Страница без id с сервера получает id локальной страницы с тем же названием
+// на том же месте дерева. localIndex - индекс этой страницы в local, -1 - её нет.
+void adoptLocalIds(Workspace *page, const QJsonObject &json, qint32 localIndex,
+                   const QList<CatalogEntry> &local, QSet<qint32> &used)
+{
+    if (localIndex >= 0 && !json.contains("id"))
+        page->setId(local[localIndex].id);
+
+    const QList<Workspace *> subs = page->getSubWorkspaces();
+    const QJsonArray pagesJson = json["pages"].toArray();
+    for (int i = 0; i < subs.size(); ++i) {
+        qint32 match = -1;
+        for (qint32 j = 0; localIndex >= 0 && j < qint32(local.size()); ++j) {
+            if (local[j].parent == localIndex && !used.contains(j)
+                && local[j].title == subs[i]->getTitle()) {
+                match = j;
+                break;
+            }
+        }
+        if (match >= 0)
+            used.insert(match);
+        adoptLocalIds(subs[i], pagesJson.at(i).toObject(), match, local, used);
+    }
+}
+
+// Сколько дней blob без ссылок не удаляется
+constexpr int BlobGraceDays = 1;
+
+void externalizePage(QJsonObject &page)
+{
+    BlobStore::instance().externalizeBlobs(page);
+}
+
+void markElement(const QJsonObject &element, QSet<QString> &referenced)
+{
+    const QString digest = element["imageDigest"].toString();
+    if (!digest.isEmpty())
+        referenced.insert(digest);
+}
+
+void markPage(const QJsonObject &page, QSet<QString> &referenced)
+{
+    const QString digest = page["iconDigest"].toString();
+    if (!digest.isEmpty())
+        referenced.insert(digest);
+    const QJsonArray elements = page["elements"].toArray();
+    for (const QJsonValue &element : elements) markElement(element.toObject(), referenced);
+}
+
+// Ссылки на blob из всех пространств basePath: страниц, версий истории и журналов,
+// в том числе оставшихся от пространств, которых уже нет в движке.
+// false - что-то не прочитать (повреждение, чужой ключ шифрования).
+bool markBlobs(const QString &basePath, QSet<QString> &referenced)
+{
+    QSet<QString> folders;
+    const QStringList stored = StorageEngine::instance().workspaces(basePath);
+    for (const QString &folder : stored) folders.insert(folder);
+    const QStringList directories = QDir(basePath).entryList(QDir::Dirs | QDir::NoDotAndDotDot);
+    for (const QString &folder : directories) folders.insert(folder);
+
+    for (const QString &folder : std::as_const(folders)) {
+        const QString workspacePath = basePath + folder + "/";
+        PageLocker locker(workspacePath);
+
+        if (StorageEngine::instance().contains(workspacePath)) {
+            QList<PageRecord> pages;
+            if (!StorageEngine::instance().readPages(workspacePath, pages))
+                return false;
+            // Ссылки непрочитанной страницы неизвестны - её blob собирать нельзя
+            for (const PageRecord &page : pages) {
+                if (page.placeholder)
+                    return false;
+                markPage(page.page, referenced);
+            }
+        }
+
+        WorkspaceHistory history(workspacePath + WorkspaceDirectory::HistoryFileName);
+        if (!history.forEachStoredPage(
+             [&referenced](const QJsonObject &page) { markPage(page, referenced); })) {
+            return false;
+        }
+
+        QList<WorkspaceJournal::Record> records;
+        if (!WorkspaceJournal(workspacePath + WorkspaceDirectory::JournalFileName).scan(records))
+            return false;
+        for (const WorkspaceJournal::Record &record : std::as_const(records)) {
+            if (record.operation == WorkspaceJournal::PageUpdate)
+                markPage(record.payload, referenced);
+            else if (record.operation == WorkspaceJournal::ElementUpdate)
+                markElement(record.payload, referenced);
+        }
+    }
+    return true;
+}
+// Секции переносятся в шарды как есть; разбираются только страницы, у которых
+// меняется id или название. Индекс пишется последним: без него пространства нет.
+bool copyBundle(const QString &filePath, const QString &workspacePath,
+                const QList<WorkspaceContainer::IndexEntry> &index, bool copy, bool renamed)
+{
+    PageLocker locker(workspacePath);
+    WorkspaceBundle bundle;
+    bool written = bundle.open(filePath) && bundle.pages().size() == index.size();
+    for (int i = 0; written && i < index.size(); ++i) {
+        QByteArray section;
+        written = bundle.readPageSection(i, section);
+        if (written && (copy || (i == 0 && renamed))) {
+            QJsonObject page;
+            written = WorkspaceContainer::decodePage(section, page);
+            page["id"] = index[i].id;
+            page["title"] = index[i].title;
+            section = WorkspaceContainer::encodePage(page);
+        }
+        written = written
+                  && StorageEngine::instance().writePageSection(workspacePath, index[i].id,
+                                                                section);
+    }
+
+    // Уже известные blob не читаются вовсе
+    for (const WorkspaceBundle::BlobEntry &blob : bundle.blobs()) {
+        if (!written || BlobStore::instance().contains(blob.digest))
+            continue;
+        QByteArray data;
+        if (!bundle.readBlob(blob, data) || BlobStore::instance().put(data) != blob.digest)
+            qWarning() << "Failed to import blob" << blob.digest << "from" << filePath;
+    }
+
+    if (!written || !StorageEngine::instance().writeIndex(workspacePath, index)) {
+        qWarning() << "Failed to import workspace file:" << filePath;
+        StorageEngine::instance().remove(workspacePath);
+        return false;
+    }
+    return true;
+}
+} // namespace
+
+LocalStorage::LocalStorage(QObject *parent) :
+    QObject(parent),
+    persistenceWorker(new PersistenceWorker(this)),
+    journalTimer(new QTimer(this))
 {
     initializePaths();
+
+    journalTimer->setSingleShot(true);
+    journalTimer->setInterval(JournalFlushDelayMs);
+    connect(journalTimer, &QTimer::timeout, this, &LocalStorage::flushJournals);
+
+    connect(persistenceWorker, &PersistenceWorker::snapshotSaved, this,
+            &LocalStorage::onSnapshotSaved);
+    connect(persistenceWorker, &PersistenceWorker::snapshotFailed, this,
+            &LocalStorage::onSnapshotFailed);
+
+    // Включение шифрования касается новых записей, старые файлы читаются как есть
+    StorageCipher::instance().setEnabled(SettingsManager::instance().encryptStorage());
+    connect(&SettingsManager::instance(), &SettingsManager::storageSettingsChanged, this, []() {
+        StorageCipher::instance().setEnabled(SettingsManager::instance().encryptStorage());
+    });
+
+    // Движок выбирается при запуске: смена на ходу оставила бы открытые пространства
+    // в прежнем. Пространства прежнего движка переносятся при загрузке каталога.
+    if (SettingsManager::instance().storageEngine() == "sqlite"
+        && !StorageEngine::select(StorageEngine::Sqlite)) {
+        qWarning() << "SQLite storage is not available in this build, using directories";
+    }
+}
+
+LocalStorage::~LocalStorage()
+{
+    flushJournals();
+}
+
+QString LocalStorage::storageRootPath()
+{
+    return QApplication::applicationDirPath() + "/Workspaces/";
 }
 
 void LocalStorage::initializePaths()
 {
-    storagePath = QApplication::applicationDirPath() + "/Workspaces/";
+    storagePath = storageRootPath();
     guestPath = storagePath + "guest/";
     userPath = storagePath + "users/";
 
@@ -43,6 +237,7 @@ void LocalStorage::setCurrentUser(const QString &username)
 {
     currentUser = username;
     QDir().mkpath(getUserWorkspacePath());
+    StorageCipher::instance().setUser(username);
 }
 
 QString LocalStorage::getCurrentUser() const
@@ -52,121 +247,1142 @@ QString LocalStorage::getCurrentUser() const
 
 void LocalStorage::clearUserData()
 {
+    persistenceWorker->waitForIdle();
+    importPool.waitForDone();
+    importingPaths.clear();
+
     QDir userDir(userPath);
     if (userDir.exists()) {
         userDir.removeRecursively();
         QDir().mkpath(userPath); // пересоздать пустую папку users
     }
+    journals.clear();
+    pendingJournals.clear();
     currentUser.clear();
+    StorageCipher::instance().setUser(QString());
+}
+
+WorkspaceSnapshot LocalStorage::takeSnapshot(Workspace *workspace, bool isGuest)
+{
+    WorkspaceSnapshot snapshot;
+    snapshot.basePath = getWorkspacePath(isGuest);
+    snapshot.workspaceTitle = workspace->getTitle();
+    snapshot.workspaceId = workspace->getId();
+    snapshot.workspacePath = snapshot.basePath + snapshot.workspaceId + "/";
+
+    // Накопленные правки попадают в журнал до снимка: их отбросит discardPrefix
+    // только после того, как снимок будет записан. В новый каталог (первое
+    // сохранение) пишется всё дерево, журнал ему не нужен.
+    const bool fullWrite = !StorageEngine::instance().contains(snapshot.workspacePath);
+    if (fullWrite)
+        pendingJournals.remove(snapshot.workspacePath);
+    else
+        flushJournal(snapshot.workspacePath);
+    snapshot.journalSize = journalFor(snapshot.workspacePath)->size();
+
+    QList<Workspace *> pages;
+    saveWorkspaceRecursive(workspace, -1, snapshot.index, pages);
+
+    // Берём только изменённые страницы и те, чья прошлая запись не удалась
+    const QSet<QString> unsaved = unsavedPages.take(snapshot.workspacePath);
+    snapshot.structureChanged = changedStructures.remove(snapshot.workspacePath);
+    for (Workspace *page : pages) {
+        // Пустая заглушка непрочитанной страницы не должна лечь поверх её шарда
+        if (page->isUnreadable())
+            continue;
+        if (!fullWrite && !page->isDirty() && !unsaved.contains(page->getId()))
+            continue;
+        snapshot.pages.insert(page->getId(), page->serializePage());
+        page->clearDirty();
+    }
+    // Удаление страницы не трогает тела оставшихся, но индекс переписать нужно
+    if (snapshot.isEmpty())
+        return snapshot;
+
+    // Номер получает только снимок, который будет записан: пустой не должен
+    // отменять обновление каталога и журнала по предыдущему
+    snapshot.generation = ++saveGenerations[snapshot.workspacePath];
+    snapshot.catalog.reserve(pages.size());
+    for (int i = 0; i < pages.size(); ++i) {
+        CatalogEntry entry;
+        entry.workspace = snapshot.workspaceTitle;
+        entry.parent = snapshot.index[i].parent;
+        entry.id = pages[i]->getId();
+        entry.title = pages[i]->getTitle();
+        entry.iconDigest = pages[i]->getIconDigest();
+        entry.status = pages[i]->getStatusString();
+        entry.createdAt = pages[i]->getCreatedAt();
+        entry.itemCount = qint32(pages[i]->getItems().size());
+        snapshot.catalog.append(entry);
+    }
+    return snapshot;
 }
 
 void LocalStorage::saveWorkspace(Workspace *workspace, bool isGuest)
+{
+    saveWorkspace(workspace, isGuest, false);
+}
+
+void LocalStorage::saveWorkspace(Workspace *workspace, bool isGuest, bool external)
 {
     if (!workspace)
         return;
 
-    QString ownerUsername = workspace->getOwner();
-    QString workspacePath;
+    // Фоновые снимки того же пространства не должны лечь поверх этой записи
+    persistenceWorker->waitForIdle();
 
-    if (isGuest) {
-        workspacePath = guestPath + workspace->getTitle() + "/";
+    WorkspaceSnapshot snapshot = takeSnapshot(workspace, isGuest);
+    snapshot.external = external;
+    if (snapshot.isEmpty()) {
+        // Журнал всё равно очищается ниже - фоновый снимок, записанный раньше,
+        // не должен потом отрезать от него префикс
+        ++saveGenerations[snapshot.workspacePath];
     } else {
-        workspacePath = getUserWorkspacePath() + workspace->getTitle() + "/";
+        QString error;
+        if (!PersistenceWorker::writeSnapshot(snapshot, error)) {
+            qWarning() << error;
+            unsavedPages[snapshot.workspacePath].unite(QSet<QString>(
+             snapshot.pages.keyBegin(), snapshot.pages.keyEnd()));
+            if (snapshot.structureChanged)
+                changedStructures.insert(snapshot.workspacePath);
+            return;
+        }
+        updateCatalog(snapshot.basePath, snapshot.workspaceId, snapshot.catalog);
+    }
+
+    // Контрольная точка: всё из журнала уже лежит в шардах
+    resetJournal(snapshot.workspacePath);
+    emit workspaceSaved(snapshot.workspaceId, snapshot.workspaceTitle);
+}
+
+bool LocalStorage::saveWorkspaceAsync(Workspace *workspace, bool isGuest)
+{
+    if (!workspace)
+        return false;
+
+    const WorkspaceSnapshot snapshot = takeSnapshot(workspace, isGuest);
+    if (snapshot.isEmpty())
+        return false;
+    persistenceWorker->enqueue(snapshot);
+    return true;
+}
+
+void LocalStorage::waitForPendingSaves()
+{
+    persistenceWorker->waitForIdle();
+}
+
+void LocalStorage::onSnapshotSaved(const WorkspaceSnapshot &snapshot)
+{
+    // Более новый снимок или синхронное сохранение уже обновили каталог и журнал
+    if (saveGenerations.value(snapshot.workspacePath) == snapshot.generation) {
+        updateCatalog(snapshot.basePath, snapshot.workspaceId, snapshot.catalog);
+        journalFor(snapshot.workspacePath)->discardPrefix(snapshot.journalSize);
+    }
+    emit workspaceSaved(snapshot.workspaceId, snapshot.workspaceTitle);
+}
+
+void LocalStorage::onSnapshotFailed(const WorkspaceSnapshot &snapshot, const QString &error)
+{
+    qWarning() << "Background save failed:" << error;
+
+    // Страницы снимка уже помечены чистыми - запомним их для следующего сохранения.
+    // Журнал не трогаем: правки в нём остаются до успешной записи.
+    unsavedPages[snapshot.workspacePath].unite(
+     QSet<QString>(snapshot.pages.keyBegin(), snapshot.pages.keyEnd()));
+    if (snapshot.structureChanged)
+        changedStructures.insert(snapshot.workspacePath);
+    emit workspaceSaveFailed(snapshot.workspaceId, snapshot.workspaceTitle, error);
+}
+
+void LocalStorage::saveWorkspaceRecursive(Workspace *workspace, qint32 parent,
+                                          QList<WorkspaceContainer::IndexEntry> &index,
+                                          QList<Workspace *> &pages)
+{
+    WorkspaceContainer::IndexEntry entry;
+    entry.parent = parent;
+    entry.id = workspace->getId();
+    entry.title = workspace->getTitle();
+
+    const qint32 current = qint32(index.size());
+    index.append(entry);
+    pages.append(workspace);
+
+    for (Workspace *sub : workspace->getSubWorkspaces()) {
+        saveWorkspaceRecursive(sub, current, index, pages);
     }
+}
+
+bool LocalStorage::writePages(const QString &workspacePath, const QList<PageRecord> &pages)
+{
+    QList<WorkspaceContainer::IndexEntry> index;
+    QHash<QString, QJsonObject> written;
+    index.reserve(pages.size());
+    for (const PageRecord &record : pages) {
+        QJsonObject page = record.page;
+        if (page["id"].toString().isEmpty())
+            page["id"] = QUuid::createUuid().toString(QUuid::WithoutBraces);
+
+        WorkspaceContainer::IndexEntry entry;
+        entry.parent = record.parent;
+        entry.id = page["id"].toString();
+        entry.title = page["title"].toString();
+        index.append(entry);
+        // Непрочитанная страница остаётся в индексе, её шард не перезаписывается
+        if (record.placeholder)
+            continue;
+        if (!StorageEngine::instance().writePage(workspacePath, entry.id, page))
+            return false;
+        written.insert(entry.id, page);
+    }
+    if (!StorageEngine::instance().writeIndex(workspacePath, index))
+        return false;
 
     QDir().mkpath(workspacePath);
+    WorkspaceHistory history(workspacePath + WorkspaceDirectory::HistoryFileName);
+    if (!history.record(workspacePath, index, written))
+        qWarning() << "Failed to record history of" << workspacePath;
 
-    QFile file(workspacePath + "workspace.json");
+    // Дерево записано целиком, старые правки из журнала к нему не относятся
+    resetJournal(workspacePath);
+    return true;
+}
+
+QString LocalStorage::catalogPath(const QString &basePath) const
+{
+    return basePath + WorkspaceCatalog::FileName;
+}
+
+bool LocalStorage::readCatalog(const QString &basePath, QList<CatalogEntry> &catalog) const
+{
+    QFile file(catalogPath(basePath));
+    if (!file.open(QIODevice::ReadOnly))
+        return false;
+
+    QByteArray data;
+    QBuffer buffer;
+    if (!StorageCipher::instance().open(file.readAll(), data))
+        return false;
+    buffer.setData(data);
+    if (!buffer.open(QIODevice::ReadOnly) || !WorkspaceCatalog::read(&buffer, catalog)) {
+        qWarning() << "Invalid workspace catalog:" << file.fileName();
+        return false;
+    }
+    return true;
+}
+
+bool LocalStorage::writeCatalog(const QString &basePath, const QList<CatalogEntry> &catalog)
+{
+    QSaveFile file(catalogPath(basePath));
     if (!file.open(QIODevice::WriteOnly)) {
-        qWarning() << "Failed to open workspace file for writing:" << file.errorString();
+        qWarning() << "Failed to open catalog for writing:" << file.errorString();
+        return false;
+    }
+    QByteArray data;
+    QBuffer buffer(&data);
+    QByteArray sealed;
+    if (!buffer.open(QIODevice::WriteOnly) || !WorkspaceCatalog::write(&buffer, catalog)
+        || !StorageCipher::instance().seal(data, sealed) || file.write(sealed) != sealed.size()
+        || !file.commit()) {
+        qWarning() << "Failed to write catalog:" << file.errorString();
+        return false;
+    }
+    StorageWatcher::recordOwnWrite(catalogPath(basePath));
+    return true;
+}
+
+void LocalStorage::updateCatalog(const QString &basePath, const QString &workspaceId,
+                                 const QList<CatalogEntry> &entries)
+{
+    QList<CatalogEntry> catalog;
+    readCatalog(basePath, catalog);
+
+    WorkspaceCatalog::replaceWorkspace(catalog, workspaceId, entries);
+    writeCatalog(basePath, catalog);
+    rememberDirectories(basePath, catalog);
+}
+
+void LocalStorage::rememberDirectories(const QString &basePath, const QList<CatalogEntry> &catalog)
+{
+    QHash<QString, QString> &directories = workspaceDirs[basePath];
+    directories.clear();
+    for (const CatalogEntry &entry : catalog) {
+        if (entry.parent < 0)
+            directories.insert(entry.workspace, entry.id);
+    }
+}
+
+QString LocalStorage::workspaceDirectory(const QString &workspace, bool isGuest) const
+{
+    // Каталог называется по id корневой страницы; название переводится в id через каталог.
+    // Неизвестное название - старый каталог по названию, который ещё не переименован.
+    const QString basePath = getWorkspacePath(isGuest);
+    const QString id = workspaceDirs.value(basePath).value(workspace);
+    if (!id.isEmpty() && StorageEngine::instance().contains(basePath + id + "/"))
+        return basePath + id + "/";
+    return basePath + workspace + "/";
+}
+
+bool LocalStorage::migrateDirectory(const QString &basePath, const QString &directory,
+                                    const QString &workspaceId)
+{
+    if (workspaceId.isEmpty() || directory == workspaceId
+        || QFileInfo::exists(basePath + workspaceId)) {
+        return false;
+    }
+
+    PageLocker locker(basePath + directory + "/");
+    journals.remove(basePath + directory + "/");
+    pendingJournals.remove(basePath + directory + "/");
+    if (!QDir(basePath).rename(directory, workspaceId)) {
+        qWarning() << "Failed to rename workspace directory" << directory << "to" << workspaceId;
+        return false;
+    }
+    return true;
+}
+
+QList<CatalogEntry> LocalStorage::loadCatalog(bool isGuest)
+{
+    const QString basePath = getWorkspacePath(isGuest);
+    verifyStorage(basePath);
+    adoptWorkspaces(basePath);
+
+    QList<CatalogEntry> catalog;
+    bool changed = !readCatalog(basePath, catalog);
+
+    QSet<QString> known; // id корней (каталоги на диске)
+    for (const CatalogEntry &entry : catalog) {
+        if (entry.parent < 0)
+            known.insert(entry.id);
+    }
+
+    // Каталог мог отстать: пространства удалены или записаны в обход LocalStorage
+    QSet<QString> present;
+    const QStringList folders = StorageEngine::instance().workspaces(basePath);
+    for (const QString &folder : folders) {
+        QString directory = folder;
+        const QString workspacePath = basePath + directory + "/";
+        present.insert(directory);
+
+        // Незавершённый журнал (аварийное завершение) сразу сводим в шарды. Журнал,
+        // который этот процесс уже открывал, - живой журнал открытого пространства:
+        // повторная загрузка каталога (например, после своей же записи) его не трогает
+        const bool recovered = !journals.contains(workspacePath)
+                               && !journalFor(workspacePath)->isEmpty()
+                               && replayJournal(workspacePath);
+        if (known.contains(directory) && !recovered)
+            continue;
+
+        QList<PageRecord> pages;
+        if (!StorageEngine::instance().readPages(workspacePath, pages) || pages.isEmpty())
+            continue;
+
+        // Каталог старого формата назван по названию пространства - переименовываем
+        // в id корня, данные при этом не переписываются
+        const QString workspaceId = pages.first().page["id"].toString();
+        if (migrateDirectory(basePath, directory, workspaceId)) {
+            present.remove(directory);
+            directory = workspaceId;
+            present.insert(directory);
+            if (known.contains(directory) && !recovered)
+                continue;
+        } else if (directory != workspaceId && known.contains(workspaceId)) {
+            continue; // устаревшая копия рядом с каталогом по id
+        }
+
+        const QString title = pages.first().page["title"].toString();
+        WorkspaceCatalog::replaceWorkspace(catalog, workspaceId,
+                                           WorkspaceCatalog::fromPages(title, pages));
+        changed = true;
+    }
+
+    for (const QString &rootId : std::as_const(known)) {
+        if (!present.contains(rootId) && !importingPaths.contains(basePath + rootId + "/")) {
+            WorkspaceCatalog::replaceWorkspace(catalog, rootId, QList<CatalogEntry>());
+            changed = true;
+        }
+    }
+
+    if (changed)
+        writeCatalog(basePath, catalog);
+    rememberDirectories(basePath, catalog);
+    collectBlobs();
+    return catalog;
+}
+
+void LocalStorage::collectBlobs()
+{
+    if (blobsCollected)
         return;
+    blobsCollected = true;
+
+    // Правки в памяти должны попасть в журналы, иначе их blob окажутся без ссылок
+    flushJournals();
+
+    QStringList basePaths;
+    basePaths << guestPath << userPath;
+    const QStringList users = QDir(userPath).entryList(QDir::Dirs | QDir::NoDotAndDotDot);
+    for (const QString &user : users) basePaths << userPath + user + "/";
+
+    QThreadPool::globalInstance()->start([basePaths]() {
+        QSet<QString> referenced;
+        for (const QString &basePath : basePaths) {
+            if (!markBlobs(basePath, referenced)) {
+                qWarning() << "Blob collection skipped, cannot read workspaces in" << basePath;
+                return;
+            }
+        }
+        const QDateTime writtenBefore = QDateTime::currentDateTime().addDays(-BlobGraceDays);
+        const int removed = BlobStore::instance().collect(referenced, writtenBefore);
+        if (removed > 0)
+            qDebug() << "Removed" << removed << "unreferenced blobs";
+    });
+}
+
+QList<CatalogEntry> LocalStorage::catalog(bool isGuest) const
+{
+    QList<CatalogEntry> entries;
+    readCatalog(getWorkspacePath(isGuest), entries);
+    return entries;
+}
+
+QStringList LocalStorage::listWorkspaces(bool isGuest)
+{
+    QStringList titles;
+    const QList<CatalogEntry> catalog = loadCatalog(isGuest);
+    for (const CatalogEntry &entry : catalog) {
+        if (entry.parent < 0)
+            titles.append(entry.workspace);
     }
+    return titles;
+}
+
+void LocalStorage::adoptWorkspaces(const QString &basePath)
+{
+    StorageEngine &target = StorageEngine::instance();
+    StorageEngine &source = StorageEngine::engine(StorageEngine::Directory);
+    if (&target == &source)
+        return;
+
+    // Пространства, записанные каталогами до смены движка, переносятся в него один раз.
+    // Журнал и история остаются в каталоге пространства, blob - в файлах BlobStore.
+    const QStringList stored = target.workspaces(basePath);
+    for (const QString &directory : source.workspaces(basePath)) {
+        QList<PageRecord> pages;
+        if (!source.readPages(basePath + directory + "/", pages) || pages.isEmpty())
+            continue;
+        const QString workspaceId = pages.first().page["id"].toString();
+        if (workspaceId.isEmpty() || stored.contains(workspaceId))
+            continue;
+        // Перенос потерял бы непрочитанные страницы - пространство остаётся в каталогах
+        if (std::any_of(pages.cbegin(), pages.cend(),
+                        [](const PageRecord &page) { return page.placeholder; })) {
+            qWarning() << "Workspace" << workspaceId << "has unreadable pages, not moving it";
+            continue;
+        }
+
+        const QString sourcePath =
+         basePath + (migrateDirectory(basePath, directory, workspaceId) ? workspaceId : directory)
+         + "/";
+        const QString workspacePath = basePath + workspaceId + "/";
+        PageLocker locker(workspacePath);
 
-    QJsonObject json;
-    saveWorkspaceRecursive(workspace, json);
-    QByteArray jsonData = QJsonDocument(json).toJson();
+        QList<WorkspaceContainer::IndexEntry> index;
+        bool written = true;
+        for (int i = 0; written && i < pages.size(); ++i) {
+            QJsonObject page = pages[i].page;
+            if (page["id"].toString().isEmpty())
+                page["id"] = QUuid::createUuid().toString(QUuid::WithoutBraces);
 
-    if (file.write(jsonData) == -1) {
-        qWarning() << "Failed to write workspace data:" << file.errorString();
+            WorkspaceContainer::IndexEntry entry;
+            entry.parent = pages[i].parent;
+            entry.id = page["id"].toString();
+            entry.title = page["title"].toString();
+            index.append(entry);
+            written = target.writePage(workspacePath, entry.id, page);
+        }
+        if (!written || !target.writeIndex(workspacePath, index)) {
+            qWarning() << "Failed to move workspace" << workspaceId << "to the storage engine";
+            target.remove(workspacePath);
+            continue;
+        }
+        source.remove(sourcePath);
     }
-    file.close();
+}
 
-    // Выводим содержимое json-файла после записи
-    // qDebug() << "[LocalStorage] Saved workspace to" << file.fileName();
-    // qDebug().noquote() << QJsonDocument::fromJson(jsonData).toJson(QJsonDocument::Indented);
+void LocalStorage::verifyStorage(const QString &basePath)
+{
+    // Проверяем каждый каталог один раз за запуск; общие blob - при первой проверке.
+    // Проверка идёт в фоне: пространство, которое сейчас проверяется, заблокировано
+    // в PageLocks, и загрузка или запись дождутся его починки.
+    if (verifiedPaths.contains(basePath))
+        return;
+    const bool includeBlobs = verifiedPaths.isEmpty();
+    verifiedPaths.insert(basePath);
+
+    QPointer<LocalStorage> self(this);
+    QThreadPool::globalInstance()->start([self, basePath, includeBlobs]() {
+        const StorageVerifyReport report = StorageVerifier::verify(basePath, includeBlobs);
+        if (report.quarantined == 0 && report.lost.isEmpty())
+            return;
+        QMetaObject::invokeMethod(
+         qApp,
+         [self, report]() {
+             if (self)
+                 emit self->storageRepaired(report.repaired, report.lost);
+         },
+         Qt::QueuedConnection);
+    });
+}
+
+WorkspaceJournal *LocalStorage::journalFor(const QString &workspacePath)
+{
+    QSharedPointer<WorkspaceJournal> &journal = journals[workspacePath];
+    if (!journal)
+        journal.reset(new WorkspaceJournal(workspacePath + WorkspaceDirectory::JournalFileName));
+    return journal.data();
 }
 
-void LocalStorage::saveWorkspaceRecursive(Workspace *workspace, QJsonObject &json)
+void LocalStorage::resetJournal(const QString &workspacePath)
 {
-    json = workspace->serializeBackend();
+    WorkspaceJournal *journal = journalFor(workspacePath);
+    if (!journal->isEmpty())
+        journal->reset();
+}
+
+LocalStorage::PendingJournal &LocalStorage::pendingJournal(Workspace *root, bool isGuest)
+{
+    const QString workspacePath = getWorkspacePath(isGuest) + root->getId() + "/";
+    PendingJournal &pending = pendingJournals[workspacePath];
+    pending.root = root;
+    pending.isGuest = isGuest;
+
+    // Таймер не перезапускается: правка ждёт записи не дольше JournalFlushDelayMs
+    if (!journalTimer->isActive())
+        journalTimer->start();
+    return pending;
+}
+
+void LocalStorage::journalPageUpdate(Workspace *root, Workspace *page, bool isGuest)
+{
+    if (!root || !page)
+        return;
+
+    PendingJournal &pending = pendingJournal(root, isGuest);
+    if (!pending.pages.contains(page))
+        pending.pages.append(page);
+}
+
+void LocalStorage::journalElementUpdate(Workspace *root, Workspace *page,
+                                        AbstractWorkspaceItem *item, bool isGuest)
+{
+    if (!root || !page || !item)
+        return;
+
+    PendingJournal &pending = pendingJournal(root, isGuest);
+    const QPair<QPointer<Workspace>, QPointer<AbstractWorkspaceItem>> element(page, item);
+    if (!pending.elements.contains(element))
+        pending.elements.append(element);
+}
+
+void LocalStorage::journalPageRemove(Workspace *root, const QString &pageId, bool isGuest)
+{
+    if (!root)
+        return;
+
+    PendingJournal &pending = pendingJournal(root, isGuest);
+    if (!pending.removed.contains(pageId))
+        pending.removed.append(pageId);
+    changedStructures.insert(getWorkspacePath(isGuest) + root->getId() + "/");
+}
+
+void LocalStorage::flushJournals()
+{
+    journalTimer->stop();
+    const QStringList paths = pendingJournals.keys();
+    for (const QString &workspacePath : paths) flushJournal(workspacePath);
+}
+
+void LocalStorage::flushJournal(const QString &workspacePath)
+{
+    const PendingJournal pending = pendingJournals.take(workspacePath);
+    if (!pending.root)
+        return;
+
+    // Журнал дополняет уже записанное дерево. Новое пространство ещё не записано
+    // и сохраняется целиком.
+    if (!StorageEngine::instance().contains(workspacePath)) {
+        saveWorkspace(pending.root, pending.isGuest);
+        return;
+    }
+
+    // Содержимое берётся в момент записи: из серии правок в журнал попадает последняя.
+    // Удаления идут последними - после них обновлять удалённые страницы нечего.
+    WorkspaceJournal *journal = journalFor(workspacePath);
+    QList<WorkspaceJournal::Record> records;
+    QSet<Workspace *> updatedPages;
+    for (const QPointer<Workspace> &page : pending.pages) {
+        if (!page)
+            continue;
+        WorkspaceJournal::Record record;
+        record.operation = WorkspaceJournal::PageUpdate;
+        record.pageId = page->getId();
+        if (Workspace *owner = page->getParentWorkspace())
+            record.parentId = owner->getId();
+        record.payload = page->serializePage();
+        records.append(record);
+        updatedPages.insert(page);
+    }
+
+    for (const auto &element : pending.elements) {
+        Workspace *page = element.first;
+        AbstractWorkspaceItem *item = element.second;
+        // Страница целиком уже несёт последнюю версию элемента
+        if (!page || !item || updatedPages.contains(page))
+            continue;
+        const qint32 index = qint32(page->getItems().indexOf(item));
+        if (index < 0)
+            continue;
+
+        WorkspaceJournal::Record record;
+        record.operation = WorkspaceJournal::ElementUpdate;
+        record.pageId = page->getId();
+        record.index = index;
+        record.elementId = item->elementId();
+        record.payload = Workspace::serializeItem(item);
+        records.append(record);
+    }
+
+    for (const QString &pageId : pending.removed) {
+        WorkspaceJournal::Record record;
+        record.operation = WorkspaceJournal::PageRemove;
+        record.pageId = pageId;
+        records.append(record);
+    }
+
+    if (!journal->append(records)) {
+        // Без журнала правка не должна потеряться - сохраняем сразу
+        saveWorkspace(pending.root, pending.isGuest);
+    }
+}
+
+bool LocalStorage::replayJournal(const QString &workspacePath)
+{
+    WorkspaceJournal *journal = journalFor(workspacePath);
+    if (journal->isEmpty())
+        return true;
+
+    // Чтение шардов и запись результата - одна операция для других потоков
+    PageLocker locker(workspacePath);
+    const QList<WorkspaceJournal::Record> records = journal->readAll();
+    if (records.isEmpty())
+        return true;
+
+    QList<PageRecord> pages;
+    if (!StorageEngine::instance().readPages(workspacePath, pages) || pages.isEmpty()) {
+        qWarning() << "Cannot replay journal without a stored workspace:" << workspacePath;
+        return false;
+    }
+
+    // Плоский список -> страницы по id; порядок обхода восстанавливается после применения
+    QStringList order;
+    QHash<QString, QJsonObject> pageById;
+    QHash<QString, QString> parentOf;
+    QSet<QString> unreadable;
+    for (const PageRecord &record : pages) {
+        const QString id = record.page["id"].toString();
+        order.append(id);
+        pageById.insert(id, record.page);
+        if (record.placeholder)
+            unreadable.insert(id);
+        parentOf.insert(id, record.parent >= 0 ? order.value(record.parent) : QString());
+    }
+
+    for (const WorkspaceJournal::Record &record : records) {
+        switch (record.operation) {
+        case WorkspaceJournal::PageUpdate:
+            if (!pageById.contains(record.pageId)) {
+                order.append(record.pageId);
+                parentOf.insert(record.pageId, record.parentId);
+            } else if (!record.parentId.isEmpty()) {
+                parentOf[record.pageId] = record.parentId;
+            }
+            pageById.insert(record.pageId, record.payload);
+            unreadable.remove(record.pageId); // страница записана целиком
+            break;
+        case WorkspaceJournal::ElementUpdate: {
+            auto it = pageById.find(record.pageId);
+            if (it == pageById.end())
+                break;
+            // Элемент ищется по elementId; старые записи и шарды без id - по индексу
+            QJsonArray elements = it->value("elements").toArray();
+            qint32 index = -1;
+            for (qint32 i = 0; i < elements.size() && !record.elementId.isEmpty(); ++i) {
+                if (elements[i].toObject()["elementId"].toString() == record.elementId) {
+                    index = i;
+                    break;
+                }
+            }
+            if (index < 0)
+                index = record.index;
+            if (index >= 0 && index < elements.size()) {
+                elements[index] = record.payload;
+                it->insert("elements", elements);
+            }
+            break;
+        }
+        case WorkspaceJournal::PageRemove:
+            // Потомки удалённой страницы отпадут при обходе дерева
+            pageById.remove(record.pageId);
+            break;
+        }
+    }
+
+    QHash<QString, QStringList> children;
+    for (const QString &id : order) {
+        const QString parentId = parentOf.value(id);
+        if (!parentId.isEmpty())
+            children[parentId].append(id);
+    }
+
+    QList<PageRecord> replayed;
+    std::function<void(const QString &, qint32)> visit = [&](const QString &id, qint32 parent) {
+        if (!pageById.contains(id))
+            return;
+        PageRecord record;
+        record.parent = parent;
+        record.page = pageById.value(id);
+        record.placeholder = unreadable.contains(id);
+        const qint32 current = qint32(replayed.size());
+        replayed.append(record);
+        for (const QString &child : children.value(id)) visit(child, current);
+    };
+    visit(order.first(), -1);
+
+    qDebug() << "Replayed" << records.size() << "journal records for" << workspacePath;
+    return writePages(workspacePath, replayed);
 }
 
 Workspace *LocalStorage::loadWorkspace(const QString &workspaceTitle, QWidget *parent, bool isGuest)
 {
-    QString workspacePath = getWorkspacePath(isGuest) + workspaceTitle + "/workspace.json";
-    QFile file(workspacePath);
+    const QString workspacePath = workspaceDirectory(workspaceTitle, isGuest);
+    waitForImport(workspacePath);
+    WorkspaceArchive::touch(workspacePath);
+    // Открытое пространство сохраняется постранично - ему нужны шарды на диске.
+    // Остальные чтения обходятся архивом в памяти.
+    if (!WorkspaceArchive::restore(workspacePath))
+        return nullptr;
 
-    if (!file.exists()) {
-        qWarning() << "Workspace file not found:" << workspacePath;
+    // Правки, не дошедшие до контрольной точки (например, после аварийного завершения)
+    replayJournal(workspacePath);
+
+    QList<PageRecord> pages;
+    bool sharded = false;
+    if (!StorageEngine::instance().readPages(workspacePath, pages, &sharded))
         return nullptr;
+
+    Workspace *workspace = loadWorkspaceRecursive(pages, parent);
+
+    // Страницы из старых форматов остаются "грязными" и при первом сохранении разойдутся по шардам
+    if (workspace && sharded)
+        workspace->clearDirty(true);
+    return workspace;
+}
+
+Workspace *LocalStorage::loadWorkspaceRecursive(const QList<PageRecord> &pages, QWidget *parent)
+{
+    // Страницы идут в порядке обхода дерева: родитель всегда раньше потомков
+    QList<Workspace *> workspaces;
+    workspaces.reserve(pages.size());
+    for (const PageRecord &record : pages) {
+        const bool isRoot = workspaces.isEmpty();
+        Workspace *workspace =
+         new Workspace(record.page["title"].toString(), isRoot ? parent : nullptr);
+        workspace->deserializePage(record.page);
+        if (record.placeholder)
+            workspace->setUnreadable(true);
+
+        if (!isRoot) {
+            Workspace *owner = workspaces.value(record.parent, workspaces.first());
+            owner->addSubWorkspace(workspace);
+        }
+        workspaces.append(workspace);
     }
+    return workspaces.value(0, nullptr);
+}
+
+QList<WorkspaceContainer::IndexEntry> LocalStorage::loadPageIndex(const QString &workspaceTitle,
+                                                                  bool isGuest) const
+{
+    QList<WorkspaceContainer::IndexEntry> index;
+    StorageEngine::instance().readIndex(workspaceDirectory(workspaceTitle, isGuest), index);
+    return index;
+}
 
+bool LocalStorage::loadPage(const QString &workspaceTitle, int pageIndex, PageRecord &page,
+                            bool isGuest) const
+{
+    return StorageEngine::instance().readPage(workspaceDirectory(workspaceTitle, isGuest),
+                                              pageIndex, page);
+}
+
+bool LocalStorage::readChangedPage(const QString &workspaceTitle, Workspace *page,
+                                   QJsonObject &stored, bool isGuest) const
+{
+    // Свои записи StorageWatcher отсеивает по времени изменения файла
+    const QString workspacePath = workspaceDirectory(workspaceTitle, isGuest);
+    return StorageEngine::instance().readPage(workspacePath, page->getId(), stored);
+}
+
+bool LocalStorage::isStructureChanged(Workspace *root, bool isGuest)
+{
+    const QList<WorkspaceContainer::IndexEntry> stored = loadPageIndex(root->getId(), isGuest);
+    if (stored.isEmpty())
+        return false;
+
+    QList<WorkspaceContainer::IndexEntry> current;
+    QList<Workspace *> pages;
+    saveWorkspaceRecursive(root, -1, current, pages);
+    if (stored.size() != current.size())
+        return true;
+    for (int i = 0; i < stored.size(); ++i) {
+        if (stored[i].id != current[i].id || stored[i].parent != current[i].parent)
+            return true;
+    }
+    return false;
+}
+
+QJsonObject LocalStorage::readWorkspaceJson(const QString &workspaceTitle, bool isGuest) const
+{
+    QList<PageRecord> pages;
+    if (!StorageEngine::instance().readPages(workspaceDirectory(workspaceTitle, isGuest), pages))
+        return QJsonObject();
+
+    // Наружу JSON уходит самодостаточным: изображения и иконки снова в base64
+    QJsonObject json = WorkspaceContainer::toJson(pages);
+    BlobStore::instance().inlineBlobs(json);
+    return json;
+}
+
+bool LocalStorage::writeWorkspaceJson(const QJsonObject &json, bool isGuest)
+{
+    QString title = json["title"].toString();
+    if (title.isEmpty())
+        return false;
+
+    QJsonObject stored = json;
+    if (stored["id"].toString().isEmpty())
+        stored["id"] = QUuid::createUuid().toString(QUuid::WithoutBraces);
+    BlobStore::instance().externalizeBlobs(stored);
+
+    // Каталог - id корня: переименование пишет в тот же каталог
+    const QString workspaceId = stored["id"].toString();
+    const QString workspacePath = getWorkspacePath(isGuest) + workspaceId + "/";
+    const QList<PageRecord> pages = WorkspaceContainer::fromJson(stored);
+    PageLocker locker(workspacePath);
+    if (!writePages(workspacePath, pages))
+        return false;
+    updateCatalog(getWorkspacePath(isGuest), workspaceId,
+                  WorkspaceCatalog::fromPages(title, pages));
+    return true;
+}
+
+bool LocalStorage::updateWorkspaceJson(const QString &workspaceTitle,
+                                       const std::function<void(QJsonObject &json)> &update,
+                                       bool isGuest)
+{
+    // Фоновая запись и другие потоки не вклинятся между чтением и записью
+    PageLocker locker(workspaceDirectory(workspaceTitle, isGuest));
+
+    QJsonObject json = readWorkspaceJson(workspaceTitle, isGuest);
+    if (json.isEmpty())
+        return false;
+    update(json);
+    return writeWorkspaceJson(json, isGuest);
+}
+
+QList<HistoryVersion> LocalStorage::workspaceHistory(const QString &workspaceTitle,
+                                                     bool isGuest) const
+{
+    const QString workspacePath = workspaceDirectory(workspaceTitle, isGuest);
+    PageLocker locker(workspacePath, QStringList() << PageLocks::IndexKey);
+    return WorkspaceHistory(workspacePath + WorkspaceDirectory::HistoryFileName).versions();
+}
+
+bool LocalStorage::readWorkspaceVersion(const QString &workspaceTitle, quint64 version,
+                                        QList<PageRecord> &pages, bool isGuest) const
+{
+    const QString workspacePath = workspaceDirectory(workspaceTitle, isGuest);
+    PageLocker locker(workspacePath, QStringList() << PageLocks::IndexKey);
+    return WorkspaceHistory(workspacePath + WorkspaceDirectory::HistoryFileName)
+     .read(version, pages);
+}
+
+bool LocalStorage::restoreWorkspaceVersion(const QString &workspaceTitle, quint64 version,
+                                           bool isGuest)
+{
+    persistenceWorker->waitForIdle();
+
+    const QString workspacePath = workspaceDirectory(workspaceTitle, isGuest);
+    QList<PageRecord> pages;
+    {
+        PageLocker locker(workspacePath);
+        if (!readWorkspaceVersion(workspaceTitle, version, pages, isGuest) || pages.isEmpty()) {
+            qWarning() << "Workspace version not found:" << workspaceTitle << version;
+            return false;
+        }
+
+        // Восстановление само становится новой версией, его тоже можно откатить.
+        // Несохранённые правки открытого пространства относятся к заменяемому дереву
+        WorkspaceArchive::restore(workspacePath);
+        pendingJournals.remove(workspacePath);
+        if (!writePages(workspacePath, pages))
+            return false;
+        QStringList pageIds;
+        for (const PageRecord &record : std::as_const(pages))
+            pageIds << record.page["id"].toString();
+        StorageWatcher::recordOwnWrites(workspacePath, pageIds);
+        const QString title = pages.first().page["title"].toString();
+        updateCatalog(getWorkspacePath(isGuest), pageIds.first(),
+                      WorkspaceCatalog::fromPages(title, pages));
+    }
+
+    // Открытое пространство перечитывается явно: StorageWatcher не видит
+    // ни собственных записей, ни строк базы SQLite
+    emit workspaceRestored(pages.first().page["id"].toString());
+    return true;
+}
+
+bool LocalStorage::exportWorkspaceJson(const QString &workspaceTitle, const QString &filePath,
+                                       bool isGuest) const
+{
+    QJsonObject json = readWorkspaceJson(workspaceTitle, isGuest);
+    if (json.isEmpty())
+        return false;
+
+    QSaveFile file(filePath);
+    if (!file.open(QIODevice::WriteOnly)) {
+        qWarning() << "Failed to open export file for writing:" << file.errorString();
+        return false;
+    }
+    file.write(QJsonDocument(json).toJson());
+    return file.commit();
+}
+
+Workspace *LocalStorage::importWorkspaceJson(const QString &filePath, QWidget *parent, bool isGuest)
+{
+    QFile file(filePath);
     if (!file.open(QIODevice::ReadOnly)) {
-        qWarning() << "Failed to open workspace file for reading:" << file.errorString();
+        qWarning() << "Failed to open import file for reading:" << file.errorString();
         return nullptr;
     }
 
-    QByteArray data = file.readAll();
-    file.close();
-
-    QJsonDocument doc = QJsonDocument::fromJson(data);
-    if (doc.isNull() || !doc.isObject()) {
-        qWarning() << "Invalid JSON in workspace file:" << workspacePath;
+    QList<PageRecord> pages;
+    if (!WorkspaceContainer::readJson(&file, pages, externalizePage)) {
+        qWarning() << "Invalid JSON in import file:" << filePath;
         return nullptr;
     }
 
-    return loadWorkspaceRecursive(doc.object(), parent);
+    Workspace *workspace = loadWorkspaceRecursive(pages, parent);
+    saveWorkspace(workspace, isGuest);
+    return workspace;
 }
 
-Workspace *LocalStorage::loadWorkspaceRecursive(const QJsonObject &json, QWidget *parent)
+bool LocalStorage::exportWorkspaceBundle(Workspace *workspace, const QString &filePath)
 {
-    Workspace *workspace = new Workspace(json["title"].toString(), parent);
-    workspace->deserializeBackend(json);
-    return workspace;
+    QList<WorkspaceContainer::IndexEntry> index;
+    QList<Workspace *> pages;
+    saveWorkspaceRecursive(workspace->getRootWorkspace(), -1, index, pages);
+
+    // Страницы сериализуются по одной, по мере записи в файл
+    return WorkspaceBundle::write(filePath, qint32(pages.size()),
+                                  [&index, &pages](qint32 i, PageRecord &record) {
+                                      record.parent = index[i].parent;
+                                      record.page = pages[i]->serializePage();
+                                  });
+}
+
+QString LocalStorage::importWorkspaceBundle(const QString &filePath, bool isGuest)
+{
+    WorkspaceBundle bundle;
+    if (!bundle.open(filePath) || bundle.pages().isEmpty())
+        return QString();
+
+    const QString basePath = getWorkspacePath(isGuest);
+    QList<CatalogEntry> catalog;
+    readCatalog(basePath, catalog);
+
+    // Файл, открытый повторно, становится копией: новые id страниц и свободное название
+    const bool copy =
+     StorageEngine::instance().contains(basePath + bundle.pages().first().id + "/");
+    QString title = bundle.pages().first().title;
+    for (int n = 2; !WorkspaceCatalog::rootIdOf(catalog, title).isEmpty(); ++n)
+        title = QString("%1 (%2)").arg(bundle.pages().first().title).arg(n);
+    const bool renamed = title != bundle.pages().first().title;
+
+    QList<WorkspaceContainer::IndexEntry> index;
+    QList<CatalogEntry> entries;
+    for (const WorkspaceBundle::PageEntry &page : bundle.pages()) {
+        WorkspaceContainer::IndexEntry entry;
+        entry.parent = page.parent;
+        entry.id = copy ? QUuid::createUuid().toString(QUuid::WithoutBraces) : page.id;
+        entry.title = page.title;
+        index.append(entry);
+
+        CatalogEntry catalogEntry;
+        catalogEntry.workspace = title;
+        catalogEntry.parent = page.parent;
+        catalogEntry.id = entry.id;
+        catalogEntry.title = page.title;
+        catalogEntry.iconDigest = page.iconDigest;
+        catalogEntry.status = page.status;
+        catalogEntry.createdAt = page.createdAt;
+        catalogEntry.itemCount = page.itemCount;
+        entries.append(catalogEntry);
+    }
+    index.first().title = title;
+    entries.first().title = title;
+
+    const QString workspaceId = index.first().id;
+    const QString workspacePath = basePath + workspaceId + "/";
+    bundle.close();
+
+    // Дерево видно в каталоге сразу, страницы и blob копируются в фоне.
+    // Загрузка пространства до конца копирования его дождётся (waitForImport).
+    updateCatalog(basePath, workspaceId, entries);
+    importingPaths.insert(workspacePath);
+
+    QPointer<LocalStorage> self(this);
+    importPool.start([self, filePath, basePath, workspacePath, workspaceId, index, copy,
+                      renamed, title]() {
+        const bool imported = copyBundle(filePath, workspacePath, index, copy, renamed);
+        QMetaObject::invokeMethod(
+         qApp,
+         [self, basePath, workspacePath, workspaceId, imported, title]() {
+             if (!self)
+                 return;
+             self->importingPaths.remove(workspacePath);
+             if (imported)
+                 return;
+             self->updateCatalog(basePath, workspaceId, QList<CatalogEntry>());
+             emit self->workspaceImportFailed(title);
+         },
+         Qt::QueuedConnection);
+    });
+    return title;
+}
+
+void LocalStorage::waitForImport(const QString &workspacePath)
+{
+    if (importingPaths.remove(workspacePath))
+        importPool.waitForDone();
+}
+
+QString LocalStorage::backupWorkspaces(const QString &backupDir, bool full, bool isGuest)
+{
+    // Копия собирается из файлов каталогов пространств
+    if (StorageEngine::selected() != StorageEngine::Directory) {
+        qWarning() << "Backups are only supported for directory storage";
+        return QString();
+    }
+
+    // Снимки, ещё не дошедшие до диска, попадают в эту же копию
+    persistenceWorker->waitForIdle();
+
+    // Цепочка копий своя у гостя и у каждого пользователя
+    const QString prefix = isGuest ? "guest" : currentUser.isEmpty() ? "users" : currentUser;
+    return StorageBackup::backup(getWorkspacePath(isGuest), BlobStore::instance().rootPath(),
+                                 backupDir, prefix, full);
+}
+
+bool LocalStorage::restoreBackup(const QStringList &backupFiles, const QString &targetPath)
+{
+    return StorageBackup::restore(backupFiles, targetPath);
 }
 
 void LocalStorage::deleteWorkspace(const QString &workspaceTitle, bool isGuest)
 {
-    QString workspacePath = getWorkspacePath(isGuest) + workspaceTitle;
+    persistenceWorker->waitForIdle();
+
+    // Принимает и название, и id корня (каталог на диске)
+    const QString workspacePath = workspaceDirectory(workspaceTitle, isGuest);
+    waitForImport(workspacePath);
+    PageLocker locker(workspacePath);
+    journals.remove(workspacePath);
+    pendingJournals.remove(workspacePath);
+    StorageEngine::instance().remove(workspacePath);
     QDir dir(workspacePath);
+    const QString workspaceId = dir.dirName();
     if (dir.exists()) {
         dir.removeRecursively();
     }
+    updateCatalog(getWorkspacePath(isGuest), workspaceId, QList<CatalogEntry>());
+}
+
+void LocalStorage::archiveColdWorkspaces(const QStringList &openTitles, int maxAgeDays,
+                                        bool isGuest)
+{
+    // Архив пакует файлы каталога пространства - другим движкам не нужен
+    if (maxAgeDays <= 0 || StorageEngine::selected() != StorageEngine::Directory)
+        return;
+
+    const QString basePath = getWorkspacePath(isGuest);
+    const QDateTime notUsedSince = QDateTime::currentDateTime().addDays(-maxAgeDays);
+
+    QSet<QString> openPaths;
+    for (const QString &title : openTitles) openPaths.insert(workspaceDirectory(title, isGuest));
+
+    // Сжатие - долгая операция, выполняем вне потока интерфейса
+    QThreadPool::globalInstance()->start([basePath, openPaths, notUsedSince]() {
+        const QStringList folders = QDir(basePath).entryList(QDir::Dirs | QDir::NoDotAndDotDot);
+        for (const QString &folder : folders) {
+            const QString workspacePath = basePath + folder + "/";
+            if (openPaths.contains(workspacePath) || WorkspaceArchive::isArchived(workspacePath))
+                continue;
+            if (WorkspaceArchive::lastAccess(workspacePath) > notUsedSince)
+                continue;
+            WorkspaceArchive::archive(workspacePath, notUsedSince);
+        }
+    });
 }
 
 void LocalStorage::syncWorkspaces(const QJsonArray &serverWorkspaces, bool keepLocal)
 {
-    QDir userDir(getUserWorkspacePath());
-    QStringList localWorkspaceTitles = userDir.entryList(QDir::Dirs | QDir::NoDotAndDotDot);
+    // Пространства названы по id корня (старые каталоги - по названию)
+    const QStringList localWorkspaceDirs =
+     StorageEngine::instance().workspaces(getUserWorkspacePath());
+    const QList<CatalogEntry> localCatalog = catalog(false);
 
-    QStringList serverWorkspaceTitles;
+    QSet<QString> serverWorkspaceKeys;
     for (const QJsonValue &workspaceValue : serverWorkspaces) {
         QJsonObject workspaceObj = workspaceValue.toObject();
         QString workspaceTitle = workspaceObj["title"].toString();
-        serverWorkspaceTitles.append(workspaceTitle);
 
         // Полная замена: всегда перезаписываем локальные данные
         Workspace *workspace = new Workspace(workspaceTitle);
         workspace->deserializeBackend(workspaceObj, true);
-        saveWorkspace(workspace, false);
+
+        // Сервер различает пространства по названию и не знает локальных id: страницы
+        // получают id уже сохранённых локально, и запись идёт в тот же каталог
+        // вместе с историей и журналом
+        const QString localId = WorkspaceCatalog::rootIdOf(localCatalog, workspaceTitle);
+        if (!localId.isEmpty()) {
+            QSet<qint32> used;
+            adoptLocalIds(workspace, workspaceObj, 0,
+                          WorkspaceCatalog::entriesOf(localCatalog, localId), used);
+        }
+
+        serverWorkspaceKeys.insert(workspace->getId());
+        serverWorkspaceKeys.insert(workspaceTitle);
+        saveWorkspace(workspace, false, true);
         delete workspace;
     }
 
     // Удаляем локальные workspaces, которых нет на сервере (если не keepLocal)
     if (!keepLocal) {
-        for (const QString &workspaceTitle : localWorkspaceTitles) {
-            if (!serverWorkspaceTitles.contains(workspaceTitle)) {
-                deleteWorkspace(workspaceTitle, false);
+        for (const QString &workspaceDir : localWorkspaceDirs) {
+            if (!serverWorkspaceKeys.contains(workspaceDir)) {
+                deleteWorkspace(workspaceDir, false);
             }
         }
     }
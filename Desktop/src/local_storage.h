@@ -3,32 +3,190 @@
 
 #include <QObject>
 #include <QDir>
+#include <QFile>
+#include <QHash>
+#include <QSet>
+#include <QSharedPointer>
+#include <QPointer>
+#include <QThreadPool>
+#include <QTimer>
+#include <functional>
 #include "workspace.h"
+#include "storage/workspace_container.h"
+#include "storage/workspace_catalog.h"
+#include "storage/workspace_journal.h"
+#include "storage/workspace_history.h"
+#include "storage/persistence_worker.h"
 
 class LocalStorage : public QObject
 {
     Q_OBJECT
 public:
     explicit LocalStorage(QObject *parent = nullptr);
+    ~LocalStorage() override;
+
+    // Корень хранилища, общий для гостя и всех пользователей
+    static QString storageRootPath();
 
     void saveWorkspace(Workspace *workspace, bool isGuest = false);
+    // Снимок изменённых страниц делается сразу, запись идёт в фоновом потоке.
+    // false - писать нечего
+    bool saveWorkspaceAsync(Workspace *workspace, bool isGuest = false);
+    void waitForPendingSaves();
     Workspace *
     loadWorkspace(const QString &workspaceTitle, QWidget *parent = nullptr, bool isGuest = false);
     void deleteWorkspace(const QString &workspaceTitle, bool isGuest = false);
     void syncWorkspaces(const QJsonArray &serverWorkspaces, bool keepLocal = false);
+    // Упаковывает в архив пространства, не открывавшиеся maxAgeDays дней (в фоне)
+    void archiveColdWorkspaces(const QStringList &openTitles, int maxAgeDays,
+                               bool isGuest = false);
     QString getWorkspacePath(bool isGuest = false) const;
     void setCurrentUser(const QString &username);
     QString getCurrentUser() const;
     void clearUserData();
     QString getWorkspaceOwnerPath(const QString &ownerUsername) const;
 
+    // Каталог для боковой панели; сверяется с каталогами на диске и восстанавливает
+    // пространства с незавершённым журналом
+    QList<CatalogEntry> loadCatalog(bool isGuest = false);
+    // Каталог как он записан, без сверки с диском - после собственных сохранений
+    QList<CatalogEntry> catalog(bool isGuest = false) const;
+    // Названия пространств по каталогу - для тех, кому нужен только список
+    QStringList listWorkspaces(bool isGuest = false);
+
+    // Постраничный доступ к бинарному контейнеру без загрузки всего дерева
+    QList<WorkspaceContainer::IndexEntry> loadPageIndex(const QString &workspaceTitle,
+                                                        bool isGuest = false) const;
+    bool loadPage(const QString &workspaceTitle, int pageIndex, PageRecord &page,
+                  bool isGuest = false) const;
+
+    // Сверка открытого пространства с диском, когда файлы переписал другой процесс.
+    // Свои записи сюда не доходят: их отсеивает StorageWatcher.
+    bool readChangedPage(const QString &workspaceTitle, Workspace *page, QJsonObject &stored,
+                         bool isGuest = false) const;
+    bool isStructureChanged(Workspace *root, bool isGuest = false);
+
+    // JSON остаётся форматом импорта/экспорта и обмена с сервером
+    QJsonObject readWorkspaceJson(const QString &workspaceTitle, bool isGuest = false) const;
+    bool writeWorkspaceJson(const QJsonObject &json, bool isGuest = false);
+    // Чтение-изменение-запись под блокировкой пространства
+    bool updateWorkspaceJson(const QString &workspaceTitle,
+                             const std::function<void(QJsonObject &json)> &update,
+                             bool isGuest = false);
+    bool exportWorkspaceJson(const QString &workspaceTitle, const QString &filePath,
+                             bool isGuest = false) const;
+    Workspace *importWorkspaceJson(const QString &filePath, QWidget *parent = nullptr,
+                                   bool isGuest = false);
+
+    // Переносимый файл *.workspace (WorkspaceBundle). При открытии дерево сразу попадает
+    // в каталог, а секции страниц и blob копируются в хранилище без разбора в фоне;
+    // возвращается название пространства в каталоге. Экспорт пишет страницы по одной.
+    bool exportWorkspaceBundle(Workspace *workspace, const QString &filePath);
+    QString importWorkspaceBundle(const QString &filePath, bool isGuest = false);
+
+    // Резервная копия пространств и blob (StorageBackup): в backupDir пишется копия
+    // только того, что изменилось с прошлой копии там же. Возвращает путь файла копии.
+    QString backupWorkspaces(const QString &backupDir, bool full = false, bool isGuest = false);
+    // Состояние на момент последней копии цепочки (полная + инкременты) в пустой каталог
+    static bool restoreBackup(const QStringList &backupFiles, const QString &targetPath);
+
+    // Локальная история: версия записывается при каждом сохранении пространства.
+    // Восстановление переписывает пространство выбранной версией.
+    QList<HistoryVersion> workspaceHistory(const QString &workspaceTitle,
+                                           bool isGuest = false) const;
+    bool readWorkspaceVersion(const QString &workspaceTitle, quint64 version,
+                              QList<PageRecord> &pages, bool isGuest = false) const;
+    bool restoreWorkspaceVersion(const QString &workspaceTitle, quint64 version,
+                                 bool isGuest = false);
+
+    // Журнал правок между сохранениями: запись в несколько байт вместо перезаписи шарда.
+    // Правки копятся JournalFlushDelayMs и пишутся одной пачкой с одним fsync;
+    // повторные правки страницы или элемента за это время дают одну запись.
+    // saveWorkspace служит контрольной точкой и очищает журнал.
+    void journalPageUpdate(Workspace *root, Workspace *page, bool isGuest = false);
+    void journalElementUpdate(Workspace *root, Workspace *page, AbstractWorkspaceItem *item,
+                              bool isGuest = false);
+    void journalPageRemove(Workspace *root, const QString &pageId, bool isGuest = false);
+    // Записывает в журналы все накопленные правки
+    void flushJournals();
+
+    // Удаляет blob, на которые не ссылаются страницы, история и журналы ни одного
+    // пользователя (в фоне, один раз за запуск)
+    void collectBlobs();
+
+signals:
+    void workspaceSaved(const QString &workspaceId, const QString &workspaceTitle);
+    void workspaceSaveFailed(const QString &workspaceId, const QString &workspaceTitle,
+                             const QString &error);
+    // Фоновая проверка хранилища нашла повреждённые файлы: repaired заменены
+    // предыдущими версиями, lost восстановить не удалось
+    void storageRepaired(int repaired, const QStringList &lost);
+    // Фоновое копирование открытого файла не удалось, пространство убрано из каталога
+    void workspaceImportFailed(const QString &workspaceTitle);
+    // restoreWorkspaceVersion переписал пространство (id корня)
+    void workspaceRestored(const QString &workspaceId);
+
+private slots:
+    void onSnapshotSaved(const WorkspaceSnapshot &snapshot);
+    void onSnapshotFailed(const WorkspaceSnapshot &snapshot, const QString &error);
+
 private:
     QString storagePath;
     QString guestPath;
     QString userPath;
     QString currentUser;
-    void saveWorkspaceRecursive(Workspace *workspace, QJsonObject &json);
-    Workspace *loadWorkspaceRecursive(const QJsonObject &json, QWidget *parent = nullptr);
+    QHash<QString, QSharedPointer<WorkspaceJournal>> journals;
+    QHash<QString, QHash<QString, QString>> workspaceDirs; // basePath -> название -> id корня
+    PersistenceWorker *persistenceWorker { nullptr };
+    QHash<QString, quint64> saveGenerations;
+    QHash<QString, QSet<QString>> unsavedPages;
+    QSet<QString> changedStructures; // пути пространств, где удаляли страницы
+    QSet<QString> verifiedPaths;
+    QThreadPool importPool;
+    QSet<QString> importingPaths; // пространства, которые ещё копируются из файла
+    bool blobsCollected { false };
+
+    // Правки, ещё не дошедшие до журнала пространства
+    struct PendingJournal
+    {
+        QPointer<Workspace> root;
+        bool isGuest { false };
+        QList<QPointer<Workspace>> pages;
+        QList<QPair<QPointer<Workspace>, QPointer<AbstractWorkspaceItem>>> elements;
+        QStringList removed;
+    };
+    QHash<QString, PendingJournal> pendingJournals; // путь пространства -> правки
+    QTimer *journalTimer { nullptr };
+
+    WorkspaceSnapshot takeSnapshot(Workspace *workspace, bool isGuest);
+    // external - workspace не открытая модель, а данные с сервера
+    void saveWorkspace(Workspace *workspace, bool isGuest, bool external);
+    void saveWorkspaceRecursive(Workspace *workspace, qint32 parent,
+                                QList<WorkspaceContainer::IndexEntry> &index,
+                                QList<Workspace *> &pages);
+    Workspace *loadWorkspaceRecursive(const QList<PageRecord> &pages, QWidget *parent = nullptr);
+
+    bool writePages(const QString &workspacePath, const QList<PageRecord> &pages);
+    // Ждёт фонового импорта пространства, если он идёт
+    void waitForImport(const QString &workspacePath);
+
+    QString catalogPath(const QString &basePath) const;
+    bool readCatalog(const QString &basePath, QList<CatalogEntry> &catalog) const;
+    bool writeCatalog(const QString &basePath, const QList<CatalogEntry> &catalog);
+    void updateCatalog(const QString &basePath, const QString &workspaceId,
+                       const QList<CatalogEntry> &entries);
+    void rememberDirectories(const QString &basePath, const QList<CatalogEntry> &catalog);
+    QString workspaceDirectory(const QString &workspace, bool isGuest) const;
+    bool migrateDirectory(const QString &basePath, const QString &directory,
+                          const QString &workspaceId);
+    void adoptWorkspaces(const QString &basePath);
+    void verifyStorage(const QString &basePath);
+
+    WorkspaceJournal *journalFor(const QString &workspacePath);
+    PendingJournal &pendingJournal(Workspace *root, bool isGuest);
+    void flushJournal(const QString &workspacePath);
+    void resetJournal(const QString &workspacePath);
+    bool replayJournal(const QString &workspacePath);
     void initializePaths();
     QString getUserWorkspacePath() const;
 };
@@ -0,0 +1,127 @@
+#include "autosave_scheduler.h"
+
+#include <QDebug>
+#include <utility>
+
+namespace {
+int countDirtyPages(Workspace *workspace)
+{
+    int count = workspace->isDirty() ? 1 : 0;
+    for (Workspace *sub : workspace->getSubWorkspaces()) count += countDirtyPages(sub);
+    return count;
+}
+} // namespace
+
+AutosaveScheduler::AutosaveScheduler(LocalStorage *localStorage, QObject *parent) :
+    QObject(parent),
+    _localStorage(localStorage)
+{
+    _idleTimer.setSingleShot(true);
+    _idleTimer.setInterval(DefaultIdleDelayMs);
+    connect(&_idleTimer, &QTimer::timeout, this, &AutosaveScheduler::flush);
+
+    // Не перезапускается правками: ограничивает задержку при непрерывном вводе
+    _deadlineTimer.setSingleShot(true);
+    _deadlineTimer.setInterval(DefaultMaxLatencyMs);
+    connect(&_deadlineTimer, &QTimer::timeout, this, &AutosaveScheduler::flush);
+
+    connect(_localStorage, &LocalStorage::workspaceSaved, this,
+            &AutosaveScheduler::onWorkspaceSaved);
+    connect(_localStorage, &LocalStorage::workspaceSaveFailed, this,
+            &AutosaveScheduler::onWorkspaceSaveFailed);
+}
+
+void AutosaveScheduler::setIdleDelay(int ms)
+{
+    _idleTimer.setInterval(ms);
+}
+
+void AutosaveScheduler::setMaxLatency(int ms)
+{
+    _deadlineTimer.setInterval(ms);
+}
+
+void AutosaveScheduler::markDirty(Workspace *root)
+{
+    if (!root)
+        return;
+    if (!_dirty.contains(root))
+        _dirty.append(root);
+    if (!_deadlineTimer.isActive()) {
+        _firstEdit.start();
+        _deadlineTimer.start();
+    }
+    _idleTimer.start();
+}
+
+void AutosaveScheduler::flush()
+{
+    _idleTimer.stop();
+    _deadlineTimer.stop();
+    if (_dirty.isEmpty())
+        return;
+
+    const QList<QPointer<Workspace>> dirty = std::exchange(_dirty, {});
+    const bool isGuest = _localStorage->getCurrentUser().isEmpty();
+    if (_writing.isEmpty()) {
+        _report = FlushReport();
+        _writeStarted.start();
+    }
+    _report.latencyMs = qMax(_report.latencyMs, _firstEdit.elapsed());
+
+    QElapsedTimer timer;
+    timer.start();
+    for (const QPointer<Workspace> &root : dirty) {
+        // Страница закрыта или удалена после правки
+        if (!root)
+            continue;
+        // Снимок снимает отметки изменений - страницы считаем до него.
+        // Удаление страницы сохраняется, даже если тела остальных не менялись
+        const int pages = countDirtyPages(root);
+        if (!_localStorage->saveWorkspaceAsync(root, isGuest))
+            continue;
+        _report.workspaces++;
+        _report.pages += pages;
+        _writing.insert(root->getId());
+    }
+    _report.snapshotMs += timer.nsecsElapsed() / 1e6;
+}
+
+void AutosaveScheduler::clear()
+{
+    _idleTimer.stop();
+    _deadlineTimer.stop();
+    _dirty.clear();
+}
+
+bool AutosaveScheduler::isPending() const
+{
+    return !_dirty.isEmpty() || !_writing.isEmpty();
+}
+
+void AutosaveScheduler::onWorkspaceSaved(const QString &workspaceId)
+{
+    finishWrite(workspaceId, false);
+}
+
+void AutosaveScheduler::onWorkspaceSaveFailed(const QString &workspaceId)
+{
+    finishWrite(workspaceId, true);
+}
+
+void AutosaveScheduler::finishWrite(const QString &workspaceId, bool failed)
+{
+    // Ручное сохранение тоже пишет через фоновый поток - его не считаем
+    if (!_writing.remove(workspaceId))
+        return;
+    _report.failed |= failed;
+    if (!_writing.isEmpty())
+        return;
+
+    _report.writeMs = _writeStarted.nsecsElapsed() / 1e6;
+    qDebug().nospace() << "Autosave: " << _report.pages << " pages in " << _report.workspaces
+                       << " workspaces, " << _report.latencyMs << " ms after first edit, snapshot "
+                       << _report.snapshotMs << " ms, written in " << _report.writeMs << " ms"
+                       << (_report.failed ? " (failed)" : "");
+    emit flushed(_report);
+}
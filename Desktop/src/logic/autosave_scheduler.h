@@ -0,0 +1,76 @@
+#ifndef AUTOSAVE_SCHEDULER_H
+#define AUTOSAVE_SCHEDULER_H
+
+#include "workspace.h"
+#include "../local_storage.h"
+
+#include <QElapsedTimer>
+#include <QList>
+#include <QObject>
+#include <QPointer>
+#include <QSet>
+#include <QTimer>
+
+// Автосохранение изменённых страниц. Каждая правка уже лежит в журнале; планировщик
+// решает, когда сбросить изменённые страницы в шарды (контрольная точка).
+//
+// Сброс происходит, когда ввод затих на idleDelay, но не позже maxLatency после первой
+// несохранённой правки - при непрерывном наборе тоже. Все пространства с правками
+// уходят одной пачкой: снимок только изменённых страниц делается сразу, запись идёт
+// в фоновом потоке (LocalStorage::saveWorkspaceAsync). Время сброса приходит сигналом
+// flushed и пишется в лог.
+class AutosaveScheduler : public QObject
+{
+    Q_OBJECT
+
+public:
+    struct FlushReport
+    {
+        int workspaces { 0 };
+        int pages { 0 };
+        qint64 latencyMs { 0 }; // от первой правки пачки до начала сброса
+        double snapshotMs { 0 }; // снимок в потоке интерфейса
+        double writeMs { 0 }; // от начала сброса до записи последнего пространства
+        bool failed { false };
+    };
+
+    static constexpr int DefaultIdleDelayMs = 2 * 1000;
+    static constexpr int DefaultMaxLatencyMs = 30 * 1000;
+
+    explicit AutosaveScheduler(LocalStorage *localStorage, QObject *parent = nullptr);
+
+    void setIdleDelay(int ms);
+    void setMaxLatency(int ms);
+
+    // Правка в пространстве root: перезапускает ожидание простоя
+    void markDirty(Workspace *root);
+    // Сбросить накопленное сейчас, не дожидаясь простоя
+    void flush();
+    // Всё уже сохранено синхронно (saveWorkspace) - ждать нечего
+    void clear();
+
+    bool isPending() const;
+
+signals:
+    void flushed(const AutosaveScheduler::FlushReport &report);
+
+private slots:
+    void onWorkspaceSaved(const QString &workspaceId);
+    void onWorkspaceSaveFailed(const QString &workspaceId);
+
+private:
+    void finishWrite(const QString &workspaceId, bool failed);
+
+    LocalStorage *_localStorage;
+    QTimer _idleTimer;
+    QTimer _deadlineTimer;
+    QElapsedTimer _firstEdit;
+    QList<QPointer<Workspace>> _dirty;
+
+    // Id корней пространств пачки, запись которых ещё идёт в фоне
+    QSet<QString> _writing;
+    QElapsedTimer _writeStarted;
+    FlushReport _report;
+};
+
+#endif // AUTOSAVE_SCHEDULER_H
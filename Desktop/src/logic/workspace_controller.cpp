@@ -1,24 +1,108 @@
 #include "workspace_controller.h"
 #include <QUuid>
 #include "../data/elements/SubspaceLinkItem.h"
+#include "../settings/settings_manager.h"
 #include <QDebug>
 #include <QInputDialog>
 #include <QLineEdit>
 #include <qapplication.h>
 
+namespace {
+// Сколько простоя ждать перед упаковкой холодных пространств
+constexpr int ArchiveIdleMs = 5 * 60 * 1000;
+
+Workspace *findPageById(Workspace *workspace, const QString &pageId)
+{
+    if (workspace->getId() == pageId)
+        return workspace;
+    for (Workspace *sub : workspace->getSubWorkspaces()) {
+        if (Workspace *page = findPageById(sub, pageId))
+            return page;
+    }
+    return nullptr;
+}
+
+bool hasDirtyPages(Workspace *workspace)
+{
+    if (workspace->isDirty())
+        return true;
+    for (Workspace *sub : workspace->getSubWorkspaces()) {
+        if (hasDirtyPages(sub))
+            return true;
+    }
+    return false;
+}
+} // namespace
+
 WorkspaceController::WorkspaceController(std::shared_ptr<LocalStorage> localStorage,
                                          QWidget *parent) :
     QObject(parent),
-    _localStorage(localStorage)
+    _localStorage(localStorage),
+    _storageWatcher(new StorageWatcher(this))
 {
+    // Журнал правок сбрасывается в шарды страниц после паузы в наборе
+    _autosave = new AutosaveScheduler(_localStorage.get(), this);
+
+    connect(_storageWatcher, &StorageWatcher::pageChanged, this,
+            &WorkspaceController::onStoragePageChanged);
+    connect(_storageWatcher, &StorageWatcher::indexChanged, this,
+            &WorkspaceController::onStorageIndexChanged);
+    connect(_storageWatcher, &StorageWatcher::catalogChanged, this,
+            &WorkspaceController::reloadCatalog);
+
     loadWorkspaces(parent);
 
-    // Connect signals from loaded workspaces
-    for (Workspace *ws : _workspaces) {
-        connect(ws, &Workspace::addSubspaceRequested, this, [this, ws]() {
-            handleAddSubspaceRequest(ws);
-        });
-    }
+    // Каталог переписывает каждое сохранение (новые названия, иконки, страницы)
+    connect(_localStorage.get(), &LocalStorage::workspaceSaved, this,
+            [this](const QString &, const QString &title) {
+                setCatalog(_localStorage->catalog(isGuest()));
+                emit workspaceSaved(title);
+            });
+    connect(_localStorage.get(), &LocalStorage::workspaceSaveFailed, this,
+            [this](const QString &, const QString &title, const QString &error) {
+                emit workspaceSaveFailed(title, error);
+            });
+    connect(_localStorage.get(), &LocalStorage::storageRepaired, this,
+            &WorkspaceController::storageRepaired);
+    connect(_localStorage.get(), &LocalStorage::workspaceRestored, this,
+            &WorkspaceController::onWorkspaceRestored);
+    connect(_localStorage.get(), &LocalStorage::workspaceImportFailed, this,
+            [this](const QString &title) {
+                reloadCatalog();
+                emit workspaceImportFailed(title);
+            });
+
+    _archiveTimer = new QTimer(this);
+    _archiveTimer->setSingleShot(true);
+    _archiveTimer->setInterval(ArchiveIdleMs);
+    connect(_archiveTimer, &QTimer::timeout, this,
+            &WorkspaceController::archiveColdWorkspaces);
+    _archiveTimer->start();
+}
+
+void WorkspaceController::connectWorkspace(Workspace *workspace)
+{
+    connect(workspace, &Workspace::addSubspaceRequested, this,
+            [this, workspace]() { handleAddSubspaceRequest(workspace); });
+
+    // Правки пачками попадают в журнал; шарды перепишет ближайшая контрольная точка
+    connect(workspace, &Workspace::pageChanged, this, [this, workspace](Workspace *page) {
+        _archiveTimer->start();
+        _localStorage->journalPageUpdate(workspace, page, isGuest());
+        _autosave->markDirty(workspace);
+    });
+    connect(workspace, &Workspace::itemChanged, this,
+            [this, workspace](Workspace *page, AbstractWorkspaceItem *item) {
+                _archiveTimer->start();
+                _localStorage->journalElementUpdate(workspace, page, item, isGuest());
+                _autosave->markDirty(workspace);
+            });
+    // Тела остальных страниц не меняются, но индекс без удалённой нужно записать
+    connect(workspace, &Workspace::pageRemoved, this, [this, workspace](const QString &pageId) {
+        _archiveTimer->start();
+        _localStorage->journalPageRemove(workspace, pageId, isGuest());
+        _autosave->markDirty(workspace);
+    });
 }
 
 void WorkspaceController::handleAddSubspaceRequest(Workspace *parent)
@@ -44,6 +128,7 @@ Workspace *WorkspaceController::createWorkspace(const QString &title)
     workspace->setIcon(QIcon(":/icons/workspace.png"));
 
     _workspaces.append(workspace);
+    connectWorkspace(workspace);
     emit workspaceAdded(workspace);
 
     // Сохраняем изменения
@@ -75,12 +160,14 @@ void WorkspaceController::removeWorkspace(Workspace *workspace)
         _workspaces.removeOne(workspace);
     }
 
-    // Удаление физически
-    _localStorage->deleteWorkspace(workspace->getTitle());
-
-    // Если есть родительское пространство - сохраняем его после изменений
     if (parent) {
-        _localStorage->saveWorkspace(root);
+        // Шард подпространства удалит сохранение корня: его больше нет в иерархии,
+        // а из остальных страниц перезапишется только родительская
+        _localStorage->saveWorkspace(root, isGuest());
+    } else {
+        // Удаление физически
+        _localStorage->deleteWorkspace(workspace->getId(), isGuest());
+        setCatalog(_localStorage->catalog(isGuest()));
     }
 
     emit workspaceRemoved(workspace);
@@ -118,13 +205,13 @@ Workspace *WorkspaceController::createSubWorkspace(Workspace *parent, const QStr
     // Наследуем иконку от родителя или используем иконку по умолчанию
     QIcon parentIcon = parent->getIcon();
     if (!parentIcon.isNull()) {
-        subspace->setIcon(parentIcon);
+        subspace->setIcon(parentIcon, parent->getIconDigest());
     } else {
         subspace->setIcon(QIcon(":/icons/workspace.png"));
     }
 
-    // Сохраняем родительское пространство, чтобы сохранить структуру вложенности
-    _localStorage->saveWorkspace(parent->getRootWorkspace());
+    // Сохраняем структуру вложенности: запишутся только родитель, новая страница и иерархия
+    _localStorage->saveWorkspace(parent->getRootWorkspace(), isGuest());
 
     return subspace;
 }
@@ -197,51 +284,219 @@ void WorkspaceController::loadFromFile(const QString &filePath)
     }
 }
 
+bool WorkspaceController::isGuest() const
+{
+    return _localStorage->getCurrentUser().isEmpty();
+}
+
 void WorkspaceController::saveWorkspaces()
 {
-    QString currentUser = _localStorage->getCurrentUser();
-    bool isGuest = currentUser.isEmpty();
+    _autosave->clear();
+    for (Workspace *workspace : _workspaces) {
+        if (!workspace->getParentWorkspace()) {
+            _localStorage->saveWorkspace(workspace, isGuest());
+        }
+    }
+}
+
+QList<CatalogEntry> WorkspaceController::getCatalog() const
+{
+    return _catalog;
+}
 
+QList<CatalogEntry> WorkspaceController::getRootEntries() const
+{
+    QList<CatalogEntry> roots;
+    QSet<QString> listed;
+    for (const CatalogEntry &entry : _catalog) {
+        if (entry.parent >= 0)
+            continue;
+        CatalogEntry root = entry;
+        // У загруженного пространства название и иконка - из живой модели
+        if (Workspace *workspace = findLoadedWorkspace(entry.id)) {
+            root.workspace = workspace->getTitle();
+            root.title = workspace->getTitle();
+            root.iconDigest = workspace->getIconDigest();
+        }
+        roots.append(root);
+        listed.insert(entry.id);
+    }
+    for (Workspace *workspace : getRootWorkspaces()) {
+        if (listed.contains(workspace->getId()))
+            continue;
+        CatalogEntry root;
+        root.workspace = workspace->getTitle();
+        root.id = workspace->getId();
+        root.title = workspace->getTitle();
+        root.iconDigest = workspace->getIconDigest();
+        roots.append(root);
+    }
+    return roots;
+}
+
+Workspace *WorkspaceController::findLoadedWorkspace(const QString &rootId) const
+{
+    for (Workspace *ws : _workspaces) {
+        if (ws->getId() == rootId)
+            return ws;
+    }
+    return nullptr;
+}
+
+Workspace *WorkspaceController::openWorkspace(const QString &workspace, const QString &pageId)
+{
+    Workspace *root = findLoadedWorkspace(workspace);
+    if (!root)
+        root = findWorkspaceByTitle(workspace);
+    if (!root) {
+        root = _localStorage->loadWorkspace(workspace, _workspaceParent, isGuest());
+        if (!root)
+            return nullptr;
+        _workspaces.append(root);
+        connectWorkspace(root);
+    }
+
+    if (pageId.isEmpty())
+        return root;
+    Workspace *page = findPageById(root, pageId);
+    return page ? page : root;
+}
+
+QString WorkspaceController::importWorkspaceFile(const QString &filePath)
+{
+    const QString title = _localStorage->importWorkspaceBundle(filePath, isGuest());
+    if (!title.isEmpty())
+        reloadCatalog();
+    return title;
+}
+
+bool WorkspaceController::exportWorkspaceFile(Workspace *workspace, const QString &filePath)
+{
+    return workspace && _localStorage->exportWorkspaceBundle(workspace, filePath);
+}
+
+void WorkspaceController::saveWorkspacesInBackground()
+{
+    _autosave->clear();
     for (Workspace *workspace : _workspaces) {
         if (!workspace->getParentWorkspace()) {
-            _localStorage->saveWorkspace(workspace, isGuest);
+            _localStorage->saveWorkspaceAsync(workspace, isGuest());
         }
     }
 }
 
 void WorkspaceController::loadWorkspaces(QWidget *parent)
 {
-    QString currentUser = _localStorage->getCurrentUser();
-
     // Очищаем текущий список рабочих пространств
     qDeleteAll(_workspaces);
     _workspaces.clear();
+    _workspaceParent = parent;
 
-    if (currentUser.isEmpty()) {
-        // Load guest workspaces only if not authenticated
-        QDir guestDir(QApplication::applicationDirPath() + "/Workspaces/guest/");
-        if (guestDir.exists()) {
-            QFileInfoList folders = guestDir.entryInfoList(QDir::Dirs | QDir::NoDotAndDotDot);
-            for (const QFileInfo &folder : folders) {
-                Workspace *workspace =
-                 _localStorage->loadWorkspace(folder.baseName(), parent, true);
-                if (workspace) {
-                    _workspaces.append(workspace);
-                }
-            }
-        }
-    } else {
-        // Только пользовательские workspaces, гостевые не трогаем и не отображаем
-        QDir userDir(QApplication::applicationDirPath() + "/Workspaces/users/" + currentUser + "/");
-        if (userDir.exists()) {
-            QFileInfoList folders = userDir.entryInfoList(QDir::Dirs | QDir::NoDotAndDotDot);
-            for (const QFileInfo &folder : folders) {
-                Workspace *workspace =
-                 _localStorage->loadWorkspace(folder.baseName(), parent, false);
-                if (workspace) {
-                    _workspaces.append(workspace);
-                }
-            }
-        }
+    // Читаем только каталог: боковая панель строится сразу,
+    // а пространства загружаются при первом открытии (openWorkspace)
+    _catalog = _localStorage->loadCatalog(isGuest());
+    _storageWatcher->setBasePath(_localStorage->getWorkspacePath(isGuest()));
+}
+
+void WorkspaceController::onStoragePageChanged(const QString &workspaceId,
+                                               const QString &pageId)
+{
+    // Незагруженные пространства видны только через каталог, его обновит изменение иерархии
+    Workspace *root = findLoadedWorkspace(workspaceId);
+    if (!root)
+        return;
+
+    Workspace *page = findPageById(root, pageId);
+    if (!page)
+        return; // новую страницу добавит изменение иерархии
+
+    // Несохранённые локальные правки важнее: они перезапишут шард при сохранении
+    if (page->isDirty()) {
+        qDebug() << "Page" << pageId << "changed on disk, keeping local edits";
+        return;
+    }
+
+    QJsonObject stored;
+    if (!_localStorage->readChangedPage(workspaceId, page, stored, isGuest()))
+        return;
+
+    page->reloadPage(stored);
+    emit pageReloaded(page);
+}
+
+void WorkspaceController::onStorageIndexChanged(const QString &workspaceId)
+{
+    Workspace *root = findLoadedWorkspace(workspaceId);
+    if (!root) {
+        reloadCatalog();
+        return;
     }
+    if (!_localStorage->isStructureChanged(root, isGuest()))
+        return;
+    if (hasDirtyPages(root)) {
+        qDebug() << "Workspace" << root->getTitle() << "changed on disk, keeping local edits";
+        return;
+    }
+
+    // Иерархия поменялась: перечитываем только это пространство
+    reloadWorkspace(root);
+}
+
+void WorkspaceController::onWorkspaceRestored(const QString &workspaceId)
+{
+    // Восстановленная версия заменяет и несохранённые правки
+    Workspace *root = findLoadedWorkspace(workspaceId);
+    if (root)
+        reloadWorkspace(root);
+    reloadCatalog();
+}
+
+void WorkspaceController::reloadWorkspace(Workspace *root)
+{
+    Workspace *fresh = _localStorage->loadWorkspace(root->getId(), _workspaceParent, isGuest());
+    if (!fresh)
+        return;
+
+    _workspaces[_workspaces.indexOf(root)] = fresh;
+    connectWorkspace(fresh);
+    emit workspaceReloaded(root, fresh);
+    root->deleteLater();
+}
+
+void WorkspaceController::reloadCatalog()
+{
+    setCatalog(_localStorage->loadCatalog(isGuest()));
+}
+
+void WorkspaceController::setCatalog(const QList<CatalogEntry> &catalog)
+{
+    // Загруженные пространства панель показывает по живой модели, поэтому
+    // собственные записи каталога перестраивать её не заставляют
+    auto unloaded = [this](const QList<CatalogEntry> &catalog) {
+        QList<CatalogEntry> entries;
+        QString rootId;
+        for (const CatalogEntry &entry : catalog) {
+            if (entry.parent < 0)
+                rootId = entry.id;
+            if (!findLoadedWorkspace(rootId))
+                entries.append(entry);
+        }
+        return entries;
+    };
+
+    const bool changed = unloaded(catalog) != unloaded(_catalog);
+    _catalog = catalog;
+    if (changed)
+        emit catalogChanged();
+}
+
+void WorkspaceController::archiveColdWorkspaces()
+{
+    // Открытые пространства не трогаем, даже если их давно не открывали заново
+    QStringList openTitles;
+    for (Workspace *workspace : getRootWorkspaces()) openTitles << workspace->getTitle();
+
+    _localStorage->archiveColdWorkspaces(openTitles,
+                                         SettingsManager::instance().archiveAfterDays(),
+                                         isGuest());
 }
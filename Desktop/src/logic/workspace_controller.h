@@ -3,6 +3,8 @@
 
 #include "workspace.h"
 #include "../local_storage.h"
+#include "../storage/storage_watcher.h"
+#include "autosave_scheduler.h"
 
 #include <QObject>
 #include <QList>
@@ -10,6 +12,8 @@
 #include <QJsonObject>
 #include <QJsonDocument>
 #include <QFile>
+#include <QTimer>
+#include <QPointer>
 
 class WorkspaceController : public QObject
 {
@@ -28,10 +32,26 @@ public:
     QJsonObject serialize() const;
     void deserialize(const QJsonObject &json);
     void saveWorkspaces();
+    // Не блокирует интерфейс: результат приходит сигналами workspaceSaved/workspaceSaveFailed
+    void saveWorkspacesInBackground();
     void loadWorkspaces(QWidget *parent = nullptr);
 
+    // Каталог всех пространств; сами пространства загружаются при первом открытии
+    QList<CatalogEntry> getCatalog() const;
+    // Корни всех пространств в порядке каталога, включая ещё не записанные новые
+    QList<CatalogEntry> getRootEntries() const;
+    Workspace *findLoadedWorkspace(const QString &rootId) const;
+    // workspace - id корня (названия могут совпадать) или название
+    Workspace *openWorkspace(const QString &workspace, const QString &pageId = QString());
+
+    // Файл *.workspace: дерево сразу появляется в каталоге, страницы читаются при открытии.
+    // Возвращает название пространства или пустую строку.
+    QString importWorkspaceFile(const QString &filePath);
+    bool exportWorkspaceFile(Workspace *workspace, const QString &filePath);
+
     // Работа с подпространствами (страницами)
     Workspace *createSubWorkspace(Workspace *parent, const QString &title);
+    // Только загруженные корни
     QList<Workspace *> getRootWorkspaces() const;
 
 public:
@@ -50,13 +70,38 @@ signals:
     void workspaceAdded(Workspace *workspace);
     void workspaceRemoved(Workspace *workspace);
     void pathUpdated(Workspace *workspace);
+    void workspaceSaved(const QString &title);
+    void workspaceSaveFailed(const QString &title, const QString &error);
+    // Файлы пространства переписал другой процесс (синхронизация, второй экземпляр)
+    void pageReloaded(Workspace *page);
+    void workspaceReloaded(Workspace *oldRoot, Workspace *newRoot);
+    void catalogChanged();
+    void storageRepaired(int repaired, const QStringList &lost);
+    void workspaceImportFailed(const QString &title);
 
 private slots:
     void handleAddSubspaceRequest(Workspace *parent);
+    void archiveColdWorkspaces();
+    void onStoragePageChanged(const QString &workspaceId, const QString &pageId);
+    void onStorageIndexChanged(const QString &workspaceId);
+    void onWorkspaceRestored(const QString &workspaceId);
+    void reloadCatalog();
 
 private:
+    bool isGuest() const;
+    void connectWorkspace(Workspace *workspace);
+    // Заменяет загруженное пространство прочитанным из хранилища
+    void reloadWorkspace(Workspace *root);
+    // Заменяет каталог; catalogChanged - только если изменились незагруженные пространства
+    void setCatalog(const QList<CatalogEntry> &catalog);
+
     QList<Workspace *> _workspaces;
+    QList<CatalogEntry> _catalog;
+    QPointer<QWidget> _workspaceParent;
     std::shared_ptr<LocalStorage> _localStorage;
+    AutosaveScheduler *_autosave { nullptr };
+    QTimer *_archiveTimer { nullptr };
+    StorageWatcher *_storageWatcher { nullptr };
 
     void recursiveSerialize(Workspace *workspace, QJsonObject &json) const;
     Workspace *recursiveDeserialize(const QJsonObject &json, Workspace *parent = nullptr);
@@ -0,0 +1,101 @@
+#include "workspace_viewer.h"
+#include "../storage/blob_store.h"
+
+#include <QEvent>
+#include <QDebug>
+
+WorkspaceViewer::WorkspaceViewer(QObject *parent) : QObject(parent)
+{}
+
+WorkspaceViewer::~WorkspaceViewer()
+{
+    BlobStore::instance().removeSource(this);
+    for (const QPointer<Workspace> &page : std::as_const(_pages)) delete page.data();
+}
+
+bool WorkspaceViewer::open(const QString &filePath, QWidget *parent)
+{
+    if (!_bundle.open(filePath, WorkspaceBundle::Mapped) || _bundle.pages().isEmpty())
+        return false;
+    _filePath = filePath;
+
+    const QList<WorkspaceBundle::PageEntry> &pages = _bundle.pages();
+    _children = QList<QList<int>>(pages.size());
+    for (int i = 0; i < pages.size(); ++i) {
+        if (pages[i].parent >= 0 && pages[i].parent < i)
+            _children[pages[i].parent].append(i);
+    }
+
+    const QList<WorkspaceBundle::BlobEntry> &blobs = _bundle.blobs();
+    for (int i = 0; i < blobs.size(); ++i) _blobIndex.insert(blobs[i].digest, i);
+
+    // Изображения и иконки страниц берутся из файла, пока он открыт в просмотре.
+    // readBlob отдаёт окно в отображённый файл, а декодирование в пуле потоков может
+    // пережить просмотр - наружу уходит копия
+    BlobStore::instance().addSource(this, [this](const QString &digest) {
+        QByteArray data;
+        const int index = _blobIndex.value(digest, -1);
+        if (index < 0 || !_bundle.readBlob(_bundle.blobs()[index], data))
+            return QByteArray();
+        return QByteArray(data.constData(), data.size());
+    });
+
+    createPage(0, nullptr, parent);
+    return true;
+}
+
+QString WorkspaceViewer::filePath() const
+{
+    return _filePath;
+}
+
+Workspace *WorkspaceViewer::root() const
+{
+    return _pages.isEmpty() ? nullptr : _pages.first().data();
+}
+
+bool WorkspaceViewer::contains(Workspace *page) const
+{
+    return page && root() && page->getRootWorkspace() == root();
+}
+
+bool WorkspaceViewer::eventFilter(QObject *watched, QEvent *event)
+{
+    if (event->type() == QEvent::Show) {
+        Workspace *page = static_cast<Workspace *>(watched);
+        if (_pending.contains(page)) {
+            page->removeEventFilter(this);
+            loadPage(page, _pending.take(page));
+        }
+    }
+    return QObject::eventFilter(watched, event);
+}
+
+Workspace *WorkspaceViewer::createPage(int index, Workspace *parent, QWidget *parentWidget)
+{
+    const WorkspaceBundle::PageEntry &entry = _bundle.pages()[index];
+    Workspace *page = new Workspace(entry.title, parentWidget);
+    page->setId(entry.id);
+    page->setReadOnly(true);
+    if (parent)
+        parent->addSubWorkspace(page);
+
+    _pages.append(page);
+    _pending.insert(page, index);
+    page->installEventFilter(this);
+    return page;
+}
+
+void WorkspaceViewer::loadPage(Workspace *page, int index)
+{
+    QJsonObject json;
+    if (!_bundle.readPage(index, json)) {
+        qWarning() << "Failed to read page" << page->getTitle() << "from" << _filePath;
+        return;
+    }
+    page->deserializePage(json);
+
+    // Ссылки на подстраницы идут после содержимого, как при обычной загрузке
+    for (int child : std::as_const(_children[index])) createPage(child, page);
+    page->clearDirty();
+}
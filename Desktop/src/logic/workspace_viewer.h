@@ -0,0 +1,50 @@
+#ifndef WORKSPACE_VIEWER_H
+#define WORKSPACE_VIEWER_H
+
+#include "workspace.h"
+#include "../storage/workspace_bundle.h"
+
+#include <QHash>
+#include <QList>
+#include <QObject>
+#include <QPointer>
+#include <QString>
+
+// Просмотр файла *.workspace без импорта в хранилище, для больших справочных
+// пространств (библиотеки сканов на сотни мегабайт).
+//
+// Файл отображается в память (WorkspaceBundle::Mapped). Страница создаётся пустой и
+// заполняется при первом показе, её подстраницы - тогда же. Изображения декодируются
+// из копии сжатых данных в размер элемента и освобождаются, когда страница скрыта,
+// так что в памяти остаётся примерно то, что видно на экране.
+// Страницы только для чтения и не попадают в хранилище.
+class WorkspaceViewer : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit WorkspaceViewer(QObject *parent = nullptr);
+    ~WorkspaceViewer();
+
+    bool open(const QString &filePath, QWidget *parent = nullptr);
+
+    QString filePath() const;
+    Workspace *root() const;
+    bool contains(Workspace *page) const;
+
+protected:
+    bool eventFilter(QObject *watched, QEvent *event) override;
+
+private:
+    Workspace *createPage(int index, Workspace *parent, QWidget *parentWidget = nullptr);
+    void loadPage(Workspace *page, int index);
+
+    QString _filePath;
+    WorkspaceBundle _bundle;
+    QList<QList<int>> _children; // индексы подстраниц для каждой страницы
+    QHash<QString, int> _blobIndex; // digest -> индекс в WorkspaceBundle::blobs()
+    QHash<Workspace *, int> _pending; // ещё не заполненные страницы
+    QList<QPointer<Workspace>> _pages;
+};
+
+#endif // WORKSPACE_VIEWER_H
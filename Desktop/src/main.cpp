@@ -1,11 +1,47 @@
 #include "mainwindow.h"
+#include "local_storage.h"
+#include "single_instance.h"
+#include "storage/storage_benchmark.h"
 
 #include <QApplication>
+#include <QFileInfo>
+#include <QMessageBox>
 
 int main(int argc, char *argv[])
 {
     QApplication a(argc, argv);
+
+    // Замер накладных расходов шифрования хранилища, без запуска интерфейса
+    if (a.arguments().contains("--storage-benchmark")) {
+        StorageBenchmark::print(StorageBenchmark::run());
+        return 0;
+    }
+    if (a.arguments().contains("--text-codec-benchmark")) {
+        StorageBenchmark::print(StorageBenchmark::runTextCodec());
+        return 0;
+    }
+
+    // Хранилище пишет только один процесс: второй экземпляр передаёт запрос первому
+    // Пути к файлам делаем абсолютными: у первого экземпляра другой рабочий каталог
+    QStringList arguments = a.arguments().mid(1);
+    for (QString &argument : arguments) {
+        if (!argument.startsWith("-") && QFileInfo(argument).isFile())
+            argument = QFileInfo(argument).absoluteFilePath();
+    }
+
+    SingleInstance instance(LocalStorage::storageRootPath());
+    if (!instance.lock()) {
+        if (instance.sendToPrimary(arguments))
+            return 0;
+        QMessageBox::warning(nullptr, "Приложение уже запущено",
+                             "Хранилище пространств используется другим экземпляром приложения.");
+        return 1;
+    }
+
     MainWindow w;
+    QObject::connect(&instance, &SingleInstance::activationRequested, &w,
+                     &MainWindow::bringToFront);
     w.show();
+    w.openFiles(arguments);
     return a.exec();
 }
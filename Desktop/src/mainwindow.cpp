@@ -14,6 +14,7 @@
 #include <QPushButton>
 #include <QListWidgetItem>
 #include <QVariant>
+#include <QFileInfo>
 #include <QDebug>
 
 MainWindow::MainWindow(QWidget *parent) : QMainWindow(parent)
@@ -50,6 +51,26 @@ MainWindow::~MainWindow()
     saveWindowState();
 }
 
+void MainWindow::bringToFront(const QStringList &arguments)
+{
+    // Свёрнутое окно возвращается в прежнее состояние (развёрнутое или нет)
+    if (isMinimized())
+        setWindowState(windowState() & ~Qt::WindowMinimized);
+    show();
+    raise();
+    activateWindow();
+    openFiles(arguments);
+}
+
+void MainWindow::openFiles(const QStringList &arguments)
+{
+    for (const QString &argument : arguments) {
+        if (argument.startsWith("-") || !QFileInfo(argument).isFile())
+            continue;
+        _mainWidget->openWorkspaceFile(argument);
+    }
+}
+
 void MainWindow::createMenus()
 {
     // File menu
@@ -70,6 +91,9 @@ void MainWindow::createMenus()
     openAction->setShortcut(QKeySequence::Open);
     connect(openAction, &QAction::triggered, _mainWidget.get(), &MainWidget::openWorkspace);
 
+    QAction *viewAction = fileMenu->addAction(QIcon(":/icons/open.png"), "Просмотреть файл...");
+    connect(viewAction, &QAction::triggered, _mainWidget.get(), &MainWidget::viewWorkspaceFile);
+
     fileMenu->addSeparator();
 
     QAction *saveAction = fileMenu->addAction(QIcon(":/icons/save.png"), "Сохранить");
@@ -19,6 +19,13 @@ public:
     MainWindow(QWidget *parent = nullptr);
     ~MainWindow();
 
+    // Файлы пространств из командной строки; остальные аргументы пропускаются
+    void openFiles(const QStringList &arguments);
+
+public slots:
+    // Запрос второго экземпляра приложения: его аргументы и показ окна
+    void bringToFront(const QStringList &arguments);
+
 protected:
     void closeEvent(QCloseEvent* event) override;
 
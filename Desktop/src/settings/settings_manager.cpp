@@ -55,6 +55,32 @@ void SettingsManager::loadDefaults()
         setAutoSync(true);
     }
 
+    // Storage defaults
+    if (!_settings.contains("storage/archiveAfterDays")) {
+        setArchiveAfterDays(30);
+    }
+    if (!_settings.contains("storage/encrypt")) {
+        setEncryptStorage(false);
+    }
+    if (!_settings.contains("storage/engine")) {
+        setStorageEngine("directory");
+    }
+    if (!_settings.contains("images/reencode")) {
+        setReencodeImages(false);
+    }
+    if (!_settings.contains("images/maxDimension")) {
+        setImageMaxDimension(2048);
+    }
+    if (!_settings.contains("images/quality")) {
+        setImageQuality(85);
+    }
+    if (!_settings.contains("images/lossless")) {
+        setLosslessImages(false);
+    }
+    if (!_settings.contains("images/memoryBudget")) {
+        setImageMemoryBudget(512);
+    }
+
     // Auth defaults
     if (!_settings.contains("auth/rememberMe")) {
         setRememberMe(false);
@@ -174,6 +200,95 @@ void SettingsManager::setAutoSync(bool enabled)
     emit syncSettingsChanged();
 }
 
+// Storage settings
+int SettingsManager::archiveAfterDays() const
+{
+    return _settings.value("storage/archiveAfterDays").toInt();
+}
+
+void SettingsManager::setArchiveAfterDays(int days)
+{
+    _settings.setValue("storage/archiveAfterDays", days);
+    emit storageSettingsChanged();
+}
+
+bool SettingsManager::encryptStorage() const
+{
+    return _settings.value("storage/encrypt").toBool();
+}
+
+void SettingsManager::setEncryptStorage(bool enabled)
+{
+    _settings.setValue("storage/encrypt", enabled);
+    emit storageSettingsChanged();
+}
+
+QString SettingsManager::storageEngine() const
+{
+    return _settings.value("storage/engine").toString();
+}
+
+void SettingsManager::setStorageEngine(const QString &engine)
+{
+    _settings.setValue("storage/engine", engine);
+    emit storageSettingsChanged();
+}
+
+bool SettingsManager::reencodeImages() const
+{
+    return _settings.value("images/reencode").toBool();
+}
+
+void SettingsManager::setReencodeImages(bool enabled)
+{
+    _settings.setValue("images/reencode", enabled);
+    emit storageSettingsChanged();
+}
+
+int SettingsManager::imageMaxDimension() const
+{
+    return _settings.value("images/maxDimension").toInt();
+}
+
+void SettingsManager::setImageMaxDimension(int pixels)
+{
+    _settings.setValue("images/maxDimension", pixels);
+    emit storageSettingsChanged();
+}
+
+int SettingsManager::imageQuality() const
+{
+    return _settings.value("images/quality").toInt();
+}
+
+void SettingsManager::setImageQuality(int quality)
+{
+    _settings.setValue("images/quality", quality);
+    emit storageSettingsChanged();
+}
+
+bool SettingsManager::losslessImages() const
+{
+    return _settings.value("images/lossless").toBool();
+}
+
+void SettingsManager::setLosslessImages(bool enabled)
+{
+    _settings.setValue("images/lossless", enabled);
+    emit storageSettingsChanged();
+}
+
+int SettingsManager::imageMemoryBudget() const
+{
+    return _settings.value("images/memoryBudget").toInt();
+}
+
+void SettingsManager::setImageMemoryBudget(int megabytes)
+{
+    _settings.setValue("images/memoryBudget", megabytes);
+    emit storageSettingsChanged();
+}
+
 // Window settings
 QByteArray SettingsManager::windowGeometry() const
 {
@@ -39,6 +39,27 @@ public:
     bool autoSync() const;
     void setAutoSync(bool enabled);
 
+    // Storage settings
+    int archiveAfterDays() const;
+    void setArchiveAfterDays(int days);
+    bool encryptStorage() const;
+    void setEncryptStorage(bool enabled);
+    // "directory" или "sqlite"; действует после перезапуска
+    QString storageEngine() const;
+    void setStorageEngine(const QString &engine);
+    // Перекодирование вставляемых изображений; выключено - файл хранится как есть
+    bool reencodeImages() const;
+    void setReencodeImages(bool enabled);
+    int imageMaxDimension() const;
+    void setImageMaxDimension(int pixels);
+    int imageQuality() const;
+    void setImageQuality(int quality);
+    bool losslessImages() const;
+    void setLosslessImages(bool enabled);
+    // Предел памяти под декодированные изображения открытых страниц, МБ
+    int imageMemoryBudget() const;
+    void setImageMemoryBudget(int megabytes);
+
     // Window settings
     QByteArray windowGeometry() const;
     void setWindowGeometry(const QByteArray& geometry);
@@ -57,6 +78,7 @@ signals:
     void themeChanged();
     void editorSettingsChanged();
     void syncSettingsChanged();
+    void storageSettingsChanged();
     void windowSettingsChanged();
     void authSettingsChanged();
 
@@ -0,0 +1,84 @@
+#include "single_instance.h"
+
+#include <QCryptographicHash>
+#include <QDataStream>
+#include <QDir>
+#include <QLocalSocket>
+#include <QDebug>
+
+namespace {
+constexpr char LockFileName[] = "instance.lock";
+constexpr int ConnectTimeoutMs = 1000;
+} // namespace
+
+SingleInstance::SingleInstance(const QString &storageRootPath, QObject *parent) :
+    QObject(parent),
+    _storageRootPath(storageRootPath),
+    _lockFile(storageRootPath + LockFileName)
+{
+    // Имя сокета зависит от пути: копии приложения в разных каталогах друг другу не мешают
+    const QByteArray pathHash = QCryptographicHash::hash(
+     QDir::cleanPath(storageRootPath).toUtf8(), QCryptographicHash::Sha1);
+    _serverName = QString("Desktop-") + QString::fromLatin1(pathHash.toHex().left(16));
+
+    // Блокировка живёт всё время работы приложения: устаревшей считается
+    // только блокировка завершившегося процесса, а не старая по времени
+    _lockFile.setStaleLockTime(0);
+
+    connect(&_server, &QLocalServer::newConnection, this, &SingleInstance::onNewConnection);
+}
+
+SingleInstance::~SingleInstance()
+{
+    _server.close();
+    _lockFile.unlock();
+}
+
+bool SingleInstance::lock()
+{
+    QDir().mkpath(_storageRootPath);
+    if (!_lockFile.tryLock(0))
+        return false;
+
+    // Сокет мог остаться от аварийно завершённого владельца - блокировка уже наша
+    if (!_server.listen(_serverName)) {
+        QLocalServer::removeServer(_serverName);
+        if (!_server.listen(_serverName))
+            qWarning() << "Failed to listen for other instances:" << _server.errorString();
+    }
+    return true;
+}
+
+bool SingleInstance::sendToPrimary(const QStringList &arguments) const
+{
+    QLocalSocket socket;
+    socket.connectToServer(_serverName);
+    if (!socket.waitForConnected(ConnectTimeoutMs)) {
+        qWarning() << "Running instance does not respond:" << socket.errorString();
+        return false;
+    }
+
+    QByteArray message;
+    QDataStream out(&message, QIODevice::WriteOnly);
+    out.setVersion(QDataStream::Qt_5_12);
+    out << arguments;
+    socket.write(message);
+    const bool written = socket.waitForBytesWritten(ConnectTimeoutMs);
+    socket.disconnectFromServer();
+    return written;
+}
+
+void SingleInstance::onNewConnection()
+{
+    while (QLocalSocket *socket = _server.nextPendingConnection()) {
+        // Сообщение целиком приходит к моменту отключения клиента
+        connect(socket, &QLocalSocket::disconnected, this, [this, socket]() {
+            QDataStream in(socket->readAll());
+            in.setVersion(QDataStream::Qt_5_12);
+            QStringList arguments;
+            in >> arguments;
+            socket->deleteLater();
+            emit activationRequested(arguments);
+        });
+    }
+}
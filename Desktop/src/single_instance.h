@@ -0,0 +1,37 @@
+#ifndef SINGLE_INSTANCE_H
+#define SINGLE_INSTANCE_H
+
+#include <QLocalServer>
+#include <QLockFile>
+#include <QObject>
+#include <QString>
+#include <QStringList>
+
+// Один процесс на хранилище. Владелец хранилища держит QLockFile в его корне и
+// слушает локальный сокет; второй экземпляр, не получив блокировку, передаёт
+// свои аргументы первому и завершается, ничего не записав.
+class SingleInstance : public QObject
+{
+    Q_OBJECT
+public:
+    explicit SingleInstance(const QString &storageRootPath, QObject *parent = nullptr);
+    ~SingleInstance();
+
+    // true - хранилище наше, запросы других экземпляров начинают приниматься
+    bool lock();
+    bool sendToPrimary(const QStringList &arguments) const;
+
+signals:
+    void activationRequested(const QStringList &arguments);
+
+private slots:
+    void onNewConnection();
+
+private:
+    QString _storageRootPath;
+    QString _serverName;
+    QLockFile _lockFile;
+    QLocalServer _server;
+};
+
+#endif // SINGLE_INSTANCE_H
@@ -0,0 +1,306 @@
+#include "blob_store.h"
+#include "crc32c.h"
+#include "storage_engine.h"
+#include "storage_cipher.h"
+
+#include <QApplication>
+#include <QCryptographicHash>
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QJsonArray>
+#include <QMutexLocker>
+#include <QtEndian>
+#include <QDebug>
+
+namespace {
+constexpr qint64 RecordHeaderSize = 4 + 4;
+constexpr char QuarantineDirName[] = "quarantine/";
+
+// false - заголовок есть, но данные не совпадают с контрольной суммой
+bool unwrapRecord(const QByteArray &record, QByteArray &data)
+{
+    if (record.size() < RecordHeaderSize
+        || qFromBigEndian<quint32>(record.constData()) != BlobStore::RecordMagic) {
+        data = record;
+        return true;
+    }
+
+    data = record.mid(RecordHeaderSize);
+    return Crc32c::checksum(data) == qFromBigEndian<quint32>(record.constData() + 4);
+}
+} // namespace
+
+BlobStore &BlobStore::instance()
+{
+    static BlobStore instance;
+    return instance;
+}
+
+BlobStore::BlobStore(QObject *parent) : QObject(parent)
+{
+    _rootPath = QApplication::applicationDirPath() + "/Workspaces/blobs/";
+    QDir().mkpath(_rootPath);
+}
+
+QString BlobStore::digestOf(const QByteArray &data)
+{
+    return QString::fromLatin1(QCryptographicHash::hash(data, QCryptographicHash::Sha256).toHex());
+}
+
+QString BlobStore::blobPath(const QString &digest) const
+{
+    return _rootPath + digest.left(2) + "/" + digest;
+}
+
+bool BlobStore::contains(const QString &digest) const
+{
+    if (digest.isEmpty())
+        return false;
+
+    QMutexLocker locker(&_mutex);
+    if (_known.contains(digest))
+        return true;
+    if (StorageEngine::instance().hasBlob(digest)) {
+        _known.insert(digest);
+        return true;
+    }
+    return false;
+}
+
+QString BlobStore::put(const QByteArray &data)
+{
+    if (data.isEmpty())
+        return QString();
+
+    const QString digest = digestOf(data);
+    if (contains(digest))
+        return digest;
+    if (!writeRecord(digest, data))
+        return QString();
+
+    QMutexLocker locker(&_mutex);
+    _known.insert(digest);
+    return digest;
+}
+
+bool BlobStore::writeRecord(const QString &key, const QByteArray &data)
+{
+    // blob общие для всех пользователей установки, поэтому шифруются общим ключом
+    QByteArray payload;
+    if (!StorageCipher::instance().seal(data, payload, StorageCipher::SharedKey))
+        return false;
+
+    QByteArray record(RecordHeaderSize, Qt::Uninitialized);
+    qToBigEndian<quint32>(RecordMagic, record.data());
+    qToBigEndian<quint32>(Crc32c::checksum(payload), record.data() + 4);
+    record.append(payload);
+    return StorageEngine::instance().writeBlob(key, record);
+}
+
+bool BlobStore::openRecord(const QString &key, const QByteArray &record, QByteArray &data) const
+{
+    QByteArray payload;
+    if (!unwrapRecord(record, payload)) {
+        qWarning() << "Blob checksum mismatch:" << key;
+        return false;
+    }
+    if (!StorageCipher::instance().open(payload, data)) {
+        qWarning() << "Failed to decrypt blob" << key;
+        return false;
+    }
+    return true;
+}
+
+QByteArray BlobStore::get(const QString &digest) const
+{
+    if (digest.isEmpty())
+        return QByteArray();
+
+    QByteArray record;
+    if (!StorageEngine::instance().readBlob(digest, record)) {
+        {
+            QMutexLocker locker(&_mutex);
+            for (const auto &source : _sources) {
+                const QByteArray data = source.second(digest);
+                if (!data.isEmpty())
+                    return data;
+            }
+        }
+        qWarning() << "Blob not found:" << digest;
+        return QByteArray();
+    }
+
+    QByteArray data;
+    return openRecord(digest, record, data) ? data : QByteArray();
+}
+
+bool BlobStore::putDerived(const QString &digest, const QString &variant, const QByteArray &data)
+{
+    return !digest.isEmpty() && !data.isEmpty() && writeRecord(digest + "." + variant, data);
+}
+
+QByteArray BlobStore::getDerived(const QString &digest, const QString &variant) const
+{
+    const QString key = digest + "." + variant;
+    QByteArray record;
+    QByteArray data;
+    if (digest.isEmpty() || !StorageEngine::instance().readBlob(key, record)
+        || !openRecord(key, record, data)) {
+        return QByteArray();
+    }
+    return data;
+}
+
+void BlobStore::addSource(const QObject *owner, const Source &source)
+{
+    QMutexLocker locker(&_mutex);
+    _sources.append(qMakePair(owner, source));
+}
+
+void BlobStore::removeSource(const QObject *owner)
+{
+    QMutexLocker locker(&_mutex);
+    for (int i = _sources.size() - 1; i >= 0; --i) {
+        if (_sources[i].first == owner)
+            _sources.removeAt(i);
+    }
+}
+
+QString BlobStore::rootPath() const
+{
+    return _rootPath;
+}
+
+bool BlobStore::verify(const QString &digest) const
+{
+    QByteArray record;
+    if (!StorageEngine::instance().readBlob(digest, record))
+        return false;
+
+    QByteArray data;
+    return unwrapRecord(record, data);
+}
+
+bool BlobStore::quarantine(const QString &digest)
+{
+    const QString quarantinePath = _rootPath + QuarantineDirName;
+    QDir().mkpath(quarantinePath);
+    const QString target =
+     quarantinePath + digest + "." + QString::number(QDateTime::currentMSecsSinceEpoch());
+    if (QFile::exists(blobPath(digest))) {
+        if (!QFile::rename(blobPath(digest), target)) {
+            qWarning() << "Failed to quarantine blob" << digest;
+            return false;
+        }
+    } else {
+        // Запись в базе движка: копия уходит в quarantine/, строка удаляется
+        QByteArray record;
+        QFile file(target);
+        if (!StorageEngine::instance().readBlob(digest, record)
+            || !file.open(QIODevice::WriteOnly) || file.write(record) != record.size()
+            || !StorageEngine::instance().removeBlob(digest)) {
+            qWarning() << "Failed to quarantine blob" << digest;
+            return false;
+        }
+    }
+
+    // Blob можно будет записать заново при следующем put() тех же данных
+    QMutexLocker locker(&_mutex);
+    _known.remove(digest);
+    qWarning() << "Quarantined damaged blob" << digest;
+    return true;
+}
+
+int BlobStore::collect(const QSet<QString> &referenced, const QDateTime &writtenBefore)
+{
+    int removed = 0;
+    const QStringList keys = StorageEngine::instance().blobKeys(writtenBefore);
+    for (const QString &key : keys) {
+        const QString digest = key.section('.', 0, 0);
+        if (referenced.contains(digest))
+            continue;
+
+        // put() того же содержимого ждёт мьютекс и либо найдёт blob в _known,
+        // либо запишет его заново после удаления
+        QMutexLocker locker(&_mutex);
+        if (_known.contains(digest))
+            continue;
+        if (StorageEngine::instance().removeBlob(key))
+            ++removed;
+    }
+    return removed;
+}
+
+void BlobStore::inlineBlobs(QJsonObject &workspaceJson) const
+{
+    if (workspaceJson.contains("iconDigest")) {
+        workspaceJson["icon"] =
+         QString::fromLatin1(get(workspaceJson["iconDigest"].toString()).toBase64());
+        workspaceJson.remove("iconDigest");
+    }
+
+    QJsonArray elements = workspaceJson["elements"].toArray();
+    bool elementsChanged = false;
+    for (int i = 0; i < elements.size(); ++i) {
+        QJsonObject element = elements[i].toObject();
+        if (element.contains("imageDigest")) {
+            element["imageData"] =
+             QString::fromLatin1(get(element["imageDigest"].toString()).toBase64());
+            element.remove("imageDigest");
+            elements[i] = element;
+            elementsChanged = true;
+        }
+    }
+    if (elementsChanged)
+        workspaceJson["elements"] = elements;
+
+    if (!workspaceJson.contains("pages"))
+        return;
+
+    QJsonArray pages = workspaceJson["pages"].toArray();
+    for (int i = 0; i < pages.size(); ++i) {
+        QJsonObject page = pages[i].toObject();
+        inlineBlobs(page);
+        pages[i] = page;
+    }
+    workspaceJson["pages"] = pages;
+}
+
+void BlobStore::externalizeBlobs(QJsonObject &workspaceJson)
+{
+    if (workspaceJson.contains("icon")) {
+        QString digest = put(QByteArray::fromBase64(workspaceJson["icon"].toString().toLatin1()));
+        if (!digest.isEmpty())
+            workspaceJson["iconDigest"] = digest;
+        workspaceJson.remove("icon");
+    }
+
+    QJsonArray elements = workspaceJson["elements"].toArray();
+    bool elementsChanged = false;
+    for (int i = 0; i < elements.size(); ++i) {
+        QJsonObject element = elements[i].toObject();
+        if (element.contains("imageData")) {
+            QString digest =
+             put(QByteArray::fromBase64(element["imageData"].toString().toLatin1()));
+            if (!digest.isEmpty())
+                element["imageDigest"] = digest;
+            element.remove("imageData");
+            elements[i] = element;
+            elementsChanged = true;
+        }
+    }
+    if (elementsChanged)
+        workspaceJson["elements"] = elements;
+
+    if (!workspaceJson.contains("pages"))
+        return;
+
+    QJsonArray pages = workspaceJson["pages"].toArray();
+    for (int i = 0; i < pages.size(); ++i) {
+        QJsonObject page = pages[i].toObject();
+        externalizeBlobs(page);
+        pages[i] = page;
+    }
+    workspaceJson["pages"] = pages;
+}
@@ -0,0 +1,78 @@
+#ifndef BLOB_STORE_H
+#define BLOB_STORE_H
+
+#include <QObject>
+#include <QByteArray>
+#include <QDateTime>
+#include <QJsonObject>
+#include <QMutex>
+#include <QSet>
+#include <QString>
+#include <functional>
+
+// Хранилище двоичных данных (изображения, иконки) с адресацией по содержимому.
+// Ключ - SHA-256 от данных. Запись хранит StorageEngine: у каталогового движка это
+// файл Workspaces/blobs/<2 символа>/<digest>, у SQLite - строка таблицы blobs.
+// Одинаковые данные хранятся один раз, повторная запись существующего blob пропускается.
+// Файл blob: magic "MNBL" | quint32 CRC32C содержимого | данные (или запись StorageCipher
+// при включённом шифровании). Blob без заголовка (записанный до появления контрольных
+// сумм) читается как есть.
+class BlobStore : public QObject
+{
+    Q_OBJECT
+public:
+    static constexpr quint32 RecordMagic = 0x4D4E424C; // "MNBL"
+
+    // Источник blob только для чтения (просмотр файла *.workspace без импорта)
+    using Source = std::function<QByteArray(const QString &digest)>;
+
+    static BlobStore &instance();
+
+    QString put(const QByteArray &data);
+    QByteArray get(const QString &digest) const;
+    bool contains(const QString &digest) const;
+    QString blobPath(const QString &digest) const;
+
+    static QString digestOf(const QByteArray &data);
+
+    // Производные данные blob (уменьшенные копии изображений) лежат рядом с ним под
+    // ключом "<digest>.<variant>" и при потере пересоздаются владельцем
+    bool putDerived(const QString &digest, const QString &variant, const QByteArray &data);
+    QByteArray getDerived(const QString &digest, const QString &variant) const;
+
+    // get() обращается к источникам, если blob нет в хранилище
+    void addSource(const QObject *owner, const Source &source);
+    void removeSource(const QObject *owner);
+
+    // Проверка контрольной суммы и перенос повреждённого blob в blobs/quarantine/
+    QString rootPath() const;
+    bool verify(const QString &digest) const;
+    bool quarantine(const QString &digest);
+
+    // Удаляет blob, которых нет в referenced, вместе с производными. Не трогает
+    // записанные после writtenBefore и все blob, записанные или найденные в этом
+    // запуске: на них могут ссылаться ещё не сохранённые страницы. Возвращает
+    // число удалённых записей.
+    int collect(const QSet<QString> &referenced, const QDateTime &writtenBefore);
+
+    // Преобразование JSON пространства между форматом хранилища (только digest)
+    // и форматом обмена с сервером (base64 внутри JSON)
+    void inlineBlobs(QJsonObject &workspaceJson) const;
+    void externalizeBlobs(QJsonObject &workspaceJson);
+
+private:
+    explicit BlobStore(QObject *parent = nullptr);
+    bool writeRecord(const QString &key, const QByteArray &data);
+    bool openRecord(const QString &key, const QByteArray &record, QByteArray &data) const;
+
+    ~BlobStore() = default;
+    BlobStore(const BlobStore &) = delete;
+    BlobStore &operator=(const BlobStore &) = delete;
+
+    QString _rootPath;
+    mutable QMutex _mutex;
+    mutable QSet<QString> _known;
+    QList<QPair<const QObject *, Source>> _sources;
+};
+
+#endif // BLOB_STORE_H
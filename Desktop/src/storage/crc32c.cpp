@@ -0,0 +1,115 @@
+#include "crc32c.h"
+
+#include <cstring>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define CRC32C_X86 1
+#include <nmmintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#elif defined(__ARM_FEATURE_CRC32)
+#define CRC32C_ARM 1
+#include <arm_acle.h>
+#endif
+
+namespace {
+constexpr quint32 Polynomial = 0x82F63B78; // отражённый полином Castagnoli
+
+struct Table
+{
+    quint32 values[256];
+
+    Table()
+    {
+        for (quint32 i = 0; i < 256; ++i) {
+            quint32 crc = i;
+            for (int bit = 0; bit < 8; ++bit) crc = (crc >> 1) ^ (Polynomial & (0u - (crc & 1)));
+            values[i] = crc;
+        }
+    }
+};
+
+quint32 softwareCrc(quint32 crc, const uchar *data, qsizetype size)
+{
+    static const Table table;
+    for (qsizetype i = 0; i < size; ++i) crc = table.values[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+    return crc;
+}
+
+#if defined(CRC32C_X86)
+#if defined(__GNUC__) || defined(__clang__)
+__attribute__((target("sse4.2")))
+#endif
+quint32
+hardwareCrc(quint32 crc, const uchar *data, qsizetype size)
+{
+    quint64 crc64 = crc;
+    while (size >= 8) {
+        quint64 word;
+        memcpy(&word, data, sizeof(word));
+        crc64 = _mm_crc32_u64(crc64, word);
+        data += 8;
+        size -= 8;
+    }
+    crc = quint32(crc64);
+    while (size-- > 0) crc = _mm_crc32_u8(crc, *data++);
+    return crc;
+}
+
+bool detectHardware()
+{
+#if defined(_MSC_VER)
+    int info[4] = {};
+    __cpuid(info, 1);
+    return info[2] & (1 << 20);
+#else
+    return __builtin_cpu_supports("sse4.2");
+#endif
+}
+#elif defined(CRC32C_ARM)
+quint32 hardwareCrc(quint32 crc, const uchar *data, qsizetype size)
+{
+    while (size >= 8) {
+        quint64 word;
+        memcpy(&word, data, sizeof(word));
+        crc = __crc32cd(crc, word);
+        data += 8;
+        size -= 8;
+    }
+    while (size-- > 0) crc = __crc32cb(crc, *data++);
+    return crc;
+}
+
+bool detectHardware()
+{
+    return true;
+}
+#endif
+} // namespace
+
+bool Crc32c::hardwareAccelerated()
+{
+#if defined(CRC32C_X86) || defined(CRC32C_ARM)
+    static const bool supported = detectHardware();
+    return supported;
+#else
+    return false;
+#endif
+}
+
+quint32 Crc32c::checksum(const char *data, qsizetype size, quint32 crc)
+{
+    const uchar *bytes = reinterpret_cast<const uchar *>(data);
+    crc = ~crc;
+#if defined(CRC32C_X86) || defined(CRC32C_ARM)
+    if (hardwareAccelerated())
+        return ~hardwareCrc(crc, bytes, size);
+#endif
+    return ~softwareCrc(crc, bytes, size);
+}
+
+quint32 Crc32c::checksum(const QByteArray &data)
+{
+    return checksum(data.constData(), data.size());
+}
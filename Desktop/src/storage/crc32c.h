@@ -0,0 +1,19 @@
+#ifndef CRC32C_H
+#define CRC32C_H
+
+#include <QByteArray>
+#include <QtGlobal>
+
+// CRC32C (Castagnoli) для контрольных сумм записей хранилища.
+// На x86-64 с SSE4.2 и на ARMv8 с расширением CRC считается инструкциями
+// процессора, иначе - табличным алгоритмом. Результат одинаков в обоих случаях.
+class Crc32c
+{
+public:
+    static quint32 checksum(const char *data, qsizetype size, quint32 crc = 0);
+    static quint32 checksum(const QByteArray &data);
+
+    static bool hardwareAccelerated();
+};
+
+#endif // CRC32C_H
@@ -0,0 +1,312 @@
+#include "directory_engine.h"
+#include "blob_store.h"
+#include "workspace_archive.h"
+#include "workspace_directory.h"
+
+#include <QBuffer>
+#include <QDir>
+#include <QDirIterator>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QDebug>
+
+namespace {
+void externalizePage(QJsonObject &page)
+{
+    BlobStore::instance().externalizeBlobs(page);
+}
+
+QString shardFileName(const QString &pageId)
+{
+    return WorkspaceDirectory::PagesDirName + pageId + WorkspaceDirectory::PageFileSuffix;
+}
+
+// Без шарда страница остаётся в иерархии пустой, а не пропадает вместе со всем деревом.
+// Если шард есть, но не прочитан, это заглушка (PageRecord::placeholder), а не пустая
+// страница: ещё ни разу не сохранённую страницу можно записывать как обычно
+QJsonObject placeholderPage(const WorkspaceContainer::IndexEntry &entry)
+{
+    QJsonObject page;
+    page["id"] = entry.id;
+    page["title"] = entry.title;
+    return page;
+}
+} // namespace
+
+StorageEngine::Kind DirectoryEngine::kind() const
+{
+    return Directory;
+}
+
+QStringList DirectoryEngine::workspaces(const QString &basePath) const
+{
+    QStringList names;
+    const QStringList folders = QDir(basePath).entryList(QDir::Dirs | QDir::NoDotAndDotDot);
+    for (const QString &folder : folders) {
+        if (contains(basePath + folder + "/"))
+            names.append(folder);
+    }
+    return names;
+}
+
+bool DirectoryEngine::contains(const QString &workspacePath) const
+{
+    return QFile::exists(workspacePath + WorkspaceDirectory::ContainerFileName)
+           || QFile::exists(workspacePath + WorkspaceDirectory::LegacyFileName)
+           || WorkspaceArchive::isArchived(workspacePath);
+}
+
+bool DirectoryEngine::remove(const QString &workspacePath)
+{
+    QDir dir(workspacePath);
+    if (!dir.exists())
+        return true;
+
+    bool removed = true;
+    const QFileInfoList entries = dir.entryInfoList(QDir::AllEntries | QDir::NoDotAndDotDot);
+    for (const QFileInfo &entry : entries) {
+        if (entry.fileName() == WorkspaceDirectory::JournalFileName
+            || entry.fileName() == WorkspaceDirectory::HistoryFileName) {
+            continue;
+        }
+        removed &= entry.isDir() ? QDir(entry.filePath()).removeRecursively()
+                                 : QFile::remove(entry.filePath());
+    }
+    if (dir.isEmpty())
+        dir.rmdir(workspacePath);
+    return removed;
+}
+
+bool DirectoryEngine::readIndex(const QString &workspacePath,
+                                QList<WorkspaceContainer::IndexEntry> &index) const
+{
+    if (WorkspaceArchive::isArchived(workspacePath)) {
+        QHash<QString, QByteArray> files;
+        return WorkspaceArchive::read(workspacePath, files,
+                                      QStringList() << WorkspaceDirectory::ContainerFileName)
+               && WorkspaceDirectory::readIndex(files.value(WorkspaceDirectory::ContainerFileName),
+                                                index);
+    }
+
+    QFile file;
+    return WorkspaceDirectory::openIndex(workspacePath, file, index);
+}
+
+bool DirectoryEngine::readContainerPage(const QString &workspacePath, QFile &container,
+                                        const WorkspaceContainer::IndexEntry &entry,
+                                        quint16 flags, PageRecord &page) const
+{
+    if (!(flags & WorkspaceContainer::ExternalPages))
+        return WorkspaceContainer::readPage(&container, entry, page);
+
+    page.parent = entry.parent;
+    if (!WorkspaceDirectory::readPageShard(workspacePath, entry.id, page.page)) {
+        const QString shardPath = WorkspaceDirectory::pageShardPath(workspacePath, entry.id);
+        page.page = placeholderPage(entry);
+        page.placeholder = QFile::exists(shardPath)
+                           || QFile::exists(shardPath + WorkspaceDirectory::PreviousSuffix);
+    }
+    return true;
+}
+
+bool DirectoryEngine::readArchivedPages(const QString &workspacePath, QList<PageRecord> &pages,
+                                        bool *current) const
+{
+    QHash<QString, QByteArray> files;
+    if (!WorkspaceArchive::read(workspacePath, files))
+        return false;
+
+    QBuffer container;
+    container.setData(files.value(WorkspaceDirectory::ContainerFileName));
+    QList<WorkspaceContainer::IndexEntry> index;
+    quint16 flags = 0;
+    if (!WorkspaceDirectory::readIndex(container.data(), index, &flags)
+        || !container.open(QIODevice::ReadOnly)) {
+        qWarning() << "Invalid workspace container in archive:" << workspacePath;
+        return false;
+    }
+
+    pages.clear();
+    pages.reserve(index.size());
+    for (const WorkspaceContainer::IndexEntry &entry : index) {
+        PageRecord record;
+        if (!(flags & WorkspaceContainer::ExternalPages)) {
+            if (!WorkspaceContainer::readPage(&container, entry, record))
+                return false;
+        } else {
+            record.parent = entry.parent;
+            if (!WorkspaceDirectory::readPageShard(files.value(shardFileName(entry.id)),
+                                                   record.page)) {
+                record.page = placeholderPage(entry);
+                const QString shardName = shardFileName(entry.id);
+                const QString previousName = shardName + WorkspaceDirectory::PreviousSuffix;
+                record.placeholder = files.contains(shardName) || files.contains(previousName);
+            }
+        }
+        pages.append(record);
+    }
+
+    if (current)
+        *current = flags & WorkspaceContainer::ExternalPages;
+    return true;
+}
+
+bool DirectoryEngine::readPages(const QString &workspacePath, QList<PageRecord> &pages,
+                                bool *current) const
+{
+    if (current)
+        *current = false;
+
+    if (WorkspaceArchive::isArchived(workspacePath))
+        return readArchivedPages(workspacePath, pages, current);
+
+    QFile container(workspacePath + WorkspaceDirectory::ContainerFileName);
+    if (container.exists()) {
+        QList<WorkspaceContainer::IndexEntry> index;
+        quint16 flags = 0;
+        if (!WorkspaceDirectory::openIndex(workspacePath, container, index, &flags))
+            return false;
+
+        pages.clear();
+        pages.reserve(index.size());
+        for (const WorkspaceContainer::IndexEntry &entry : index) {
+            PageRecord record;
+            if (!readContainerPage(workspacePath, container, entry, flags, record)) {
+                qWarning() << "Invalid workspace container:" << container.fileName();
+                return false;
+            }
+            pages.append(record);
+        }
+
+        if (current)
+            *current = flags & WorkspaceContainer::ExternalPages;
+        return true;
+    }
+
+    // Старый формат: один JSON на всё дерево
+    QFile legacy(workspacePath + WorkspaceDirectory::LegacyFileName);
+    if (!legacy.exists()) {
+        qWarning() << "Workspace file not found:" << container.fileName();
+        return false;
+    }
+    if (!legacy.open(QIODevice::ReadOnly)) {
+        qWarning() << "Failed to open workspace file for reading:" << legacy.errorString();
+        return false;
+    }
+
+    // Потоковый разбор: base64 каждой страницы сразу уходит в хранилище blob
+    if (!WorkspaceContainer::readJson(&legacy, pages, externalizePage)) {
+        qWarning() << "Invalid JSON in workspace file:" << legacy.fileName();
+        return false;
+    }
+    return true;
+}
+
+bool DirectoryEngine::readPage(const QString &workspacePath, int pageIndex,
+                               PageRecord &page) const
+{
+    QFile file(workspacePath + WorkspaceDirectory::ContainerFileName);
+    if (!file.exists()) {
+        // Старый JSON не поддерживает произвольный доступ - читаем целиком
+        QList<PageRecord> pages;
+        if (!readPages(workspacePath, pages) || pageIndex < 0 || pageIndex >= pages.size())
+            return false;
+        page = pages[pageIndex];
+        return true;
+    }
+    QList<WorkspaceContainer::IndexEntry> index;
+    quint16 flags = 0;
+    if (!WorkspaceDirectory::openIndex(workspacePath, file, index, &flags) || pageIndex < 0
+        || pageIndex >= index.size()) {
+        return false;
+    }
+    return readContainerPage(workspacePath, file, index[pageIndex], flags, page);
+}
+
+bool DirectoryEngine::readPage(const QString &workspacePath, const QString &pageId,
+                               QJsonObject &page) const
+{
+    if (WorkspaceArchive::isArchived(workspacePath)) {
+        QHash<QString, QByteArray> files;
+        return WorkspaceArchive::read(workspacePath, files, QStringList() << shardFileName(pageId))
+               && WorkspaceDirectory::readPageShard(files.value(shardFileName(pageId)), page);
+    }
+    return WorkspaceDirectory::readPageShard(workspacePath, pageId, page);
+}
+
+bool DirectoryEngine::readPageChecksum(const QString &workspacePath, const QString &pageId,
+                                       quint32 &checksum) const
+{
+    return WorkspaceDirectory::readPageChecksum(workspacePath, pageId, checksum);
+}
+
+bool DirectoryEngine::writePage(const QString &workspacePath, const QString &pageId,
+                                const QJsonObject &page)
+{
+    return WorkspaceDirectory::writePageShard(workspacePath, pageId, page);
+}
+
+bool DirectoryEngine::writePageSection(const QString &workspacePath, const QString &pageId,
+                                       const QByteArray &section)
+{
+    return WorkspaceDirectory::writePageSection(workspacePath, pageId, section);
+}
+
+bool DirectoryEngine::writeIndex(const QString &workspacePath,
+                                 const QList<WorkspaceContainer::IndexEntry> &index)
+{
+    return WorkspaceDirectory::writeIndex(workspacePath, index);
+}
+
+bool DirectoryEngine::hasBlob(const QString &digest) const
+{
+    return QFileInfo::exists(BlobStore::instance().blobPath(digest));
+}
+
+bool DirectoryEngine::readBlob(const QString &digest, QByteArray &record) const
+{
+    QFile file(BlobStore::instance().blobPath(digest));
+    if (!file.open(QIODevice::ReadOnly))
+        return false;
+    record = file.readAll();
+    return true;
+}
+
+bool DirectoryEngine::writeBlob(const QString &digest, const QByteArray &record)
+{
+    const QString path = BlobStore::instance().blobPath(digest);
+    QDir().mkpath(QFileInfo(path).absolutePath());
+
+    QSaveFile file(path);
+    if (!file.open(QIODevice::WriteOnly) || file.write(record) != record.size()
+        || !file.commit()) {
+        qWarning() << "Failed to write blob" << digest << ":" << file.errorString();
+        return false;
+    }
+    return true;
+}
+
+QStringList DirectoryEngine::blobKeys(const QDateTime &writtenBefore) const
+{
+    QStringList keys;
+    const QString rootPath = BlobStore::instance().rootPath();
+    const QStringList shards = QDir(rootPath).entryList(QDir::Dirs | QDir::NoDotAndDotDot);
+    for (const QString &shard : shards) {
+        // Каталоги blob - первые два символа digest; quarantine/ и прочее не трогаем
+        if (shard.size() != 2)
+            continue;
+        QDirIterator it(rootPath + shard, QDir::Files);
+        while (it.hasNext()) {
+            it.next();
+            if (it.fileInfo().lastModified() < writtenBefore)
+                keys.append(it.fileName());
+        }
+    }
+    return keys;
+}
+
+bool DirectoryEngine::removeBlob(const QString &key)
+{
+    const QString path = BlobStore::instance().blobPath(key);
+    return !QFile::exists(path) || QFile::remove(path);
+}
@@ -0,0 +1,52 @@
+#ifndef DIRECTORY_ENGINE_H
+#define DIRECTORY_ENGINE_H
+
+#include "storage_engine.h"
+
+#include <QFile>
+
+// Каталог на пространство (раскладка описана в WorkspaceDirectory), blob - файлами
+// в BlobStore::rootPath(). Читает и старые форматы: контейнер со встроенными
+// страницами, workspace.json и упакованное холодное пространство (WorkspaceArchive).
+class DirectoryEngine : public StorageEngine
+{
+public:
+    Kind kind() const override;
+
+    QStringList workspaces(const QString &basePath) const override;
+    bool contains(const QString &workspacePath) const override;
+    bool remove(const QString &workspacePath) override;
+
+    bool readIndex(const QString &workspacePath,
+                   QList<WorkspaceContainer::IndexEntry> &index) const override;
+    bool readPages(const QString &workspacePath, QList<PageRecord> &pages,
+                   bool *current = nullptr) const override;
+    bool readPage(const QString &workspacePath, int pageIndex, PageRecord &page) const override;
+    bool readPage(const QString &workspacePath, const QString &pageId,
+                  QJsonObject &page) const override;
+    bool readPageChecksum(const QString &workspacePath, const QString &pageId,
+                          quint32 &checksum) const override;
+
+    bool writePage(const QString &workspacePath, const QString &pageId,
+                   const QJsonObject &page) override;
+    bool writePageSection(const QString &workspacePath, const QString &pageId,
+                          const QByteArray &section) override;
+    bool writeIndex(const QString &workspacePath,
+                    const QList<WorkspaceContainer::IndexEntry> &index) override;
+
+    bool hasBlob(const QString &digest) const override;
+    bool readBlob(const QString &digest, QByteArray &record) const override;
+    bool writeBlob(const QString &digest, const QByteArray &record) override;
+    QStringList blobKeys(const QDateTime &writtenBefore) const override;
+    bool removeBlob(const QString &key) override;
+
+private:
+    bool readContainerPage(const QString &workspacePath, QFile &container,
+                           const WorkspaceContainer::IndexEntry &entry, quint16 flags,
+                           PageRecord &page) const;
+    // Холодное пространство читается из архива в памяти, без распаковки на диск
+    bool readArchivedPages(const QString &workspacePath, QList<PageRecord> &pages,
+                           bool *current) const;
+};
+
+#endif // DIRECTORY_ENGINE_H
@@ -0,0 +1,104 @@
+#include "image_pyramid.h"
+#include "blob_store.h"
+
+#include <QBuffer>
+#include <QImageReader>
+#include <QImageWriter>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QSet>
+#include <QtMath>
+#include <QDebug>
+
+namespace {
+QMutex buildingMutex;
+QSet<QString> building;
+} // namespace
+
+QString ImagePyramid::variant(int level)
+{
+    return "t" + QString::number(level);
+}
+
+QList<int> ImagePyramid::levels(const QSize &imageSize)
+{
+    QList<int> result;
+    const int longest = qMax(imageSize.width(), imageSize.height());
+    for (int level = BaseLevel; level <= TopLevel && level < longest; level *= 2)
+        result.append(level);
+    return result;
+}
+
+int ImagePyramid::levelFor(const QSize &imageSize, const QSize &target)
+{
+    if (imageSize.isEmpty() || target.isEmpty())
+        return 0;
+
+    // Элемент растягивает изображение по обеим сторонам - уровень должен покрыть обе
+    const double scale = qMax(double(target.width()) / imageSize.width(),
+                              double(target.height()) / imageSize.height());
+    const int needed = qCeil(qMax(imageSize.width(), imageSize.height()) * scale);
+    for (int level : levels(imageSize)) {
+        if (level >= needed)
+            return level;
+    }
+    return 0;
+}
+
+QImage ImagePyramid::load(const QString &digest, int level)
+{
+    const QByteArray data = BlobStore::instance().getDerived(digest, variant(level));
+    return data.isEmpty() ? QImage() : QImage::fromData(data);
+}
+
+bool ImagePyramid::build(const QString &digest, const QByteArray &imageData)
+{
+    {
+        QMutexLocker locker(&buildingMutex);
+        if (building.contains(digest))
+            return true;
+        building.insert(digest);
+    }
+
+    QBuffer buffer;
+    buffer.setData(imageData);
+    buffer.open(QIODevice::ReadOnly);
+    QImageReader reader(&buffer);
+    reader.setAutoTransform(true);
+
+    QSize size = reader.size();
+    if (reader.transformation() & QImageIOHandler::TransformationRotate90)
+        size.transpose();
+    const QList<int> sizes = levels(size);
+
+    bool built = true;
+    if (!sizes.isEmpty()) {
+        // Декодер JPEG уменьшает при чтении - полноразмерный снимок в памяти не нужен
+        const QSize raw = reader.size();
+        reader.setScaledSize(raw.scaled(sizes.last(), sizes.last(), Qt::KeepAspectRatio));
+        QImage image = reader.read();
+        if (image.isNull()) {
+            qWarning() << "Failed to decode image for thumbnails:" << reader.errorString();
+            built = false;
+        }
+
+        const QByteArray format = image.hasAlphaChannel() ? "png" : "jpeg";
+        for (int i = sizes.size() - 1; i >= 0 && built; --i) {
+            // Каждый уровень - из предыдущего, вдвое большего
+            if (i < sizes.size() - 1)
+                image = image.scaled(image.size().scaled(sizes[i], sizes[i], Qt::KeepAspectRatio),
+                                     Qt::IgnoreAspectRatio, Qt::SmoothTransformation);
+            QByteArray encoded;
+            QBuffer out(&encoded);
+            out.open(QIODevice::WriteOnly);
+            QImageWriter writer(&out, format);
+            writer.setQuality(Quality);
+            built = writer.write(image)
+                    && BlobStore::instance().putDerived(digest, variant(sizes[i]), encoded);
+        }
+    }
+
+    QMutexLocker locker(&buildingMutex);
+    building.remove(digest);
+    return built;
+}
@@ -0,0 +1,36 @@
+#ifndef IMAGE_PYRAMID_H
+#define IMAGE_PYRAMID_H
+
+#include <QByteArray>
+#include <QImage>
+#include <QList>
+#include <QSize>
+#include <QString>
+
+// Уменьшенные копии изображения для показа: уровни 256, 512, 1024 и 2048 px по большей
+// стороне, только меньше оригинала. Уровень хранится рядом с blob изображения
+// (BlobStore::putDerived, вариант "t<размер>"): JPEG, с прозрачностью - PNG.
+// Элемент показывает наименьший уровень, покрывающий его размер в пикселях
+// устройства, и держит в памяти только его, а не полноразмерный снимок.
+class ImagePyramid
+{
+public:
+    static constexpr int BaseLevel = 256;
+    static constexpr int TopLevel = 2048;
+    static constexpr int Quality = 85;
+
+    // Уровни, которые есть смысл строить для изображения imageSize
+    static QList<int> levels(const QSize &imageSize);
+    // Наименьший уровень, покрывающий target; 0 - нужен оригинал
+    static int levelFor(const QSize &imageSize, const QSize &target);
+
+    static QImage load(const QString &digest, int level);
+    // Строит все уровни одним декодированием оригинала; вызывается из пула потоков.
+    // Одновременные вызовы для одного digest не дублируют работу
+    static bool build(const QString &digest, const QByteArray &imageData);
+
+private:
+    static QString variant(int level);
+};
+
+#endif // IMAGE_PYRAMID_H
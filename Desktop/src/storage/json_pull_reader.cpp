@@ -0,0 +1,370 @@
+#include "json_pull_reader.h"
+
+#include <QJsonArray>
+#include <QJsonObject>
+
+namespace {
+void appendUtf8(QByteArray &out, uint codePoint)
+{
+    if (codePoint < 0x80) {
+        out.append(char(codePoint));
+    } else if (codePoint < 0x800) {
+        out.append(char(0xC0 | (codePoint >> 6)));
+        out.append(char(0x80 | (codePoint & 0x3F)));
+    } else if (codePoint < 0x10000) {
+        out.append(char(0xE0 | (codePoint >> 12)));
+        out.append(char(0x80 | ((codePoint >> 6) & 0x3F)));
+        out.append(char(0x80 | (codePoint & 0x3F)));
+    } else {
+        out.append(char(0xF0 | (codePoint >> 18)));
+        out.append(char(0x80 | ((codePoint >> 12) & 0x3F)));
+        out.append(char(0x80 | ((codePoint >> 6) & 0x3F)));
+        out.append(char(0x80 | (codePoint & 0x3F)));
+    }
+}
+
+int hexValue(int c)
+{
+    if (c >= '0' && c <= '9')
+        return c - '0';
+    if (c >= 'a' && c <= 'f')
+        return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F')
+        return c - 'A' + 10;
+    return -1;
+}
+} // namespace
+
+JsonPullReader::JsonPullReader(QIODevice *device) : _device(device) {}
+
+JsonPullReader::Token JsonPullReader::token() const
+{
+    return _token;
+}
+
+QString JsonPullReader::name() const
+{
+    return _name;
+}
+
+QString JsonPullReader::stringValue() const
+{
+    return _string;
+}
+
+double JsonPullReader::numberValue() const
+{
+    return _number;
+}
+
+bool JsonPullReader::boolValue() const
+{
+    return _bool;
+}
+
+bool JsonPullReader::hasError() const
+{
+    return !_error.isEmpty();
+}
+
+QString JsonPullReader::errorString() const
+{
+    return _error;
+}
+
+bool JsonPullReader::fill()
+{
+    if (!_device)
+        return false;
+    _offset += _pos;
+    _buffer = _device->read(ChunkSize);
+    _pos = 0;
+    return !_buffer.isEmpty();
+}
+
+int JsonPullReader::peek()
+{
+    if (_pos >= _buffer.size() && !fill())
+        return -1;
+    return uchar(_buffer.at(_pos));
+}
+
+int JsonPullReader::get()
+{
+    const int c = peek();
+    if (c >= 0)
+        ++_pos;
+    return c;
+}
+
+void JsonPullReader::skipWhitespace()
+{
+    for (int c = peek(); c == ' ' || c == '\n' || c == '\r' || c == '\t'; c = peek()) ++_pos;
+}
+
+JsonPullReader::Token JsonPullReader::fail(const QString &message)
+{
+    if (_error.isEmpty())
+        _error = QString("%1 at offset %2").arg(message).arg(_offset + _pos);
+    _token = Invalid;
+    return _token;
+}
+
+JsonPullReader::Token JsonPullReader::next()
+{
+    if (hasError())
+        return Invalid;
+
+    skipWhitespace();
+    if (_done) {
+        if (peek() >= 0)
+            return fail("Unexpected data after document");
+        return _token = EndDocument;
+    }
+
+    int c = peek();
+    if (!_stack.isEmpty()) {
+        const char closing = _stack.last() == '{' ? '}' : ']';
+        if (c == closing && !_afterName) {
+            ++_pos;
+            _stack.removeLast();
+            _needComma = true;
+            _done = _stack.isEmpty();
+            return _token = (closing == '}' ? EndObject : EndArray);
+        }
+
+        if (_needComma) {
+            if (c != ',')
+                return fail("Expected ','");
+            ++_pos;
+            skipWhitespace();
+            c = peek();
+            _needComma = false;
+        }
+
+        if (_stack.last() == '{' && !_afterName) {
+            if (c != '"')
+                return fail("Expected member name");
+            ++_pos;
+            if (!readString(_name))
+                return Invalid;
+            skipWhitespace();
+            if (get() != ':')
+                return fail("Expected ':'");
+            _afterName = true;
+            return _token = Name;
+        }
+    }
+
+    _afterName = false;
+    switch (c) {
+    case '{':
+    case '[':
+        ++_pos;
+        _stack.append(char(c));
+        _needComma = false;
+        return _token = (c == '{' ? StartObject : StartArray);
+    case -1:
+        return fail("Unexpected end of data");
+    default:
+        break;
+    }
+
+    const Token scalar = readScalar();
+    if (scalar == Invalid)
+        return Invalid;
+    _needComma = true;
+    _done = _stack.isEmpty();
+    return _token = scalar;
+}
+
+JsonPullReader::Token JsonPullReader::readScalar()
+{
+    const int c = peek();
+    if (c == '"') {
+        ++_pos;
+        return readString(_string) ? String : Invalid;
+    }
+    if (c == 't' || c == 'f') {
+        _bool = c == 't';
+        return readLiteral(_bool ? "true" : "false") ? Bool : Invalid;
+    }
+    if (c == 'n')
+        return readLiteral("null") ? Null : Invalid;
+    if (c == '-' || (c >= '0' && c <= '9'))
+        return readNumber() ? Number : Invalid;
+    return fail("Unexpected character");
+}
+
+bool JsonPullReader::readString(QString &value)
+{
+    QByteArray utf8;
+    for (;;) {
+        // Длинные участки без экранирования копируются из буфера целиком
+        const int start = _pos;
+        while (_pos < _buffer.size()) {
+            const char ch = _buffer.at(_pos);
+            if (ch == '"' || ch == '\\')
+                break;
+            ++_pos;
+        }
+        utf8.append(_buffer.constData() + start, _pos - start);
+
+        // Блок закончился посреди строки - подгружаем следующий и продолжаем
+        if (_pos >= _buffer.size()) {
+            if (peek() < 0) {
+                fail("Unterminated string");
+                return false;
+            }
+            continue;
+        }
+
+        if (get() == '"')
+            break;
+
+        const int escape = get();
+        switch (escape) {
+        case '"': utf8.append('"'); break;
+        case '\\': utf8.append('\\'); break;
+        case '/': utf8.append('/'); break;
+        case 'b': utf8.append('\b'); break;
+        case 'f': utf8.append('\f'); break;
+        case 'n': utf8.append('\n'); break;
+        case 'r': utf8.append('\r'); break;
+        case 't': utf8.append('\t'); break;
+        case 'u': {
+            auto readHex = [this](uint &unit) {
+                unit = 0;
+                for (int i = 0; i < 4; ++i) {
+                    const int digit = hexValue(get());
+                    if (digit < 0)
+                        return false;
+                    unit = (unit << 4) | uint(digit);
+                }
+                return true;
+            };
+            uint unit = 0;
+            if (!readHex(unit)) {
+                fail("Invalid \\u escape");
+                return false;
+            }
+            if (unit >= 0xD800 && unit < 0xDC00 && peek() == '\\') {
+                ++_pos;
+                uint low = 0;
+                if (get() != 'u' || !readHex(low)) {
+                    fail("Invalid surrogate pair");
+                    return false;
+                }
+                unit = (low >= 0xDC00 && low < 0xE000)
+                 ? 0x10000 + ((unit - 0xD800) << 10) + (low - 0xDC00)
+                 : 0xFFFD;
+            } else if (unit >= 0xD800 && unit < 0xE000) {
+                unit = 0xFFFD;
+            }
+            appendUtf8(utf8, unit);
+            break;
+        }
+        default:
+            fail("Invalid escape sequence");
+            return false;
+        }
+    }
+
+    value = QString::fromUtf8(utf8);
+    return true;
+}
+
+bool JsonPullReader::readLiteral(const char *literal)
+{
+    for (const char *p = literal; *p; ++p) {
+        if (get() != uchar(*p)) {
+            fail("Invalid literal");
+            return false;
+        }
+    }
+    return true;
+}
+
+bool JsonPullReader::readNumber()
+{
+    QByteArray text;
+    for (int c = peek(); c >= 0; c = peek()) {
+        if (!((c >= '0' && c <= '9') || c == '-' || c == '+' || c == '.' || c == 'e' || c == 'E'))
+            break;
+        text.append(char(c));
+        ++_pos;
+    }
+
+    bool ok = false;
+    _number = text.toDouble(&ok);
+    if (!ok)
+        fail("Invalid number");
+    return ok;
+}
+
+QJsonValue JsonPullReader::readValue()
+{
+    switch (_token) {
+    case String:
+        return _string;
+    case Number:
+        return _number;
+    case Bool:
+        return _bool;
+    case Null:
+        return QJsonValue(QJsonValue::Null);
+    case StartObject: {
+        QJsonObject object;
+        while (next() == Name) {
+            const QString key = _name;
+            next();
+            const QJsonValue value = readValue();
+            if (hasError())
+                return QJsonValue(QJsonValue::Undefined);
+            object.insert(key, value);
+        }
+        if (_token != EndObject)
+            return QJsonValue(QJsonValue::Undefined);
+        return object;
+    }
+    case StartArray: {
+        QJsonArray array;
+        for (Token item = next(); item != EndArray; item = next()) {
+            if (item == Invalid || item == EndDocument)
+                return QJsonValue(QJsonValue::Undefined);
+            array.append(readValue());
+            if (hasError())
+                return QJsonValue(QJsonValue::Undefined);
+        }
+        return array;
+    }
+    default:
+        fail("Expected a value");
+        return QJsonValue(QJsonValue::Undefined);
+    }
+}
+
+void JsonPullReader::skipValue()
+{
+    if (_token != StartObject && _token != StartArray)
+        return;
+
+    int depth = 1;
+    while (depth > 0) {
+        switch (next()) {
+        case StartObject:
+        case StartArray:
+            ++depth;
+            break;
+        case EndObject:
+        case EndArray:
+            --depth;
+            break;
+        case Invalid:
+        case EndDocument:
+            return;
+        default:
+            break;
+        }
+    }
+}
@@ -0,0 +1,84 @@
+#ifndef JSON_PULL_READER_H
+#define JSON_PULL_READER_H
+
+#include <QByteArray>
+#include <QIODevice>
+#include <QJsonValue>
+#include <QString>
+#include <QVector>
+
+// Потоковый (pull) разбор JSON прямо из QIODevice.
+//
+// Читатель выдаёт по одному токену за вызов next() и читает устройство блоками,
+// поэтому в памяти находится только текущий блок и значение текущего токена.
+// Целое поддерево можно собрать через readValue() - это удобно для небольших
+// объектов (элемент страницы), не строя DOM всего документа.
+class JsonPullReader
+{
+public:
+    enum Token
+    {
+        Invalid,
+        StartObject,
+        EndObject,
+        StartArray,
+        EndArray,
+        Name,
+        String,
+        Number,
+        Bool,
+        Null,
+        EndDocument
+    };
+
+    explicit JsonPullReader(QIODevice *device);
+
+    Token next();
+    Token token() const;
+
+    QString name() const;
+    QString stringValue() const;
+    double numberValue() const;
+    bool boolValue() const;
+
+    // Текущее значение целиком (для StartObject/StartArray - всё поддерево)
+    QJsonValue readValue();
+    void skipValue();
+
+    bool hasError() const;
+    QString errorString() const;
+
+private:
+    bool fill();
+    int peek();
+    int get();
+    void skipWhitespace();
+    Token fail(const QString &message);
+
+    bool readString(QString &value);
+    bool readLiteral(const char *literal);
+    bool readNumber();
+    Token readScalar();
+
+    static constexpr qint64 ChunkSize = 64 * 1024;
+
+    QIODevice *_device { nullptr };
+    QByteArray _buffer;
+    int _pos { 0 };
+    qint64 _offset { 0 };
+
+    // Открытые контейнеры: '{' или '['
+    QVector<char> _stack;
+    bool _needComma { false };
+    bool _afterName { false };
+    bool _done { false };
+
+    Token _token { Invalid };
+    QString _name;
+    QString _string;
+    double _number { 0 };
+    bool _bool { false };
+    QString _error;
+};
+
+#endif // JSON_PULL_READER_H
@@ -0,0 +1,73 @@
+#include "page_locks.h"
+
+#include <QMutexLocker>
+
+PageLocks &PageLocks::instance()
+{
+    static PageLocks instance;
+    return instance;
+}
+
+bool PageLocks::isFree(const QString &workspacePath, const QStringList &pageIds) const
+{
+    const auto whole = _whole.constFind(workspacePath);
+    if (whole != _whole.cend())
+        return whole->owner == QThread::currentThreadId();
+
+    const auto held = _held.constFind(workspacePath);
+    if (held == _held.cend() || held->isEmpty())
+        return true;
+    if (pageIds.isEmpty())
+        return false;
+    for (const QString &pageId : pageIds) {
+        if (held->contains(pageId))
+            return false;
+    }
+    return true;
+}
+
+void PageLocks::lock(const QString &workspacePath, const QStringList &pageIds)
+{
+    // Все страницы захватываются разом, поэтому взаимных блокировок не бывает
+    QMutexLocker locker(&_mutex);
+    while (!isFree(workspacePath, pageIds)) _released.wait(&_mutex);
+
+    if (pageIds.isEmpty()) {
+        WholeLock &whole = _whole[workspacePath];
+        whole.owner = QThread::currentThreadId();
+        ++whole.depth;
+        return;
+    }
+    if (_whole.contains(workspacePath))
+        return; // страницы уже заблокированы вместе со всем пространством
+    QSet<QString> &held = _held[workspacePath];
+    for (const QString &pageId : pageIds) held.insert(pageId);
+}
+
+void PageLocks::unlock(const QString &workspacePath, const QStringList &pageIds)
+{
+    QMutexLocker locker(&_mutex);
+    const auto whole = _whole.find(workspacePath);
+    if (pageIds.isEmpty()) {
+        if (whole != _whole.end() && --whole->depth == 0)
+            _whole.erase(whole);
+    } else if (whole == _whole.end()) {
+        QSet<QString> &held = _held[workspacePath];
+        for (const QString &pageId : pageIds) held.remove(pageId);
+        if (held.isEmpty())
+            _held.remove(workspacePath);
+    }
+    _released.wakeAll();
+}
+
+PageLocker::PageLocker(const QString &workspacePath, const QStringList &pageIds) :
+    _workspacePath(workspacePath),
+    _pageIds(pageIds)
+{
+    PageLocks::instance().lock(_workspacePath, _pageIds);
+}
+
+PageLocker::~PageLocker()
+{
+    PageLocks::instance().unlock(_workspacePath, _pageIds);
+}
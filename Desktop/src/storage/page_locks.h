@@ -0,0 +1,62 @@
+#ifndef PAGE_LOCKS_H
+#define PAGE_LOCKS_H
+
+#include <QHash>
+#include <QMutex>
+#include <QSet>
+#include <QString>
+#include <QStringList>
+#include <QThread>
+#include <QWaitCondition>
+
+// Блокировки страниц хранилища между потоками одного процесса: фоновая запись
+// снимков, синхронизация с сервером и сохранение из интерфейса не пишут одну
+// страницу одновременно. Иерархия (workspace.mnw) блокируется как страница IndexKey.
+// Пустой список страниц блокирует пространство целиком (чтение-изменение-запись);
+// такая блокировка повторно входима, а страницы под ней поток уже держит.
+//
+// Между процессами хранилище защищает блокировка SingleInstance.
+class PageLocks
+{
+public:
+    static constexpr char IndexKey[] = "#index";
+
+    static PageLocks &instance();
+
+    void lock(const QString &workspacePath, const QStringList &pageIds);
+    void unlock(const QString &workspacePath, const QStringList &pageIds);
+
+private:
+    PageLocks() = default;
+    PageLocks(const PageLocks &) = delete;
+    PageLocks &operator=(const PageLocks &) = delete;
+
+    bool isFree(const QString &workspacePath, const QStringList &pageIds) const;
+
+    QMutex _mutex;
+    QWaitCondition _released;
+    QHash<QString, QSet<QString>> _held; // пространство -> заблокированные страницы
+    struct WholeLock
+    {
+        Qt::HANDLE owner { nullptr };
+        int depth { 0 };
+    };
+    QHash<QString, WholeLock> _whole; // пространства, заблокированные целиком
+};
+
+// Аналог QMutexLocker для PageLocks
+class PageLocker
+{
+public:
+    PageLocker(const QString &workspacePath, const QStringList &pageIds = QStringList());
+    ~PageLocker();
+
+    PageLocker(const PageLocker &) = delete;
+    PageLocker &operator=(const PageLocker &) = delete;
+
+private:
+    QString _workspacePath;
+    QStringList _pageIds;
+};
+
+#endif // PAGE_LOCKS_H
@@ -0,0 +1,110 @@
+#include "persistence_worker.h"
+#include "workspace_directory.h"
+#include "page_locks.h"
+#include "storage_engine.h"
+#include "workspace_history.h"
+#include "storage_watcher.h"
+
+#include <QDir>
+#include <QMutexLocker>
+#include <QDebug>
+
+PersistenceWorker::PersistenceWorker(QObject *parent) : QObject(parent), _context(new QObject)
+{
+    qRegisterMetaType<WorkspaceSnapshot>();
+
+    _thread.setObjectName("PersistenceWorker");
+    _context->moveToThread(&_thread);
+    _thread.start(QThread::LowPriority);
+}
+
+PersistenceWorker::~PersistenceWorker()
+{
+    waitForIdle();
+    _thread.quit();
+    _thread.wait();
+    delete _context;
+}
+
+void PersistenceWorker::enqueue(const WorkspaceSnapshot &snapshot)
+{
+    {
+        QMutexLocker locker(&_mutex);
+        auto it = _pending.find(snapshot.workspacePath);
+        if (it == _pending.end()) {
+            _pending.insert(snapshot.workspacePath, snapshot);
+            _order.append(snapshot.workspacePath);
+        } else {
+            // Ожидающий снимок ещё не начат: новый заменяет его, забирая страницы,
+            // которые изменились только в старом
+            WorkspaceSnapshot merged = snapshot;
+            for (auto page = it->pages.cbegin(); page != it->pages.cend(); ++page) {
+                if (!merged.pages.contains(page.key()))
+                    merged.pages.insert(page.key(), page.value());
+            }
+            merged.structureChanged |= it->structureChanged;
+            *it = merged;
+        }
+    }
+
+    QMetaObject::invokeMethod(_context, [this]() { processQueue(); }, Qt::QueuedConnection);
+}
+
+void PersistenceWorker::waitForIdle()
+{
+    QMutexLocker locker(&_mutex);
+    while (_busy || !_order.isEmpty()) _idle.wait(&_mutex);
+}
+
+void PersistenceWorker::processQueue()
+{
+    for (;;) {
+        WorkspaceSnapshot snapshot;
+        {
+            QMutexLocker locker(&_mutex);
+            if (_order.isEmpty()) {
+                _busy = false;
+                _idle.wakeAll();
+                return;
+            }
+            snapshot = _pending.take(_order.takeFirst());
+            _busy = true;
+        }
+
+        QString error;
+        if (writeSnapshot(snapshot, error))
+            emit snapshotSaved(snapshot);
+        else
+            emit snapshotFailed(snapshot, error);
+    }
+}
+
+bool PersistenceWorker::writeSnapshot(const WorkspaceSnapshot &snapshot, QString &error)
+{
+    QStringList lockedPages = snapshot.pages.keys();
+    lockedPages << PageLocks::IndexKey;
+    PageLocker locker(snapshot.workspacePath, lockedPages);
+
+    for (auto it = snapshot.pages.cbegin(); it != snapshot.pages.cend(); ++it) {
+        if (!StorageEngine::instance().writePage(snapshot.workspacePath, it.key(), it.value())) {
+            error = QString("Failed to write page %1").arg(it.key());
+            return false;
+        }
+    }
+    if (!StorageEngine::instance().writeIndex(snapshot.workspacePath, snapshot.index)) {
+        error = QString("Failed to write index of %1").arg(snapshot.workspaceTitle);
+        return false;
+    }
+    // Модель в памяти уже такая, как на диске - перечитывать нечего. О внешних
+    // данных наблюдатель сообщает: открытое пространство должно их подхватить.
+    if (!snapshot.external)
+        StorageWatcher::recordOwnWrites(snapshot.workspacePath, snapshot.pages.keys());
+
+    // История вторична: сбой записи версии не отменяет сохранение.
+    // Её файл лежит в каталоге пространства при любом движке.
+    QDir().mkpath(snapshot.workspacePath);
+    WorkspaceHistory history(snapshot.workspacePath + WorkspaceDirectory::HistoryFileName);
+    if (!history.record(snapshot.workspacePath, snapshot.index, snapshot.pages))
+        qWarning() << "Failed to record history of" << snapshot.workspaceTitle;
+    return true;
+}
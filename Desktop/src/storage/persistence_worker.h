@@ -0,0 +1,71 @@
+#ifndef PERSISTENCE_WORKER_H
+#define PERSISTENCE_WORKER_H
+
+#include "workspace_catalog.h"
+#include "workspace_container.h"
+
+#include <QHash>
+#include <QJsonObject>
+#include <QList>
+#include <QMetaType>
+#include <QMutex>
+#include <QObject>
+#include <QString>
+#include <QThread>
+#include <QWaitCondition>
+
+// Неизменяемый снимок пространства для записи. Страницы уже сериализованы
+// в QJsonObject (copy-on-write), поэтому снимок дёшев и не ссылается на виджеты.
+struct WorkspaceSnapshot
+{
+    QString basePath;
+    QString workspacePath;
+    QString workspaceTitle;
+    QString workspaceId; // id корня - имя каталога пространства
+    quint64 generation { 0 };
+    qint64 journalSize { 0 }; // размер журнала на момент снимка
+    QList<WorkspaceContainer::IndexEntry> index;
+    QHash<QString, QJsonObject> pages; // только изменённые страницы, по id
+    QList<CatalogEntry> catalog;
+    bool external { false }; // данные не из открытой модели (синхронизация с сервером)
+    bool structureChanged { false }; // иерархия изменилась, даже если страниц нет
+
+    bool isEmpty() const { return pages.isEmpty() && !structureChanged; }
+};
+Q_DECLARE_METATYPE(WorkspaceSnapshot)
+
+// Запись снимков в отдельном потоке.
+//
+// Очередь хранит не больше одного снимка на пространство: более новый снимок
+// поглощает ожидающий (страницы объединяются, иерархия берётся из нового).
+// Результат приходит сигналами в поток владельца.
+class PersistenceWorker : public QObject
+{
+    Q_OBJECT
+public:
+    explicit PersistenceWorker(QObject *parent = nullptr);
+    ~PersistenceWorker();
+
+    void enqueue(const WorkspaceSnapshot &snapshot);
+    void waitForIdle();
+
+    static bool writeSnapshot(const WorkspaceSnapshot &snapshot, QString &error);
+
+signals:
+    void snapshotSaved(const WorkspaceSnapshot &snapshot);
+    void snapshotFailed(const WorkspaceSnapshot &snapshot, const QString &error);
+
+private:
+    void processQueue();
+
+    QThread _thread;
+    QObject *_context { nullptr };
+
+    QMutex _mutex;
+    QWaitCondition _idle;
+    QList<QString> _order;
+    QHash<QString, WorkspaceSnapshot> _pending;
+    bool _busy { false };
+};
+
+#endif // PERSISTENCE_WORKER_H
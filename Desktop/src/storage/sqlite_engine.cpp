@@ -0,0 +1,587 @@
+#include "sqlite_engine.h"
+
+#if defined(DESKTOP_STORAGE_SQLITE)
+
+#include "storage_cipher.h"
+#include "workspace_directory.h"
+
+#include <QAtomicInt>
+#include <QCborMap>
+#include <QCborValue>
+#include <QDir>
+#include <QFileInfo>
+#include <QHash>
+#include <QSet>
+#include <QJsonArray>
+#include <QSqlDatabase>
+#include <QSqlError>
+#include <QSqlQuery>
+#include <QThreadStorage>
+#include <QVariant>
+#include <QDebug>
+
+namespace {
+const char *const Schema[] = {
+ "CREATE TABLE IF NOT EXISTS workspaces ("
+ " path TEXT PRIMARY KEY, base TEXT NOT NULL, id TEXT NOT NULL)",
+ "CREATE INDEX IF NOT EXISTS workspaces_base ON workspaces (base)",
+ "CREATE TABLE IF NOT EXISTS pages ("
+ " workspace TEXT NOT NULL, id TEXT NOT NULL, position INTEGER NOT NULL DEFAULT -1,"
+ " parent INTEGER NOT NULL DEFAULT -1, title TEXT, meta BLOB, checksum INTEGER,"
+ " PRIMARY KEY (workspace, id))",
+ "CREATE INDEX IF NOT EXISTS pages_position ON pages (workspace, position)",
+ "CREATE TABLE IF NOT EXISTS elements ("
+ " workspace TEXT NOT NULL, page TEXT NOT NULL, position INTEGER NOT NULL, type TEXT, data BLOB,"
+ " PRIMARY KEY (workspace, page, position))",
+ "CREATE TABLE IF NOT EXISTS blobs (digest TEXT PRIMARY KEY, record BLOB NOT NULL)"
+};
+
+// Соединение потока закрывается вместе с потоком
+struct Connection
+{
+    QString name;
+    ~Connection() { QSqlDatabase::removeDatabase(name); }
+};
+QThreadStorage<Connection *> connections;
+QAtomicInt connectionCount;
+
+QSqlDatabase database(const QString &databasePath)
+{
+    if (!connections.hasLocalData()) {
+        Connection *connection = new Connection;
+        connection->name = QString("storage-%1").arg(connectionCount.fetchAndAddRelaxed(1));
+        connections.setLocalData(connection);
+
+        QSqlDatabase db = QSqlDatabase::addDatabase("QSQLITE", connection->name);
+        db.setDatabaseName(databasePath);
+        db.setConnectOptions("QSQLITE_BUSY_TIMEOUT=5000");
+        if (!db.open()) {
+            qWarning() << "Failed to open storage database:" << db.lastError().text();
+            return db;
+        }
+
+        // WAL - режим файла базы, но выставлять его безопасно из каждого соединения
+        QSqlQuery query(db);
+        query.exec("PRAGMA journal_mode=WAL");
+        query.exec("PRAGMA synchronous=NORMAL");
+        for (const char *statement : Schema) {
+            if (!query.exec(statement))
+                qWarning() << "Failed to create storage schema:" << query.lastError().text();
+        }
+        return db;
+    }
+    return QSqlDatabase::database(connections.localData()->name);
+}
+
+bool exec(QSqlQuery &query)
+{
+    if (query.exec())
+        return true;
+    qWarning() << "Storage database query failed:" << query.lastError().text();
+    return false;
+}
+
+// BEGIN IMMEDIATE: запись берёт блокировку сразу и ждёт её по busy timeout,
+// а не падает с SQLITE_BUSY посреди транзакции
+class Transaction
+{
+public:
+    explicit Transaction(const QSqlDatabase &db) : _query(db)
+    {
+        _active = db.isOpen() && _query.exec("BEGIN IMMEDIATE");
+    }
+    ~Transaction()
+    {
+        if (_active)
+            _query.exec("ROLLBACK");
+    }
+
+    bool isActive() const { return _active; }
+    bool commit()
+    {
+        if (!_active || !_query.exec("COMMIT"))
+            return false;
+        _active = false;
+        return true;
+    }
+
+private:
+    QSqlQuery _query;
+    bool _active { false };
+};
+
+bool sealObject(const QJsonObject &object, QByteArray &sealed)
+{
+    return StorageCipher::instance().seal(QCborMap::fromJsonObject(object).toCborValue().toCbor(),
+                                          sealed);
+}
+
+bool openObject(const QByteArray &sealed, QJsonObject &object)
+{
+    QByteArray data;
+    if (!StorageCipher::instance().open(sealed, data))
+        return false;
+    QCborParserError error;
+    const QCborValue value = QCborValue::fromCbor(data, &error);
+    if (error.error != QCborError::NoError || !value.isMap())
+        return false;
+    object = value.toMap().toJsonObject();
+    return true;
+}
+
+// Элементы - как секции контейнера, с сжатой разметкой текста
+bool openElement(const QByteArray &sealed, QJsonObject &element)
+{
+    QByteArray data;
+    return StorageCipher::instance().open(sealed, data)
+           && WorkspaceContainer::decodeElement(data, element);
+}
+
+// Строка уже хранит encoded в нужном виде. Сравниваются открытые данные: с шифрованием
+// запечатанные байты каждый раз разные (случайный nonce)
+bool storedAs(const QByteArray &sealed, const QByteArray &encoded)
+{
+    const StorageCipher &cipher = StorageCipher::instance();
+    QByteArray data;
+    return StorageCipher::isSealed(sealed) == cipher.isEnabled() && cipher.open(sealed, data)
+           && data == encoded;
+}
+
+// Строка pages (id, parent, title, meta) и её элементы -> страница.
+// complete = false - часть элементов не прочитана
+void pageOf(const QSqlQuery &row, const QJsonArray &elements, bool complete,
+            PageRecord &record)
+{
+    record.parent = row.value(1).toInt();
+    const QByteArray meta = row.value(3).toByteArray();
+    if (meta.isEmpty() || !openObject(meta, record.page) || !complete) {
+        // Ещё не записанная страница остаётся в иерархии пустой; непрочитанная -
+        // заглушкой, которую нельзя записывать поверх строк
+        record.placeholder = !meta.isEmpty();
+        if (record.placeholder)
+            qWarning() << "Failed to read page" << row.value(0).toString();
+        record.page = QJsonObject();
+        record.page["id"] = row.value(0).toString();
+        record.page["title"] = row.value(2).toString();
+        return;
+    }
+    record.page["elements"] = elements;
+}
+
+bool appendElement(const QSqlQuery &row, int dataColumn, QJsonArray &elements)
+{
+    QJsonObject element;
+    if (!openElement(row.value(dataColumn).toByteArray(), element)) {
+        qWarning() << "Failed to read page element" << row.value(dataColumn - 1).toInt();
+        return false;
+    }
+    elements.append(element);
+    return true;
+}
+
+// false - запрос не удался или элемент не прочитан
+bool readElements(const QSqlDatabase &db, const QString &key, const QString &pageId,
+                  QJsonArray &elements)
+{
+    QSqlQuery query(db);
+    query.prepare("SELECT position, data FROM elements WHERE workspace = ? AND page = ?"
+                  " ORDER BY position");
+    query.addBindValue(key);
+    query.addBindValue(pageId);
+    if (!exec(query))
+        return false;
+    bool complete = true;
+    while (query.next()) complete &= appendElement(query, 1, elements);
+    return complete;
+}
+} // namespace
+
+SqliteEngine::SqliteEngine(const QString &databasePath) :
+    _databasePath(databasePath),
+    _rootPath(QFileInfo(databasePath).absolutePath())
+{
+    QDir().mkpath(_rootPath);
+}
+
+StorageEngine::Kind SqliteEngine::kind() const
+{
+    return Sqlite;
+}
+
+QString SqliteEngine::keyOf(const QString &path) const
+{
+    return QDir(_rootPath).relativeFilePath(QDir::cleanPath(path));
+}
+
+QStringList SqliteEngine::workspaces(const QString &basePath) const
+{
+    QSqlQuery query(database(_databasePath));
+    query.prepare("SELECT id FROM workspaces WHERE base = ?");
+    query.addBindValue(keyOf(basePath));
+
+    QStringList names;
+    if (exec(query)) {
+        while (query.next()) names.append(query.value(0).toString());
+    }
+    return names;
+}
+
+bool SqliteEngine::contains(const QString &workspacePath) const
+{
+    QSqlQuery query(database(_databasePath));
+    query.prepare("SELECT 1 FROM workspaces WHERE path = ?");
+    query.addBindValue(keyOf(workspacePath));
+    return exec(query) && query.next();
+}
+
+bool SqliteEngine::remove(const QString &workspacePath)
+{
+    const QSqlDatabase db = database(_databasePath);
+    const QString key = keyOf(workspacePath);
+    Transaction transaction(db);
+    if (!transaction.isActive())
+        return false;
+
+    QSqlQuery query(db);
+    for (const char *statement : { "DELETE FROM elements WHERE workspace = ?",
+                                   "DELETE FROM pages WHERE workspace = ?",
+                                   "DELETE FROM workspaces WHERE path = ?" }) {
+        query.prepare(statement);
+        query.addBindValue(key);
+        if (!exec(query))
+            return false;
+    }
+    return transaction.commit();
+}
+
+bool SqliteEngine::readIndex(const QString &workspacePath,
+                             QList<WorkspaceContainer::IndexEntry> &index) const
+{
+    QSqlQuery query(database(_databasePath));
+    query.prepare("SELECT id, parent, title FROM pages WHERE workspace = ? AND position >= 0"
+                  " ORDER BY position");
+    query.addBindValue(keyOf(workspacePath));
+    if (!exec(query))
+        return false;
+
+    index.clear();
+    while (query.next()) {
+        WorkspaceContainer::IndexEntry entry;
+        entry.id = query.value(0).toString();
+        entry.parent = query.value(1).toInt();
+        entry.title = query.value(2).toString();
+        index.append(entry);
+    }
+    return !index.isEmpty() || contains(workspacePath);
+}
+
+bool SqliteEngine::readPages(const QString &workspacePath, QList<PageRecord> &pages,
+                             bool *current) const
+{
+    if (current)
+        *current = true;
+
+    // Два запроса на всё дерево: элементы группируются по странице заранее
+    const QSqlDatabase db = database(_databasePath);
+    const QString key = keyOf(workspacePath);
+    QSqlQuery query(db);
+    query.prepare("SELECT page, position, data FROM elements WHERE workspace = ?"
+                  " ORDER BY page, position");
+    query.addBindValue(key);
+    if (!exec(query))
+        return false;
+    QHash<QString, QJsonArray> elements;
+    QSet<QString> incomplete;
+    while (query.next()) {
+        const QString pageId = query.value(0).toString();
+        if (!appendElement(query, 2, elements[pageId]))
+            incomplete.insert(pageId);
+    }
+
+    query.prepare("SELECT id, parent, title, meta FROM pages WHERE workspace = ? AND position >= 0"
+                  " ORDER BY position");
+    query.addBindValue(key);
+    if (!exec(query))
+        return false;
+
+    pages.clear();
+    while (query.next()) {
+        PageRecord record;
+        const QString pageId = query.value(0).toString();
+        pageOf(query, elements.value(pageId), !incomplete.contains(pageId), record);
+        pages.append(record);
+    }
+    if (pages.isEmpty()) {
+        qWarning() << "Workspace not found in storage database:" << key;
+        return false;
+    }
+    return true;
+}
+
+bool SqliteEngine::readPage(const QString &workspacePath, int pageIndex, PageRecord &page) const
+{
+    const QSqlDatabase db = database(_databasePath);
+    const QString key = keyOf(workspacePath);
+    QSqlQuery query(db);
+    query.prepare("SELECT id, parent, title, meta FROM pages WHERE workspace = ? AND position = ?");
+    query.addBindValue(key);
+    query.addBindValue(pageIndex);
+    if (pageIndex < 0 || !exec(query) || !query.next())
+        return false;
+
+    QJsonArray elements;
+    const bool complete = readElements(db, key, query.value(0).toString(), elements);
+    pageOf(query, elements, complete, page);
+    return true;
+}
+
+bool SqliteEngine::readPage(const QString &workspacePath, const QString &pageId,
+                            QJsonObject &page) const
+{
+    const QSqlDatabase db = database(_databasePath);
+    const QString key = keyOf(workspacePath);
+    QSqlQuery query(db);
+    query.prepare("SELECT meta FROM pages WHERE workspace = ? AND id = ?");
+    query.addBindValue(key);
+    query.addBindValue(pageId);
+    if (!exec(query) || !query.next() || !openObject(query.value(0).toByteArray(), page))
+        return false;
+
+    QJsonArray elements;
+    if (!readElements(db, key, pageId, elements))
+        return false;
+    page["elements"] = elements;
+    return true;
+}
+
+bool SqliteEngine::readPageChecksum(const QString &workspacePath, const QString &pageId,
+                                    quint32 &checksum) const
+{
+    QSqlQuery query(database(_databasePath));
+    query.prepare("SELECT checksum FROM pages WHERE workspace = ? AND id = ?");
+    query.addBindValue(keyOf(workspacePath));
+    query.addBindValue(pageId);
+    if (!exec(query) || !query.next() || query.value(0).isNull())
+        return false;
+    checksum = quint32(query.value(0).toLongLong());
+    return true;
+}
+
+bool SqliteEngine::writePage(const QString &workspacePath, const QString &pageId,
+                             const QJsonObject &page)
+{
+    QJsonObject meta = page;
+    meta.remove("elements");
+    meta.remove("pages");
+    QByteArray sealedMeta;
+    if (!sealObject(meta, sealedMeta))
+        return false;
+
+    const QSqlDatabase db = database(_databasePath);
+    const QString key = keyOf(workspacePath);
+    Transaction transaction(db);
+    if (!transaction.isActive())
+        return false;
+
+    // Новая страница получает место в иерархии со следующей записью индекса
+    QSqlQuery query(db);
+    query.prepare("INSERT INTO pages (workspace, id, title, meta, checksum) VALUES (?, ?, ?, ?, ?)"
+                  " ON CONFLICT (workspace, id) DO UPDATE SET"
+                  " title = excluded.title, meta = excluded.meta, checksum = excluded.checksum");
+    query.addBindValue(key);
+    query.addBindValue(pageId);
+    query.addBindValue(page["title"].toString());
+    query.addBindValue(sealedMeta);
+    query.addBindValue(qint64(WorkspaceDirectory::pageChecksum(page)));
+    if (!exec(query))
+        return false;
+
+    // Переписываются только позиции, данные которых изменились
+    QHash<int, QByteArray> stored;
+    query.prepare("SELECT position, data FROM elements WHERE workspace = ? AND page = ?");
+    query.addBindValue(key);
+    query.addBindValue(pageId);
+    if (!exec(query))
+        return false;
+    while (query.next()) stored.insert(query.value(0).toInt(), query.value(1).toByteArray());
+
+    const QJsonArray elements = page["elements"].toArray();
+    QSqlQuery insert(db);
+    insert.prepare("INSERT INTO elements (type, data, workspace, page, position)"
+                   " VALUES (?, ?, ?, ?, ?)");
+    QSqlQuery update(db);
+    update.prepare("UPDATE elements SET type = ?, data = ?"
+                   " WHERE workspace = ? AND page = ? AND position = ?");
+    for (int i = 0; i < elements.size(); ++i) {
+        const QJsonObject element = elements[i].toObject();
+        const QByteArray encoded = WorkspaceContainer::encodeElement(element);
+        const auto it = stored.constFind(i);
+        if (it != stored.cend() && storedAs(*it, encoded))
+            continue;
+
+        QByteArray data;
+        if (!StorageCipher::instance().seal(encoded, data))
+            return false;
+        QSqlQuery &write = it == stored.cend() ? insert : update;
+        write.addBindValue(element["type"].toString());
+        write.addBindValue(data);
+        write.addBindValue(key);
+        write.addBindValue(pageId);
+        write.addBindValue(i);
+        if (!exec(write))
+            return false;
+    }
+
+    if (stored.size() > elements.size()) {
+        query.prepare("DELETE FROM elements WHERE workspace = ? AND page = ? AND position >= ?");
+        query.addBindValue(key);
+        query.addBindValue(pageId);
+        query.addBindValue(elements.size());
+        if (!exec(query))
+            return false;
+    }
+    return transaction.commit();
+}
+
+bool SqliteEngine::writeIndex(const QString &workspacePath,
+                              const QList<WorkspaceContainer::IndexEntry> &index)
+{
+    const QSqlDatabase db = database(_databasePath);
+    const QString key = keyOf(workspacePath);
+    Transaction transaction(db);
+    if (!transaction.isActive())
+        return false;
+
+    QSqlQuery query(db);
+    query.prepare("INSERT OR IGNORE INTO workspaces (path, base, id) VALUES (?, ?, ?)");
+    query.addBindValue(key);
+    query.addBindValue(key.section('/', 0, -2));
+    query.addBindValue(key.section('/', -1));
+    if (!exec(query))
+        return false;
+
+    query.prepare("UPDATE pages SET position = -1 WHERE workspace = ?");
+    query.addBindValue(key);
+    if (!exec(query))
+        return false;
+
+    // Страница без записанного содержимого остаётся в иерархии пустой, как без шарда
+    query.prepare("INSERT INTO pages (workspace, id, position, parent, title)"
+                  " VALUES (?, ?, ?, ?, ?)"
+                  " ON CONFLICT (workspace, id) DO UPDATE SET"
+                  " position = excluded.position, parent = excluded.parent,"
+                  " title = excluded.title");
+    for (int i = 0; i < index.size(); ++i) {
+        query.addBindValue(key);
+        query.addBindValue(index[i].id);
+        query.addBindValue(i);
+        query.addBindValue(index[i].parent);
+        query.addBindValue(index[i].title);
+        if (!exec(query))
+            return false;
+    }
+
+    // Страницы, выпавшие из иерархии, удаляются вместе с элементами
+    query.prepare("DELETE FROM elements WHERE workspace = ? AND page IN"
+                  " (SELECT id FROM pages WHERE workspace = ? AND position < 0)");
+    query.addBindValue(key);
+    query.addBindValue(key);
+    if (!exec(query))
+        return false;
+
+    query.prepare("DELETE FROM pages WHERE workspace = ? AND position < 0");
+    query.addBindValue(key);
+    return exec(query) && transaction.commit();
+}
+
+bool SqliteEngine::hasBlob(const QString &digest) const
+{
+    QSqlQuery query(database(_databasePath));
+    query.prepare("SELECT 1 FROM blobs WHERE digest = ?");
+    query.addBindValue(digest);
+    if (exec(query) && query.next())
+        return true;
+    return engine(Directory).hasBlob(digest);
+}
+
+bool SqliteEngine::readBlob(const QString &digest, QByteArray &record) const
+{
+    QSqlQuery query(database(_databasePath));
+    query.prepare("SELECT record FROM blobs WHERE digest = ?");
+    query.addBindValue(digest);
+    if (exec(query) && query.next()) {
+        record = query.value(0).toByteArray();
+        return true;
+    }
+    return engine(Directory).readBlob(digest, record);
+}
+
+bool SqliteEngine::writeBlob(const QString &digest, const QByteArray &record)
+{
+    QSqlQuery query(database(_databasePath));
+    query.prepare("INSERT OR IGNORE INTO blobs (digest, record) VALUES (?, ?)");
+    query.addBindValue(digest);
+    query.addBindValue(record);
+    return exec(query);
+}
+
+QStringList SqliteEngine::blobKeys(const QDateTime &writtenBefore) const
+{
+    // Время записи строк не хранится: отбираются все, плюс файлы до перехода на SQLite
+    QStringList keys = engine(Directory).blobKeys(writtenBefore);
+    QSqlQuery query(database(_databasePath));
+    query.prepare("SELECT digest FROM blobs");
+    if (exec(query)) {
+        while (query.next()) keys.append(query.value(0).toString());
+    }
+    return keys;
+}
+
+bool SqliteEngine::removeBlob(const QString &key)
+{
+    QSqlQuery query(database(_databasePath));
+    query.prepare("DELETE FROM blobs WHERE digest = ?");
+    query.addBindValue(key);
+    return exec(query) && engine(Directory).removeBlob(key);
+}
+
+bool SqliteEngine::verify(QStringList &damaged) const
+{
+    damaged.clear();
+    const QSqlDatabase db = database(_databasePath);
+    QSqlQuery query(db);
+    if (!query.exec("PRAGMA quick_check")) {
+        qWarning() << "Storage database check failed:" << query.lastError().text();
+        damaged << _databasePath;
+        return false;
+    }
+    while (query.next()) {
+        const QString result = query.value(0).toString();
+        if (result != "ok")
+            damaged << QString("%1: %2").arg(_databasePath, result);
+    }
+
+    // Страницы, которые не расшифровать или не разобрать, readPages отдаёт заглушками
+    query.prepare("SELECT path FROM workspaces");
+    if (!exec(query)) {
+        damaged << _databasePath;
+        return false;
+    }
+    QStringList workspaces;
+    while (query.next()) workspaces << query.value(0).toString();
+    for (const QString &key : std::as_const(workspaces)) {
+        QList<PageRecord> pages;
+        if (!readPages(_rootPath + "/" + key + "/", pages)) {
+            damaged << key;
+            continue;
+        }
+        for (const PageRecord &page : std::as_const(pages)) {
+            if (page.placeholder)
+                damaged << key + "/" + page.page["id"].toString();
+        }
+    }
+
+    return true;
+}
+
+#endif // DESKTOP_STORAGE_SQLITE
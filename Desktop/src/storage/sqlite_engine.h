@@ -0,0 +1,66 @@
+#ifndef SQLITE_ENGINE_H
+#define SQLITE_ENGINE_H
+
+#include "storage_engine.h"
+
+// Всё хранилище - одна база SQLite в режиме WAL (Workspaces/storage.db):
+//   workspaces (path, base, id)                        - path = "<base><id>" от корня хранилища
+//   pages      (workspace, id, position, parent, title, meta, checksum)
+//   elements   (workspace, page, position, type, data)
+//   blobs      (digest, record)
+//
+// meta - CBOR страницы без элементов, data - элемент как в секции контейнера
+// (WorkspaceContainer::encodeElement); оба через StorageCipher, как шарды.
+// Страница с position < 0 записана, но ещё не вошла в иерархию.
+// Правка одного элемента - одна строка elements вместо перезаписи страницы.
+//
+// У каждого потока своё соединение: в WAL читатели (поток синхронизации) не ждут
+// записи из фоновой записи снимков и интерфейса, а запись не ждёт читателей.
+// Собирается только с Qt SQL (DESKTOP_STORAGE_SQLITE), иначе движок недоступен.
+class SqliteEngine : public StorageEngine
+{
+public:
+    static constexpr char FileName[] = "storage.db";
+
+    explicit SqliteEngine(const QString &databasePath);
+
+    Kind kind() const override;
+
+    QStringList workspaces(const QString &basePath) const override;
+    bool contains(const QString &workspacePath) const override;
+    bool remove(const QString &workspacePath) override;
+
+    bool readIndex(const QString &workspacePath,
+                   QList<WorkspaceContainer::IndexEntry> &index) const override;
+    bool readPages(const QString &workspacePath, QList<PageRecord> &pages,
+                   bool *current = nullptr) const override;
+    bool readPage(const QString &workspacePath, int pageIndex, PageRecord &page) const override;
+    bool readPage(const QString &workspacePath, const QString &pageId,
+                  QJsonObject &page) const override;
+    bool readPageChecksum(const QString &workspacePath, const QString &pageId,
+                          quint32 &checksum) const override;
+
+    bool writePage(const QString &workspacePath, const QString &pageId,
+                   const QJsonObject &page) override;
+    bool writeIndex(const QString &workspacePath,
+                    const QList<WorkspaceContainer::IndexEntry> &index) override;
+
+    // Blob, записанные до перехода на SQLite, читаются из файлов BlobStore
+    bool hasBlob(const QString &digest) const override;
+    bool readBlob(const QString &digest, QByteArray &record) const override;
+    bool writeBlob(const QString &digest, const QByteArray &record) override;
+    QStringList blobKeys(const QDateTime &writtenBefore) const override;
+    bool removeBlob(const QString &key) override;
+
+    // PRAGMA quick_check, затем страницы всех пространств и строки blob
+    bool verify(QStringList &damaged) const override;
+
+private:
+    // "<корень>/users/bob/<id>/" -> "users/bob/<id>"
+    QString keyOf(const QString &path) const;
+
+    QString _databasePath;
+    QString _rootPath;
+};
+
+#endif // SQLITE_ENGINE_H
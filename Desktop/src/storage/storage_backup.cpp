@@ -0,0 +1,374 @@
+#include "storage_backup.h"
+#include "crc32c.h"
+#include "page_locks.h"
+#include "workspace_archive.h"
+#include "workspace_directory.h"
+
+#include <QDataStream>
+#include <QDir>
+#include <QDirIterator>
+#include <QFile>
+#include <QFileInfo>
+#include <QRegularExpression>
+#include <QSaveFile>
+#include <QtEndian>
+#include <QDebug>
+#include <algorithm>
+
+namespace {
+constexpr QDataStream::Version StreamVersion = QDataStream::Qt_5_12;
+
+QString keyOf(quint8 kind, const QString &path)
+{
+    return QString::number(kind) + ":" + path;
+}
+
+bool isSkipped(const QString &relativePath)
+{
+    const QString fileName = QFileInfo(relativePath).fileName();
+    return relativePath.contains(WorkspaceDirectory::QuarantineDirName)
+           || fileName.endsWith(WorkspaceDirectory::PreviousSuffix)
+           || fileName == WorkspaceDirectory::HistoryFileName
+           || fileName == WorkspaceArchive::AccessStampFileName;
+}
+
+// Для шарда страницы сумма берётся из заголовка, остальные файлы читаются целиком
+bool readState(const QString &path, StorageBackup::FileState &state)
+{
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly))
+        return false;
+
+    state.size = file.size();
+    if (path.endsWith(WorkspaceDirectory::PageFileSuffix)) {
+        const QByteArray header = file.read(8);
+        if (header.size() == 8
+            && qFromBigEndian<quint32>(header.constData()) == WorkspaceDirectory::ShardMagic) {
+            state.checksum = qFromBigEndian<quint32>(header.constData() + 4);
+            return true;
+        }
+        file.seek(0);
+    }
+    state.checksum = Crc32c::checksum(file.readAll());
+    return true;
+}
+
+// Запись с контрольной суммой всего, что записано до трейлера
+class BackupWriter
+{
+public:
+    explicit BackupWriter(const QString &path) : _file(path)
+    {}
+
+    bool open()
+    {
+        return _file.open(QIODevice::WriteOnly);
+    }
+
+    template<typename Serialize>
+    bool write(const Serialize &serialize)
+    {
+        QByteArray data;
+        QDataStream out(&data, QIODevice::WriteOnly);
+        out.setVersion(StreamVersion);
+        serialize(out);
+        _checksum = Crc32c::checksum(data.constData(), data.size(), _checksum);
+        return _file.write(data) == data.size();
+    }
+
+    qint64 pos() const
+    {
+        return _file.pos();
+    }
+
+    bool commit()
+    {
+        const quint64 manifestOffset = _manifestOffset;
+        const quint32 checksum = _checksum;
+        return write([&](QDataStream &out) {
+                   out << manifestOffset << checksum << quint32(StorageBackup::Magic);
+               })
+               && _file.commit();
+    }
+
+    void setManifestOffset(qint64 offset)
+    {
+        _manifestOffset = quint64(offset);
+    }
+
+    void cancel()
+    {
+        _file.cancelWriting();
+    }
+
+    QString errorString() const
+    {
+        return _file.errorString();
+    }
+
+private:
+    QSaveFile _file;
+    quint32 _checksum { 0 };
+    quint64 _manifestOffset { 0 };
+};
+
+struct ManifestEntry
+{
+    quint8 kind { 0 };
+    QString path;
+    StorageBackup::FileState state;
+};
+} // namespace
+
+QString StorageBackup::backup(const QString &workspacesPath, const QString &blobsPath,
+                              const QString &backupDir, const QString &prefix, bool full)
+{
+    QDir().mkpath(backupDir);
+
+    // Инкремент строится от манифеста последней копии; без неё копия полная
+    const QStringList existing = backups(backupDir, prefix);
+    Header previous;
+    quint64 sequence = 1;
+    bool incremental = false;
+    if (!existing.isEmpty() && readHeader(existing.last(), previous)) {
+        sequence = previous.sequence + 1;
+        incremental = !full;
+    }
+
+    const QString path = QString("%1/%2-%3%4")
+                          .arg(backupDir, prefix)
+                          .arg(sequence, 6, 10, QChar('0'))
+                          .arg(FileSuffix);
+    BackupWriter writer(path);
+    if (!writer.open()) {
+        qWarning() << "Failed to open backup file for writing:" << writer.errorString();
+        return QString();
+    }
+
+    const quint64 baseSequence = incremental ? previous.sequence : sequence;
+    bool written = writer.write([&](QDataStream &out) {
+        out << quint32(Magic) << quint16(FormatVersion) << sequence << baseSequence;
+    });
+
+    QList<ManifestEntry> manifest;
+    int changed = 0;
+    auto addFile = [&](quint8 kind, const QString &relativePath, const QString &filePath) {
+        ManifestEntry entry;
+        entry.kind = kind;
+        entry.path = relativePath;
+        if (!written)
+            return;
+        if (kind == BlobFile)
+            entry.state.size = QFileInfo(filePath).size();
+        else if (!readState(filePath, entry.state))
+            return;
+        manifest.append(entry);
+
+        // blob не меняются: одинаковое имя - одинаковое содержимое
+        const QString key = keyOf(kind, relativePath);
+        if (incremental && previous.manifest.contains(key)
+            && (kind == BlobFile
+                || previous.manifest[key].checksum == entry.state.checksum)) {
+            return;
+        }
+
+        QFile file(filePath);
+        if (!file.open(QIODevice::ReadOnly)) {
+            qWarning() << "Failed to read file for backup:" << filePath;
+            manifest.removeLast();
+            return;
+        }
+        const QByteArray data = file.readAll();
+        written = writer.write([&](QDataStream &out) { out << kind << relativePath << data; });
+        ++changed;
+    };
+
+    const QDir workspacesDir(workspacesPath);
+    for (const QString &fileName : workspacesDir.entryList(QDir::Files))
+        addFile(WorkspaceFile, fileName, workspacesDir.filePath(fileName));
+    for (const QString &dirName : workspacesDir.entryList(QDir::Dirs | QDir::NoDotAndDotDot)) {
+        // Пространство не меняется, пока его файлы копируются
+        const QString workspacePath = workspacesPath + dirName + "/";
+        PageLocker locker(workspacePath);
+        QDirIterator it(workspacePath, QDir::Files, QDirIterator::Subdirectories);
+        while (it.hasNext()) {
+            const QString filePath = it.next();
+            const QString relativePath = workspacesDir.relativeFilePath(filePath);
+            if (!isSkipped(relativePath))
+                addFile(WorkspaceFile, relativePath, filePath);
+        }
+    }
+
+    const QDir blobsDir(blobsPath);
+    QDirIterator blobs(blobsPath, QDir::Files, QDirIterator::Subdirectories);
+    while (blobs.hasNext()) {
+        const QString filePath = blobs.next();
+        const QString relativePath = blobsDir.relativeFilePath(filePath);
+        if (!isSkipped(relativePath))
+            addFile(BlobFile, relativePath, filePath);
+    }
+
+    writer.setManifestOffset(writer.pos());
+    written = written && writer.write([&](QDataStream &out) {
+        out << quint32(manifest.size());
+        for (const ManifestEntry &entry : std::as_const(manifest))
+            out << entry.kind << entry.path << entry.state.size << entry.state.checksum;
+    });
+    if (!written || !writer.commit()) {
+        qWarning() << "Failed to write backup:" << writer.errorString();
+        writer.cancel();
+        return QString();
+    }
+
+    qDebug() << "Backup" << path << (incremental ? "incremental:" : "full:") << changed << "of"
+             << manifest.size() << "files";
+    return path;
+}
+
+QStringList StorageBackup::backups(const QString &backupDir, const QString &prefix)
+{
+    const QRegularExpression pattern(QString("^%1-(\\d+)%2$")
+                                      .arg(QRegularExpression::escape(prefix),
+                                           QRegularExpression::escape(FileSuffix)));
+
+    QList<QPair<quint64, QString>> found;
+    const QDir dir(backupDir);
+    for (const QString &fileName : dir.entryList(QDir::Files)) {
+        const QRegularExpressionMatch match = pattern.match(fileName);
+        if (match.hasMatch())
+            found.append(qMakePair(match.captured(1).toULongLong(), dir.filePath(fileName)));
+    }
+    std::sort(found.begin(), found.end());
+
+    QStringList files;
+    for (const auto &backup : std::as_const(found)) files.append(backup.second);
+    return files;
+}
+
+bool StorageBackup::restore(const QStringList &backupFiles, const QString &targetPath)
+{
+    if (backupFiles.isEmpty())
+        return false;
+    const QString root = QDir::cleanPath(targetPath) + "/";
+    if (!QDir(root).isEmpty()) {
+        qWarning() << "Backup restore target is not empty:" << targetPath;
+        return false;
+    }
+
+    // Цепочка: полная копия и инкременты, каждый построен от предыдущего
+    QList<Header> headers;
+    for (const QString &backupFile : backupFiles) {
+        Header header;
+        if (!readHeader(backupFile, header))
+            return false;
+        const bool linked = headers.isEmpty() ? header.baseSequence == header.sequence
+                                              : header.baseSequence == headers.last().sequence;
+        if (!linked) {
+            qWarning() << "Backup chain is broken at" << backupFile;
+            return false;
+        }
+        headers.append(header);
+    }
+
+    // Более поздние копии перезаписывают файлы более ранних
+    const QString blobsPath = root + "blobs/";
+    for (const QString &backupFile : backupFiles) {
+        QFile file(backupFile);
+        if (!file.open(QIODevice::ReadOnly))
+            return false;
+
+        QDataStream in(&file);
+        in.setVersion(StreamVersion);
+
+        // Полная проверка суммы: восстанавливать из повреждённой копии нельзя
+        quint64 manifestOffset = 0;
+        quint32 checksum = 0;
+        quint32 computed = 0;
+        while (file.pos() < file.size() - TrailerSize) {
+            const QByteArray chunk = file.read(qMin<qint64>(1 << 20, file.size() - TrailerSize
+                                                                     - file.pos()));
+            computed = Crc32c::checksum(chunk.constData(), chunk.size(), computed);
+        }
+        in >> manifestOffset >> checksum;
+        if (computed != checksum) {
+            qWarning() << "Backup checksum mismatch:" << backupFile;
+            return false;
+        }
+
+        quint32 magic = 0;
+        quint16 version = 0;
+        quint64 sequence = 0;
+        quint64 baseSequence = 0;
+        file.seek(0);
+        in >> magic >> version >> sequence >> baseSequence;
+        while (in.status() == QDataStream::Ok && file.pos() < qint64(manifestOffset)) {
+            quint8 kind = 0;
+            QString path;
+            QByteArray data;
+            in >> kind >> path >> data;
+            if (in.status() != QDataStream::Ok || path.contains(".."))
+                return false;
+
+            const QString filePath = (kind == BlobFile ? blobsPath : root) + path;
+            QDir().mkpath(QFileInfo(filePath).absolutePath());
+            QSaveFile target(filePath);
+            if (!target.open(QIODevice::WriteOnly) || target.write(data) != data.size()
+                || !target.commit()) {
+                qWarning() << "Failed to restore" << filePath << target.errorString();
+                return false;
+            }
+        }
+    }
+
+    // Файлы, удалённые к моменту последней копии, убираем
+    const QHash<QString, FileState> &manifest = headers.last().manifest;
+    QDirIterator it(root, QDir::Files, QDirIterator::Subdirectories);
+    while (it.hasNext()) {
+        const QString filePath = QDir::cleanPath(it.next());
+        const bool isBlob = filePath.startsWith(blobsPath);
+        const QString relativePath = filePath.mid(isBlob ? blobsPath.size() : root.size());
+        if (!manifest.contains(keyOf(isBlob ? BlobFile : WorkspaceFile, relativePath)))
+            QFile::remove(filePath);
+    }
+    return true;
+}
+
+bool StorageBackup::readHeader(const QString &backupFile, Header &header)
+{
+    QFile file(backupFile);
+    if (!file.open(QIODevice::ReadOnly) || file.size() < TrailerSize)
+        return false;
+
+    QDataStream in(&file);
+    in.setVersion(StreamVersion);
+
+    quint32 magic = 0;
+    quint16 version = 0;
+    in >> magic >> version >> header.sequence >> header.baseSequence;
+    if (in.status() != QDataStream::Ok || magic != Magic || version == 0
+        || version > FormatVersion) {
+        return false;
+    }
+
+    quint64 manifestOffset = 0;
+    quint32 checksum = 0;
+    file.seek(file.size() - TrailerSize);
+    in >> manifestOffset >> checksum >> magic;
+    if (in.status() != QDataStream::Ok || magic != Magic
+        || manifestOffset > quint64(file.size() - TrailerSize)) {
+        return false;
+    }
+
+    file.seek(qint64(manifestOffset));
+    quint32 count = 0;
+    in >> count;
+    header.manifest.clear();
+    for (quint32 i = 0; i < count && in.status() == QDataStream::Ok; ++i) {
+        quint8 kind = 0;
+        QString path;
+        FileState state;
+        in >> kind >> path >> state.size >> state.checksum;
+        header.manifest.insert(keyOf(kind, path), state);
+    }
+    return in.status() == QDataStream::Ok;
+}
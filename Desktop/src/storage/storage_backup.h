@@ -0,0 +1,70 @@
+#ifndef STORAGE_BACKUP_H
+#define STORAGE_BACKUP_H
+
+#include <QHash>
+#include <QList>
+#include <QString>
+#include <QStringList>
+
+// Инкрементальные резервные копии каталога пространств и blob.
+//
+// Копия - файл <prefix>-<sequence>.mnb в каталоге резервных копий:
+//   header:   magic "MNBK" | quint16 version | quint64 sequence | quint64 baseSequence
+//             (равен sequence у полной копии)
+//   data:     записи (quint8 kind, QString path, QByteArray содержимое) до манифеста
+//   manifest: quint32 count x (quint8 kind, QString path, qint64 size, quint32 CRC32C)
+//   trailer:  quint64 manifestOffset | quint32 CRC32C всего до трейлера | magic "MNBK"
+//
+// Данные пишутся потоком, по одному файлу, пространство при этом заблокировано целиком.
+// Манифест перечисляет все файлы на момент копии, данные - только те, которых нет
+// в манифесте предыдущей копии или чья контрольная сумма изменилась. Файлы копируются
+// как лежат на диске (шифрованные - шифрованными). Для шардов страниц берётся сумма из
+// заголовка, поэтому без изменений шард даже не читается; blob адресуются содержимым
+// и сравниваются по имени. Перезапись неизменённых данных при выходе копию не раздувает.
+//
+// Не копируются: *.prev, quarantine/, history.mnh и отметки доступа.
+class StorageBackup
+{
+public:
+    static constexpr quint32 Magic = 0x4D4E424B; // "MNBK"
+    static constexpr quint16 FormatVersion = 1;
+    static constexpr char FileSuffix[] = ".mnb";
+    static constexpr qint64 TrailerSize = 8 + 4 + 4;
+
+    enum Kind : quint8
+    {
+        WorkspaceFile = 0, // путь относительно каталога пространств
+        BlobFile = 1 // путь относительно корня BlobStore
+    };
+
+    struct FileState
+    {
+        qint64 size { 0 };
+        quint32 checksum { 0 };
+    };
+
+    // Пишет копию со следующим номером; полная, если предыдущих нет или full.
+    // Возвращает путь созданного файла или пустую строку.
+    static QString backup(const QString &workspacesPath, const QString &blobsPath,
+                          const QString &backupDir, const QString &prefix, bool full = false);
+
+    // Копии prefix в каталоге по возрастанию номера
+    static QStringList backups(const QString &backupDir, const QString &prefix);
+
+    // Собирает состояние на момент последней копии цепочки: полная копия и
+    // инкременты по порядку. Пространства - в targetPath, blob - в targetPath/blobs/;
+    // targetPath должен быть пустым или ещё не существовать.
+    static bool restore(const QStringList &backupFiles, const QString &targetPath);
+
+private:
+    struct Header
+    {
+        quint64 sequence { 0 };
+        quint64 baseSequence { 0 };
+        QHash<QString, FileState> manifest; // "<kind>:<path>" -> состояние
+    };
+
+    static bool readHeader(const QString &backupFile, Header &header);
+};
+
+#endif // STORAGE_BACKUP_H
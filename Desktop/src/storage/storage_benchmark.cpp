@@ -0,0 +1,278 @@
+#include "storage_benchmark.h"
+#include "storage_cipher.h"
+#include "text_codec.h"
+#include "workspace_directory.h"
+
+#include <QElapsedTimer>
+#include <QJsonArray>
+#include <QJsonObject>
+#include <QRandomGenerator>
+#include <QTemporaryDir>
+#include <QTextCursor>
+#include <QTextDocument>
+#include <QTextList>
+#include <QTextStream>
+#include <QUuid>
+#include <QDebug>
+#include <functional>
+#include <limits>
+
+namespace {
+// Текст с повторами, как в настоящих заметках
+QJsonObject makePage(int index, qint64 bytes)
+{
+    QJsonArray elements;
+    qint64 written = 0;
+    for (int element = 0; written < bytes; ++element) {
+        QString text;
+        for (int line = 0; line < 32; ++line) {
+            text += QString("Заметка %1, элемент %2, строка %3: %4. ")
+                     .arg(index)
+                     .arg(element)
+                     .arg(line)
+                     .arg(QRandomGenerator::global()->generate());
+        }
+        QJsonObject item;
+        item["type"] = "TextItem";
+        item["content"] = text;
+        elements.append(item);
+        written += text.toUtf8().size();
+    }
+
+    QJsonObject page;
+    page["id"] = QUuid::createUuid().toString(QUuid::WithoutBraces);
+    page["title"] = QString("Страница %1").arg(index);
+    page["elements"] = elements;
+    return page;
+}
+
+// Заметка, как её сохраняет TextItem: QTextEdit::toHtml() с абзацами, выделением и списками
+QByteArray makeNote()
+{
+    static const QStringList words = { "встреча", "проект", "заметка", "срок", "задача",
+                                       "список", "идея", "черновик", "отчёт", "план",
+                                       "review", "deadline", "draft", "todo", "notes" };
+    QRandomGenerator *random = QRandomGenerator::global();
+    auto sentence = [&]() {
+        QStringList parts;
+        const int count = 3 + random->bounded(12);
+        for (int i = 0; i < count; ++i) parts.append(words[random->bounded(words.size())]);
+        return parts.join(' ') + ". ";
+    };
+
+    QTextDocument document;
+    QTextCursor cursor(&document);
+    const int paragraphs = 1 + random->bounded(4);
+    for (int p = 0; p < paragraphs; ++p) {
+        if (p > 0)
+            cursor.insertBlock();
+        if (random->bounded(4) == 0) {
+            QTextListFormat list;
+            list.setStyle(random->bounded(2) ? QTextListFormat::ListDisc
+                                             : QTextListFormat::ListDecimal);
+            cursor.insertList(list);
+            cursor.insertText(sentence());
+            cursor.insertBlock();
+            cursor.insertText(sentence());
+            continue;
+        }
+        cursor.insertText(sentence());
+        if (random->bounded(3) == 0) {
+            QTextCharFormat format;
+            format.setFontWeight(QFont::Bold);
+            cursor.insertText(sentence(), format);
+            cursor.setCharFormat(QTextCharFormat());
+        }
+    }
+    return document.toHtml().toUtf8();
+}
+
+double bestOf(int repeats, const std::function<void()> &operation)
+{
+    double best = std::numeric_limits<double>::max();
+    for (int i = 0; i < repeats; ++i) {
+        QElapsedTimer timer;
+        timer.start();
+        operation();
+        best = qMin(best, timer.nsecsElapsed() / 1e6);
+    }
+    return best;
+}
+} // namespace
+
+QList<StorageBenchmark::Result> StorageBenchmark::run(qint64 workspaceBytes, int pageCount,
+                                                      int repeats)
+{
+    QList<Result> results;
+    QTemporaryDir dir;
+    if (!dir.isValid()) {
+        qWarning() << "Failed to create benchmark directory";
+        return results;
+    }
+    const QString workspacePath = dir.path() + "/benchmark/";
+
+    QList<QJsonObject> pages;
+    QList<WorkspaceContainer::IndexEntry> index;
+    qint64 sectionBytes = 0;
+    for (int i = 0; i < pageCount; ++i) {
+        pages.append(makePage(i, workspaceBytes / pageCount));
+        WorkspaceContainer::IndexEntry entry;
+        entry.parent = i == 0 ? -1 : 0;
+        entry.id = pages.last()["id"].toString();
+        entry.title = pages.last()["title"].toString();
+        index.append(entry);
+        sectionBytes += WorkspaceContainer::encodePage(pages.last()).size();
+    }
+
+    // Случайный ключ: замер не касается ключей пользователей
+    StorageCipher &cipher = StorageCipher::instance();
+    QByteArray key(StorageCipher::KeySize, Qt::Uninitialized);
+    QRandomGenerator::system()->fillRange(reinterpret_cast<quint32 *>(key.data()),
+                                          StorageCipher::KeySize / 4);
+    cipher.setKey(StorageCipher::UserKey, key);
+
+    auto measure = [&](const QString &name, qint64 bytes, const std::function<void()> &prepare,
+                       const std::function<void()> &operation) {
+        Result result;
+        result.name = name;
+        result.bytes = bytes;
+        for (bool encrypted : { false, true }) {
+            cipher.setEnabled(encrypted);
+            if (prepare)
+                prepare();
+            (encrypted ? result.encryptedMs : result.plainMs) = bestOf(repeats, operation);
+        }
+        results.append(result);
+    };
+
+    QByteArray buffer(workspaceBytes, Qt::Uninitialized);
+    QRandomGenerator::global()->fillRange(reinterpret_cast<quint32 *>(buffer.data()),
+                                          buffer.size() / 4);
+    measure("seal + open in memory", buffer.size(), nullptr, [&]() {
+        QByteArray sealed;
+        QByteArray plain;
+        cipher.seal(buffer, sealed);
+        cipher.open(sealed, plain);
+    });
+
+    auto save = [&]() {
+        for (const QJsonObject &page : std::as_const(pages))
+            WorkspaceDirectory::writePageShard(workspacePath, page["id"].toString(), page);
+        WorkspaceDirectory::writeIndex(workspacePath, index);
+    };
+    measure("save workspace", sectionBytes, nullptr, save);
+
+    measure("load workspace", sectionBytes, save, [&]() {
+        QFile container;
+        QList<WorkspaceContainer::IndexEntry> stored;
+        WorkspaceDirectory::openIndex(workspacePath, container, stored);
+        for (const WorkspaceContainer::IndexEntry &entry : std::as_const(stored)) {
+            QJsonObject page;
+            WorkspaceDirectory::readPageShard(workspacePath, entry.id, page);
+        }
+    });
+
+    cipher.setEnabled(false);
+    return results;
+}
+
+void StorageBenchmark::print(const QList<Result> &results)
+{
+    QTextStream out(stdout);
+    out << "Storage encryption benchmark (AES-256-GCM"
+        << (StorageCipher::isSupported() ? ", OpenSSL" : ", not available in this build")
+        << ")\n";
+    for (const Result &result : results) {
+        const double megabytes = result.bytes / double(1 << 20);
+        const double overhead =
+         result.plainMs > 0 ? (result.encryptedMs / result.plainMs - 1.0) * 100.0 : 0.0;
+        out << QString("%1 %2 MB  plain %3 ms  encrypted %4 ms (%5 MB/s)  overhead %6%\n")
+                .arg(result.name, -24)
+                .arg(megabytes, 0, 'f', 1)
+                .arg(result.plainMs, 0, 'f', 2)
+                .arg(result.encryptedMs, 0, 'f', 2)
+                .arg(result.encryptedMs > 0 ? megabytes * 1000.0 / result.encryptedMs : 0.0, 0,
+                     'f', 0)
+                .arg(overhead, 0, 'f', 1);
+    }
+}
+
+QList<StorageBenchmark::CodecResult> StorageBenchmark::runTextCodec(int elementCount, int repeats)
+{
+    QList<QByteArray> training;
+    QList<QByteArray> samples;
+    for (int i = 0; i < elementCount; ++i) (i % 2 ? samples : training).append(makeNote());
+
+    qint64 bytes = 0;
+    for (const QByteArray &sample : std::as_const(samples)) bytes += sample.size();
+
+    using Transform = std::function<QByteArray(const QByteArray &)>;
+    QList<CodecResult> results;
+    auto measure = [&](const QString &name, const Transform &encode, const Transform &decode) {
+        QList<QByteArray> encoded;
+        CodecResult result;
+        result.name = name;
+        result.bytes = bytes;
+        for (const QByteArray &sample : std::as_const(samples)) {
+            encoded.append(encode(sample));
+            result.compressedBytes += encoded.last().size();
+        }
+        result.decodeMs = bestOf(repeats, [&]() {
+            for (const QByteArray &data : std::as_const(encoded)) decode(data);
+        });
+        results.append(result);
+    };
+
+    measure(
+     "qCompress, no dictionary", [](const QByteArray &data) { return qCompress(data); },
+     [](const QByteArray &data) { return qUncompress(data); });
+    if (!TextCodec::isSupported())
+        return results;
+
+    // Невыгодные элементы хранятся как есть - так же, как в WorkspaceContainer::encodeElement
+    TextCodec &codec = TextCodec::instance();
+    auto withDictionary = [&](const QString &name, const QByteArray &dictionary) {
+        measure(
+         name,
+         [&](const QByteArray &data) {
+             const QByteArray frame = codec.compress(data, dictionary);
+             return frame.isEmpty() ? data : frame;
+         },
+         [&](const QByteArray &data) {
+             QByteArray text;
+             if (data.startsWith(char(TextCodec::DeflateMethod)))
+                 codec.decompress(data, text);
+             return text;
+         });
+    };
+    withDictionary("built-in dictionary", codec.htmlDictionary());
+
+    QElapsedTimer timer;
+    timer.start();
+    const QByteArray trained = TextCodec::train(training);
+    qDebug() << "Trained" << trained.size() << "byte dictionary on" << training.size()
+             << "elements in" << timer.elapsed() << "ms";
+    codec.addDictionary(trained);
+    withDictionary("trained dictionary", trained);
+    return results;
+}
+
+void StorageBenchmark::print(const QList<CodecResult> &results)
+{
+    QTextStream out(stdout);
+    out << "Text element compression benchmark (deflate"
+        << (TextCodec::isSupported() ? " with preset dictionary" : ", dictionary not available")
+        << ")\n";
+    for (const CodecResult &result : results) {
+        const double megabytes = result.bytes / double(1 << 20);
+        out << QString("%1 %2 MB -> %3 MB  ratio %4  decode %5 ms (%6 MB/s)\n")
+                .arg(result.name, -26)
+                .arg(megabytes, 0, 'f', 2)
+                .arg(result.compressedBytes / double(1 << 20), 0, 'f', 2)
+                .arg(result.compressedBytes > 0 ? double(result.bytes) / result.compressedBytes
+                                                : 0.0,
+                     0, 'f', 2)
+                .arg(result.decodeMs, 0, 'f', 2)
+                .arg(result.decodeMs > 0 ? megabytes * 1000.0 / result.decodeMs : 0.0, 0, 'f', 0);
+    }
+}
@@ -0,0 +1,41 @@
+#ifndef STORAGE_BENCHMARK_H
+#define STORAGE_BENCHMARK_H
+
+#include <QList>
+#include <QString>
+
+// Замер накладных расходов шифрования хранилища: одни и те же операции
+// выполняются с открытыми и с зашифрованными записями во временном каталоге.
+// Запуск: Desktop --storage-benchmark; результаты печатаются в stdout.
+// Desktop --text-codec-benchmark - степень сжатия и скорость распаковки разметки
+// текстовых элементов (TextCodec) без словаря, со встроенным и с обученным словарём.
+class StorageBenchmark
+{
+public:
+    struct Result
+    {
+        QString name;
+        qint64 bytes { 0 };
+        double plainMs { 0 };
+        double encryptedMs { 0 };
+    };
+
+    // Лучшее из repeats прогонов для workspaceBytes данных, разложенных по pageCount страниц
+    static QList<Result> run(qint64 workspaceBytes = 8 << 20, int pageCount = 200,
+                             int repeats = 5);
+    static void print(const QList<Result> &results);
+
+    struct CodecResult
+    {
+        QString name;
+        qint64 bytes { 0 };
+        qint64 compressedBytes { 0 };
+        double decodeMs { 0 };
+    };
+
+    // Словарь обучается на половине из elementCount элементов, замер - на другой половине
+    static QList<CodecResult> runTextCodec(int elementCount = 4000, int repeats = 5);
+    static void print(const QList<CodecResult> &results);
+};
+
+#endif // STORAGE_BENCHMARK_H
@@ -0,0 +1,462 @@
+#include "storage_cipher.h"
+
+#include <QCoreApplication>
+#include <QCryptographicHash>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QMessageAuthenticationCode>
+#include <QMutexLocker>
+#include <QRandomGenerator>
+#include <QtEndian>
+#include <QUuid>
+#include <QDebug>
+
+#include <cstring>
+
+#if defined(DESKTOP_STORAGE_ENCRYPTION)
+#include <openssl/evp.h>
+#include <openssl/rand.h>
+#endif
+
+#if defined(DESKTOP_STORAGE_KEYCHAIN)
+#include <QEventLoop>
+#if QT_VERSION >= QT_VERSION_CHECK(6, 0, 0)
+#include <qt6keychain/keychain.h>
+#else
+#include <qt5keychain/keychain.h>
+#endif
+#endif
+
+namespace {
+constexpr char SecretFileName[] = "/settings/storage.key";
+// Отметка, что секрет лежит в хранилище ключей: без неё недоступное хранилище
+// ключей привело бы к созданию нового секрета и потере зашифрованных данных.
+// Внутри - имя записи в хранилище ключей (пусто у прежних версий)
+constexpr char KeychainMarkerFileName[] = "/settings/storage.keychain";
+constexpr char KeyContextPrefix[] = "Desktop storage key v1:";
+constexpr qsizetype ChunkSize = 1 << 20;
+
+QByteArray keyIdOf(const QByteArray &key)
+{
+    return QCryptographicHash::hash(key, QCryptographicHash::Sha256)
+     .left(StorageCipher::KeyIdSize);
+}
+
+#if defined(DESKTOP_STORAGE_KEYCHAIN)
+constexpr char KeychainService[] = "Desktop storage key";
+
+QString keychainMarkerPath()
+{
+    return QCoreApplication::applicationDirPath() + KeychainMarkerFileName;
+}
+
+// Запись в хранилище ключей у каждой установки своя. Имя случайное и лежит в отметке
+// рядом с данными, поэтому переносится вместе с ними; прежние версии называли запись
+// путём к приложению
+QString keychainAccount()
+{
+    QFile marker(keychainMarkerPath());
+    const QString account = marker.open(QIODevice::ReadOnly)
+                             ? QString::fromUtf8(marker.readAll()).trimmed()
+                             : QString();
+    return account.isEmpty() ? QCoreApplication::applicationDirPath() : account;
+}
+
+// Задания QtKeychain асинхронные; секрет нужен до первого чтения хранилища
+bool runKeychainJob(QKeychain::Job &job)
+{
+    QEventLoop loop;
+    QObject::connect(&job, &QKeychain::Job::finished, &loop, &QEventLoop::quit);
+    job.setAutoDelete(false);
+    job.start();
+    loop.exec();
+    return job.error() == QKeychain::NoError;
+}
+
+// true - хранилище ключей ответило; secret пуст, если записи нет
+bool readKeychainSecret(QByteArray &secret)
+{
+    QKeychain::ReadPasswordJob job(KeychainService);
+    job.setKey(keychainAccount());
+    if (runKeychainJob(job)) {
+        secret = job.binaryData();
+        return true;
+    }
+    secret.clear();
+    if (job.error() == QKeychain::EntryNotFound)
+        return true;
+    qWarning() << "OS keychain is not available:" << job.errorString();
+    return false;
+}
+
+// Пишется только новый секрет, поэтому и имя записи новое
+bool writeKeychainSecret(const QByteArray &secret)
+{
+    const QString account = QUuid::createUuid().toString(QUuid::WithoutBraces);
+    QKeychain::WritePasswordJob job(KeychainService);
+    job.setKey(account);
+    job.setBinaryData(secret);
+    if (runKeychainJob(job)) {
+        QFile marker(keychainMarkerPath());
+        QDir().mkpath(QFileInfo(marker).absolutePath());
+        if (marker.open(QIODevice::WriteOnly) && marker.write(account.toUtf8()) > 0)
+            return true;
+        qWarning() << "Failed to write storage key marker:" << marker.errorString();
+        QKeychain::DeletePasswordJob cleanup(KeychainService);
+        cleanup.setKey(account);
+        runKeychainJob(cleanup);
+        return false;
+    }
+    qWarning() << "Failed to store storage key in OS keychain:" << job.errorString();
+    return false;
+}
+#endif
+
+bool readSecretFile(const QString &path, QByteArray &secret)
+{
+    QFile file(path);
+    secret = file.open(QIODevice::ReadOnly) ? file.readAll() : QByteArray();
+    if (secret.size() != StorageCipher::KeySize) {
+        qWarning() << "Invalid storage key file:" << path;
+        secret.clear();
+        return false;
+    }
+    return true;
+}
+
+// Файл с секретом с самого создания доступен только владельцу: пишется во временный
+// файл с такими правами и переименовывается
+bool writeSecretFile(const QString &path, const QByteArray &secret)
+{
+    QDir().mkpath(QFileInfo(path).absolutePath());
+    const QString temporaryPath = path + ".new";
+    QFile::remove(temporaryPath);
+
+    QFile out(temporaryPath);
+    if (!out.open(QIODevice::WriteOnly | QIODevice::NewOnly,
+                  QFileDevice::ReadOwner | QFileDevice::WriteOwner)
+        || out.write(secret) != secret.size() || !out.flush()) {
+        qWarning() << "Failed to write storage key file:" << out.errorString();
+        out.close();
+        QFile::remove(temporaryPath);
+        return false;
+    }
+    out.close();
+    return QFile::rename(temporaryPath, path);
+}
+
+// Секрет создаётся один раз; испорченный файл не перезаписываем, иначе
+// зашифрованные им данные станут нечитаемыми. create - создать, если секрета ещё нет
+QByteArray loadSecret(bool create)
+{
+    const QString path = QCoreApplication::applicationDirPath() + SecretFileName;
+    const bool inKeychain = QFile::exists(QCoreApplication::applicationDirPath()
+                                          + KeychainMarkerFileName);
+    QByteArray secret;
+
+#if defined(DESKTOP_STORAGE_KEYCHAIN)
+    // Без отметки и файла секрета нет нигде - хранилище ключей не спрашиваем
+    if ((inKeychain || create || QFile::exists(path)) && readKeychainSecret(secret)) {
+        if (secret.size() == StorageCipher::KeySize)
+            return secret;
+        if (!secret.isEmpty()) {
+            qWarning() << "Invalid storage key in OS keychain";
+            return QByteArray();
+        }
+
+        // Секрет прежних версий переносится из файла; файл удаляется только
+        // после успешной записи в хранилище ключей
+        if (QFile::exists(path)) {
+            if (!readSecretFile(path, secret))
+                return QByteArray();
+            if (writeKeychainSecret(secret))
+                QFile::remove(path);
+            return secret;
+        }
+
+        // Секрет уже перенесён в хранилище ключей, а записи там нет (хранилище
+        // сброшено): новый секрет сделал бы нечитаемыми все зашифрованные данные
+        if (inKeychain) {
+            qWarning() << "Storage key is missing from the OS keychain";
+            return QByteArray();
+        }
+        if (!create)
+            return QByteArray();
+
+        secret = QByteArray(StorageCipher::KeySize, Qt::Uninitialized);
+        QRandomGenerator::system()->fillRange(reinterpret_cast<quint32 *>(secret.data()),
+                                              StorageCipher::KeySize / 4);
+        if (writeKeychainSecret(secret))
+            return secret;
+        // Хранилище ключей не приняло запись - остаётся файл
+        return writeSecretFile(path, secret) ? secret : QByteArray();
+    }
+#endif
+
+    if (QFile::exists(path))
+        return readSecretFile(path, secret) ? secret : QByteArray();
+    if (inKeychain) {
+        qWarning() << "Storage key is kept in the OS keychain, which is not available";
+        return QByteArray();
+    }
+    if (!create)
+        return QByteArray();
+
+    secret = QByteArray(StorageCipher::KeySize, Qt::Uninitialized);
+    QRandomGenerator::system()->fillRange(reinterpret_cast<quint32 *>(secret.data()),
+                                          StorageCipher::KeySize / 4);
+    return writeSecretFile(path, secret) ? secret : QByteArray();
+}
+
+#if defined(DESKTOP_STORAGE_ENCRYPTION)
+// AES-256-GCM одним проходом; данные подаются кусками, потому что длина в EVP - int
+bool gcm(bool encrypt, const QByteArray &key, const char *header, const char *input,
+         qsizetype size, char *output, char *tag)
+{
+    EVP_CIPHER_CTX *context = EVP_CIPHER_CTX_new();
+    if (!context)
+        return false;
+
+    const uchar *nonce = reinterpret_cast<const uchar *>(header + 4 + StorageCipher::KeyIdSize);
+    int length = 0;
+    bool ok =
+     EVP_CipherInit_ex(context, EVP_aes_256_gcm(), nullptr, nullptr, nullptr, encrypt) == 1
+     && EVP_CIPHER_CTX_ctrl(context, EVP_CTRL_GCM_SET_IVLEN, StorageCipher::NonceSize, nullptr)
+         == 1
+     && EVP_CipherInit_ex(context, nullptr, nullptr,
+                          reinterpret_cast<const uchar *>(key.constData()), nonce, -1)
+         == 1
+     && EVP_CipherUpdate(context, nullptr, &length, reinterpret_cast<const uchar *>(header),
+                         StorageCipher::HeaderSize)
+         == 1;
+
+    for (qsizetype done = 0; ok && done < size; done += ChunkSize) {
+        const int chunk = int(qMin(ChunkSize, size - done));
+        ok = EVP_CipherUpdate(context, reinterpret_cast<uchar *>(output + done), &length,
+                              reinterpret_cast<const uchar *>(input + done), chunk)
+             == 1;
+    }
+
+    if (ok && !encrypt)
+        ok = EVP_CIPHER_CTX_ctrl(context, EVP_CTRL_GCM_SET_TAG, StorageCipher::TagSize, tag) == 1;
+    ok = ok && EVP_CipherFinal_ex(context, reinterpret_cast<uchar *>(output + size), &length) == 1;
+    if (ok && encrypt)
+        ok = EVP_CIPHER_CTX_ctrl(context, EVP_CTRL_GCM_GET_TAG, StorageCipher::TagSize, tag) == 1;
+
+    EVP_CIPHER_CTX_free(context);
+    return ok;
+}
+#endif
+} // namespace
+
+StorageCipher &StorageCipher::instance()
+{
+    static StorageCipher instance;
+    return instance;
+}
+
+StorageCipher::StorageCipher() = default;
+
+bool StorageCipher::isSupported()
+{
+#if defined(DESKTOP_STORAGE_ENCRYPTION)
+    return true;
+#else
+    return false;
+#endif
+}
+
+bool StorageCipher::hasKeychain()
+{
+#if defined(DESKTOP_STORAGE_KEYCHAIN)
+    return true;
+#else
+    return false;
+#endif
+}
+
+bool StorageCipher::loadKeys(bool create)
+{
+    QMutexLocker locker(&_secretMutex);
+    if (!_secret.isEmpty())
+        return true;
+    // Без create секрет ищется один раз: отсутствие не должно каждый раз
+    // запускать задание хранилища ключей
+    if (!isSupported() || (_secretLoaded && !create))
+        return false;
+    _secretLoaded = true;
+
+    _secret = loadSecret(create);
+    if (_secret.isEmpty())
+        return false;
+    const QByteArray sharedKeyId = registerKey(deriveKey("shared"));
+    const QByteArray userKeyId =
+     registerKey(deriveKey(_username.isEmpty() ? QString("guest") : "user:" + _username));
+
+    // Явно заданные ключи (setKey) остаются текущими
+    QMutexLocker keysLocker(&_mutex);
+    if (_sharedKeyId.isEmpty())
+        _sharedKeyId = sharedKeyId;
+    if (_userKeyId.isEmpty())
+        _userKeyId = userKeyId;
+    return true;
+}
+
+bool StorageCipher::isSealed(const QByteArray &data)
+{
+    return data.size() >= HeaderSize + TagSize && qFromBigEndian<quint32>(data.constData()) == Magic;
+}
+
+QByteArray StorageCipher::deriveKey(const QString &context) const
+{
+    return QMessageAuthenticationCode::hash((QString(KeyContextPrefix) + context).toUtf8(), _secret,
+                                            QCryptographicHash::Sha256);
+}
+
+QByteArray StorageCipher::registerKey(const QByteArray &key)
+{
+    const QByteArray keyId = keyIdOf(key);
+    QMutexLocker locker(&_mutex);
+    _keys.insert(keyId, key);
+    return keyId;
+}
+
+void StorageCipher::setUser(const QString &username)
+{
+    QMutexLocker secretLocker(&_secretMutex);
+    _username = username;
+    if (_secret.isEmpty())
+        return;
+
+    const QByteArray keyId =
+     registerKey(deriveKey(username.isEmpty() ? QString("guest") : "user:" + username));
+    QMutexLocker locker(&_mutex);
+    _userKeyId = keyId;
+}
+
+void StorageCipher::setEnabled(bool enabled)
+{
+    if (enabled)
+        loadKeys(true);
+    QMutexLocker locker(&_mutex);
+    if (enabled && (!isSupported() || _keys.isEmpty())) {
+        qWarning() << "Storage encryption is not available";
+        enabled = false;
+    }
+    _enabled = enabled;
+}
+
+bool StorageCipher::isEnabled() const
+{
+    QMutexLocker locker(&_mutex);
+    return _enabled;
+}
+
+void StorageCipher::setKey(KeyScope scope, const QByteArray &key)
+{
+    const QByteArray keyId = registerKey(key);
+    QMutexLocker locker(&_mutex);
+    (scope == SharedKey ? _sharedKeyId : _userKeyId) = keyId;
+}
+
+bool StorageCipher::seal(const QByteArray &data, QByteArray &sealed, KeyScope scope,
+                         bool force) const
+{
+    QByteArray key;
+    QByteArray keyId;
+    {
+        QMutexLocker locker(&_mutex);
+        if (!_enabled && !force) {
+            sealed = data;
+            return true;
+        }
+        keyId = scope == SharedKey ? _sharedKeyId : _userKeyId;
+        key = _keys.value(keyId);
+    }
+    // Принудительное шифрование при выключенном хранилище - только уже созданным секретом
+    if (key.isEmpty() && const_cast<StorageCipher *>(this)->loadKeys(false)) {
+        QMutexLocker locker(&_mutex);
+        keyId = scope == SharedKey ? _sharedKeyId : _userKeyId;
+        key = _keys.value(keyId);
+    }
+
+#if defined(DESKTOP_STORAGE_ENCRYPTION)
+    if (key.isEmpty()) {
+        qWarning() << "No storage key to encrypt with";
+        return false;
+    }
+
+    sealed = QByteArray(HeaderSize + data.size() + TagSize, Qt::Uninitialized);
+    char *header = sealed.data();
+    qToBigEndian<quint32>(Magic, header);
+    memcpy(header + 4, keyId.constData(), KeyIdSize);
+    if (RAND_bytes(reinterpret_cast<uchar *>(header + 4 + KeyIdSize), NonceSize) != 1
+        || !gcm(true, key, header, data.constData(), data.size(), header + HeaderSize,
+                header + HeaderSize + data.size())) {
+        qWarning() << "Failed to encrypt storage record";
+        sealed.clear();
+        return false;
+    }
+    return true;
+#else
+    Q_UNUSED(key);
+    Q_UNUSED(keyId);
+    qWarning() << "Storage encryption is not available in this build";
+    return false;
+#endif
+}
+
+bool StorageCipher::open(const QByteArray &data, QByteArray &plain) const
+{
+    if (!isSealed(data)) {
+        plain = data;
+        return true;
+    }
+
+#if defined(DESKTOP_STORAGE_ENCRYPTION)
+    const QByteArray keyId = data.mid(4, KeyIdSize);
+    QByteArray key;
+    {
+        QMutexLocker locker(&_mutex);
+        key = _keys.value(keyId);
+    }
+    // Секрет загружается при первой зашифрованной записи
+    if (key.isEmpty() && const_cast<StorageCipher *>(this)->loadKeys(false)) {
+        QMutexLocker locker(&_mutex);
+        key = _keys.value(keyId);
+    }
+    if (key.isEmpty()) {
+        qWarning() << "Storage record is encrypted with an unknown key";
+        return false;
+    }
+
+    const qsizetype size = data.size() - HeaderSize - TagSize;
+    QByteArray tag = data.right(TagSize);
+    plain = QByteArray(size, Qt::Uninitialized);
+    if (!gcm(false, key, data.constData(), data.constData() + HeaderSize, size, plain.data(),
+             tag.data())) {
+        plain.clear();
+        return false;
+    }
+    return true;
+#else
+    qWarning() << "Encrypted storage requires a build with OpenSSL";
+    return false;
+#endif
+}
+
+bool StorageCipher::hasKeyFor(const QByteArray &data) const
+{
+    if (!isSealed(data))
+        return true;
+    {
+        QMutexLocker locker(&_mutex);
+        if (_keys.contains(data.mid(4, KeyIdSize)))
+            return true;
+    }
+    if (!const_cast<StorageCipher *>(this)->loadKeys(false))
+        return false;
+    QMutexLocker locker(&_mutex);
+    return _keys.contains(data.mid(4, KeyIdSize));
+}
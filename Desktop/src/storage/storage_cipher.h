@@ -0,0 +1,91 @@
+#ifndef STORAGE_CIPHER_H
+#define STORAGE_CIPHER_H
+
+#include <QByteArray>
+#include <QHash>
+#include <QMutex>
+#include <QString>
+
+// Шифрование хранилища на диске (AES-256-GCM через OpenSSL, на x86-64 и ARMv8
+// выполняется инструкциями AES/PCLMUL процессора).
+//
+// Зашифрованная запись: magic "MNEC" | 8 байт id ключа | 12 байт nonce | шифротекст | 16 байт тега.
+// Заголовок входит в аутентифицируемые данные. Записи без magic читаются как есть,
+// поэтому хранилище можно включить поверх существующих данных: файлы шифруются
+// при следующей записи.
+//
+// Ключи выводятся HMAC-SHA256 из случайного секрета установки и контекста: отдельный
+// ключ на каждого пользователя, гостя и общие данные (blobs, токен). Секрет хранится
+// в системном хранилище ключей (QtKeychain, DESKTOP_STORAGE_KEYCHAIN); без него или
+// когда хранилище ключей недоступно - в файле settings/storage.key, доступном только
+// владельцу. Файл, оставшийся от прежних версий, переносится в хранилище ключей.
+// Ключи пользователей разделяют данные, но не защищают их друг от друга: все они
+// выводятся из одного секрета, и тот, кто прочитал settings/storage.key, расшифрует
+// данные любого пользователя установки.
+// Секрет загружается при включении шифрования или при первой зашифрованной записи
+// и создаётся только при включении шифрования. Если секрет уже перенесён в хранилище
+// ключей, а записи там нет, новый не создаётся: шифрование остаётся выключенным.
+// Расшифровка выбирает ключ по id, так что гостевые данные читаются и после входа.
+// Сборка без OpenSSL (DESKTOP_STORAGE_ENCRYPTION не определён) пишет открытые данные.
+class StorageCipher
+{
+public:
+    static constexpr quint32 Magic = 0x4D4E4543; // "MNEC"
+    static constexpr int KeySize = 32;
+    static constexpr int KeyIdSize = 8;
+    static constexpr int NonceSize = 12;
+    static constexpr int TagSize = 16;
+    static constexpr int HeaderSize = 4 + KeyIdSize + NonceSize;
+
+    enum KeyScope
+    {
+        UserKey, // данные текущего пользователя (или гостя)
+        SharedKey // данные, общие для всех пользователей установки
+    };
+
+    static StorageCipher &instance();
+
+    static bool isSupported();
+    // Сборка хранит секрет в системном хранилище ключей
+    static bool hasKeychain();
+    static bool isSealed(const QByteArray &data);
+
+    // Регистрирует ключ пользователя и делает его текущим; пустое имя - гость
+    void setUser(const QString &username);
+    void setEnabled(bool enabled);
+    bool isEnabled() const;
+    // Явный ключ вместо выведенного из секрета установки (замеры, проверки)
+    void setKey(KeyScope scope, const QByteArray &key);
+
+    // Без включённого шифрования sealed - те же данные. force - шифровать независимо
+    // от настройки (токен авторизации). false - зашифровать не удалось, писать нельзя.
+    bool seal(const QByteArray &data, QByteArray &sealed, KeyScope scope = UserKey,
+              bool force = false) const;
+    // Открытые данные возвращаются как есть; false - тег не сошёлся или ключ неизвестен
+    bool open(const QByteArray &data, QByteArray &plain) const;
+    // false - запись зашифрована ключом, которого в этом процессе нет
+    bool hasKeyFor(const QByteArray &data) const;
+
+private:
+    StorageCipher();
+    StorageCipher(const StorageCipher &) = delete;
+    StorageCipher &operator=(const StorageCipher &) = delete;
+
+    QByteArray deriveKey(const QString &context) const;
+    QByteArray registerKey(const QByteArray &key);
+    // Загружает секрет установки и выводит из него ключи; create - создать секрет,
+    // если его ещё нет
+    bool loadKeys(bool create);
+
+    QMutex _secretMutex;
+    QByteArray _secret;
+    bool _secretLoaded { false };
+    QString _username;
+    mutable QMutex _mutex;
+    QHash<QByteArray, QByteArray> _keys; // id ключа -> ключ
+    QByteArray _userKeyId;
+    QByteArray _sharedKeyId;
+    bool _enabled { false };
+};
+
+#endif // STORAGE_CIPHER_H
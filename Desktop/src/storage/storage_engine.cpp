@@ -0,0 +1,63 @@
+#include "storage_engine.h"
+#include "directory_engine.h"
+#include "sqlite_engine.h"
+
+#include <QApplication>
+#include <atomic>
+
+namespace {
+std::atomic<StorageEngine::Kind> selectedKind { StorageEngine::Directory };
+} // namespace
+
+StorageEngine &StorageEngine::instance()
+{
+    return engine(selectedKind.load());
+}
+
+StorageEngine &StorageEngine::engine(Kind kind)
+{
+    static DirectoryEngine directory;
+#if defined(DESKTOP_STORAGE_SQLITE)
+    if (kind == Sqlite) {
+        static SqliteEngine sqlite(QApplication::applicationDirPath() + "/Workspaces/"
+                                   + SqliteEngine::FileName);
+        return sqlite;
+    }
+#endif
+    return directory;
+}
+
+bool StorageEngine::select(Kind kind)
+{
+    if (!isSupported(kind))
+        return false;
+    selectedKind.store(kind);
+    return true;
+}
+
+StorageEngine::Kind StorageEngine::selected()
+{
+    return selectedKind.load();
+}
+
+bool StorageEngine::isSupported(Kind kind)
+{
+#if defined(DESKTOP_STORAGE_SQLITE)
+    return kind == Directory || kind == Sqlite;
+#else
+    return kind == Directory;
+#endif
+}
+
+bool StorageEngine::verify(QStringList &damaged) const
+{
+    damaged.clear();
+    return true;
+}
+
+bool StorageEngine::writePageSection(const QString &workspacePath, const QString &pageId,
+                                     const QByteArray &section)
+{
+    QJsonObject page;
+    return WorkspaceContainer::decodePage(section, page) && writePage(workspacePath, pageId, page);
+}
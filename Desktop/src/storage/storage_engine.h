@@ -0,0 +1,89 @@
+#ifndef STORAGE_ENGINE_H
+#define STORAGE_ENGINE_H
+
+#include "workspace_container.h"
+
+#include <QByteArray>
+#include <QDateTime>
+#include <QJsonObject>
+#include <QList>
+#include <QString>
+#include <QStringList>
+
+// Движок хранения страниц пространств и blob. Все чтения и записи данных
+// пространства идут через выбранный движок; журнал правок, история версий и
+// каталог для боковой панели остаются файлами в каталоге пространства и базовом каталоге.
+//
+// Пространство адресуется путём <basePath><id корня>/, как и раньше, - по нему же
+// берутся PageLocks. Блокировки страниц движок не берёт, это делает вызывающий.
+// Реализации не зависят от состояния LocalStorage и вызываются из любого потока.
+//
+//   Directory - каталог на пространство, шарды страниц (WorkspaceDirectory)
+//   Sqlite    - одна база SQLite в режиме WAL на всё хранилище (SqliteEngine)
+class StorageEngine
+{
+public:
+    enum Kind
+    {
+        Directory,
+        Sqlite
+    };
+
+    virtual ~StorageEngine() = default;
+
+    // Выбранный движок. Переключение действует на последующие операции;
+    // false - движок недоступен в этой сборке, остаётся прежний.
+    static StorageEngine &instance();
+    static StorageEngine &engine(Kind kind);
+    static bool select(Kind kind);
+    static Kind selected();
+    static bool isSupported(Kind kind);
+
+    virtual Kind kind() const = 0;
+
+    // Имена пространств в basePath: id корня (у Directory - и старые каталоги по названию)
+    virtual QStringList workspaces(const QString &basePath) const = 0;
+    virtual bool contains(const QString &workspacePath) const = 0;
+    // Удаляет страницы и иерархию; журнал и история в каталоге пространства остаются
+    virtual bool remove(const QString &workspacePath) = 0;
+
+    virtual bool readIndex(const QString &workspacePath,
+                           QList<WorkspaceContainer::IndexEntry> &index) const = 0;
+    // Дерево целиком в порядке обхода. current = false - данные в старом формате,
+    // страницы стоит переписать при следующем сохранении.
+    virtual bool readPages(const QString &workspacePath, QList<PageRecord> &pages,
+                           bool *current = nullptr) const = 0;
+    virtual bool readPage(const QString &workspacePath, int pageIndex,
+                          PageRecord &page) const = 0;
+    virtual bool readPage(const QString &workspacePath, const QString &pageId,
+                          QJsonObject &page) const = 0;
+    // Контрольная сумма записанной страницы (WorkspaceDirectory::pageChecksum);
+    // false - сумма неизвестна, страницу нужно прочитать
+    virtual bool readPageChecksum(const QString &workspacePath, const QString &pageId,
+                                  quint32 &checksum) const = 0;
+
+    virtual bool writePage(const QString &workspacePath, const QString &pageId,
+                           const QJsonObject &page) = 0;
+    // Уже закодированная секция (WorkspaceContainer::encodePage)
+    virtual bool writePageSection(const QString &workspacePath, const QString &pageId,
+                                  const QByteArray &section);
+    // Пишет иерархию и удаляет страницы, которых в ней больше нет
+    virtual bool writeIndex(const QString &workspacePath,
+                            const QList<WorkspaceContainer::IndexEntry> &index) = 0;
+
+    // Записи BlobStore (заголовок и данные) по digest
+    virtual bool hasBlob(const QString &digest) const = 0;
+    virtual bool readBlob(const QString &digest, QByteArray &record) const = 0;
+    virtual bool writeBlob(const QString &digest, const QByteArray &record) = 0;
+    // Ключи записей blob и производных "<digest>.<variant>", записанных до writtenBefore.
+    // Движок без времени записи возвращает все ключи.
+    virtual QStringList blobKeys(const QDateTime &writtenBefore) const = 0;
+    virtual bool removeBlob(const QString &key) = 0;
+
+    // Проверка при запуске страниц, которые движок хранит вне файлов пространств
+    // (файлы и все записи blob проверяет StorageVerifier). В damaged - что
+    // не прочитать; false - проверка не удалась. У Directory проверять нечего.
+    virtual bool verify(QStringList &damaged) const;
+};
+
+#endif // STORAGE_ENGINE_H
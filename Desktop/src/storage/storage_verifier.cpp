@@ -0,0 +1,167 @@
+#include "storage_verifier.h"
+#include "blob_store.h"
+#include "crc32c.h"
+#include "workspace_archive.h"
+#include "workspace_directory.h"
+#include "page_locks.h"
+#include "storage_engine.h"
+
+#include <QDateTime>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QThreadPool>
+#include <QDebug>
+#include <functional>
+
+namespace {
+constexpr qsizetype BlobBatch = 256;
+} // namespace
+
+void StorageVerifyReport::merge(const StorageVerifyReport &other)
+{
+    workspaces += other.workspaces;
+    pages += other.pages;
+    blobs += other.blobs;
+    quarantined += other.quarantined;
+    repaired += other.repaired;
+    lost += other.lost;
+}
+
+StorageVerifyReport StorageVerifier::verify(const QString &basePath, bool includeBlobs)
+{
+    QElapsedTimer timer;
+    timer.start();
+
+    StorageVerifyReport report;
+    QMutex reportMutex;
+    QThreadPool pool;
+
+    auto run = [&](const std::function<StorageVerifyReport()> &task) {
+        pool.start([&reportMutex, &report, task]() {
+            const StorageVerifyReport partial = task();
+            QMutexLocker locker(&reportMutex);
+            report.merge(partial);
+        });
+    };
+
+    const QStringList folders = QDir(basePath).entryList(QDir::Dirs | QDir::NoDotAndDotDot);
+    for (const QString &title : folders) {
+        const QString workspacePath = basePath + title + "/";
+        run([workspacePath]() { return verifyWorkspace(workspacePath); });
+    }
+
+    if (StorageEngine::selected() != StorageEngine::Directory) {
+        run([]() {
+            StorageVerifyReport report;
+            StorageEngine::instance().verify(report.lost);
+            return report;
+        });
+    }
+
+    if (includeBlobs && StorageEngine::selected() != StorageEngine::Directory) {
+        // Записи в базе движка и файлы до перехода на него; частями по BlobBatch
+        const QStringList keys = StorageEngine::instance().blobKeys(QDateTime());
+        for (qsizetype i = 0; i < keys.size(); i += BlobBatch) {
+            const QStringList batch = keys.mid(i, BlobBatch);
+            run([batch]() { return verifyBlobKeys(batch); });
+        }
+    } else if (includeBlobs) {
+        // blob разложены по каталогам из двух первых символов digest
+        const QString blobRoot = BlobStore::instance().rootPath();
+        const QStringList prefixes =
+         QDir(blobRoot).entryList(QStringList() << "??", QDir::Dirs | QDir::NoDotAndDotDot);
+        for (const QString &prefix : prefixes) {
+            const QString prefixPath = blobRoot + prefix + "/";
+            run([prefixPath]() { return verifyBlobs(prefixPath); });
+        }
+    }
+
+    pool.waitForDone();
+    report.elapsedMs = timer.elapsed();
+
+    qDebug() << "Storage verified in" << report.elapsedMs << "ms:" << report.workspaces
+             << "workspaces," << report.pages << "pages," << report.blobs << "blobs,"
+             << report.quarantined << "quarantined," << report.repaired << "repaired"
+             << (Crc32c::hardwareAccelerated() ? "(hardware CRC32C)" : "(software CRC32C)");
+    for (const QString &path : std::as_const(report.lost)) qWarning() << "Unrecoverable:" << path;
+    return report;
+}
+
+StorageVerifyReport StorageVerifier::verifyWorkspace(const QString &workspacePath)
+{
+    StorageVerifyReport report;
+    if (WorkspaceArchive::isArchived(workspacePath))
+        return report;
+    if (!QFile::exists(workspacePath + WorkspaceDirectory::ContainerFileName)
+        && !QFile::exists(workspacePath + WorkspaceDirectory::ContainerFileName
+                          + WorkspaceDirectory::PreviousSuffix)) {
+        return report; // старый JSON или не пространство
+    }
+    report.workspaces = 1;
+
+    // Проверка идёт в фоне и может подменять файлы - пространство держим целиком
+    PageLocker locker(workspacePath);
+    const QString containerPath = workspacePath + WorkspaceDirectory::ContainerFileName;
+    if (!WorkspaceDirectory::verifyIndex(workspacePath)) {
+        if (QFile::exists(containerPath))
+            ++report.quarantined;
+        if (!WorkspaceDirectory::repairIndex(workspacePath)) {
+            report.lost << containerPath;
+            return report;
+        }
+        ++report.repaired;
+    }
+
+    QFile container;
+    QList<WorkspaceContainer::IndexEntry> index;
+    quint16 flags = 0;
+    if (!WorkspaceDirectory::openIndex(workspacePath, container, index, &flags)
+        || !(flags & WorkspaceContainer::ExternalPages)) {
+        return report;
+    }
+
+    for (const WorkspaceContainer::IndexEntry &entry : index) {
+        const QString shardPath = WorkspaceDirectory::pageShardPath(workspacePath, entry.id);
+        if (!QFile::exists(shardPath)
+            && !QFile::exists(shardPath + WorkspaceDirectory::PreviousSuffix)) {
+            continue; // страница ещё ни разу не сохранялась
+        }
+        ++report.pages;
+        if (WorkspaceDirectory::verifyPageShard(workspacePath, entry.id))
+            continue;
+
+        if (QFile::exists(shardPath))
+            ++report.quarantined;
+        if (WorkspaceDirectory::repairPageShard(workspacePath, entry.id))
+            ++report.repaired;
+        else
+            report.lost << shardPath;
+    }
+    return report;
+}
+
+StorageVerifyReport StorageVerifier::verifyBlobs(const QString &prefixPath)
+{
+    return verifyBlobKeys(QDir(prefixPath).entryList(QDir::Files));
+}
+
+StorageVerifyReport StorageVerifier::verifyBlobKeys(const QStringList &digests)
+{
+    StorageVerifyReport report;
+    BlobStore &store = BlobStore::instance();
+
+    for (const QString &digest : digests) {
+        ++report.blobs;
+        if (store.verify(digest))
+            continue;
+
+        // У blob нет предыдущей версии: данные вернутся при следующей записи того же содержимого
+        if (store.quarantine(digest))
+            ++report.quarantined;
+        report.lost << store.blobPath(digest);
+    }
+    return report;
+}
@@ -0,0 +1,41 @@
+#ifndef STORAGE_VERIFIER_H
+#define STORAGE_VERIFIER_H
+
+#include <QString>
+#include <QStringList>
+
+struct StorageVerifyReport
+{
+    int workspaces { 0 };
+    int pages { 0 };
+    int blobs { 0 };
+    int quarantined { 0 }; // повреждённые файлы, убранные в quarantine/
+    int repaired { 0 }; // из них заменены предыдущей версией
+    QStringList lost; // восстановить не удалось
+    qint64 elapsedMs { 0 };
+
+    void merge(const StorageVerifyReport &other);
+};
+
+// Быстрая проверка хранилища при запуске: сверяются только контрольные суммы
+// CRC32C контейнеров, шардов и blob, содержимое не разбирается. Пространства
+// и каталоги blob проверяются параллельно. Повреждённый файл убирается
+// в quarantine/ и заменяется предыдущей целой версией, если она есть.
+// Упакованные (холодные) пространства не проверяются до распаковки.
+// Проверяемое пространство блокируется в PageLocks, поэтому проверку можно
+// запускать в фоне параллельно с загрузкой.
+// Движок SQLite проверяет свою базу сам (StorageEngine::verify): непрочитанные
+// страницы попадают в lost, предыдущих версий у строк нет. Записи blob в базе
+// проверяются и убираются в quarantine/ так же, как файлы.
+class StorageVerifier
+{
+public:
+    static StorageVerifyReport verify(const QString &basePath, bool includeBlobs = true);
+
+private:
+    static StorageVerifyReport verifyWorkspace(const QString &workspacePath);
+    static StorageVerifyReport verifyBlobs(const QString &prefixPath);
+    static StorageVerifyReport verifyBlobKeys(const QStringList &digests);
+};
+
+#endif // STORAGE_VERIFIER_H
@@ -0,0 +1,215 @@
+#include "storage_watcher.h"
+#include "storage_engine.h"
+#include "workspace_catalog.h"
+#include "workspace_directory.h"
+
+#include <QDir>
+#include <QFileInfo>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QDebug>
+#include <utility>
+
+namespace {
+// Запись пространства - это несколько переименований подряд, их сводим в одну проверку
+constexpr int DebounceMs = 300;
+
+// Файл -> время изменения после собственной записи
+QMutex ownWritesMutex;
+QHash<QString, QDateTime> ownWrites;
+} // namespace
+
+StorageWatcher::StorageWatcher(QObject *parent) : QObject(parent)
+{
+    _debounce.setSingleShot(true);
+    _debounce.setInterval(DebounceMs);
+    connect(&_debounce, &QTimer::timeout, this, &StorageWatcher::scan);
+    connect(&_watcher, &QFileSystemWatcher::directoryChanged, this,
+            &StorageWatcher::onDirectoryChanged);
+}
+
+void StorageWatcher::setBasePath(const QString &basePath)
+{
+    const QStringList watched = _watcher.directories();
+    if (!watched.isEmpty())
+        _watcher.removePaths(watched);
+    _debounce.stop();
+    _workspaces.clear();
+    _changedDirs.clear();
+    _files.clear();
+
+    _basePath = basePath.isEmpty() ? QString() : QDir::cleanPath(basePath);
+    if (_basePath.isEmpty() || !QFileInfo(_basePath).isDir())
+        return;
+
+    _watcher.addPath(_basePath);
+    _files[_basePath] = listFiles(_basePath, QStringList() << WorkspaceCatalog::FileName);
+    _watchPages = StorageEngine::selected() == StorageEngine::Directory;
+    if (!_watchPages) {
+        // Изменения строк базы не видны как файлы: следим только за каталогом пространств
+        qWarning() << "Changes made outside the app are not picked up with this storage engine";
+        return;
+    }
+    const QStringList folders = QDir(_basePath).entryList(QDir::Dirs | QDir::NoDotAndDotDot);
+    for (const QString &workspaceId : folders) watchWorkspace(workspaceId);
+}
+
+void StorageWatcher::recordOwnWrite(const QString &filePath)
+{
+    const QFileInfo info(filePath);
+    if (!info.exists())
+        return; // движок хранит данные не в файлах
+    QMutexLocker locker(&ownWritesMutex);
+    ownWrites.insert(QDir::cleanPath(filePath), info.lastModified());
+}
+
+void StorageWatcher::recordOwnWrites(const QString &workspacePath, const QStringList &pageIds)
+{
+    for (const QString &pageId : pageIds)
+        recordOwnWrite(WorkspaceDirectory::pageShardPath(workspacePath, pageId));
+    recordOwnWrite(workspacePath + WorkspaceDirectory::ContainerFileName);
+}
+
+bool StorageWatcher::isOwnWrite(const QString &filePath, const QDateTime &modified)
+{
+    QMutexLocker locker(&ownWritesMutex);
+    const auto it = ownWrites.constFind(filePath);
+    if (it == ownWrites.constEnd())
+        return false;
+    const bool own = it.value() == modified;
+    if (!own)
+        ownWrites.erase(it); // файл переписан после нас
+    return own;
+}
+
+void StorageWatcher::onDirectoryChanged(const QString &path)
+{
+    _changedDirs.insert(QDir::cleanPath(path));
+    _debounce.start();
+}
+
+void StorageWatcher::scan()
+{
+    const QSet<QString> changed = std::exchange(_changedDirs, QSet<QString>());
+    const QString pagesDirName = QDir::cleanPath(WorkspaceDirectory::PagesDirName);
+
+    for (const QString &dir : changed) {
+        const QFileInfo info(dir);
+        if (dir == _basePath)
+            scanBase();
+        else if (info.fileName() == pagesDirName)
+            scanPages(QFileInfo(info.path()).fileName());
+        else if (info.path() == _basePath)
+            scanWorkspace(info.fileName());
+    }
+}
+
+void StorageWatcher::watchWorkspace(const QString &workspaceId)
+{
+    _workspaces.insert(workspaceId);
+
+    const QString workspaceDir = _basePath + "/" + workspaceId;
+    _watcher.addPath(workspaceDir);
+    _files[workspaceDir] =
+     listFiles(workspaceDir, QStringList() << WorkspaceDirectory::ContainerFileName);
+
+    const QString pagesDir = QDir::cleanPath(workspaceDir + "/" + WorkspaceDirectory::PagesDirName);
+    if (QFileInfo(pagesDir).isDir()) {
+        _watcher.addPath(pagesDir);
+        _files[pagesDir] =
+         listFiles(pagesDir, QStringList() << QString("*") + WorkspaceDirectory::PageFileSuffix);
+    }
+}
+
+void StorageWatcher::scanBase()
+{
+    const QHash<QString, QDateTime> files =
+     listFiles(_basePath, QStringList() << WorkspaceCatalog::FileName);
+    const QString catalogName = WorkspaceCatalog::FileName;
+    bool changed = files != _files.value(_basePath)
+                   && !isOwnWrite(_basePath + "/" + catalogName, files.value(catalogName));
+    _files[_basePath] = files;
+    if (!_watchPages) {
+        if (changed)
+            emit catalogChanged();
+        return;
+    }
+
+    const QStringList folders = QDir(_basePath).entryList(QDir::Dirs | QDir::NoDotAndDotDot);
+    const QSet<QString> current(folders.cbegin(), folders.cend());
+    if (current == _workspaces) {
+        if (changed)
+            emit catalogChanged();
+        return;
+    }
+
+    for (const QString &workspaceId : current - _workspaces) watchWorkspace(workspaceId);
+    for (const QString &workspaceId : _workspaces - current) {
+        const QString workspaceDir = _basePath + "/" + workspaceId;
+        _files.remove(workspaceDir);
+        _files.remove(QDir::cleanPath(workspaceDir + "/" + WorkspaceDirectory::PagesDirName));
+        _workspaces.remove(workspaceId);
+    }
+    emit catalogChanged();
+}
+
+void StorageWatcher::scanWorkspace(const QString &workspaceId)
+{
+    const QString workspaceDir = _basePath + "/" + workspaceId;
+    if (!_workspaces.contains(workspaceId) || !QFileInfo(workspaceDir).isDir())
+        return;
+
+    // Каталог страниц появляется при первой записи или распаковке архива: начинаем
+    // следить, ничего не сообщая - о новых страницах скажет изменение иерархии
+    const QString pagesDir = QDir::cleanPath(workspaceDir + "/" + WorkspaceDirectory::PagesDirName);
+    if (!_watcher.directories().contains(pagesDir) && QFileInfo(pagesDir).isDir()) {
+        _watcher.addPath(pagesDir);
+        _files[pagesDir] =
+         listFiles(pagesDir, QStringList() << QString("*") + WorkspaceDirectory::PageFileSuffix);
+    }
+
+    QHash<QString, QDateTime> files =
+     listFiles(workspaceDir, QStringList() << WorkspaceDirectory::ContainerFileName);
+    QHash<QString, QDateTime> &known = _files[workspaceDir];
+    const QString container = WorkspaceDirectory::ContainerFileName;
+    // Исчезновение контейнера (упаковка в архив) изменением не считается
+    const bool changed = files.contains(container) && files.value(container) != known.value(container)
+                         && !isOwnWrite(workspaceDir + "/" + container, files.value(container));
+    known = files;
+    if (changed)
+        emit indexChanged(workspaceId);
+}
+
+void StorageWatcher::scanPages(const QString &workspaceId)
+{
+    const QString pagesDir =
+     QDir::cleanPath(_basePath + "/" + workspaceId + "/" + WorkspaceDirectory::PagesDirName);
+    if (!_workspaces.contains(workspaceId) || !_files.contains(pagesDir))
+        return;
+
+    const QHash<QString, QDateTime> files =
+     listFiles(pagesDir, QStringList() << QString("*") + WorkspaceDirectory::PageFileSuffix);
+    QHash<QString, QDateTime> &known = _files[pagesDir];
+
+    QStringList changedPages;
+    for (auto it = files.cbegin(); it != files.cend(); ++it) {
+        if (known.value(it.key()) != it.value()
+            && !isOwnWrite(pagesDir + "/" + it.key(), it.value())) {
+            QString pageId = it.key();
+            pageId.chop(int(sizeof(WorkspaceDirectory::PageFileSuffix) - 1));
+            changedPages << pageId;
+        }
+    }
+    known = files;
+
+    for (const QString &pageId : std::as_const(changedPages)) emit pageChanged(workspaceId, pageId);
+}
+
+QHash<QString, QDateTime> StorageWatcher::listFiles(const QString &dirPath,
+                                                    const QStringList &filters) const
+{
+    QHash<QString, QDateTime> files;
+    const QFileInfoList entries = QDir(dirPath).entryInfoList(filters, QDir::Files);
+    for (const QFileInfo &entry : entries) files.insert(entry.fileName(), entry.lastModified());
+    return files;
+}
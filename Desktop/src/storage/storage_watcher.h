@@ -0,0 +1,62 @@
+#ifndef STORAGE_WATCHER_H
+#define STORAGE_WATCHER_H
+
+#include <QDateTime>
+#include <QFileSystemWatcher>
+#include <QHash>
+#include <QObject>
+#include <QSet>
+#include <QString>
+#include <QTimer>
+
+// Следит за каталогом пространств и сообщает, что именно поменялось на диске:
+// шард страницы, иерархия пространства, набор пространств или их каталог.
+//
+// Все записи хранилища идут через QSaveFile (переименование в каталоге), поэтому
+// наблюдаются каталоги, а изменённые файлы находятся сравнением времени изменения.
+// Собственные записи приложения (сохранение модели из памяти) отмечаются через
+// recordOwnWrite: файл с запомненным временем изменения не сообщается.
+// Пространство в сигналах - имя его каталога (id корня).
+// Если страницы хранит не Directory (SQLite), наблюдается только каталог пространств:
+// pageChanged и indexChanged не приходят, о чём при запуске пишется предупреждение.
+class StorageWatcher : public QObject
+{
+    Q_OBJECT
+public:
+    explicit StorageWatcher(QObject *parent = nullptr);
+
+    // Пустой путь останавливает наблюдение
+    void setBasePath(const QString &basePath);
+
+    // Вызывается после записи файла; потокобезопасно
+    static void recordOwnWrite(const QString &filePath);
+    // Шарды pageIds и иерархия пространства
+    static void recordOwnWrites(const QString &workspacePath, const QStringList &pageIds);
+
+signals:
+    void pageChanged(const QString &workspaceId, const QString &pageId);
+    void indexChanged(const QString &workspaceId);
+    void catalogChanged(); // добавлено или удалено пространство, переписан каталог
+
+private slots:
+    void onDirectoryChanged(const QString &path);
+    void scan();
+
+private:
+    void watchWorkspace(const QString &workspaceId);
+    void scanBase();
+    void scanWorkspace(const QString &workspaceId);
+    void scanPages(const QString &workspaceId);
+    QHash<QString, QDateTime> listFiles(const QString &dirPath, const QStringList &filters) const;
+    static bool isOwnWrite(const QString &filePath, const QDateTime &modified);
+
+    QFileSystemWatcher _watcher;
+    QTimer _debounce;
+    QString _basePath;
+    bool _watchPages { true };
+    QSet<QString> _workspaces;
+    QSet<QString> _changedDirs;
+    QHash<QString, QHash<QString, QDateTime>> _files; // каталог -> файл -> время изменения
+};
+
+#endif // STORAGE_WATCHER_H
@@ -0,0 +1,294 @@
+#include "text_codec.h"
+
+#include <QMutexLocker>
+#include <QDebug>
+
+#include <algorithm>
+#include <iterator>
+
+#if defined(DESKTOP_TEXT_DICTIONARY)
+#include <zlib.h>
+#endif
+
+namespace {
+// Разметка QTextEdit::toHtml() (Qt 6). Частые фрагменты - в конце.
+// Версии словаря не правятся: по ним распаковываются уже сохранённые элементы.
+// Копии - TEXT_DICTIONARIES в backend/api/middleware.py, в том же порядке
+constexpr char HtmlDictionaryV1[] =
+ R"dict(<ol style="margin-top: 0px; margin-bottom: 0px; margin-left: 0px; margin-right: 0px; -qt-list-indent: 1;"><li style=" margin-top:0px; margin-bottom:0px; margin-left:0px; margin-right:0px; -qt-block-indent:0; text-indent:0px;">
+<ul style="margin-top: 0px; margin-bottom: 0px; margin-left: 0px; margin-right: 0px; -qt-list-indent: 1;"><li style=" margin-top:12px; margin-bottom:0px; margin-left:0px; margin-right:0px; -qt-block-indent:0; text-indent:0px;">
+<span style=" font-style:italic;"></span><span style=" font-weight:700;"></span><span style=" text-decoration: underline;"></span></li></ul></ol>
+<body style=" font-family:'Sans Serif'; font-size:9pt; font-weight:400; font-style:normal;">
+<body style=" font-family:'Ubuntu'; font-size:11pt; font-weight:400; font-style:normal;">
+<body style=" font-family:'.AppleSystemUIFont'; font-size:13pt; font-weight:400; font-style:normal;">
+<p style="-qt-paragraph-type:empty; margin-top:0px; margin-bottom:0px; margin-left:0px; margin-right:0px; -qt-block-indent:0; text-indent:0px;"><br /></p>
+<!DOCTYPE HTML PUBLIC "-//W3C//DTD HTML 4.0//EN" "http://www.w3.org/TR/REC-html40/strict.dtd">
+<html><head><meta name="qrichtext" content="1" /><meta charset="utf-8" /><style type="text/css">
+p, li { white-space: pre-wrap; }
+hr { height: 1px; border-width: 0; }
+li.unchecked::marker { content: "\2610"; }
+li.checked::marker { content: "\2612"; }
+</style></head><body style=" font-family:'Segoe UI'; font-size:9pt; font-weight:400; font-style:normal;">
+<p style=" margin-top:0px; margin-bottom:0px; margin-left:0px; margin-right:0px; -qt-block-indent:0; text-indent:0px;"></p></body></html>)dict";
+
+// Новый словарь дописывается в конец и становится текущим, старые остаются
+constexpr const char *HtmlDictionaries[] = { HtmlDictionaryV1 };
+static_assert(std::size(HtmlDictionaries) == size_t(TextCodec::DictionaryVersion),
+              "DictionaryVersion must name the last dictionary");
+
+constexpr int TrainGram = 16;
+constexpr int TrainSegmentLimit = 1024;
+constexpr qsizetype InflateLimit = qsizetype(1) << 28;
+
+// Экранирование строки как в QJsonDocument и json.dumps: только кавычка,
+// обратная косая черта и управляющие символы
+QByteArray escapeJson(const QByteArray &data)
+{
+    QByteArray escaped;
+    escaped.reserve(data.size() + data.size() / 8);
+    for (const char c : data) {
+        switch (c) {
+        case '"': escaped += "\\\""; break;
+        case '\\': escaped += "\\\\"; break;
+        case '\n': escaped += "\\n"; break;
+        case '\r': escaped += "\\r"; break;
+        case '\t': escaped += "\\t"; break;
+        default:
+            if (uchar(c) < 0x20)
+                escaped += "\\u00" + QByteArray::number(uchar(c), 16).rightJustified(2, '0');
+            else
+                escaped += c;
+        }
+    }
+    return escaped;
+}
+
+#if defined(DESKTOP_TEXT_DICTIONARY)
+quint32 adlerOf(const QByteArray &dictionary)
+{
+    return quint32(adler32(adler32(0L, Z_NULL, 0),
+                           reinterpret_cast<const Bytef *>(dictionary.constData()),
+                           uInt(dictionary.size())));
+}
+#endif
+} // namespace
+
+TextCodec &TextCodec::instance()
+{
+    static TextCodec codec;
+    return codec;
+}
+
+TextCodec::TextCodec()
+{
+    for (const char *dictionary : HtmlDictionaries) {
+        _html = dictionary;
+        _json = escapeJson(_html);
+        addDictionary(_html);
+        addDictionary(_json);
+    }
+}
+
+bool TextCodec::isSupported()
+{
+#if defined(DESKTOP_TEXT_DICTIONARY)
+    return true;
+#else
+    return false;
+#endif
+}
+
+QByteArray TextCodec::htmlDictionary() const
+{
+    return _html;
+}
+
+QByteArray TextCodec::jsonDictionary() const
+{
+    return _json;
+}
+
+quint32 TextCodec::addDictionary(const QByteArray &dictionary)
+{
+#if defined(DESKTOP_TEXT_DICTIONARY)
+    const quint32 id = adlerOf(dictionary);
+    QMutexLocker locker(&_mutex);
+    _dictionaries.insert(id, dictionary);
+    return id;
+#else
+    Q_UNUSED(dictionary);
+    return 0;
+#endif
+}
+
+QByteArray TextCodec::compress(const QByteArray &data, const QByteArray &dictionary) const
+{
+    const QByteArray stream = deflate(data, dictionary.isEmpty() ? _html : dictionary);
+    if (stream.isEmpty() || stream.size() + 1 >= data.size())
+        return QByteArray();
+    return char(DeflateMethod) + stream;
+}
+
+bool TextCodec::decompress(const QByteArray &frame, QByteArray &data) const
+{
+    if (frame.isEmpty() || quint8(frame[0]) != DeflateMethod) {
+        qWarning() << "Unknown text compression method";
+        return false;
+    }
+    return inflate(frame.mid(1), data);
+}
+
+QByteArray TextCodec::deflate(const QByteArray &data, const QByteArray &dictionary) const
+{
+#if defined(DESKTOP_TEXT_DICTIONARY)
+    z_stream stream {};
+    if (deflateInit(&stream, Z_BEST_COMPRESSION) != Z_OK)
+        return QByteArray();
+    if (deflateSetDictionary(&stream, reinterpret_cast<const Bytef *>(dictionary.constData()),
+                             uInt(dictionary.size()))
+        != Z_OK) {
+        deflateEnd(&stream);
+        return QByteArray();
+    }
+
+    QByteArray out(qsizetype(deflateBound(&stream, uLong(data.size()))), Qt::Uninitialized);
+    stream.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(data.constData()));
+    stream.avail_in = uInt(data.size());
+    stream.next_out = reinterpret_cast<Bytef *>(out.data());
+    stream.avail_out = uInt(out.size());
+    const int status = ::deflate(&stream, Z_FINISH);
+    out.resize(qsizetype(stream.total_out));
+    deflateEnd(&stream);
+    return status == Z_STREAM_END ? out : QByteArray();
+#else
+    Q_UNUSED(data);
+    Q_UNUSED(dictionary);
+    return QByteArray();
+#endif
+}
+
+bool TextCodec::inflate(const QByteArray &stream, QByteArray &data) const
+{
+#if defined(DESKTOP_TEXT_DICTIONARY)
+    z_stream z {};
+    if (inflateInit(&z) != Z_OK)
+        return false;
+    z.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(stream.constData()));
+    z.avail_in = uInt(stream.size());
+
+    QByteArray out(qMax<qsizetype>(stream.size() * 4, 1024), Qt::Uninitialized);
+    int status = Z_OK;
+    for (;;) {
+        if (qsizetype(z.total_out) == out.size()) {
+            if (out.size() >= InflateLimit) {
+                status = Z_MEM_ERROR;
+                break;
+            }
+            out.resize(out.size() * 2);
+        }
+        z.next_out = reinterpret_cast<Bytef *>(out.data()) + z.total_out;
+        z.avail_out = uInt(out.size() - qsizetype(z.total_out));
+
+        status = ::inflate(&z, Z_NO_FLUSH);
+        if (status == Z_NEED_DICT) {
+            QMutexLocker locker(&_mutex);
+            const QByteArray dictionary = _dictionaries.value(quint32(z.adler));
+            locker.unlock();
+            if (dictionary.isEmpty())
+                break;
+            status = inflateSetDictionary(&z,
+                                          reinterpret_cast<const Bytef *>(dictionary.constData()),
+                                          uInt(dictionary.size()));
+            if (status != Z_OK)
+                break;
+            continue;
+        }
+        // Z_BUF_ERROR при заполненном выходе - нужно больше места
+        if (status == Z_STREAM_END || (status != Z_OK && status != Z_BUF_ERROR))
+            break;
+        if (z.avail_out != 0) {
+            // Вход кончился раньше потока
+            status = Z_DATA_ERROR;
+            break;
+        }
+    }
+    out.resize(qsizetype(z.total_out));
+    inflateEnd(&z);
+
+    if (status != Z_STREAM_END) {
+        qWarning() << "Failed to inflate text:" << (status == Z_NEED_DICT ? "unknown dictionary"
+                                                                            : "corrupted data");
+        return false;
+    }
+    data = out;
+    return true;
+#else
+    Q_UNUSED(stream);
+    Q_UNUSED(data);
+    qWarning() << "Text compression is not supported in this build";
+    return false;
+#endif
+}
+
+QByteArray TextCodec::train(const QList<QByteArray> &samples, int capacity)
+{
+    // Сколько образцов содержат фрагмент и где он встретился первым
+    struct Gram
+    {
+        int count { 0 };
+        int lastSample { -1 };
+        int sample { 0 };
+        int position { 0 };
+        bool taken { false };
+    };
+    QHash<QByteArray, Gram> grams;
+    for (int s = 0; s < samples.size(); ++s) {
+        const QByteArray &sample = samples[s];
+        for (qsizetype i = 0; i + TrainGram <= sample.size(); ++i) {
+            Gram &gram = grams[sample.mid(i, TrainGram)];
+            if (gram.lastSample == s)
+                continue;
+            if (gram.count == 0) {
+                gram.sample = s;
+                gram.position = int(i);
+            }
+            gram.lastSample = s;
+            ++gram.count;
+        }
+    }
+
+    QList<QPair<int, QByteArray>> ranked;
+    for (auto it = grams.cbegin(); it != grams.cend(); ++it) {
+        if (it->count > 1)
+            ranked.append({ it->count, it.key() });
+    }
+    std::stable_sort(ranked.begin(), ranked.end(),
+                     [](const auto &a, const auto &b) { return a.first > b.first; });
+
+    // Фрагмент растёт вправо, пока следующие окна встречаются не реже половины его частоты
+    QList<QByteArray> segments;
+    qsizetype size = 0;
+    for (const auto &[count, key] : ranked) {
+        if (size >= capacity)
+            break;
+        const Gram gram = grams.value(key);
+        if (gram.taken)
+            continue;
+        const QByteArray &sample = samples[gram.sample];
+        qsizetype end = gram.position + TrainGram;
+        while (end < sample.size() && end - gram.position < TrainSegmentLimit
+               && grams.value(sample.mid(end - TrainGram + 1, TrainGram)).count * 2 >= count) {
+            ++end;
+        }
+        const QByteArray segment = sample.mid(gram.position, end - gram.position);
+        for (qsizetype i = 0; i + TrainGram <= segment.size(); ++i)
+            grams[segment.mid(i, TrainGram)].taken = true;
+        segments.append(segment);
+        size += segment.size();
+    }
+
+    QByteArray dictionary;
+    dictionary.reserve(size);
+    for (auto it = segments.crbegin(); it != segments.crend(); ++it) dictionary += *it;
+    return dictionary.right(capacity);
+}
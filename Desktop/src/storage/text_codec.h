@@ -0,0 +1,67 @@
+#ifndef TEXT_CODEC_H
+#define TEXT_CODEC_H
+
+#include <QByteArray>
+#include <QHash>
+#include <QList>
+#include <QMutex>
+
+// Сжатие разметки текстовых элементов (deflate с заранее заданным словарём, zlib).
+// QTextEdit::toHtml() повторяет в каждом элементе DOCTYPE, блок <style> и одинаковые
+// style="..." абзацев; со словарём из этой же разметки маленькая заметка сжимается
+// до ссылок на словарь, без него deflate на сотнях байт почти ничего не выигрывает.
+//
+// Кадр хранилища: quint8 метод | поток zlib. Поток несёт Adler-32 своего словаря (FDICT),
+// по нему decompress находит словарь среди зарегистрированных. Встроенные словари
+// версионируются: сжимаем текущей версией, а все прежние остаются зарегистрированными,
+// поэтому элементы и тела запросов, сжатые старым словарём, по-прежнему читаются.
+// Каждая версия зарегистрирована в двух видах: как есть и с экранированием строки JSON,
+// для тел запросов синхронизации (Content-Encoding: x-text-dictionary; сервер выбирает
+// словарь по тому же Adler-32 из списка версий в api/middleware.py).
+// Обученный train словарь пришлось бы хранить вместе с данными и передавать серверу,
+// поэтому в хранилище и синхронизации используется встроенный: основная часть
+// повторов - служебная разметка QTextEdit, а она от заметок пользователя не зависит.
+// Сборка без zlib (DESKTOP_TEXT_DICTIONARY не определён) хранит текст без сжатия.
+class TextCodec
+{
+public:
+    static constexpr quint8 DeflateMethod = 1;
+    static constexpr char ContentEncoding[] = "x-text-dictionary";
+    // Номер текущего встроенного словаря
+    static constexpr int DictionaryVersion = 1;
+
+    static TextCodec &instance();
+
+    static bool isSupported();
+
+    // Текущая версия встроенного словаря
+    QByteArray htmlDictionary() const;
+    QByteArray jsonDictionary() const;
+
+    // Словарь для распаковки (например, обученный train); возвращает его Adler-32
+    quint32 addDictionary(const QByteArray &dictionary);
+
+    // Пустой результат - сжатие не выигрывает, хранить как есть.
+    // Пустой dictionary - встроенный словарь разметки
+    QByteArray compress(const QByteArray &data,
+                        const QByteArray &dictionary = QByteArray()) const;
+    bool decompress(const QByteArray &frame, QByteArray &data) const;
+
+    // Поток zlib без кадра - тело запроса с ContentEncoding
+    QByteArray deflate(const QByteArray &data, const QByteArray &dictionary) const;
+    bool inflate(const QByteArray &stream, QByteArray &data) const;
+
+    // Словарь из повторяющихся фрагментов образцов, самые частые - в конце
+    // (deflate дешевле кодирует близкие расстояния)
+    static QByteArray train(const QList<QByteArray> &samples, int capacity = 16 * 1024);
+
+private:
+    TextCodec();
+
+    mutable QMutex _mutex;
+    QHash<quint32, QByteArray> _dictionaries;
+    QByteArray _html;
+    QByteArray _json;
+};
+
+#endif // TEXT_CODEC_H
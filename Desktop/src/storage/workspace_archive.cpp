@@ -0,0 +1,181 @@
+#include "workspace_archive.h"
+#include "workspace_directory.h"
+#include "workspace_journal.h"
+#include "page_locks.h"
+
+#include <QDataStream>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QMutexLocker>
+#include <QSaveFile>
+#include <QDebug>
+
+namespace {
+constexpr QDataStream::Version StreamVersion = QDataStream::Qt_5_12;
+} // namespace
+
+QMutex &WorkspaceArchive::mutex()
+{
+    static QMutex archiveMutex;
+    return archiveMutex;
+}
+
+bool WorkspaceArchive::isArchived(const QString &workspacePath)
+{
+    return QFile::exists(workspacePath + ArchiveFileName);
+}
+
+void WorkspaceArchive::touch(const QString &workspacePath)
+{
+    QSaveFile file(workspacePath + AccessStampFileName);
+    if (file.open(QIODevice::WriteOnly)) {
+        file.write(QDateTime::currentDateTimeUtc().toString(Qt::ISODate).toLatin1());
+        file.commit();
+    }
+}
+
+QDateTime WorkspaceArchive::lastAccess(const QString &workspacePath)
+{
+    QFile stamp(workspacePath + AccessStampFileName);
+    if (stamp.open(QIODevice::ReadOnly)) {
+        const QDateTime time = QDateTime::fromString(QString::fromLatin1(stamp.readAll()),
+                                                     Qt::ISODate);
+        if (time.isValid())
+            return time;
+    }
+
+    // Пространства, созданные до появления отметки, судим по последней записи
+    const QFileInfo container(workspacePath + WorkspaceDirectory::ContainerFileName);
+    if (container.exists())
+        return container.lastModified();
+    return QFileInfo(workspacePath).lastModified();
+}
+
+bool WorkspaceArchive::archive(const QString &workspacePath, const QDateTime &notUsedSince,
+                               int compressionLevel)
+{
+    PageLocker pageLocker(workspacePath);
+    QMutexLocker locker(&mutex());
+
+    // Условия перепроверяются под блокировкой: пространство могли открыть,
+    // пока задача добиралась до него
+    if (isArchived(workspacePath) || lastAccess(workspacePath) > notUsedSince)
+        return false;
+    if (!WorkspaceJournal(workspacePath + WorkspaceDirectory::JournalFileName).isEmpty())
+        return false;
+    if (!QFile::exists(workspacePath + WorkspaceDirectory::ContainerFileName))
+        return false;
+
+    QStringList files;
+    files << WorkspaceDirectory::ContainerFileName;
+    const QStringList shards = QDir(workspacePath + WorkspaceDirectory::PagesDirName)
+                                .entryList(QStringList() << QString("*")
+                                            + WorkspaceDirectory::PageFileSuffix,
+                                           QDir::Files);
+    for (const QString &shard : shards) files << WorkspaceDirectory::PagesDirName + shard;
+
+    QSaveFile archiveFile(workspacePath + ArchiveFileName);
+    if (!archiveFile.open(QIODevice::WriteOnly)) {
+        qWarning() << "Failed to open archive for writing:" << archiveFile.errorString();
+        return false;
+    }
+
+    QDataStream out(&archiveFile);
+    out.setVersion(StreamVersion);
+    out << quint32(Magic) << quint16(FormatVersion) << quint32(files.size());
+    for (const QString &relativePath : files) {
+        QFile file(workspacePath + relativePath);
+        if (!file.open(QIODevice::ReadOnly)) {
+            archiveFile.cancelWriting();
+            return false;
+        }
+        out << relativePath << qCompress(file.readAll(), compressionLevel);
+    }
+    if (out.status() != QDataStream::Ok || !archiveFile.commit()) {
+        qWarning() << "Failed to write archive:" << archiveFile.errorString();
+        return false;
+    }
+
+    // Архив записан целиком - исходные файлы больше не нужны,
+    // вместе с предыдущими версиями файлов
+    QFile::remove(workspacePath + WorkspaceDirectory::ContainerFileName);
+    QFile::remove(workspacePath + WorkspaceDirectory::ContainerFileName
+                  + WorkspaceDirectory::PreviousSuffix);
+    QDir(workspacePath + WorkspaceDirectory::PagesDirName).removeRecursively();
+    qDebug() << "Archived cold workspace" << workspacePath;
+    return true;
+}
+
+bool WorkspaceArchive::read(const QString &workspacePath, QHash<QString, QByteArray> &files,
+                            const QStringList &only)
+{
+    QMutexLocker locker(&mutex());
+    return readLocked(workspacePath, files, only);
+}
+
+bool WorkspaceArchive::readLocked(const QString &workspacePath,
+                                  QHash<QString, QByteArray> &files, const QStringList &only)
+{
+    QFile archiveFile(workspacePath + ArchiveFileName);
+    if (!archiveFile.open(QIODevice::ReadOnly)) {
+        qWarning() << "Failed to open archive for reading:" << archiveFile.errorString();
+        return false;
+    }
+
+    QDataStream in(&archiveFile);
+    in.setVersion(StreamVersion);
+
+    quint32 magic = 0;
+    quint16 version = 0;
+    quint32 count = 0;
+    in >> magic >> version >> count;
+    if (in.status() != QDataStream::Ok || magic != Magic || version == 0
+        || version > FormatVersion) {
+        qWarning() << "Invalid workspace archive:" << archiveFile.fileName();
+        return false;
+    }
+
+    files.clear();
+    for (quint32 i = 0; i < count; ++i) {
+        QString relativePath;
+        QByteArray compressed;
+        in >> relativePath >> compressed;
+        if (in.status() != QDataStream::Ok || relativePath.contains(".."))
+            return false;
+        if (!only.isEmpty() && !only.contains(relativePath))
+            continue;
+
+        const QByteArray data = qUncompress(compressed);
+        if (data.isEmpty() && !compressed.isEmpty()) {
+            qWarning() << "Damaged entry" << relativePath << "in archive" << archiveFile.fileName();
+            return false;
+        }
+        files.insert(relativePath, data);
+        if (!only.isEmpty() && files.size() == only.size())
+            break;
+    }
+    return true;
+}
+
+bool WorkspaceArchive::restore(const QString &workspacePath)
+{
+    QMutexLocker locker(&mutex());
+
+    if (!isArchived(workspacePath))
+        return true;
+    QHash<QString, QByteArray> files;
+    if (!readLocked(workspacePath, files, QStringList()))
+        return false;
+
+    QDir().mkpath(workspacePath + WorkspaceDirectory::PagesDirName);
+    for (auto it = files.constBegin(); it != files.constEnd(); ++it) {
+        QSaveFile file(workspacePath + it.key());
+        if (!file.open(QIODevice::WriteOnly) || file.write(it.value()) != it.value().size()
+            || !file.commit()) {
+            qWarning() << "Failed to restore" << it.key() << "from archive";
+            return false;
+        }
+    }
+    return QFile::remove(workspacePath + ArchiveFileName);
+}
@@ -0,0 +1,49 @@
+#ifndef WORKSPACE_ARCHIVE_H
+#define WORKSPACE_ARCHIVE_H
+
+#include <QByteArray>
+#include <QDateTime>
+#include <QHash>
+#include <QMutex>
+#include <QString>
+#include <QStringList>
+
+// Холодный уровень хранения: давно не открывавшееся пространство упаковывается
+// в один сжатый файл workspace.mnz, шарды и индекс удаляются.
+//
+// Формат (QDataStream): magic "MNWZ" | quint16 version | quint32 count |
+//   count x (QString relativePath, QByteArray qCompress(data))
+//
+// Чтение метаданных и страниц (каталог, синхронизация) идёт из архива в памяти,
+// на диск пространство распаковывается только при открытии. Упаковка и распаковка
+// одного пространства взаимно исключены, поэтому фоновая упаковка безопасна
+// относительно открытия пространства пользователем.
+class WorkspaceArchive
+{
+public:
+    static constexpr quint32 Magic = 0x4D4E575A; // "MNWZ"
+    static constexpr quint16 FormatVersion = 1;
+    static constexpr char ArchiveFileName[] = "workspace.mnz";
+    static constexpr char AccessStampFileName[] = "last_opened";
+
+    static bool isArchived(const QString &workspacePath);
+
+    // Упаковывает, если пространство не открывалось с notUsedSince и журнал пуст
+    static bool archive(const QString &workspacePath, const QDateTime &notUsedSince,
+                        int compressionLevel = 9);
+    static bool restore(const QString &workspacePath);
+    // Содержимое упакованных файлов по относительному пути, без распаковки на диск.
+    // only - читать только эти файлы; пустой - все.
+    static bool read(const QString &workspacePath, QHash<QString, QByteArray> &files,
+                     const QStringList &only = QStringList());
+
+    static void touch(const QString &workspacePath);
+    static QDateTime lastAccess(const QString &workspacePath);
+
+private:
+    static QMutex &mutex();
+    static bool readLocked(const QString &workspacePath, QHash<QString, QByteArray> &files,
+                           const QStringList &only);
+};
+
+#endif // WORKSPACE_ARCHIVE_H
@@ -0,0 +1,254 @@
+#include "workspace_bundle.h"
+#include "blob_store.h"
+#include "crc32c.h"
+
+#include <QDataStream>
+#include <QMutexLocker>
+#include <QSaveFile>
+#include <QSet>
+#include <QDebug>
+
+namespace {
+constexpr QDataStream::Version StreamVersion = QDataStream::Qt_5_12;
+constexpr qint64 HeaderSize = 4 + 2 + 2;
+
+// Иконка страницы и изображения элементов
+QStringList blobsOf(const QJsonObject &page)
+{
+    QStringList digests;
+    if (!page["iconDigest"].toString().isEmpty())
+        digests.append(page["iconDigest"].toString());
+    for (const QJsonValue &value : page["elements"].toArray()) {
+        const QString digest = value.toObject()["imageDigest"].toString();
+        if (!digest.isEmpty())
+            digests.append(digest);
+    }
+    return digests;
+}
+} // namespace
+
+bool WorkspaceBundle::write(const QString &filePath, qint32 pageCount,
+                            const std::function<void(qint32 i, PageRecord &page)> &pageAt)
+{
+    QSaveFile file(filePath);
+    if (!file.open(QIODevice::WriteOnly)) {
+        qWarning() << "Failed to open workspace file for writing:" << file.errorString();
+        return false;
+    }
+
+    QDataStream out(&file);
+    out.setVersion(StreamVersion);
+    out << quint32(Magic) << quint16(FormatVersion) << quint16(0);
+
+    auto writeSection = [&file](const QByteArray &data, quint64 &offset, quint64 &size,
+                                quint32 &checksum) {
+        offset = quint64(file.pos());
+        size = quint64(data.size());
+        checksum = Crc32c::checksum(data);
+        return file.write(data) == data.size();
+    };
+
+    // Секции пишутся по одной: в памяти только текущая страница или blob
+    QList<PageEntry> pageIndex;
+    QStringList digests;
+    QSet<QString> seen;
+    pageIndex.reserve(pageCount);
+    for (qint32 i = 0; i < pageCount; ++i) {
+        PageRecord record;
+        pageAt(i, record);
+        PageEntry entry;
+        entry.parent = record.parent;
+        entry.id = record.page["id"].toString();
+        entry.title = record.page["title"].toString();
+        entry.iconDigest = record.page["iconDigest"].toString();
+        entry.status = record.page["status"].toString();
+        entry.createdAt = record.page["created_at"].toString();
+        entry.itemCount = qint32(record.page["elements"].toArray().size());
+        if (!writeSection(WorkspaceContainer::encodePage(record.page), entry.offset, entry.size,
+                          entry.checksum)) {
+            qWarning() << "Failed to write workspace file:" << file.errorString();
+            file.cancelWriting();
+            return false;
+        }
+        pageIndex.append(entry);
+
+        for (const QString &digest : blobsOf(record.page)) {
+            if (!seen.contains(digest)) {
+                seen.insert(digest);
+                digests.append(digest);
+            }
+        }
+    }
+
+    QList<BlobEntry> blobIndex;
+    blobIndex.reserve(digests.size());
+    for (const QString &digest : std::as_const(digests)) {
+        const QByteArray data = BlobStore::instance().get(digest);
+        if (data.isEmpty()) {
+            qWarning() << "Blob is missing, not written to workspace file:" << digest;
+            continue;
+        }
+        BlobEntry entry;
+        entry.digest = digest;
+        if (!writeSection(data, entry.offset, entry.size, entry.checksum)) {
+            qWarning() << "Failed to write workspace file:" << file.errorString();
+            file.cancelWriting();
+            return false;
+        }
+        blobIndex.append(entry);
+    }
+
+    const quint64 indexOffset = quint64(file.pos());
+    QByteArray index;
+    QDataStream indexOut(&index, QIODevice::WriteOnly);
+    indexOut.setVersion(StreamVersion);
+    indexOut << quint32(pageIndex.size());
+    for (const PageEntry &entry : std::as_const(pageIndex)) {
+        indexOut << entry.parent << entry.id << entry.title << entry.iconDigest << entry.status
+                 << entry.createdAt << entry.itemCount << entry.offset << entry.size
+                 << entry.checksum;
+    }
+    indexOut << quint32(blobIndex.size());
+    for (const BlobEntry &entry : std::as_const(blobIndex))
+        indexOut << entry.digest << entry.offset << entry.size << entry.checksum;
+
+    out.writeRawData(index.constData(), int(index.size()));
+    out << indexOffset << Crc32c::checksum(index) << quint32(Magic);
+    if (out.status() != QDataStream::Ok || !file.commit()) {
+        qWarning() << "Failed to write workspace file:" << file.errorString();
+        return false;
+    }
+    return true;
+}
+
+bool WorkspaceBundle::open(const QString &filePath, OpenMode mode)
+{
+    close();
+    _file.setFileName(filePath);
+    if (!_file.open(QIODevice::ReadOnly)) {
+        qWarning() << "Failed to open workspace file:" << _file.errorString();
+        return false;
+    }
+    if (_file.size() < HeaderSize + TrailerSize)
+        return false;
+
+    QDataStream in(&_file);
+    in.setVersion(StreamVersion);
+
+    quint32 magic = 0;
+    quint16 version = 0;
+    quint16 flags = 0;
+    in >> magic >> version >> flags;
+    if (magic != Magic || version == 0 || version > FormatVersion) {
+        qWarning() << "Not a workspace file:" << filePath;
+        return false;
+    }
+
+    quint64 indexOffset = 0;
+    quint32 checksum = 0;
+    _file.seek(_file.size() - TrailerSize);
+    in >> indexOffset >> checksum >> magic;
+    if (in.status() != QDataStream::Ok || magic != Magic || indexOffset < quint64(HeaderSize)
+        || indexOffset > quint64(_file.size() - TrailerSize)) {
+        qWarning() << "Workspace file is truncated:" << filePath;
+        return false;
+    }
+
+    // Индекс читается целиком: его размер зависит только от числа страниц и blob
+    _file.seek(qint64(indexOffset));
+    const QByteArray index = _file.read(_file.size() - TrailerSize - qint64(indexOffset));
+    if (Crc32c::checksum(index) != checksum) {
+        qWarning() << "Workspace file index checksum mismatch:" << filePath;
+        return false;
+    }
+
+    QDataStream indexIn(index);
+    indexIn.setVersion(StreamVersion);
+    quint32 count = 0;
+    indexIn >> count;
+    for (quint32 i = 0; i < count && indexIn.status() == QDataStream::Ok; ++i) {
+        PageEntry entry;
+        indexIn >> entry.parent >> entry.id >> entry.title >> entry.iconDigest >> entry.status
+         >> entry.createdAt >> entry.itemCount >> entry.offset >> entry.size >> entry.checksum;
+        _pages.append(entry);
+    }
+    indexIn >> count;
+    for (quint32 i = 0; i < count && indexIn.status() == QDataStream::Ok; ++i) {
+        BlobEntry entry;
+        indexIn >> entry.digest >> entry.offset >> entry.size >> entry.checksum;
+        _blobs.append(entry);
+    }
+    if (indexIn.status() != QDataStream::Ok) {
+        close();
+        return false;
+    }
+
+    if (mode == Mapped) {
+        _mapped = _file.map(0, _file.size());
+        if (!_mapped)
+            qWarning() << "Failed to map workspace file, reading sections instead:" << filePath;
+    }
+    return true;
+}
+
+void WorkspaceBundle::close()
+{
+    if (_mapped) {
+        _file.unmap(const_cast<uchar *>(_mapped));
+        _mapped = nullptr;
+    }
+    _file.close();
+    _pages.clear();
+    _blobs.clear();
+}
+
+const QList<WorkspaceBundle::PageEntry> &WorkspaceBundle::pages() const
+{
+    return _pages;
+}
+
+const QList<WorkspaceBundle::BlobEntry> &WorkspaceBundle::blobs() const
+{
+    return _blobs;
+}
+
+bool WorkspaceBundle::readPageSection(int index, QByteArray &section)
+{
+    if (index < 0 || index >= _pages.size())
+        return false;
+    const PageEntry &entry = _pages[index];
+    return readSection(entry.offset, entry.size, entry.checksum, section);
+}
+
+bool WorkspaceBundle::readPage(int index, QJsonObject &page)
+{
+    QByteArray section;
+    return readPageSection(index, section) && WorkspaceContainer::decodePage(section, page);
+}
+
+bool WorkspaceBundle::readBlob(const BlobEntry &entry, QByteArray &data)
+{
+    return readSection(entry.offset, entry.size, entry.checksum, data);
+}
+
+bool WorkspaceBundle::readSection(quint64 offset, quint64 size, quint32 checksum,
+                                  QByteArray &data)
+{
+    if (!_file.isOpen() || offset + size > quint64(_file.size()))
+        return false;
+
+    if (_mapped) {
+        data = QByteArray::fromRawData(reinterpret_cast<const char *>(_mapped + offset),
+                                       qsizetype(size));
+    } else {
+        QMutexLocker locker(&_readMutex);
+        if (!_file.seek(qint64(offset)))
+            return false;
+        data = _file.read(qint64(size));
+    }
+    if (quint64(data.size()) != size || Crc32c::checksum(data) != checksum) {
+        qWarning() << "Workspace file section is damaged at offset" << offset;
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,96 @@
+#ifndef WORKSPACE_BUNDLE_H
+#define WORKSPACE_BUNDLE_H
+
+#include "workspace_container.h"
+
+#include <QFile>
+#include <QList>
+#include <QMutex>
+#include <QString>
+#include <functional>
+
+// Переносимый файл пространства (*.workspace): дерево страниц, элементы и blob в одном файле.
+//
+// Формат (все числа big-endian, QDataStream):
+//   header:  magic "MNWB" | quint16 version | quint16 flags
+//   секции:  страницы (WorkspaceContainer::encodePage) и blob (исходные данные) подряд
+//   index:   quint32 pageCount | pageCount x (qint32 parent, QString id, QString title,
+//              QString iconDigest, QString status, QString createdAt, qint32 itemCount,
+//              quint64 offset, quint64 size, quint32 CRC32C)
+//            quint32 blobCount | blobCount x (QString digest, quint64 offset, quint64 size,
+//              quint32 CRC32C)
+//   trailer: quint64 indexOffset | quint32 CRC32C индекса | magic "MNWB"
+//
+// Индекс в конце: запись идёт потоком (blob читаются из BlobStore по одному),
+// а чтение начинается с трейлера - дерево известно сразу, страницы и blob
+// читаются по смещению только когда нужны.
+//
+// В режиме Mapped файл отображается в память только для чтения: секции возвращаются
+// как представления отображённой области без копирования (действительны, пока файл
+// открыт), и в памяти процесса оказываются только прочитанные страницы файла.
+// Чтение секций можно вызывать из разных потоков: без отображения seek и read
+// общего QFile идут под мьютексом.
+class WorkspaceBundle
+{
+public:
+    static constexpr quint32 Magic = 0x4D4E5742; // "MNWB"
+    static constexpr quint16 FormatVersion = 1;
+    static constexpr qint64 TrailerSize = 8 + 4 + 4;
+    static constexpr char FileSuffix[] = "workspace";
+
+    enum OpenMode
+    {
+        Buffered, // секции читаются в память (импорт)
+        Mapped // секции - представления отображённого файла (просмотр)
+    };
+
+    struct PageEntry
+    {
+        qint32 parent { -1 };
+        QString id;
+        QString title;
+        QString iconDigest;
+        QString status;
+        QString createdAt;
+        qint32 itemCount { 0 };
+        quint64 offset { 0 };
+        quint64 size { 0 };
+        quint32 checksum { 0 };
+    };
+
+    struct BlobEntry
+    {
+        QString digest;
+        quint64 offset { 0 };
+        quint64 size { 0 };
+        quint32 checksum { 0 };
+    };
+
+    // Страницы в порядке обхода дерева; blob, на которые они ссылаются, берутся из BlobStore.
+    // Страница i запрашивается у pageAt прямо перед записью: в памяти одновременно
+    // только одна страница
+    static bool write(const QString &filePath, qint32 pageCount,
+                      const std::function<void(qint32 i, PageRecord &page)> &pageAt);
+
+    bool open(const QString &filePath, OpenMode mode = Buffered);
+    void close();
+
+    const QList<PageEntry> &pages() const;
+    const QList<BlobEntry> &blobs() const;
+
+    // Секция страницы как есть, без разбора (копирование в шард)
+    bool readPageSection(int index, QByteArray &section);
+    bool readPage(int index, QJsonObject &page);
+    bool readBlob(const BlobEntry &entry, QByteArray &data);
+
+private:
+    bool readSection(quint64 offset, quint64 size, quint32 checksum, QByteArray &data);
+
+    QFile _file;
+    QMutex _readMutex; // seek + read по _file
+    const uchar *_mapped { nullptr };
+    QList<PageEntry> _pages;
+    QList<BlobEntry> _blobs;
+};
+
+#endif // WORKSPACE_BUNDLE_H
@@ -0,0 +1,127 @@
+#include "workspace_catalog.h"
+
+#include <QDataStream>
+
+namespace {
+constexpr QDataStream::Version StreamVersion = QDataStream::Qt_5_12;
+} // namespace
+
+bool WorkspaceCatalog::read(QIODevice *device, QList<CatalogEntry> &entries)
+{
+    if (!device || !device->isOpen())
+        return false;
+
+    QDataStream in(device);
+    in.setVersion(StreamVersion);
+
+    quint32 magic = 0;
+    quint16 version = 0;
+    quint32 count = 0;
+    in >> magic >> version >> count;
+    if (in.status() != QDataStream::Ok || magic != Magic || version == 0
+        || version > FormatVersion) {
+        return false;
+    }
+
+    QList<CatalogEntry> result;
+    for (quint32 i = 0; i < count; ++i) {
+        CatalogEntry entry;
+        in >> entry.workspace >> entry.parent >> entry.id >> entry.title >> entry.iconDigest
+         >> entry.status >> entry.createdAt >> entry.itemCount;
+        if (in.status() != QDataStream::Ok)
+            return false;
+        result.append(entry);
+    }
+
+    entries = result;
+    return true;
+}
+
+bool WorkspaceCatalog::write(QIODevice *device, const QList<CatalogEntry> &entries)
+{
+    if (!device || !device->isOpen())
+        return false;
+
+    QDataStream out(device);
+    out.setVersion(StreamVersion);
+    out << quint32(Magic) << quint16(FormatVersion) << quint32(entries.size());
+    for (const CatalogEntry &entry : entries) {
+        out << entry.workspace << entry.parent << entry.id << entry.title << entry.iconDigest
+            << entry.status << entry.createdAt << entry.itemCount;
+    }
+    return out.status() == QDataStream::Ok;
+}
+
+QList<CatalogEntry> WorkspaceCatalog::fromPages(const QString &workspace,
+                                                const QList<PageRecord> &pages)
+{
+    QList<CatalogEntry> entries;
+    entries.reserve(pages.size());
+    for (const PageRecord &record : pages) {
+        CatalogEntry entry;
+        entry.workspace = workspace;
+        entry.parent = record.parent;
+        entry.id = record.page["id"].toString();
+        entry.title = record.page["title"].toString();
+        entry.iconDigest = record.page["iconDigest"].toString();
+        entry.status = record.page["status"].toString();
+        entry.createdAt = record.page["created_at"].toString();
+        entry.itemCount = qint32(record.page["elements"].toArray().size());
+        entries.append(entry);
+    }
+    return entries;
+}
+
+namespace {
+// Страницы пространства - корень и следующие за ним до следующего корня
+void rangeOf(const QList<CatalogEntry> &catalog, const QString &rootId, qsizetype &begin,
+             qsizetype &end)
+{
+    begin = catalog.size();
+    for (qsizetype i = 0; i < catalog.size(); ++i) {
+        if (catalog[i].parent < 0 && catalog[i].id == rootId) {
+            begin = i;
+            break;
+        }
+    }
+    end = begin < catalog.size() ? begin + 1 : begin;
+    while (end < catalog.size() && catalog[end].parent >= 0) ++end;
+}
+} // namespace
+
+void WorkspaceCatalog::replaceWorkspace(QList<CatalogEntry> &catalog, const QString &rootId,
+                                        const QList<CatalogEntry> &entries)
+{
+    qsizetype begin = 0;
+    qsizetype end = 0;
+    rangeOf(catalog, rootId, begin, end);
+    catalog.remove(begin, end - begin);
+    for (qsizetype i = 0; i < entries.size(); ++i) catalog.insert(begin + i, entries[i]);
+}
+
+QList<CatalogEntry> WorkspaceCatalog::entriesOf(const QList<CatalogEntry> &catalog,
+                                                const QString &rootId)
+{
+    qsizetype begin = 0;
+    qsizetype end = 0;
+    rangeOf(catalog, rootId, begin, end);
+    return catalog.mid(begin, end - begin);
+}
+
+QString WorkspaceCatalog::workspaceOf(const QList<CatalogEntry> &catalog, const QString &rootId)
+{
+    for (const CatalogEntry &entry : catalog) {
+        if (entry.parent < 0 && entry.id == rootId)
+            return entry.workspace;
+    }
+    return QString();
+}
+
+QString WorkspaceCatalog::rootIdOf(const QList<CatalogEntry> &catalog, const QString &workspace)
+{
+    for (const CatalogEntry &entry : catalog) {
+        if (entry.parent < 0 && entry.workspace == workspace)
+            return entry.id;
+    }
+    return QString();
+}
@@ -0,0 +1,62 @@
+#ifndef WORKSPACE_CATALOG_H
+#define WORKSPACE_CATALOG_H
+
+#include "workspace_container.h"
+
+#include <QIODevice>
+#include <QList>
+#include <QString>
+
+// Одна страница в каталоге: всё, что нужно боковой панели, без элементов
+struct CatalogEntry
+{
+    QString workspace; // название пространства (заголовок корня); каталог на диске - id корня
+    qint32 parent { -1 }; // индекс родителя среди страниц того же пространства
+    QString id;
+    QString title;
+    QString iconDigest;
+    QString status;
+    QString createdAt;
+    qint32 itemCount { 0 };
+
+    bool operator==(const CatalogEntry &other) const
+    {
+        return workspace == other.workspace && parent == other.parent && id == other.id
+               && title == other.title && iconDigest == other.iconDigest
+               && status == other.status && createdAt == other.createdAt
+               && itemCount == other.itemCount;
+    }
+};
+
+// Каталог всех пространств пользователя (или гостя) в одном небольшом файле.
+//
+// Формат (QDataStream): magic "MNCA" | quint16 version | quint32 count |
+//   count x (workspace, parent, id, title, iconDigest, status, createdAt, itemCount)
+//
+// Страницы одного пространства идут подряд в порядке обхода дерева,
+// поэтому дерево строится за один проход без чтения самих пространств.
+class WorkspaceCatalog
+{
+public:
+    static constexpr quint32 Magic = 0x4D4E4341; // "MNCA"
+    static constexpr quint16 FormatVersion = 1;
+    static constexpr char FileName[] = "catalog.mnc";
+
+    static bool read(QIODevice *device, QList<CatalogEntry> &entries);
+    static bool write(QIODevice *device, const QList<CatalogEntry> &entries);
+
+    static QList<CatalogEntry> fromPages(const QString &workspace, const QList<PageRecord> &pages);
+
+    // Пространства различаются по id корня: названия могут совпадать.
+    // Заменяет страницы пространства на месте, сохраняя порядок пространств
+    static void replaceWorkspace(QList<CatalogEntry> &catalog, const QString &rootId,
+                                 const QList<CatalogEntry> &entries);
+    static QList<CatalogEntry> entriesOf(const QList<CatalogEntry> &catalog,
+                                         const QString &rootId);
+    // Название пространства по id корневой страницы; пусто, если такого нет
+    static QString workspaceOf(const QList<CatalogEntry> &catalog, const QString &rootId);
+    // id корня первого пространства с таким названием; пусто, если такого нет
+    static QString rootIdOf(const QList<CatalogEntry> &catalog, const QString &workspace);
+};
+
+#endif // WORKSPACE_CATALOG_H
@@ -0,0 +1,386 @@
+#include "workspace_container.h"
+#include "json_pull_reader.h"
+#include "crc32c.h"
+#include "text_codec.h"
+
+#include <QDataStream>
+#include <QCborMap>
+#include <QCborValue>
+#include <QtEndian>
+#include <functional>
+#include <QDebug>
+
+namespace {
+constexpr QDataStream::Version StreamVersion = QDataStream::Qt_5_12;
+constexpr qint64 HeaderSize = 4 + 2 + 2;
+} // namespace
+
+bool WorkspaceContainer::isContainer(QIODevice *device)
+{
+    if (!device || !device->isOpen())
+        return false;
+    const QByteArray head = device->peek(4);
+    return head.size() == 4 && qFromBigEndian<quint32>(head.constData()) == Magic;
+}
+
+QByteArray WorkspaceContainer::encodePage(const QJsonObject &page)
+{
+    QByteArray data;
+    QDataStream out(&data, QIODevice::WriteOnly);
+    out.setVersion(StreamVersion);
+
+    QJsonObject meta = page;
+    meta.remove("elements");
+    meta.remove("pages");
+    out << quint32(PageTag) << QCborMap::fromJsonObject(meta).toCborValue().toCbor();
+
+    // Каждый элемент - отдельная секция с типом в открытом виде,
+    // чтобы читатель мог пропустить ненужные элементы без разбора CBOR
+    const QJsonArray elements = page["elements"].toArray();
+    out << quint32(elements.size());
+    for (const QJsonValue &value : elements) {
+        const QJsonObject element = value.toObject();
+        out << element["type"].toString() << encodeElement(element);
+    }
+    return data;
+}
+
+bool WorkspaceContainer::decodePage(const QByteArray &data, QJsonObject &page)
+{
+    QDataStream in(data);
+    in.setVersion(StreamVersion);
+
+    quint32 tag = 0;
+    QByteArray meta;
+    in >> tag >> meta;
+    if (in.status() != QDataStream::Ok || tag != PageTag)
+        return false;
+
+    QCborParserError error;
+    QCborValue metaValue = QCborValue::fromCbor(meta, &error);
+    if (error.error != QCborError::NoError || !metaValue.isMap())
+        return false;
+    page = metaValue.toMap().toJsonObject();
+
+    quint32 count = 0;
+    in >> count;
+    QJsonArray elements;
+    for (quint32 i = 0; i < count && in.status() == QDataStream::Ok; ++i) {
+        QString type;
+        QByteArray payload;
+        in >> type >> payload;
+        // Пропущенный элемент стёрся бы при следующем сохранении - страницу не загружаем
+        QJsonObject element;
+        if (!decodeElement(payload, element)) {
+            qWarning() << "Failed to decode element" << i << "of type" << type;
+            return false;
+        }
+        elements.append(element);
+    }
+    if (in.status() != QDataStream::Ok)
+        return false;
+
+    page["elements"] = elements;
+    return true;
+}
+
+QByteArray WorkspaceContainer::encodeElement(const QJsonObject &element)
+{
+    QCborMap map = QCborMap::fromJsonObject(element);
+    const QJsonValue content = element["content"];
+    if (content.isString()) {
+        const QByteArray frame = TextCodec::instance().compress(content.toString().toUtf8());
+        if (!frame.isEmpty())
+            map[QLatin1String("content")] = QCborValue(frame);
+    }
+    return map.toCborValue().toCbor();
+}
+
+bool WorkspaceContainer::decodeElement(const QByteArray &data, QJsonObject &element)
+{
+    QCborParserError error;
+    const QCborValue value = QCborValue::fromCbor(data, &error);
+    if (error.error != QCborError::NoError || !value.isMap())
+        return false;
+
+    QCborMap map = value.toMap();
+    const QCborValue content = map.value(QLatin1String("content"));
+    if (content.isByteArray()) {
+        QByteArray text;
+        if (!TextCodec::instance().decompress(content.toByteArray(), text))
+            return false;
+        map[QLatin1String("content")] = QString::fromUtf8(text);
+    }
+    element = map.toJsonObject();
+    return true;
+}
+
+namespace {
+void writeIndexTail(QDataStream &out, QIODevice *device,
+                    const QList<WorkspaceContainer::IndexEntry> &index)
+{
+    const quint64 indexOffset = quint64(device->pos());
+
+    // Индекс собирается в буфер, чтобы посчитать его контрольную сумму для трейлера
+    QByteArray data;
+    QDataStream indexOut(&data, QIODevice::WriteOnly);
+    indexOut.setVersion(StreamVersion);
+    indexOut << quint32(index.size());
+    for (const WorkspaceContainer::IndexEntry &entry : index) {
+        indexOut << entry.parent << entry.id << entry.title << entry.offset << entry.size;
+    }
+
+    out.writeRawData(data.constData(), int(data.size()));
+    out << indexOffset << quint32(index.size()) << Crc32c::checksum(data)
+        << quint32(WorkspaceContainer::Magic);
+}
+} // namespace
+
+bool WorkspaceContainer::write(QIODevice *device, const QList<PageRecord> &pages)
+{
+    if (!device || !device->isOpen())
+        return false;
+
+    QDataStream out(device);
+    out.setVersion(StreamVersion);
+    out << quint32(Magic) << quint16(FormatVersion) << quint16(NoFlags);
+
+    QList<IndexEntry> index;
+    index.reserve(pages.size());
+    for (const PageRecord &record : pages) {
+        const QByteArray section = encodePage(record.page);
+
+        IndexEntry entry;
+        entry.parent = record.parent;
+        entry.id = record.page["id"].toString();
+        entry.title = record.page["title"].toString();
+        entry.offset = quint64(device->pos());
+        entry.size = quint64(section.size());
+        if (device->write(section) != section.size())
+            return false;
+        index.append(entry);
+    }
+
+    writeIndexTail(out, device, index);
+    return out.status() == QDataStream::Ok;
+}
+
+bool WorkspaceContainer::writeIndex(QIODevice *device, const QList<IndexEntry> &index,
+                                    quint16 flags)
+{
+    if (!device || !device->isOpen())
+        return false;
+
+    QDataStream out(device);
+    out.setVersion(StreamVersion);
+    out << quint32(Magic) << quint16(FormatVersion) << flags;
+    writeIndexTail(out, device, index);
+    return out.status() == QDataStream::Ok;
+}
+
+bool WorkspaceContainer::readIndex(QIODevice *device, QList<IndexEntry> &index, quint16 *flags)
+{
+    if (!device || !device->isOpen() || device->isSequential())
+        return false;
+    if (device->size() < HeaderSize + LegacyTrailerSize)
+        return false;
+
+    QDataStream in(device);
+    in.setVersion(StreamVersion);
+
+    quint32 magic = 0;
+    quint16 version = 0;
+    quint16 headerFlags = 0;
+    device->seek(0);
+    in >> magic >> version >> headerFlags;
+    if (magic != Magic || version == 0 || version > FormatVersion)
+        return false;
+    if (flags)
+        *flags = headerFlags;
+
+    const qint64 trailerSize = version >= 3 ? TrailerSize : LegacyTrailerSize;
+    quint64 indexOffset = 0;
+    quint32 pageCount = 0;
+    quint32 checksum = 0;
+    device->seek(device->size() - trailerSize);
+    in >> indexOffset >> pageCount;
+    if (version >= 3)
+        in >> checksum;
+    in >> magic;
+    if (in.status() != QDataStream::Ok || magic != Magic)
+        return false;
+    if (indexOffset < quint64(HeaderSize) || indexOffset > quint64(device->size() - trailerSize))
+        return false;
+
+    device->seek(qint64(indexOffset));
+    if (version >= 3) {
+        const QByteArray data = device->peek(device->size() - trailerSize - qint64(indexOffset));
+        if (Crc32c::checksum(data) != checksum) {
+            qWarning() << "Workspace index checksum mismatch";
+            return false;
+        }
+    }
+
+    quint32 count = 0;
+    in >> count;
+    if (count != pageCount)
+        return false;
+
+    index.clear();
+    index.reserve(int(count));
+    for (quint32 i = 0; i < count; ++i) {
+        IndexEntry entry;
+        in >> entry.parent;
+        if (version >= 2)
+            in >> entry.id;
+        in >> entry.title >> entry.offset >> entry.size;
+        if (in.status() != QDataStream::Ok)
+            return false;
+        index.append(entry);
+    }
+    return true;
+}
+
+bool WorkspaceContainer::readPage(QIODevice *device, const IndexEntry &entry, PageRecord &page)
+{
+    if (!device || !device->seek(qint64(entry.offset)))
+        return false;
+
+    const QByteArray section = device->read(qint64(entry.size));
+    if (quint64(section.size()) != entry.size)
+        return false;
+
+    page.parent = entry.parent;
+    return decodePage(section, page.page);
+}
+
+bool WorkspaceContainer::readAll(QIODevice *device, QList<PageRecord> &pages)
+{
+    QList<IndexEntry> index;
+    if (!readIndex(device, index))
+        return false;
+
+    pages.clear();
+    pages.reserve(index.size());
+    for (const IndexEntry &entry : index) {
+        PageRecord record;
+        if (!readPage(device, entry, record))
+            return false;
+        pages.append(record);
+    }
+    return true;
+}
+
+void WorkspaceContainer::flattenJson(const QJsonObject &json, qint32 parent,
+                                     QList<PageRecord> &pages)
+{
+    PageRecord record;
+    record.parent = parent;
+    record.page = json;
+    record.page.remove("pages");
+
+    const qint32 current = qint32(pages.size());
+    pages.append(record);
+
+    const QJsonArray subPages = json["pages"].toArray();
+    for (const QJsonValue &subPage : subPages) {
+        flattenJson(subPage.toObject(), current, pages);
+    }
+}
+
+QList<PageRecord> WorkspaceContainer::fromJson(const QJsonObject &workspaceJson)
+{
+    QList<PageRecord> pages;
+    flattenJson(workspaceJson, -1, pages);
+    return pages;
+}
+
+QJsonObject WorkspaceContainer::toJson(const QList<PageRecord> &pages)
+{
+    if (pages.isEmpty())
+        return QJsonObject();
+
+    QList<QList<int>> children(pages.size());
+    for (int i = 0; i < pages.size(); ++i) {
+        const qint32 parent = pages[i].parent;
+        if (parent >= 0 && parent < i)
+            children[parent].append(i);
+    }
+
+    std::function<QJsonObject(int)> build = [&](int i) {
+        QJsonObject json = pages[i].page;
+        QJsonArray subPages;
+        for (int child : children[i]) subPages.append(build(child));
+        json["pages"] = subPages;
+        return json;
+    };
+    return build(0);
+}
+
+namespace {
+// Текущий токен - начало объекта страницы
+bool readJsonPage(JsonPullReader &reader, qint32 parent, QList<PageRecord> &pages,
+                  const std::function<void(QJsonObject &)> &pageReady)
+{
+    // Место родителя резервируется сразу: "pages" может встретиться раньше
+    // остальных полей, а потомки должны идти в списке после родителя
+    const qint32 current = qint32(pages.size());
+    pages.append(PageRecord { parent, QJsonObject() });
+
+    QJsonObject page;
+    while (reader.next() == JsonPullReader::Name) {
+        const QString name = reader.name();
+        const JsonPullReader::Token token = reader.next();
+
+        if (name == "pages" && token == JsonPullReader::StartArray) {
+            while (reader.next() == JsonPullReader::StartObject) {
+                if (!readJsonPage(reader, current, pages, pageReady))
+                    return false;
+            }
+            if (reader.token() != JsonPullReader::EndArray)
+                return false;
+        } else if (name == "elements" && token == JsonPullReader::StartArray) {
+            // Каждый элемент собирается отдельно и сразу попадает в массив страницы
+            QJsonArray elements;
+            for (JsonPullReader::Token item = reader.next(); item != JsonPullReader::EndArray;
+                 item = reader.next()) {
+                if (item == JsonPullReader::Invalid)
+                    return false;
+                elements.append(reader.readValue());
+            }
+            page["elements"] = elements;
+        } else {
+            page[name] = reader.readValue();
+        }
+
+        if (reader.hasError())
+            return false;
+    }
+    if (reader.token() != JsonPullReader::EndObject)
+        return false;
+
+    if (pageReady)
+        pageReady(page);
+    pages[current].page = page;
+    return true;
+}
+} // namespace
+
+bool WorkspaceContainer::readJson(QIODevice *device, QList<PageRecord> &pages,
+                                  const std::function<void(QJsonObject &page)> &pageReady)
+{
+    if (!device || !device->isOpen())
+        return false;
+
+    JsonPullReader reader(device);
+    QList<PageRecord> result;
+    if (reader.next() != JsonPullReader::StartObject
+        || !readJsonPage(reader, -1, result, pageReady)
+        || reader.next() != JsonPullReader::EndDocument) {
+        qWarning() << "Invalid workspace JSON:" << reader.errorString();
+        return false;
+    }
+
+    pages = result;
+    return true;
+}
@@ -0,0 +1,92 @@
+#ifndef WORKSPACE_CONTAINER_H
+#define WORKSPACE_CONTAINER_H
+
+#include <QIODevice>
+#include <QJsonObject>
+#include <QJsonArray>
+#include <QList>
+#include <QString>
+#include <functional>
+
+// Одна страница дерева пространства в "плоском" виде: метаданные и элементы
+// без вложенных "pages". Иерархия задаётся индексом родителя.
+struct PageRecord
+{
+    qint32 parent { -1 };
+    QJsonObject page;
+    // Содержимое не прочитано (шард и его .prev повреждены): в page только id и
+    // название. Такую страницу нельзя записывать и считать полным списком ссылок
+    bool placeholder { false };
+};
+
+// Бинарный контейнер пространства.
+//
+// Формат (все числа big-endian, QDataStream):
+//   header:  magic "MNWC" | quint16 version | quint16 flags
+//   pages:   для каждой страницы секция "PAGE":
+//              QByteArray meta (CBOR) | quint32 count | count x (QString type, QByteArray CBOR)
+//            строка "content" элемента, если сжатие выигрывает, - байтовая строка CBOR
+//            с кадром TextCodec (разметка QTextEdit со словарём)
+//   index:   quint32 count | count x (qint32 parent, QString id, QString title,
+//                                     quint64 offset, quint64 size)
+//   trailer: quint64 indexOffset | quint32 pageCount | quint32 CRC32C индекса | magic "MNWC"
+//
+// Индекс лежит в конце, поэтому запись идёт потоком без seek, а чтение
+// начинается с трейлера и может перейти сразу к нужной странице.
+// С флагом ExternalPages секций в файле нет: каждая страница лежит в
+// отдельном файле-шарде, а контейнер хранит только иерархию.
+// Версии 1 (без id в индексе) и 2 (без контрольной суммы) читаются для совместимости.
+class WorkspaceContainer
+{
+public:
+    static constexpr quint32 Magic = 0x4D4E5743; // "MNWC"
+    static constexpr quint32 PageTag = 0x50414745; // "PAGE"
+    static constexpr quint16 FormatVersion = 3;
+    static constexpr qint64 TrailerSize = 8 + 4 + 4 + 4;
+    static constexpr qint64 LegacyTrailerSize = 8 + 4 + 4;
+
+    enum Flag : quint16
+    {
+        NoFlags = 0x0,
+        ExternalPages = 0x1
+    };
+
+    struct IndexEntry
+    {
+        qint32 parent { -1 };
+        QString id;
+        QString title;
+        quint64 offset { 0 };
+        quint64 size { 0 };
+    };
+
+    static bool isContainer(QIODevice *device);
+
+    static bool write(QIODevice *device, const QList<PageRecord> &pages);
+    static bool writeIndex(QIODevice *device, const QList<IndexEntry> &index,
+                           quint16 flags = ExternalPages);
+    static bool readIndex(QIODevice *device, QList<IndexEntry> &index, quint16 *flags = nullptr);
+    static bool readPage(QIODevice *device, const IndexEntry &entry, PageRecord &page);
+    static bool readAll(QIODevice *device, QList<PageRecord> &pages);
+
+    // Отдельная секция страницы (используется и внутри контейнера)
+    static QByteArray encodePage(const QJsonObject &page);
+    static bool decodePage(const QByteArray &data, QJsonObject &page);
+    static QByteArray encodeElement(const QJsonObject &element);
+    static bool decodeElement(const QByteArray &data, QJsonObject &element);
+
+    // Преобразование между вложенным JSON (формат backend) и плоским списком страниц
+    static QList<PageRecord> fromJson(const QJsonObject &workspaceJson);
+    static QJsonObject toJson(const QList<PageRecord> &pages);
+
+    // То же, что fromJson, но потоком из устройства, без DOM всего документа.
+    // pageReady получает каждую страницу сразу после разбора (например, чтобы
+    // вынести base64 в хранилище blob до чтения следующих страниц).
+    static bool readJson(QIODevice *device, QList<PageRecord> &pages,
+                         const std::function<void(QJsonObject &page)> &pageReady = {});
+
+private:
+    static void flattenJson(const QJsonObject &json, qint32 parent, QList<PageRecord> &pages);
+};
+
+#endif // WORKSPACE_CONTAINER_H
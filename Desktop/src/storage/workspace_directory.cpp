@@ -0,0 +1,338 @@
+#include "workspace_directory.h"
+#include "workspace_archive.h"
+#include "crc32c.h"
+#include "storage_cipher.h"
+
+#include <QDateTime>
+#include <QBuffer>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QSet>
+#include <QtEndian>
+#include <QDebug>
+#include <functional>
+
+#if defined(Q_OS_WIN)
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
+
+namespace {
+constexpr qint64 ShardHeaderSize = 4 + 4;
+
+// Контрольная сумма считается по тому, что лежит на диске (в том числе по шифротексту),
+// поэтому целостность проверяется и без ключа
+QByteArray wrapShard(const QByteArray &payload)
+{
+    QByteArray data(ShardHeaderSize, Qt::Uninitialized);
+    qToBigEndian<quint32>(WorkspaceDirectory::ShardMagic, data.data());
+    qToBigEndian<quint32>(Crc32c::checksum(payload), data.data() + 4);
+    return data + payload;
+}
+
+// Шарды без заголовка записаны до появления контрольных сумм и принимаются как есть
+bool unwrapShard(const QByteArray &data, QByteArray &payload)
+{
+    if (data.size() < ShardHeaderSize
+        || qFromBigEndian<quint32>(data.constData()) != WorkspaceDirectory::ShardMagic) {
+        payload = data;
+        return data.size() >= 4
+               && qFromBigEndian<quint32>(data.constData()) == WorkspaceContainer::PageTag;
+    }
+
+    payload = data.mid(ShardHeaderSize);
+    return Crc32c::checksum(payload) == qFromBigEndian<quint32>(data.constData() + 4);
+}
+
+bool readShardSection(const QString &path, QByteArray &section)
+{
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly))
+        return false;
+
+    QByteArray payload;
+    return unwrapShard(file.readAll(), payload)
+           && StorageCipher::instance().open(payload, section);
+}
+
+bool readShardFile(const QString &path, QJsonObject &page)
+{
+    QByteArray section;
+    return readShardSection(path, section) && WorkspaceContainer::decodePage(section, page);
+}
+
+bool shardIntact(const QString &path)
+{
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly))
+        return false;
+
+    QByteArray payload;
+    return unwrapShard(file.readAll(), payload);
+}
+
+// Зашифрованный контейнер расшифровывается целиком: он содержит только иерархию
+bool readContainer(QIODevice &file, QList<WorkspaceContainer::IndexEntry> &index, quint16 *flags)
+{
+    if (!StorageCipher::isSealed(file.peek(StorageCipher::HeaderSize + StorageCipher::TagSize)))
+        return WorkspaceContainer::readIndex(&file, index, flags);
+
+    QBuffer buffer;
+    QByteArray data;
+    if (!StorageCipher::instance().open(file.readAll(), data))
+        return false;
+    buffer.setData(data);
+    return buffer.open(QIODevice::ReadOnly)
+           && WorkspaceContainer::readIndex(&buffer, index, flags);
+}
+
+bool containerIntact(const QString &path)
+{
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly))
+        return false;
+
+    // Без ключа зашифрованный контейнер проверить нельзя - считаем его целым
+    if (!StorageCipher::instance().hasKeyFor(file.peek(StorageCipher::HeaderSize
+                                                       + StorageCipher::TagSize))) {
+        return true;
+    }
+    QList<WorkspaceContainer::IndexEntry> index;
+    return readContainer(file, index, nullptr);
+}
+
+// Вызывается перед commit() новой версии. Текущий файл остаётся на месте, а .prev
+// становится жёсткой ссылкой на него (без поддержки ссылок - копией): commit() подменит
+// только имя основного файла, и ни в какой момент основного файла не будет недоставать.
+void keepPrevious(const QString &path)
+{
+    const QString previous = path + WorkspaceDirectory::PreviousSuffix;
+    QFile::remove(previous);
+    if (!QFile::exists(path))
+        return;
+#if defined(Q_OS_WIN)
+    const bool linked = CreateHardLinkW(reinterpret_cast<const wchar_t *>(previous.utf16()),
+                                        reinterpret_cast<const wchar_t *>(path.utf16()), nullptr);
+#else
+    const bool linked = ::link(QFile::encodeName(path).constData(),
+                               QFile::encodeName(previous).constData())
+                        == 0;
+#endif
+    if (!linked && !QFile::copy(path, previous))
+        qWarning() << "Failed to keep previous version of" << path;
+}
+
+bool restorePrevious(const QString &workspacePath, const QString &path,
+                     const std::function<bool(const QString &)> &intact)
+{
+    if (QFile::exists(path)) {
+        const QString quarantinePath = workspacePath + WorkspaceDirectory::QuarantineDirName;
+        QDir().mkpath(quarantinePath);
+        const QString target = quarantinePath + QFileInfo(path).fileName() + "."
+                               + QString::number(QDateTime::currentMSecsSinceEpoch());
+        if (!QFile::rename(path, target)) {
+            qWarning() << "Failed to quarantine" << path;
+            return false;
+        }
+        qWarning() << "Quarantined damaged file" << path;
+    }
+
+    const QString previous = path + WorkspaceDirectory::PreviousSuffix;
+    if (!intact(previous))
+        return false;
+    return QFile::copy(previous, path);
+}
+} // namespace
+
+QString WorkspaceDirectory::pageShardPath(const QString &workspacePath, const QString &pageId)
+{
+    return workspacePath + PagesDirName + pageId + PageFileSuffix;
+}
+
+bool WorkspaceDirectory::writePageShard(const QString &workspacePath, const QString &pageId,
+                                        const QJsonObject &page)
+{
+    return writePageSection(workspacePath, pageId, WorkspaceContainer::encodePage(page));
+}
+
+bool WorkspaceDirectory::writePageSection(const QString &workspacePath, const QString &pageId,
+                                          const QByteArray &section)
+{
+    QDir().mkpath(workspacePath + PagesDirName);
+
+    // QSaveFile пишет во временный файл и подменяет старый только после успешной записи
+    const QString path = pageShardPath(workspacePath, pageId);
+    QSaveFile file(path);
+    if (!file.open(QIODevice::WriteOnly)) {
+        qWarning() << "Failed to open page file for writing:" << file.errorString();
+        return false;
+    }
+
+    QByteArray payload;
+    if (!StorageCipher::instance().seal(section, payload)) {
+        file.cancelWriting();
+        return false;
+    }
+    const QByteArray data = wrapShard(payload);
+    if (file.write(data) != data.size()) {
+        qWarning() << "Failed to write page data:" << file.errorString();
+        file.cancelWriting();
+        return false;
+    }
+    keepPrevious(path);
+    if (!file.commit()) {
+        qWarning() << "Failed to write page data:" << file.errorString();
+        return false;
+    }
+    return true;
+}
+
+bool WorkspaceDirectory::readPageShard(const QString &workspacePath, const QString &pageId,
+                                       QJsonObject &page)
+{
+    const QString path = pageShardPath(workspacePath, pageId);
+    if (readShardFile(path, page))
+        return true;
+
+    if (readShardFile(path + PreviousSuffix, page)) {
+        qWarning() << "Page file is damaged, using previous version:" << path;
+        return true;
+    }
+    qWarning() << "Failed to read page file:" << path;
+    return false;
+}
+
+bool WorkspaceDirectory::readPageChecksum(const QString &workspacePath, const QString &pageId,
+                                          quint32 &checksum)
+{
+    QFile file(pageShardPath(workspacePath, pageId));
+    if (!file.open(QIODevice::ReadOnly))
+        return false;
+
+    const QByteArray header = file.read(ShardHeaderSize);
+    if (header.size() < ShardHeaderSize || qFromBigEndian<quint32>(header.constData()) != ShardMagic)
+        return false;
+    if (!StorageCipher::isSealed(file.peek(StorageCipher::HeaderSize + StorageCipher::TagSize))) {
+        checksum = qFromBigEndian<quint32>(header.constData() + 4);
+        return true;
+    }
+
+    // В заголовке зашифрованного шарда сумма шифротекста - сравнивать надо открытую секцию
+    QByteArray section;
+    if (!StorageCipher::instance().open(file.readAll(), section))
+        return false;
+    checksum = Crc32c::checksum(section);
+    return true;
+}
+
+quint32 WorkspaceDirectory::pageChecksum(const QJsonObject &page)
+{
+    return Crc32c::checksum(WorkspaceContainer::encodePage(page));
+}
+
+bool WorkspaceDirectory::writeIndex(const QString &workspacePath,
+                                    const QList<WorkspaceContainer::IndexEntry> &index)
+{
+    QDir().mkpath(workspacePath);
+
+    QSaveFile file(workspacePath + ContainerFileName);
+    if (!file.open(QIODevice::WriteOnly)) {
+        qWarning() << "Failed to open workspace file for writing:" << file.errorString();
+        return false;
+    }
+
+    QByteArray data;
+    QBuffer buffer(&data);
+    QByteArray sealed;
+    if (!buffer.open(QIODevice::WriteOnly) || !WorkspaceContainer::writeIndex(&buffer, index)
+        || !StorageCipher::instance().seal(data, sealed) || file.write(sealed) != sealed.size()) {
+        qWarning() << "Failed to write workspace data:" << file.errorString();
+        file.cancelWriting();
+        return false;
+    }
+    keepPrevious(workspacePath + ContainerFileName);
+    if (!file.commit()) {
+        qWarning() << "Failed to write workspace data:" << file.errorString();
+        return false;
+    }
+
+    // Удаляем шарды страниц (и их предыдущие версии), которых больше нет в иерархии
+    QSet<QString> ids;
+    for (const WorkspaceContainer::IndexEntry &entry : index) ids.insert(entry.id);
+    QDir pagesDir(workspacePath + PagesDirName);
+    const QStringList shards = pagesDir.entryList(
+     QStringList() << QString("*") + PageFileSuffix << QString("*") + PageFileSuffix + PreviousSuffix,
+     QDir::Files);
+    for (const QString &shard : shards) {
+        QString id = shard;
+        if (id.endsWith(PreviousSuffix))
+            id.chop(int(sizeof(PreviousSuffix) - 1));
+        id.chop(int(sizeof(PageFileSuffix) - 1));
+        if (!ids.contains(id))
+            pagesDir.remove(shard);
+    }
+
+    // После первой записи в бинарном формате старый JSON больше не нужен
+    QFile::remove(workspacePath + LegacyFileName);
+    // Записано полное дерево - упакованная копия устарела
+    QFile::remove(workspacePath + WorkspaceArchive::ArchiveFileName);
+    return true;
+}
+
+bool WorkspaceDirectory::openIndex(const QString &workspacePath, QFile &container,
+                                   QList<WorkspaceContainer::IndexEntry> &index, quint16 *flags)
+{
+    container.setFileName(workspacePath + ContainerFileName);
+    if (container.open(QIODevice::ReadOnly) && readContainer(container, index, flags))
+        return true;
+
+    // Чужой ключ - не повреждение, чинить нечего
+    if (container.isOpen() && container.seek(0)
+        && !StorageCipher::instance().hasKeyFor(
+         container.peek(StorageCipher::HeaderSize + StorageCipher::TagSize))) {
+        return false;
+    }
+    container.close();
+    qWarning() << "Invalid workspace container:" << container.fileName();
+    return repairIndex(workspacePath) && container.open(QIODevice::ReadOnly)
+           && readContainer(container, index, flags);
+}
+
+bool WorkspaceDirectory::readIndex(const QByteArray &container,
+                                   QList<WorkspaceContainer::IndexEntry> &index, quint16 *flags)
+{
+    QBuffer buffer;
+    buffer.setData(container);
+    return buffer.open(QIODevice::ReadOnly) && readContainer(buffer, index, flags);
+}
+
+bool WorkspaceDirectory::readPageShard(const QByteArray &shard, QJsonObject &page)
+{
+    QByteArray payload;
+    QByteArray section;
+    return unwrapShard(shard, payload) && StorageCipher::instance().open(payload, section)
+           && WorkspaceContainer::decodePage(section, page);
+}
+
+bool WorkspaceDirectory::verifyIndex(const QString &workspacePath)
+{
+    return containerIntact(workspacePath + ContainerFileName);
+}
+
+bool WorkspaceDirectory::verifyPageShard(const QString &workspacePath, const QString &pageId)
+{
+    return shardIntact(pageShardPath(workspacePath, pageId));
+}
+
+bool WorkspaceDirectory::repairIndex(const QString &workspacePath)
+{
+    return restorePrevious(workspacePath, workspacePath + ContainerFileName, containerIntact);
+}
+
+bool WorkspaceDirectory::repairPageShard(const QString &workspacePath, const QString &pageId)
+{
+    return restorePrevious(workspacePath, pageShardPath(workspacePath, pageId), shardIntact);
+}
@@ -0,0 +1,73 @@
+#ifndef WORKSPACE_DIRECTORY_H
+#define WORKSPACE_DIRECTORY_H
+
+#include "workspace_container.h"
+
+#include <QFile>
+#include <QJsonObject>
+#include <QList>
+#include <QString>
+
+// Раскладка пространства на диске:
+//   workspace.mnw     - иерархия страниц (контейнер с флагом ExternalPages)
+//   pages/<id>.page   - по файлу на страницу
+//   workspace.json    - старый формат, удаляется после первой бинарной записи
+//   journal.log       - журнал правок после последней контрольной точки
+//   history.mnh       - локальная история версий (WorkspaceHistory)
+//   *.prev            - предыдущая версия контейнера или шарда
+//   quarantine/       - повреждённые файлы, найденные проверкой
+//
+// Шард страницы: magic "MNPS" | quint32 CRC32C содержимого | секция страницы,
+// при включённом шифровании - запись StorageCipher с секцией; так же шифруется контейнер.
+// Повреждённый шард или контейнер при чтении заменяется предыдущей версией.
+// Функции не зависят от состояния LocalStorage и могут вызываться из потока записи.
+class WorkspaceDirectory
+{
+public:
+    static constexpr char ContainerFileName[] = "workspace.mnw";
+    static constexpr char LegacyFileName[] = "workspace.json";
+    static constexpr char PagesDirName[] = "pages/";
+    static constexpr char PageFileSuffix[] = ".page";
+    static constexpr char JournalFileName[] = "journal.log";
+    static constexpr char HistoryFileName[] = "history.mnh";
+    static constexpr char PreviousSuffix[] = ".prev";
+    static constexpr char QuarantineDirName[] = "quarantine/";
+    static constexpr quint32 ShardMagic = 0x4D4E5053; // "MNPS"
+
+    static QString pageShardPath(const QString &workspacePath, const QString &pageId);
+    static bool writePageShard(const QString &workspacePath, const QString &pageId,
+                               const QJsonObject &page);
+    // То же для уже закодированной секции (WorkspaceContainer::encodePage)
+    static bool writePageSection(const QString &workspacePath, const QString &pageId,
+                                 const QByteArray &section);
+    static bool readPageShard(const QString &workspacePath, const QString &pageId,
+                              QJsonObject &page);
+
+    // Пишет иерархию и удаляет шарды страниц, которых в ней больше нет
+    static bool writeIndex(const QString &workspacePath,
+                           const QList<WorkspaceContainer::IndexEntry> &index);
+    // Открывает контейнер и читает иерархию. Повреждённый контейнер заменяется
+    // предыдущей версией; container остаётся открытым для чтения встроенных страниц.
+    static bool openIndex(const QString &workspacePath, QFile &container,
+                          QList<WorkspaceContainer::IndexEntry> &index, quint16 *flags = nullptr);
+    // То же по содержимому файлов, прочитанному из архива (WorkspaceArchive::read)
+    static bool readIndex(const QByteArray &container, QList<WorkspaceContainer::IndexEntry> &index,
+                          quint16 *flags = nullptr);
+    static bool readPageShard(const QByteArray &shard, QJsonObject &page);
+
+    // Контрольная сумма из заголовка шарда; false для шардов без заголовка
+    static bool readPageChecksum(const QString &workspacePath, const QString &pageId,
+                                 quint32 &checksum);
+    static quint32 pageChecksum(const QJsonObject &page);
+
+    // Проверка контрольных сумм без разбора содержимого
+    static bool verifyIndex(const QString &workspacePath);
+    static bool verifyPageShard(const QString &workspacePath, const QString &pageId);
+
+    // Убирает повреждённый файл в quarantine/ и возвращает на место предыдущую
+    // версию, если она цела. false - восстановить нечего.
+    static bool repairIndex(const QString &workspacePath);
+    static bool repairPageShard(const QString &workspacePath, const QString &pageId);
+};
+
+#endif // WORKSPACE_DIRECTORY_H
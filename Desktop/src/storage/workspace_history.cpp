@@ -0,0 +1,540 @@
+#include "workspace_history.h"
+#include "crc32c.h"
+#include "storage_cipher.h"
+#include "storage_engine.h"
+
+#include <QBuffer>
+#include <QDataStream>
+#include <QFileInfo>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QSaveFile>
+#include <QSet>
+#include <QDebug>
+
+namespace {
+constexpr QDataStream::Version StreamVersion = QDataStream::Qt_5_12;
+constexpr qint64 HeaderSize = 4 + 2;
+constexpr qint64 FrameHeaderSize = 4 + 4;
+
+struct PagePayload
+{
+    QString id;
+    quint32 checksum { 0 };
+    QByteArray data; // сжатая (и зашифрованная) секция
+};
+
+// Тело записи; offsets получает смещения секций относительно начала тела
+bool encodeRecord(quint64 version, qint64 savedAt,
+                  const QList<WorkspaceContainer::IndexEntry> &index,
+                  const QList<PagePayload> &pages, QByteArray &body,
+                  QHash<QString, qint64> &offsets)
+{
+    QByteArray indexData;
+    QDataStream indexOut(&indexData, QIODevice::WriteOnly);
+    indexOut.setVersion(StreamVersion);
+    indexOut << quint32(index.size());
+    for (const WorkspaceContainer::IndexEntry &entry : index)
+        indexOut << entry.parent << entry.id << entry.title;
+
+    QByteArray sealedIndex;
+    if (!StorageCipher::instance().seal(indexData, sealedIndex))
+        return false;
+
+    body.clear();
+    QBuffer buffer(&body);
+    buffer.open(QIODevice::WriteOnly);
+    QDataStream out(&buffer);
+    out.setVersion(StreamVersion);
+
+    out << version << savedAt << sealedIndex << quint32(pages.size());
+    for (const PagePayload &page : pages) {
+        out << page.id << page.checksum;
+        offsets.insert(page.id, buffer.pos());
+        out << page.data;
+    }
+    return true;
+}
+
+bool decodeIndex(QDataStream &in, QList<WorkspaceContainer::IndexEntry> &index)
+{
+    quint32 count = 0;
+    in >> count;
+    for (quint32 i = 0; i < count && in.status() == QDataStream::Ok; ++i) {
+        WorkspaceContainer::IndexEntry entry;
+        in >> entry.parent >> entry.id >> entry.title;
+        index.append(entry);
+    }
+    return in.status() == QDataStream::Ok;
+}
+
+QByteArray frame(const QByteArray &body)
+{
+    QByteArray data;
+    QDataStream out(&data, QIODevice::WriteOnly);
+    out.setVersion(StreamVersion);
+    out << quint32(body.size()) << Crc32c::checksum(body);
+    return data + body;
+}
+
+QByteArray fileHeader()
+{
+    QByteArray data;
+    QDataStream out(&data, QIODevice::WriteOnly);
+    out.setVersion(StreamVersion);
+    out << quint32(WorkspaceHistory::Magic) << quint16(WorkspaceHistory::FormatVersion);
+    return data;
+}
+} // namespace
+
+WorkspaceHistory::WorkspaceHistory(const QString &filePath) : _filePath(filePath) { }
+
+namespace {
+QMutex cacheMutex;
+} // namespace
+
+QHash<QString, WorkspaceHistory::Cached> &WorkspaceHistory::cachedHistories()
+{
+    static QHash<QString, Cached> histories;
+    return histories;
+}
+
+bool WorkspaceHistory::loadCached()
+{
+    const QFileInfo info(_filePath);
+    QMutexLocker locker(&cacheMutex);
+    QHash<QString, Cached> &histories = cachedHistories();
+    const auto it = histories.constFind(_filePath);
+    if (it == histories.cend())
+        return false;
+    if (!info.exists() || info.size() != it->fileSize || info.lastModified() != it->modified) {
+        histories.erase(it);
+        return false;
+    }
+    _records = it->records;
+    _validSize = it->validSize;
+    _fileVersion = it->fileVersion;
+    _loaded = true;
+    return true;
+}
+
+void WorkspaceHistory::cache() const
+{
+    const QFileInfo info(_filePath);
+    QMutexLocker locker(&cacheMutex);
+    if (!info.exists()) {
+        cachedHistories().remove(_filePath);
+        return;
+    }
+    Cached &cached = cachedHistories()[_filePath];
+    cached.records = _records;
+    cached.validSize = _validSize;
+    cached.fileVersion = _fileVersion;
+    cached.fileSize = info.size();
+    cached.modified = info.lastModified();
+}
+
+bool WorkspaceHistory::load()
+{
+    if (_loaded || loadCached())
+        return true;
+
+    _records.clear();
+    _validSize = 0;
+
+    QFile file(_filePath);
+    if (!file.exists()) {
+        _loaded = true;
+        return true;
+    }
+    if (!file.open(QIODevice::ReadOnly)) {
+        qWarning() << "Failed to open workspace history:" << file.errorString();
+        return false;
+    }
+
+    QDataStream in(&file);
+    in.setVersion(StreamVersion);
+    quint32 magic = 0;
+    quint16 version = 0;
+    in >> magic >> version;
+    if (in.status() != QDataStream::Ok || magic != Magic || version == 0
+        || version > FormatVersion) {
+        // Нечитаемая история начинается заново при следующей записи
+        qWarning() << "Invalid workspace history:" << _filePath;
+        _loaded = true;
+        return true;
+    }
+    _validSize = HeaderSize;
+    _fileVersion = version;
+
+    while (!file.atEnd()) {
+        const qint64 recordStart = file.pos();
+        quint32 size = 0;
+        quint32 checksum = 0;
+        in >> size >> checksum;
+        if (in.status() != QDataStream::Ok || size > file.size() - file.pos())
+            break;
+        const QByteArray body = file.read(size);
+        if (body.size() != qsizetype(size) || Crc32c::checksum(body) != checksum)
+            break;
+
+        QBuffer buffer;
+        buffer.setData(body);
+        buffer.open(QIODevice::ReadOnly);
+        QDataStream bodyIn(&buffer);
+        bodyIn.setVersion(StreamVersion);
+
+        Record record;
+        bodyIn >> record.version >> record.savedAt;
+        if (version < 2) {
+            decodeIndex(bodyIn, record.index);
+        } else {
+            // Иерархия хранится отдельной записью, чтобы названия страниц тоже шифровались
+            QByteArray sealedIndex;
+            QByteArray indexData;
+            bodyIn >> sealedIndex;
+            if (!StorageCipher::instance().open(sealedIndex, indexData)) {
+                qWarning() << "Failed to decrypt workspace history:" << _filePath;
+                return false;
+            }
+            QDataStream indexIn(indexData);
+            indexIn.setVersion(StreamVersion);
+            if (!decodeIndex(indexIn, record.index))
+                break;
+        }
+
+        // Сами страницы не читаем - запоминаем, где они лежат
+        quint32 count = 0;
+        bodyIn >> count;
+        for (quint32 i = 0; i < count && bodyIn.status() == QDataStream::Ok; ++i) {
+            QString id;
+            StoredPage page;
+            quint32 length = 0;
+            bodyIn >> id >> page.checksum;
+            page.offset = recordStart + FrameHeaderSize + buffer.pos();
+            bodyIn >> length;
+            bodyIn.skipRawData(int(length));
+            record.stored.insert(id, page);
+        }
+        if (bodyIn.status() != QDataStream::Ok)
+            break;
+
+        _records.append(record);
+        _validSize = file.pos();
+    }
+
+    _loaded = true;
+    file.close();
+    cache();
+    return true;
+}
+
+QHash<QString, WorkspaceHistory::StoredPage> WorkspaceHistory::pagesOf(int recordIndex) const
+{
+    QHash<QString, StoredPage> latest;
+    for (int i = 0; i <= recordIndex; ++i) {
+        for (auto it = _records[i].stored.cbegin(); it != _records[i].stored.cend(); ++it)
+            latest.insert(it.key(), it.value());
+    }
+
+    QHash<QString, StoredPage> pages;
+    for (const WorkspaceContainer::IndexEntry &entry : _records[recordIndex].index) {
+        const auto it = latest.constFind(entry.id);
+        if (it != latest.cend())
+            pages.insert(entry.id, it.value());
+    }
+    return pages;
+}
+
+bool WorkspaceHistory::readSection(QFile &file, qint64 offset, QByteArray &data) const
+{
+    if (!file.seek(offset))
+        return false;
+    QDataStream in(&file);
+    in.setVersion(StreamVersion);
+    in >> data;
+    return in.status() == QDataStream::Ok;
+}
+
+bool WorkspaceHistory::record(const QString &workspacePath,
+                              const QList<WorkspaceContainer::IndexEntry> &index,
+                              const QHash<QString, QJsonObject> &pages)
+{
+    if (!load())
+        return false;
+
+    const QHash<QString, StoredPage> previous =
+     _records.isEmpty() ? QHash<QString, StoredPage>() : pagesOf(int(_records.size()) - 1);
+
+    QList<PagePayload> changed;
+    for (const WorkspaceContainer::IndexEntry &entry : index) {
+        QJsonObject page;
+        if (pages.contains(entry.id)) {
+            page = pages.value(entry.id);
+        } else if (previous.contains(entry.id)
+                   || !StorageEngine::instance().readPage(workspacePath, entry.id, page)) {
+            // Страница не попала ни в историю, ни в хранилище: версия без неё
+            // восстановила бы пустую страницу
+            continue;
+        }
+
+        const QByteArray section = WorkspaceContainer::encodePage(page);
+        PagePayload payload;
+        payload.id = entry.id;
+        payload.checksum = Crc32c::checksum(section);
+        const auto stored = previous.constFind(entry.id);
+        if (stored != previous.cend() && stored->checksum == payload.checksum)
+            continue;
+        // Сначала сжатие, потом шифрование: шифротекст не сжимается
+        if (!StorageCipher::instance().seal(qCompress(section), payload.data))
+            return false;
+        changed.append(payload);
+    }
+
+    // Ни страницы, ни иерархия не изменились - новая версия не нужна
+    if (changed.isEmpty() && !_records.isEmpty()) {
+        const QList<WorkspaceContainer::IndexEntry> &last = _records.last().index;
+        bool sameIndex = last.size() == index.size();
+        for (int i = 0; sameIndex && i < index.size(); ++i) {
+            sameIndex = last[i].id == index[i].id && last[i].parent == index[i].parent
+                        && last[i].title == index[i].title;
+        }
+        if (sameIndex)
+            return true;
+    }
+
+    Record record;
+    record.version = _records.isEmpty() ? 1 : _records.last().version + 1;
+    record.savedAt = QDateTime::currentMSecsSinceEpoch();
+    record.index = index;
+
+    QHash<QString, qint64> offsets;
+    QByteArray body;
+    if (!encodeRecord(record.version, record.savedAt, index, changed, body, offsets))
+        return false;
+
+    // Записи старого формата переписываются, прежде чем дописывать новые
+    if (_fileVersion < FormatVersion && !_records.isEmpty()) {
+        QList<int> all;
+        for (int i = 0; i < _records.size(); ++i) all.append(i);
+        if (!rewrite(all))
+            return false;
+    }
+
+    QFile file(_filePath);
+    if (!file.open(QIODevice::ReadWrite)) {
+        qWarning() << "Failed to open workspace history for writing:" << file.errorString();
+        return false;
+    }
+    // Новый файл получает заголовок, оборванный хвост старого отрезается
+    if (_validSize < HeaderSize) {
+        file.resize(0);
+        file.write(fileHeader());
+        _validSize = HeaderSize;
+        _fileVersion = FormatVersion;
+    } else if (file.size() != _validSize) {
+        file.resize(_validSize);
+    }
+    file.seek(_validSize);
+
+    const qint64 recordStart = _validSize;
+    const QByteArray data = frame(body);
+    if (file.write(data) != data.size()) {
+        qWarning() << "Failed to write workspace history:" << file.errorString();
+        return false;
+    }
+    file.close();
+
+    for (const PagePayload &payload : std::as_const(changed)) {
+        StoredPage page;
+        page.checksum = payload.checksum;
+        page.offset = recordStart + FrameHeaderSize + offsets.value(payload.id);
+        record.stored.insert(payload.id, page);
+    }
+    _records.append(record);
+    _validSize = recordStart + data.size();
+
+    if (_records.size() % CompactEvery == 0)
+        compact();
+    cache();
+    return true;
+}
+
+QList<HistoryVersion> WorkspaceHistory::versions()
+{
+    QList<HistoryVersion> result;
+    if (!load())
+        return result;
+
+    result.reserve(_records.size());
+    for (const Record &record : std::as_const(_records)) {
+        HistoryVersion version;
+        version.version = record.version;
+        version.savedAt = QDateTime::fromMSecsSinceEpoch(record.savedAt);
+        version.pageCount = int(record.index.size());
+        version.storedPages = int(record.stored.size());
+        result.append(version);
+    }
+    return result;
+}
+
+bool WorkspaceHistory::read(quint64 version, QList<PageRecord> &pages)
+{
+    if (!load())
+        return false;
+
+    int recordIndex = -1;
+    for (int i = 0; i < _records.size(); ++i) {
+        if (_records[i].version == version) {
+            recordIndex = i;
+            break;
+        }
+    }
+    if (recordIndex < 0)
+        return false;
+
+    QFile file(_filePath);
+    if (!file.open(QIODevice::ReadOnly))
+        return false;
+
+    const QHash<QString, StoredPage> stored = pagesOf(recordIndex);
+    pages.clear();
+    pages.reserve(_records[recordIndex].index.size());
+    for (const WorkspaceContainer::IndexEntry &entry : _records[recordIndex].index) {
+        PageRecord page;
+        page.parent = entry.parent;
+
+        QByteArray data;
+        QByteArray compressed;
+        const auto it = stored.constFind(entry.id);
+        if (it == stored.cend() || !readSection(file, it->offset, data)
+            || !StorageCipher::instance().open(data, compressed)
+            || !WorkspaceContainer::decodePage(qUncompress(compressed), page.page)) {
+            // Страница не попала в историю (например, шард был повреждён): при
+            // восстановлении версии её содержимое в хранилище не перезаписывается
+            page.page = QJsonObject();
+            page.page["id"] = entry.id;
+            page.page["title"] = entry.title;
+            page.placeholder = true;
+        }
+        pages.append(page);
+    }
+    return true;
+}
+
+bool WorkspaceHistory::forEachStoredPage(const std::function<void(const QJsonObject &page)> &visit)
+{
+    if (!load())
+        return false;
+    if (_records.isEmpty())
+        return true;
+
+    QFile file(_filePath);
+    if (!file.open(QIODevice::ReadOnly))
+        return false;
+
+    for (const Record &record : std::as_const(_records)) {
+        for (const StoredPage &stored : record.stored) {
+            QByteArray data;
+            QByteArray compressed;
+            QJsonObject page;
+            if (!readSection(file, stored.offset, data)
+                || !StorageCipher::instance().open(data, compressed)
+                || !WorkspaceContainer::decodePage(qUncompress(compressed), page)) {
+                return false;
+            }
+            visit(page);
+        }
+    }
+    return true;
+}
+
+bool WorkspaceHistory::compact(const QDateTime &now)
+{
+    if (!load() || _records.size() < 2)
+        return true;
+
+    const QDate today = now.date();
+    QList<int> keep;
+    for (int i = 0; i < _records.size(); ++i) {
+        const QDateTime savedAt = QDateTime::fromMSecsSinceEpoch(_records[i].savedAt);
+        const qint64 ageDays = savedAt.date().daysTo(today);
+        const bool last = i == _records.size() - 1;
+        const bool lastOfDay = last
+                               || QDateTime::fromMSecsSinceEpoch(_records[i + 1].savedAt).date()
+                                   != savedAt.date();
+        if (last || ageDays < KeepAllDays || (ageDays < KeepDailyDays && lastOfDay))
+            keep.append(i);
+    }
+    if (keep.size() == _records.size())
+        return true;
+    return rewrite(keep);
+}
+
+bool WorkspaceHistory::rewrite(const QList<int> &keep)
+{
+    QFile source(_filePath);
+    if (!source.open(QIODevice::ReadOnly))
+        return false;
+
+    // Каждая оставшаяся версия получает страницы, отличающиеся от предыдущей оставшейся
+    QByteArray output = fileHeader();
+    QList<Record> records;
+    QHash<QString, quint32> previous;
+    for (int recordIndex : std::as_const(keep)) {
+        const Record &original = _records[recordIndex];
+        const QHash<QString, StoredPage> stored = pagesOf(recordIndex);
+
+        QList<PagePayload> changed;
+        QHash<QString, quint32> current;
+        for (auto it = stored.cbegin(); it != stored.cend(); ++it) {
+            current.insert(it.key(), it->checksum);
+            if (previous.contains(it.key()) && previous.value(it.key()) == it->checksum)
+                continue;
+
+            PagePayload payload;
+            payload.id = it.key();
+            payload.checksum = it->checksum;
+            if (!readSection(source, it->offset, payload.data))
+                return false;
+            changed.append(payload);
+        }
+        previous = current;
+
+        QHash<QString, qint64> offsets;
+        QByteArray body;
+        if (!encodeRecord(original.version, original.savedAt, original.index, changed, body,
+                          offsets)) {
+            return false;
+        }
+
+        Record record;
+        record.version = original.version;
+        record.savedAt = original.savedAt;
+        record.index = original.index;
+        for (const PagePayload &payload : std::as_const(changed)) {
+            StoredPage page;
+            page.checksum = payload.checksum;
+            page.offset = output.size() + FrameHeaderSize + offsets.value(payload.id);
+            record.stored.insert(payload.id, page);
+        }
+        records.append(record);
+        output += frame(body);
+    }
+    source.close();
+
+    QSaveFile file(_filePath);
+    if (!file.open(QIODevice::WriteOnly) || file.write(output) != output.size()
+        || !file.commit()) {
+        qWarning() << "Failed to compact workspace history:" << file.errorString();
+        return false;
+    }
+
+    qDebug() << "Compacted workspace history" << _filePath << "from" << _records.size() << "to"
+             << records.size() << "versions";
+    _records = records;
+    _validSize = output.size();
+    _fileVersion = FormatVersion;
+    cache();
+    return true;
+}
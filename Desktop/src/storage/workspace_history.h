@@ -0,0 +1,111 @@
+#ifndef WORKSPACE_HISTORY_H
+#define WORKSPACE_HISTORY_H
+
+#include "workspace_container.h"
+
+#include <QDateTime>
+#include <QFile>
+#include <QHash>
+#include <QJsonObject>
+#include <QList>
+#include <QString>
+#include <functional>
+
+// Одна сохранённая версия пространства
+struct HistoryVersion
+{
+    quint64 version { 0 };
+    QDateTime savedAt;
+    int pageCount { 0 }; // страниц в дереве этой версии
+    int storedPages { 0 }; // из них записано в этой версии, остальные - из предыдущих
+};
+
+// Локальная история версий пространства (history.mnh).
+//
+// Каждое сохранение дописывает версию: полную иерархию и только те страницы,
+// содержимое которых изменилось с предыдущей версии (дельта на уровне страниц,
+// каждая страница сжата). Неизменённая страница берётся из последней версии,
+// где она записана, поэтому восстановление - это чтение индекса и по одному
+// seek на страницу, без проигрывания цепочки.
+//
+// Формат (QDataStream): magic "MNHI" | quint16 version, затем записи
+//   quint32 size | quint32 CRC32C тела | тело:
+//   quint64 version | qint64 savedAt (мс) |
+//   QByteArray иерархия (quint32 count | count x (parent, id, title)) |
+//   quint32 stored | stored x (QString id, quint32 CRC32C секции, QByteArray qCompress(секция))
+// Иерархия и сжатые секции при включённом шифровании - записи StorageCipher.
+// В версии 1 иерархия шла прямо в теле; такой файл переписывается при первой записи.
+//
+// Оборванная запись в конце отбрасывается. Компактизация оставляет все версии
+// за последние KeepAllDays дней, по одной в день до KeepDailyDays и последнюю версию.
+//
+// Прочитанный индекс (версии и смещения страниц) остаётся в памяти процесса, пока файл
+// не изменит кто-то другой: очередное сохранение только дописывает запись в конец.
+// Доступ к одному файлу из разных потоков разделяет PageLocks (IndexKey).
+class WorkspaceHistory
+{
+public:
+    static constexpr quint32 Magic = 0x4D4E4849; // "MNHI"
+    static constexpr quint16 FormatVersion = 2;
+    static constexpr int KeepAllDays = 7;
+    static constexpr int KeepDailyDays = 90;
+    static constexpr int CompactEvery = 64; // версий между компактизациями
+
+    explicit WorkspaceHistory(const QString &filePath);
+
+    // pages - изменённые страницы; страницы индекса, которых ещё нет в истории,
+    // читаются из шардов пространства workspacePath
+    bool record(const QString &workspacePath, const QList<WorkspaceContainer::IndexEntry> &index,
+                const QHash<QString, QJsonObject> &pages);
+
+    QList<HistoryVersion> versions();
+    bool read(quint64 version, QList<PageRecord> &pages);
+    // Каждая записанная в историю страница один раз, во всех версиях.
+    // false - историю или страницу не прочитать.
+    bool forEachStoredPage(const std::function<void(const QJsonObject &page)> &visit);
+    bool compact(const QDateTime &now = QDateTime::currentDateTime());
+
+private:
+    struct StoredPage
+    {
+        quint32 checksum { 0 };
+        qint64 offset { 0 }; // начало QByteArray с секцией
+    };
+
+    struct Record
+    {
+        quint64 version { 0 };
+        qint64 savedAt { 0 };
+        QList<WorkspaceContainer::IndexEntry> index;
+        QHash<QString, StoredPage> stored;
+    };
+
+    bool load();
+    // Индекс из памяти процесса, если файл с тех пор не менялся
+    bool loadCached();
+    void cache() const;
+    QHash<QString, StoredPage> pagesOf(int recordIndex) const;
+    bool readSection(QFile &file, qint64 offset, QByteArray &data) const;
+    // Переписывает файл, оставляя записи с номерами keep
+    bool rewrite(const QList<int> &keep);
+
+    struct Cached
+    {
+        QList<Record> records;
+        qint64 validSize { 0 };
+        quint16 fileVersion { FormatVersion };
+        qint64 fileSize { 0 };
+        QDateTime modified;
+    };
+
+    // Путь файла -> прочитанный индекс; под мьютексом в workspace_history.cpp
+    static QHash<QString, Cached> &cachedHistories();
+
+    QString _filePath;
+    bool _loaded { false };
+    qint64 _validSize { 0 };
+    quint16 _fileVersion { FormatVersion };
+    QList<Record> _records;
+};
+
+#endif // WORKSPACE_HISTORY_H
@@ -0,0 +1,315 @@
+#include "workspace_journal.h"
+#include "storage_cipher.h"
+#include "crc32c.h"
+
+#include <QCborMap>
+#include <QCborValue>
+#include <QDataStream>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QDebug>
+
+#if defined(Q_OS_WIN)
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+namespace {
+constexpr QDataStream::Version StreamVersion = QDataStream::Qt_5_12;
+constexpr qint64 FileHeaderSize = 4 + 2;
+constexpr qint64 FrameHeaderSize = 4 + 4;
+constexpr qint64 LegacyFrameHeaderSize = 4 + 2;
+constexpr quint16 LegacyVersion = 1;
+
+bool syncToDisk(QFile &file)
+{
+    if (!file.flush())
+        return false;
+#if defined(Q_OS_WIN)
+    return _commit(file.handle()) == 0;
+#else
+    return ::fsync(file.handle()) == 0;
+#endif
+}
+
+QByteArray encodeRecord(const WorkspaceJournal::Record &record)
+{
+    QByteArray body;
+    QDataStream out(&body, QIODevice::WriteOnly);
+    out.setVersion(StreamVersion);
+    out << record.sequence << quint8(record.operation) << record.pageId << record.parentId
+        << record.index << record.elementId
+        << QCborMap::fromJsonObject(record.payload).toCborValue().toCbor();
+    return body;
+}
+
+bool decodeRecord(const QByteArray &body, quint16 version, WorkspaceJournal::Record &record)
+{
+    QDataStream in(body);
+    in.setVersion(StreamVersion);
+
+    quint8 operation = 0;
+    QByteArray payload;
+    in >> record.sequence >> operation >> record.pageId >> record.parentId >> record.index;
+    if (version > LegacyVersion)
+        in >> record.elementId;
+    in >> payload;
+    if (in.status() != QDataStream::Ok)
+        return false;
+    if (operation < WorkspaceJournal::PageUpdate || operation > WorkspaceJournal::PageRemove)
+        return false;
+
+    record.operation = WorkspaceJournal::Operation(operation);
+    record.payload = QCborValue::fromCbor(payload).toMap().toJsonObject();
+    return true;
+}
+} // namespace
+
+WorkspaceJournal::WorkspaceJournal(const QString &filePath) :
+    _filePath(filePath),
+    _file(filePath)
+{}
+
+WorkspaceJournal::~WorkspaceJournal()
+{
+    _file.close();
+}
+
+QString WorkspaceJournal::filePath() const
+{
+    return _filePath;
+}
+
+bool WorkspaceJournal::isEmpty() const
+{
+    QFileInfo info(_filePath);
+    return !info.exists() || info.size() <= FileHeaderSize;
+}
+
+qint64 WorkspaceJournal::size() const
+{
+    QFileInfo info(_filePath);
+    return info.exists() ? info.size() : 0;
+}
+
+bool WorkspaceJournal::writeHeader(QIODevice *device) const
+{
+    QDataStream out(device);
+    out.setVersion(StreamVersion);
+    out << quint32(Magic) << quint16(FormatVersion);
+    return out.status() == QDataStream::Ok;
+}
+
+bool WorkspaceJournal::openForAppend()
+{
+    if (_file.isOpen())
+        return true;
+
+    // Номер следующей записи продолжает уже лежащий на диске журнал
+    quint16 version = FormatVersion;
+    const QList<Record> existing = readAll(&version);
+    _nextSequence = existing.isEmpty() ? 1 : existing.last().sequence + 1;
+    if (version > FormatVersion)
+        return false;
+
+    // Журнал старого формата переписываем целиком: кадры разных версий не смешиваются
+    if (version != FormatVersion || size() == 0) {
+        QSaveFile out(_filePath);
+        if (!out.open(QIODevice::WriteOnly) || !writeHeader(&out)) {
+            qWarning() << "Failed to create journal:" << out.errorString();
+            return false;
+        }
+        for (const Record &record : existing) {
+            QByteArray frame;
+            if (!encodeFrame(record, frame) || out.write(frame) != frame.size()) {
+                out.cancelWriting();
+                return false;
+            }
+        }
+        if (!out.commit()) {
+            qWarning() << "Failed to create journal:" << out.errorString();
+            return false;
+        }
+    }
+
+    if (!_file.open(QIODevice::WriteOnly | QIODevice::Append)) {
+        qWarning() << "Failed to open journal for writing:" << _file.errorString();
+        return false;
+    }
+    return true;
+}
+
+bool WorkspaceJournal::encodeFrame(const Record &record, QByteArray &frame) const
+{
+    QByteArray body;
+    if (!StorageCipher::instance().seal(encodeRecord(record), body))
+        return false;
+
+    frame.clear();
+    QDataStream out(&frame, QIODevice::WriteOnly);
+    out.setVersion(StreamVersion);
+    out << quint32(body.size()) << quint32(Crc32c::checksum(body));
+    frame.append(body);
+    return true;
+}
+
+bool WorkspaceJournal::append(const Record &record)
+{
+    return append(QList<Record>() << record);
+}
+
+bool WorkspaceJournal::append(QList<Record> records)
+{
+    if (records.isEmpty())
+        return true;
+    if (!openForAppend())
+        return false;
+
+    QByteArray frames;
+    for (Record &record : records) {
+        record.sequence = _nextSequence++;
+        QByteArray frame;
+        if (!encodeFrame(record, frame))
+            return false;
+        frames.append(frame);
+    }
+
+    if (_file.write(frames) != frames.size() || !syncToDisk(_file)) {
+        qWarning() << "Failed to append journal records:" << _file.errorString();
+        return false;
+    }
+    return true;
+}
+
+bool WorkspaceJournal::readRecords(QList<Record> &records, quint16 &version,
+                                   qint64 &validSize) const
+{
+    records.clear();
+    version = LegacyVersion;
+    validSize = 0;
+
+    QFile file(_filePath);
+    if (!file.exists() || !file.open(QIODevice::ReadOnly))
+        return true;
+
+    QDataStream in(&file);
+    in.setVersion(StreamVersion);
+
+    quint32 magic = 0;
+    if (file.size() >= FileHeaderSize) {
+        in >> magic;
+        if (magic == Magic) {
+            in >> version;
+            validSize = FileHeaderSize;
+        } else {
+            file.seek(0);
+            in.resetStatus();
+        }
+    }
+    if (version > FormatVersion) {
+        qWarning() << "Unsupported journal version" << version << "in" << _filePath;
+        validSize = file.size();
+        return false;
+    }
+
+    const qint64 headerSize = version > LegacyVersion ? FrameHeaderSize : LegacyFrameHeaderSize;
+    while (file.size() - validSize >= headerSize) {
+        quint32 size = 0;
+        quint32 checksum = 0;
+        in >> size;
+        if (version > LegacyVersion) {
+            in >> checksum;
+        } else {
+            quint16 legacyChecksum = 0;
+            in >> legacyChecksum;
+            checksum = legacyChecksum;
+        }
+        if (qint64(size) > file.size() - file.pos())
+            break;
+
+        const QByteArray body = file.read(size);
+        const quint32 actual = version > LegacyVersion ? Crc32c::checksum(body)
+                                                       : quint16(qChecksum(body));
+        if (quint32(body.size()) != size || actual != checksum)
+            break;
+
+        // Целая запись, которую нечем расшифровать, - не оборванный хвост: журнал не трогаем
+        QByteArray plain;
+        Record record;
+        if (!StorageCipher::instance().open(body, plain)) {
+            qWarning() << "Failed to decrypt journal" << _filePath;
+            validSize = file.size();
+            return false;
+        }
+        if (!decodeRecord(plain, version, record))
+            break;
+
+        records.append(record);
+        validSize = file.pos();
+    }
+    return true;
+}
+
+bool WorkspaceJournal::scan(QList<Record> &records) const
+{
+    quint16 version = 0;
+    qint64 validSize = 0;
+    return readRecords(records, version, validSize);
+}
+
+QList<WorkspaceJournal::Record> WorkspaceJournal::readAll(quint16 *formatVersion)
+{
+    QList<Record> records;
+    quint16 version = 0;
+    qint64 validSize = 0;
+    readRecords(records, version, validSize);
+    if (formatVersion)
+        *formatVersion = version;
+
+    // Хвост, оборванный при сбое, отрезаем, чтобы новые записи шли за последней целой
+    if (validSize < size()) {
+        qWarning() << "Discarding torn journal tail in" << _filePath << "at offset" << validSize;
+        const bool wasOpen = _file.isOpen();
+        _file.close();
+        QFile::resize(_filePath, validSize);
+        if (wasOpen)
+            _file.open(QIODevice::WriteOnly | QIODevice::Append);
+    }
+    return records;
+}
+
+bool WorkspaceJournal::reset()
+{
+    _file.close();
+    _nextSequence = 1;
+    if (!QFile::exists(_filePath))
+        return true;
+    return QFile::resize(_filePath, 0);
+}
+
+bool WorkspaceJournal::discardPrefix(qint64 size)
+{
+    if (size <= FileHeaderSize)
+        return true;
+    if (size >= this->size())
+        return reset();
+
+    // Пока снимок записывался, в журнал дописали новые правки - оставляем только их
+    QFile file(_filePath);
+    if (!file.open(QIODevice::ReadOnly) || !file.seek(size)) {
+        qWarning() << "Failed to read journal tail:" << file.errorString();
+        return false;
+    }
+    const QByteArray tail = file.readAll();
+    file.close();
+
+    _file.close();
+    QSaveFile out(_filePath);
+    if (!out.open(QIODevice::WriteOnly) || !writeHeader(&out) || out.write(tail) != tail.size()
+        || !out.commit()) {
+        qWarning() << "Failed to rewrite journal:" << out.errorString();
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,79 @@
+#ifndef WORKSPACE_JOURNAL_H
+#define WORKSPACE_JOURNAL_H
+
+#include <QFile>
+#include <QJsonObject>
+#include <QList>
+#include <QString>
+
+// Журнал изменений пространства (write-ahead log).
+//
+// Изменения страниц и элементов дописываются в конец journal.log пачкой и
+// сбрасываются на диск (fsync) один раз до возврата из append(). Основное хранилище
+// (шарды страниц) обновляется только на контрольной точке, после которой
+// журнал очищается. При запуске незавершённый журнал проигрывается поверх шардов.
+//
+// Файл: magic "MNJL" | quint16 version | кадры. Кадр: quint32 size |
+// quint32 CRC32C тела | тело (QDataStream, при включённом шифровании - запись
+// StorageCipher). Оборванный при сбое хвост не проходит проверку и отбрасывается.
+// Журнал без заголовка (версия 1, CRC-16 в кадре) читается и при первой записи
+// переписывается в текущий формат.
+class WorkspaceJournal
+{
+public:
+    enum Operation : quint8
+    {
+        PageUpdate = 1, // страница целиком (метаданные и элементы) и её родитель
+        ElementUpdate = 2, // один элемент страницы по elementId (в старых записях - по индексу)
+        PageRemove = 3 // страница и все её потомки
+    };
+
+    struct Record
+    {
+        quint64 sequence { 0 };
+        Operation operation { PageUpdate };
+        QString pageId;
+        QString parentId;
+        qint32 index { -1 };
+        QString elementId;
+        QJsonObject payload;
+    };
+
+    static constexpr quint32 Magic = 0x4D4E4A4C; // "MNJL"
+    static constexpr quint16 FormatVersion = 2;
+
+    explicit WorkspaceJournal(const QString &filePath);
+    ~WorkspaceJournal();
+
+    WorkspaceJournal(const WorkspaceJournal &) = delete;
+    WorkspaceJournal &operator=(const WorkspaceJournal &) = delete;
+
+    bool append(const Record &record);
+    // Все записи одним fsync
+    bool append(QList<Record> records);
+    // formatVersion - версия формата файла на диске
+    QList<Record> readAll(quint16 *formatVersion = nullptr);
+    // Чтение без обрезки оборванного хвоста - для потоков, которые в журнал не пишут.
+    // false - запись не расшифровать.
+    bool scan(QList<Record> &records) const;
+    bool reset();
+    // Отбрасывает первые size байт: записи, уже попавшие в сохранённый снимок
+    bool discardPrefix(qint64 size);
+
+    bool isEmpty() const;
+    qint64 size() const;
+    QString filePath() const;
+
+private:
+    bool openForAppend();
+    bool writeHeader(QIODevice *device) const;
+    bool encodeFrame(const Record &record, QByteArray &frame) const;
+    // validSize - длина целой части файла
+    bool readRecords(QList<Record> &records, quint16 &version, qint64 &validSize) const;
+
+    QString _filePath;
+    QFile _file;
+    quint64 _nextSequence { 0 };
+};
+
+#endif // WORKSPACE_JOURNAL_H
@@ -66,31 +66,23 @@ void SyncManager::syncWithVersionSelection(const QJsonArray &serverWorkspaces)
 
 bool SyncManager::hasVersionConflicts(const QJsonArray &serverWorkspaces)
 {
-    QDir userDir(localStorage->getWorkspacePath(false));
-    QStringList localWorkspaces = userDir.entryList(QDir::Dirs | QDir::NoDotAndDotDot);
+    const QStringList localWorkspaces = localStorage->listWorkspaces(false);
 
     for (const QString &workspaceName : localWorkspaces) {
-        QString localPath = userDir.filePath(workspaceName) + "/workspace.json";
-        QFile localFile(localPath);
-        
-        if (localFile.open(QIODevice::ReadOnly)) {
-            QJsonDocument localDoc = QJsonDocument::fromJson(localFile.readAll());
-            localFile.close();
-            
-            if (localDoc.isObject()) {
-                QJsonObject localWorkspace = localDoc.object();
-                QString localVersion = localWorkspace["version"].toString();
-                
-                // Find corresponding server workspace
-                for (const QJsonValue &serverValue : serverWorkspaces) {
-                    QJsonObject serverWorkspace = serverValue.toObject();
-                    if (serverWorkspace["name"].toString() == workspaceName) {
-                        QString serverVersion = serverWorkspace["version"].toString();
-                        if (localVersion != serverVersion) {
-                            return true;
-                        }
-                        break;
+        // Версия хранится в корневой странице - остальное дерево не читаем
+        PageRecord localRoot;
+        if (localStorage->loadPage(workspaceName, 0, localRoot, false)) {
+            QString localVersion = localRoot.page["version"].toString();
+
+            // Find corresponding server workspace
+            for (const QJsonValue &serverValue : serverWorkspaces) {
+                QJsonObject serverWorkspace = serverValue.toObject();
+                if (serverWorkspace["name"].toString() == workspaceName) {
+                    QString serverVersion = serverWorkspace["version"].toString();
+                    if (localVersion != serverVersion) {
+                        return true;
                     }
+                    break;
                 }
             }
         }
@@ -116,21 +108,8 @@ void SyncManager::onWorkspacesFetched(const QJsonArray &workspaces)
 void SyncManager::onPagesFetched(const QString &workspaceTitle, const QJsonArray &pages)
 {
     // Update workspace items in local storage
-    QDir userDir(localStorage->getWorkspacePath(false));
-    QString workspacePath = userDir.filePath(workspaceTitle) + "/workspace.json";
-    QFile workspaceFile(workspacePath);
-    if (workspaceFile.open(QIODevice::ReadOnly)) {
-        QJsonDocument doc = QJsonDocument::fromJson(workspaceFile.readAll());
-        workspaceFile.close();
-        if (doc.isObject()) {
-            QJsonObject workspace = doc.object();
-            workspace["pages"] = pages;
-            if (workspaceFile.open(QIODevice::WriteOnly)) {
-                workspaceFile.write(QJsonDocument(workspace).toJson());
-                workspaceFile.close();
-            }
-        }
-    }
+    localStorage->updateWorkspaceJson(
+     workspaceTitle, [&pages](QJsonObject &workspace) { workspace["pages"] = pages; }, false);
 }
 
 void SyncManager::onSyncCompleted(const QJsonObject &response)
@@ -154,8 +133,7 @@ void SyncManager::syncLocalChanges()
     _isSyncing = true;
     emit syncStarted();
     QJsonObject changes = collectLocalChanges();
-    QDir userDir(localStorage->getWorkspacePath(false));
-    QStringList workspaceNames = userDir.entryList(QDir::Dirs | QDir::NoDotAndDotDot);
+    const QStringList workspaceNames = localStorage->listWorkspaces(false);
     for (const QString &workspaceName : workspaceNames) {
         apiClient->syncWorkspace(workspaceName, changes);
     }
@@ -166,20 +144,12 @@ QJsonObject SyncManager::collectLocalChanges()
     QJsonObject changes;
     QJsonArray workspaces;
     
-    QDir userDir(localStorage->getWorkspacePath(false));
-    QStringList workspaceNames = userDir.entryList(QDir::Dirs | QDir::NoDotAndDotDot);
+    const QStringList workspaceNames = localStorage->listWorkspaces(false);
     
     for (const QString &workspaceName : workspaceNames) {
-        QString workspacePath = userDir.filePath(workspaceName) + "/workspace.json";
-        QFile workspaceFile(workspacePath);
-        
-        if (workspaceFile.open(QIODevice::ReadOnly)) {
-            QJsonDocument doc = QJsonDocument::fromJson(workspaceFile.readAll());
-            workspaceFile.close();
-            
-            if (doc.isObject()) {
-                workspaces.append(doc.object());
-            }
+        QJsonObject workspace = localStorage->readWorkspaceJson(workspaceName, false);
+        if (!workspace.isEmpty()) {
+            workspaces.append(workspace);
         }
     }
     
@@ -191,17 +161,11 @@ void SyncManager::startUserSync()
 {
     // Собрать все локальные guest workspaces
     QJsonArray localWorkspaces;
-    QDir guestDir(localStorage->getWorkspacePath(true));
-    QStringList workspaceNames = guestDir.entryList(QDir::Dirs | QDir::NoDotAndDotDot);
+    const QStringList workspaceNames = localStorage->listWorkspaces(true);
     for (const QString &workspaceName : workspaceNames) {
-        QString workspacePath = guestDir.filePath(workspaceName) + "/workspace.json";
-        QFile workspaceFile(workspacePath);
-        if (workspaceFile.open(QIODevice::ReadOnly)) {
-            QJsonDocument doc = QJsonDocument::fromJson(workspaceFile.readAll());
-            workspaceFile.close();
-            if (doc.isObject()) {
-                localWorkspaces.append(doc.object());
-            }
+        QJsonObject workspace = localStorage->readWorkspaceJson(workspaceName, true);
+        if (!workspace.isEmpty()) {
+            localWorkspaces.append(workspace);
         }
     }
 
@@ -230,10 +194,9 @@ void SyncManager::onUserSyncFinalReceived(const QJsonArray &finalWorkspaces)
     localStorage->syncWorkspaces(finalWorkspaces, false); // false = полная замена
 
     // 2. Очищаем guest workspaces
-    QDir guestDir(localStorage->getWorkspacePath(true));
-    QStringList guestWorkspaces = guestDir.entryList(QDir::Dirs | QDir::NoDotAndDotDot);
+    const QStringList guestWorkspaces = localStorage->listWorkspaces(true);
     for (const QString &ws : guestWorkspaces) {
-        guestDir.rmdir(ws);
+        localStorage->deleteWorkspace(ws, true);
     }
 
     // 3. Загружаем страницы для каждого workspace с сервера
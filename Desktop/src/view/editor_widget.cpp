@@ -102,6 +102,13 @@ void EditorWidget::onWorkspaceRemoved(Workspace *workspace)
     }
 }
 
+void EditorWidget::onPageReloaded(Workspace *page)
+{
+    // Содержимое страницы обновилось само, а заголовок мог смениться
+    if (_currentWorkspace && _currentWorkspace->getPathChain().contains(page))
+        updateBreadcrumb();
+}
+
 Workspace *EditorWidget::currentWorkspace() const
 {
     return _currentWorkspace;
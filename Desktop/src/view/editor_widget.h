@@ -24,6 +24,7 @@ public:
 
 public slots:
     void onWorkspaceRemoved(Workspace* workspace);
+    void onPageReloaded(Workspace *page);
 
 private:
     Workspace *_currentWorkspace { nullptr };
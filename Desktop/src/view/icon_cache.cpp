@@ -0,0 +1,127 @@
+#include "icon_cache.h"
+#include "storage/blob_store.h"
+
+#include <QPainter>
+#include <QDebug>
+
+namespace {
+qsizetype costOf(const QPixmap &pixmap)
+{
+    return qMax<qsizetype>(1, qsizetype(pixmap.width()) * pixmap.height() * 4);
+}
+
+QString keyOf(const QString &digest, const QSize &size, qreal devicePixelRatio,
+              const QMargins &padding)
+{
+    return QStringLiteral("%1/%2x%3@%4/%5,%6,%7,%8")
+     .arg(digest)
+     .arg(size.width())
+     .arg(size.height())
+     .arg(devicePixelRatio)
+     .arg(padding.left())
+     .arg(padding.top())
+     .arg(padding.right())
+     .arg(padding.bottom());
+}
+} // namespace
+
+IconCache &IconCache::instance()
+{
+    static IconCache cache;
+    return cache;
+}
+
+IconCache::IconCache() :
+    _pixmaps(DefaultCapacity),
+    _originals(OriginalCapacity)
+{}
+
+QPixmap IconCache::source(const QString &digest)
+{
+    ++(_originals.contains(digest) ? _hits : _misses);
+    return original(digest);
+}
+
+QPixmap IconCache::original(const QString &digest)
+{
+    if (const QPixmap *cached = _originals.object(digest))
+        return *cached;
+
+    QPixmap pixmap;
+    if (digest.isEmpty())
+        pixmap.load(DefaultIconPath);
+    else if (!pixmap.loadFromData(BlobStore::instance().get(digest), "PNG"))
+        qWarning() << "Failed to decode icon" << digest;
+    if (pixmap.isNull())
+        return pixmap;
+
+    // Иконки показываются мелко: большой исходник не нужен целиком и не должен
+    // вытеснять из кэша остальные
+    if (qMax(pixmap.width(), pixmap.height()) > MaxOriginalSize)
+        pixmap = pixmap.scaled(MaxOriginalSize, MaxOriginalSize, Qt::KeepAspectRatio,
+                               Qt::SmoothTransformation);
+    _originals.insert(digest, new QPixmap(pixmap), costOf(pixmap));
+    return pixmap;
+}
+
+QPixmap IconCache::pixmap(const QString &digest, const QSize &size, qreal devicePixelRatio,
+                          const QMargins &padding)
+{
+    if (size.isEmpty())
+        return QPixmap();
+    const QString key = keyOf(digest, size, devicePixelRatio, padding);
+    if (const QPixmap *cached = _pixmaps.object(key)) {
+        ++_hits;
+        return *cached;
+    }
+
+    ++_misses;
+    const QPixmap image = original(digest);
+    if (image.isNull())
+        return QPixmap();
+
+    // Рисуем в пикселях устройства: на HiDPI иконка не размывается при выводе
+    const QSize canvas = size.grownBy(padding) * devicePixelRatio;
+    QPixmap result(canvas);
+    result.fill(Qt::transparent);
+    const QSize glyph = image.size().scaled(size * devicePixelRatio, Qt::KeepAspectRatio);
+    const QPoint offset(qRound(padding.left() * devicePixelRatio)
+                         + (qRound(size.width() * devicePixelRatio) - glyph.width()) / 2,
+                        qRound(padding.top() * devicePixelRatio)
+                         + (qRound(size.height() * devicePixelRatio) - glyph.height()) / 2);
+    {
+        QPainter painter(&result);
+        painter.setRenderHint(QPainter::SmoothPixmapTransform);
+        painter.drawPixmap(QRect(offset, glyph), image);
+    }
+    result.setDevicePixelRatio(devicePixelRatio);
+
+    _pixmaps.insert(key, new QPixmap(result), costOf(result));
+    return result;
+}
+
+QIcon IconCache::icon(const QString &digest, const QSize &size, qreal devicePixelRatio,
+                      const QMargins &padding)
+{
+    const QPixmap rendered = pixmap(digest, size, devicePixelRatio, padding);
+    return rendered.isNull() ? QIcon() : QIcon(rendered);
+}
+
+quint64 IconCache::hits() const
+{
+    return _hits;
+}
+
+quint64 IconCache::misses() const
+{
+    return _misses;
+}
+
+void IconCache::clear()
+{
+    qDebug() << "Icon cache cleared, hits:" << _hits << "misses:" << _misses;
+    _pixmaps.clear();
+    _originals.clear();
+    _hits = 0;
+    _misses = 0;
+}
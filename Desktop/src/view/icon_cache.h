@@ -0,0 +1,53 @@
+#ifndef ICON_CACHE_H
+#define ICON_CACHE_H
+
+#include <QCache>
+#include <QIcon>
+#include <QMargins>
+#include <QPixmap>
+#include <QSize>
+#include <QString>
+
+// Общий кэш растеризованных иконок пространств для дерева, заголовка страницы и
+// ссылок на подпространства. Иконка адресуется digest из BlobStore, поэтому при смене
+// иконки старые записи просто перестают запрашиваться. Ключ - digest, логический
+// размер, отступы и devicePixelRatio экрана: каждая иконка декодируется и
+// масштабируется один раз на размер и переиспользуется всеми виджетами.
+// Декодированные исходники лежат в отдельном кэше, уменьшенные до MaxOriginalSize.
+// Пустой digest - иконка по умолчанию. Работает только в потоке интерфейса.
+class IconCache
+{
+public:
+    static constexpr int DefaultCapacity = 8 * 1024 * 1024; // байт пикселей
+    static constexpr int OriginalCapacity = 4 * 1024 * 1024;
+    static constexpr int MaxOriginalSize = 256; // по большей стороне
+    static constexpr char DefaultIconPath[] = ":/icons/workspace.png";
+
+    static IconCache &instance();
+
+    // Исходная иконка в натуральном размере, но не больше MaxOriginalSize
+    QPixmap source(const QString &digest);
+    // Иконка, вписанная в size с сохранением пропорций, с прозрачными полями padding.
+    // Логический размер результата - size плюс поля
+    QPixmap pixmap(const QString &digest, const QSize &size, qreal devicePixelRatio,
+                   const QMargins &padding = QMargins());
+    QIcon icon(const QString &digest, const QSize &size, qreal devicePixelRatio,
+               const QMargins &padding = QMargins());
+
+    // Для диагностики; clear() пишет их в лог
+    quint64 hits() const;
+    quint64 misses() const;
+    void clear();
+
+private:
+    IconCache();
+    // Декодированный исходник; в счётчики не входит
+    QPixmap original(const QString &digest);
+
+    QCache<QString, QPixmap> _pixmaps; // растры по размерам
+    QCache<QString, QPixmap> _originals; // по digest
+    quint64 _hits { 0 };
+    quint64 _misses { 0 };
+};
+
+#endif // ICON_CACHE_H
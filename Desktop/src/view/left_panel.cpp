@@ -1,4 +1,5 @@
 #include "left_panel.h"
+#include "icon_cache.h"
 #include <qpushbutton.h>
 
 #include <QInputDialog>
@@ -6,10 +7,49 @@
 #include <QIcon>
 #include <QFileDialog>
 #include <QMessageBox>
-#include <QPainter>
 #include <QTreeWidget>
+#include <QTreeWidgetItemIterator>
 #include <QListWidgetItem>
 #include <QDebug>
+#include <QHash>
+#include <QSet>
+
+namespace {
+// Для незагруженных страниц вместо указателя хранится адрес в каталоге
+constexpr int RootIdRole = Qt::UserRole + 1;
+constexpr int PageIdRole = Qt::UserRole + 2;
+// Поля вокруг иконок в дереве updateWorkspaceList: корни сдвинуты вправо сильнее страниц
+const QMargins RootIconPadding(24, 8, 8, 8);
+const QMargins SubIconPadding(8, 4, 8, 4);
+constexpr qreal SubIconScale = 0.8;
+
+QIcon catalogIcon(const CatalogEntry &entry, const QTreeWidget *tree)
+{
+    if (entry.iconDigest.isEmpty())
+        return QIcon();
+    return IconCache::instance().icon(entry.iconDigest, tree->iconSize(),
+                                      tree->devicePixelRatioF());
+}
+
+QIcon pageIcon(const Workspace *page, const QTreeWidget *tree)
+{
+    return IconCache::instance().icon(page->getIconDigest(), tree->iconSize(),
+                                      tree->devicePixelRatioF());
+}
+
+// Страницы каталога сгруппированы по пространствам в исходном порядке;
+// каждое пространство начинается со своего корня (названия могут совпадать)
+QList<QList<CatalogEntry>> groupByWorkspace(const QList<CatalogEntry> &catalog)
+{
+    QList<QList<CatalogEntry>> groups;
+    for (const CatalogEntry &entry : catalog) {
+        if (groups.isEmpty() || entry.parent < 0)
+            groups.append(QList<CatalogEntry>());
+        groups.last().append(entry);
+    }
+    return groups;
+}
+} // namespace
 
 LeftPanel::LeftPanel(QWidget *parent) : QWidget(parent), _workspaceTree(new QTreeWidget(this))
 {
@@ -40,32 +80,106 @@ void LeftPanel::refreshWorkspaceList()
                                                                       QTreeWidgetItem *parentItem) {
         QTreeWidgetItem *item = new QTreeWidgetItem(parentItem);
         item->setText(0, ws->getTitle());
-        if (!ws->getIcon().isNull()) {
-            // QPixmap pixmap = ws->getIcon().pixmap(iconSize);
-            // QPixmap paddedPixmap(iconSize.width() + 8, iconSize.height() + 8);
-            // paddedPixmap.fill(Qt::transparent);
-            // QPixmap scaledPixmap =
-            //  pixmap.scaled(iconSize, Qt::KeepAspectRatio, Qt::SmoothTransformation);
-            // QPainter painter(&paddedPixmap);
-            // painter.drawPixmap(4, 4, scaledPixmap);
-            item->setIcon(0, ws->getIcon());
-        }
+        if (!ws->getIcon().isNull())
+            item->setIcon(0, pageIcon(ws, _workspaceTree));
         item->setData(0, Qt::UserRole, QVariant::fromValue(static_cast<void *>(ws)));
+        item->setData(0, PageIdRole, ws->getId());
         if (parentItem)
             parentItem->addChild(item);
         else
             _workspaceTree->addTopLevelItem(item);
         for (Workspace *sub : ws->getSubWorkspaces()) addTree(sub, item);
     };
-    for (Workspace *ws : _workspaceController->getRootWorkspaces()) addTree(ws, nullptr);
+
+    // Порядок задаёт каталог; загруженные пространства показываются по живой модели
+    QSet<Workspace *> added;
+    for (const QList<CatalogEntry> &entries : groupByWorkspace(_workspaceController->getCatalog())) {
+        Workspace *ws = _workspaceController->findLoadedWorkspace(entries.first().id);
+        if (!ws) {
+            addCatalogTree(entries);
+        } else if (!added.contains(ws)) {
+            addTree(ws, nullptr);
+            added.insert(ws);
+        }
+    }
+    for (Workspace *ws : _workspaceController->getRootWorkspaces()) {
+        if (!added.contains(ws))
+            addTree(ws, nullptr);
+    }
     _workspaceTree->expandAll();
 }
 
+void LeftPanel::addCatalogTree(const QList<CatalogEntry> &entries)
+{
+    QList<QTreeWidgetItem *> items;
+    items.reserve(entries.size());
+    for (const CatalogEntry &entry : entries) {
+        QTreeWidgetItem *parentItem = entry.parent >= 0 ? items.value(entry.parent) : nullptr;
+        QTreeWidgetItem *item =
+         parentItem ? new QTreeWidgetItem(parentItem) : new QTreeWidgetItem(_workspaceTree);
+        item->setText(0, entry.title);
+        item->setIcon(0, catalogIcon(entry, _workspaceTree));
+        item->setData(0, Qt::UserRole, QVariant::fromValue(static_cast<void *>(nullptr)));
+        item->setData(0, RootIdRole, entries.first().id);
+        item->setData(0, PageIdRole, entry.id);
+        items.append(item);
+    }
+}
+
+Workspace *LeftPanel::workspaceForItem(QTreeWidgetItem *item)
+{
+    if (!item || !_workspaceController)
+        return nullptr;
+
+    Workspace *workspace = static_cast<Workspace *>(item->data(0, Qt::UserRole).value<void *>());
+    if (workspace)
+        return workspace;
+
+    // Пространство ещё не загружено: читаем его с диска при первом обращении
+    const QString rootId = item->data(0, RootIdRole).toString();
+    if (rootId.isEmpty())
+        return nullptr;
+    workspace = _workspaceController->openWorkspace(rootId, item->data(0, PageIdRole).toString());
+    if (!workspace)
+        return nullptr;
+
+    QTreeWidgetItem *rootItem = item;
+    while (rootItem->parent()) rootItem = rootItem->parent();
+    bindLoadedItems(rootItem, workspace->getRootWorkspace());
+    return workspace;
+}
+
+void LeftPanel::bindLoadedItems(QTreeWidgetItem *rootItem, Workspace *root)
+{
+    QHash<QString, Workspace *> pages;
+    std::function<void(Workspace *)> collect = [&](Workspace *ws) {
+        pages.insert(ws->getId(), ws);
+        for (Workspace *sub : ws->getSubWorkspaces()) collect(sub);
+    };
+    collect(root);
+
+    std::function<void(QTreeWidgetItem *)> bind = [&](QTreeWidgetItem *item) {
+        if (Workspace *ws = pages.value(item->data(0, PageIdRole).toString()))
+            item->setData(0, Qt::UserRole, QVariant::fromValue(static_cast<void *>(ws)));
+        for (int i = 0; i < item->childCount(); ++i) bind(item->child(i));
+    };
+    bind(rootItem);
+}
+
+bool LeftPanel::workspaceTitleExists(const QString &title) const
+{
+    for (const CatalogEntry &root : _workspaceController->getRootEntries()) {
+        if (root.title == title)
+            return true;
+    }
+    return false;
+}
+
 void LeftPanel::onWorkspaceClicked(QTreeWidgetItem *item)
 {
     if (!item || !_workspaceController)
         return;
-    Workspace *workspace = static_cast<Workspace *>(item->data(0, Qt::UserRole).value<void *>());
+    Workspace *workspace = workspaceForItem(item);
     if (workspace)
         emit workspaceSelected(workspace);
 }
@@ -111,12 +225,7 @@ void LeftPanel::onCreateWorkspace()
     connect(createButton, &QPushButton::clicked, [this, dialog, nameEdit, &selectedIcon]() {
         QString workspaceName = nameEdit->text();
         if (!workspaceName.isEmpty()) {
-            auto existingWorkspaces = _workspaceController->getAllWorkspaces();
-            bool nameExists = std::any_of(existingWorkspaces.begin(), existingWorkspaces.end(),
-                                          [&workspaceName](Workspace *workspace) {
-                                              return workspace->getTitle() == workspaceName;
-                                          });
-            if (nameExists) {
+            if (workspaceTitleExists(workspaceName)) {
                 QMessageBox::warning(this, tr("Ошибка"),
                                      tr("Пространство с таким именем уже существует."));
                 return;
@@ -141,7 +250,7 @@ void LeftPanel::onCreateSubWorkspace()
     QTreeWidgetItem *item = _workspaceTree->currentItem();
     if (!item || !_workspaceController)
         return;
-    Workspace *parent = static_cast<Workspace *>(item->data(0, Qt::UserRole).value<void *>());
+    Workspace *parent = workspaceForItem(item);
     if (!parent)
         return;
 
@@ -204,7 +313,7 @@ void LeftPanel::showContextMenu(const QPoint &pos)
     QTreeWidgetItem *item = _workspaceTree->itemAt(pos);
     if (!item || !_workspaceController)
         return;
-    Workspace *workspace = static_cast<Workspace *>(item->data(0, Qt::UserRole).value<void *>());
+    Workspace *workspace = workspaceForItem(item);
     if (!workspace)
         return;
 
@@ -255,6 +364,19 @@ void LeftPanel::showContextMenu(const QPoint &pos)
     contextMenu.exec(_workspaceTree->viewport()->mapToGlobal(pos));
 }
 
+void LeftPanel::onPageReloaded(Workspace *page)
+{
+    for (QTreeWidgetItemIterator it(_workspaceTree); *it; ++it) {
+        QTreeWidgetItem *item = *it;
+        if (item->data(0, PageIdRole).toString() != page->getId())
+            continue;
+        item->setText(0, page->getTitle());
+        if (!page->getIcon().isNull())
+            item->setIcon(0, pageIcon(page, _workspaceTree));
+        return;
+    }
+}
+
 void LeftPanel::updateWorkspaceList()
 {
     if (!_workspaceController)
@@ -269,49 +391,32 @@ void LeftPanel::updateWorkspaceList()
     qDebug() << "Tree indentation:" << _workspaceTree->indentation();
     qDebug() << "Tree icon size:" << _workspaceTree->iconSize();
 
-    // Check if default icon exists
-    QString defaultIconPath = ":/icons/workspace.png";
-    QFile iconFile(defaultIconPath);
-    qDebug() << "\n=== Default Icon Check ===";
-    qDebug() << "Default icon path:" << defaultIconPath;
-    qDebug() << "Icon file exists:" << iconFile.exists();
-
     // Add root workspaces
     qDebug() << "\n=== Root Workspaces ===";
-    for (Workspace *ws : _workspaceController->getRootWorkspaces()) {
+    const qreal dpr = _workspaceTree->devicePixelRatioF();
+    QHash<QString, QList<CatalogEntry>> catalogTrees;
+    for (const QList<CatalogEntry> &entries : groupByWorkspace(_workspaceController->getCatalog()))
+        catalogTrees.insert(entries.first().id, entries);
+
+    // Порядок задаёт каталог; незагруженные пространства - прямо из него
+    for (const CatalogEntry &root : _workspaceController->getRootEntries()) {
+        Workspace *ws = _workspaceController->findLoadedWorkspace(root.id);
+        if (!ws) {
+            addCatalogTree(catalogTrees.value(root.id));
+            continue;
+        }
         QTreeWidgetItem *item = new QTreeWidgetItem(_workspaceTree);
         item->setText(0, ws->getTitle());
-        item->setData(0, Qt::UserRole, QVariant::fromValue(ws));
-
-        // Set icon with increased padding
-        QPixmap paddedPixmap(iconSize.width() + 32,
-                             iconSize.height() + 16); // Увеличили отступ слева
-        paddedPixmap.fill(Qt::transparent);
-
-        if (!ws->getIcon().isNull()) {
-            QPixmap pixmap = ws->getIcon().pixmap(iconSize);
-            QPixmap scaledPixmap =
-             pixmap.scaled(iconSize, Qt::KeepAspectRatio, Qt::SmoothTransformation);
-            QPainter painter(&paddedPixmap);
-            painter.drawPixmap(24, 8, scaledPixmap);
-            qDebug() << "Workspace" << ws->getTitle() << "has custom icon, size:" << pixmap.size();
-        } else {
-            // Set default icon with padding
-            QIcon defaultIcon(defaultIconPath);
-            QPixmap defaultPixmap = defaultIcon.pixmap(iconSize);
-            if (defaultPixmap.isNull()) {
-                qDebug() << "ERROR: Failed to load default icon for workspace" << ws->getTitle();
-                qDebug() << "Icon path:" << defaultIconPath;
-                qDebug() << "Icon is null:" << defaultIcon.isNull();
-                qDebug() << "Available icon sizes:" << defaultIcon.availableSizes();
-            } else {
-                QPainter painter(&paddedPixmap);
-                painter.drawPixmap(24, 8, defaultPixmap); // Сдвинули иконку вправо
-                item->setIcon(0, QIcon(paddedPixmap));
-                qDebug() << "Workspace" << ws->getTitle()
-                         << "has default icon, size:" << defaultPixmap.size();
-            }
-        }
+        item->setData(0, Qt::UserRole, QVariant::fromValue(static_cast<void *>(ws)));
+        item->setData(0, PageIdRole, ws->getId());
+
+        // Иконка с отступом слева; без своей иконки - иконка по умолчанию
+        const QString digest = ws->getIcon().isNull() ? QString() : ws->getIconDigest();
+        QIcon icon = IconCache::instance().icon(digest, iconSize, dpr, RootIconPadding);
+        if (icon.isNull())
+            qDebug() << "ERROR: Failed to load icon for workspace" << ws->getTitle();
+        else
+            item->setIcon(0, icon);
 
         // Add subworkspaces recursively
         addSubWorkspacesToTree(item, ws);
@@ -345,35 +450,18 @@ void LeftPanel::addSubWorkspacesToTree(QTreeWidgetItem *parentItem, Workspace *p
     for (Workspace *sub : parentWorkspace->getSubWorkspaces()) {
         QTreeWidgetItem *item = new QTreeWidgetItem(parentItem);
         item->setText(0, sub->getTitle());
-        item->setData(0, Qt::UserRole, QVariant::fromValue(sub));
-
-        // Set icon with increased padding
-        QSize iconSize = _workspaceTree->iconSize();
-        QPixmap paddedPixmap(iconSize.width() + 16, iconSize.height() + 8); // Уменьшили отступы
-        paddedPixmap.fill(Qt::transparent);
-
-        if (!sub->getIcon().isNull()) {
-            QPixmap pixmap = sub->getIcon().pixmap(iconSize * 0.8); // Уменьшаем размер иконки
-            QPainter painter(&paddedPixmap);
-            painter.drawPixmap(8, 4, pixmap); // Сдвинули иконку вправо
-        } else {
-            // Set default icon with padding
-            QIcon defaultIcon(":/icons/workspace.png");
-            QPixmap defaultPixmap = defaultIcon.pixmap(iconSize);
-            if (defaultPixmap.isNull()) {
-                qDebug() << "ERROR: Failed to load default icon for subworkspace"
-                         << sub->getTitle();
-                qDebug() << "Icon path: :/icons/workspace.png";
-                qDebug() << "Icon is null:" << defaultIcon.isNull();
-                qDebug() << "Available icon sizes:" << defaultIcon.availableSizes();
-            } else {
-                QPainter painter(&paddedPixmap);
-                painter.drawPixmap(24, 8, defaultPixmap); // Сдвинули иконку вправо
-                item->setIcon(0, QIcon(paddedPixmap));
-                qDebug() << "Subworkspace" << sub->getTitle()
-                         << "has default icon, size:" << defaultPixmap.size();
-            }
-        }
+        item->setData(0, Qt::UserRole, QVariant::fromValue(static_cast<void *>(sub)));
+        item->setData(0, PageIdRole, sub->getId());
+
+        // Иконка страницы меньше и ближе к краю, чем у корня
+        const QString digest = sub->getIcon().isNull() ? QString() : sub->getIconDigest();
+        QIcon icon = IconCache::instance().icon(digest, _workspaceTree->iconSize() * SubIconScale,
+                                                _workspaceTree->devicePixelRatioF(),
+                                                SubIconPadding);
+        if (icon.isNull())
+            qDebug() << "ERROR: Failed to load icon for subworkspace" << sub->getTitle();
+        else
+            item->setIcon(0, icon);
 
         // Recursively add subworkspaces
         addSubWorkspacesToTree(item, sub);
@@ -27,6 +27,7 @@ public slots:
     void onCreateWorkspace();
     void onCreateSubWorkspace();
     void updateWorkspaceList();
+    void onPageReloaded(Workspace *page);
 
 private slots:
     void onWorkspaceClicked(QTreeWidgetItem *item);
@@ -34,6 +35,12 @@ private slots:
 
 private:
     void addSubWorkspacesToTree(QTreeWidgetItem *parentItem, Workspace *parentWorkspace);
+
+    // Пространства из каталога, ещё не загруженные в память
+    void addCatalogTree(const QList<CatalogEntry> &entries);
+    Workspace *workspaceForItem(QTreeWidgetItem *item);
+    void bindLoadedItems(QTreeWidgetItem *rootItem, Workspace *root);
+    bool workspaceTitleExists(const QString &title) const;
     
     QTreeWidget *_workspaceTree;
     WorkspaceController *_workspaceController { nullptr };
@@ -1,6 +1,7 @@
 #include "main_widget.h"
 #include "../error_handler.h"
 #include "auth_dialog.h"
+#include "storage/workspace_bundle.h"
 #include <qmainwindow.h>
 #include <qtoolbar.h>
 
@@ -10,6 +11,7 @@
 #include <QVBoxLayout>
 #include <QHBoxLayout>
 #include <QFileDialog>
+#include <QFileInfo>
 #include <QApplication>
 #include <QDebug>
 #include <QTimer>
@@ -35,6 +37,32 @@ MainWidget::MainWidget(QWidget *parent) :
             &MainWidget::workspaceAdded);
     connect(_workspaceController.get(), &WorkspaceController::workspaceRemoved, this,
             &MainWidget::workspaceRemoved);
+    connect(_workspaceController.get(), &WorkspaceController::workspaceSaved, this,
+            [this](const QString &title) {
+                _hasUnsavedChanges = false;
+                emit statusMessage("Workspace saved: " + title);
+            });
+    connect(_workspaceController.get(), &WorkspaceController::workspaceSaveFailed, this,
+            [this](const QString &title, const QString &error) {
+                _hasUnsavedChanges = true;
+                emit statusMessage("Failed to save workspace: " + title);
+                ErrorHandler::instance().showError("Ошибка сохранения", error);
+            });
+    connect(_workspaceController.get(), &WorkspaceController::storageRepaired, this,
+            [this](int repaired, const QStringList &lost) {
+                if (repaired > 0)
+                    emit statusMessage(QString("Restored %1 damaged files").arg(repaired));
+                if (!lost.isEmpty())
+                    ErrorHandler::instance().showError(
+                     "Повреждение хранилища",
+                     "Не удалось восстановить файлы:\n" + lost.join("\n"));
+            });
+    connect(_workspaceController.get(), &WorkspaceController::workspaceImportFailed, this,
+            [](const QString &title) {
+                ErrorHandler::instance().showError("Ошибка открытия",
+                                                   "Не удалось скопировать пространство: "
+                                                    + title);
+            });
     connect(_workspaceController.get(), &WorkspaceController::pathUpdated, this,
             [this](Workspace *workspace) {
                 if (_editorWidget) {
@@ -56,6 +84,8 @@ MainWidget::MainWidget(QWidget *parent) :
 
 MainWidget::~MainWidget()
 {
+    if (_viewer && _editorWidget && _viewer->contains(_editorWidget->currentWorkspace()))
+        _editorWidget->setCurrentWorkspace(nullptr);
     if (_workspaceController) {
         _workspaceController->saveWorkspaces();
     }
@@ -151,6 +181,23 @@ void MainWidget::initConnections()
 
     connect(_leftPanel.get(), &LeftPanel::workspaceSelected, _editorWidget.get(),
             &EditorWidget::setCurrentWorkspace);
+
+    // Пространства, переписанные на диске другим процессом, обновляются на месте
+    connect(_workspaceController.get(), &WorkspaceController::pageReloaded, _editorWidget.get(),
+            &EditorWidget::onPageReloaded);
+    connect(_workspaceController.get(), &WorkspaceController::pageReloaded, _leftPanel.get(),
+            &LeftPanel::onPageReloaded);
+    connect(_workspaceController.get(), &WorkspaceController::catalogChanged, _leftPanel.get(),
+            &LeftPanel::refreshWorkspaceList);
+    connect(_workspaceController.get(), &WorkspaceController::workspaceReloaded, this,
+            [this](Workspace *oldRoot, Workspace *newRoot) {
+                Workspace *current = _editorWidget->currentWorkspace();
+                if (current && current->getRootWorkspace() == oldRoot) {
+                    _editorWidget->setCurrentWorkspace(
+                     _workspaceController->openWorkspace(newRoot->getId(), current->getId()));
+                }
+                _leftPanel->refreshWorkspaceList();
+            });
     connect(_leftPanel.get(), &LeftPanel::subWorkspaceSelected, _editorWidget.get(),
             &EditorWidget::setCurrentWorkspace);
 
@@ -327,11 +374,46 @@ void MainWidget::openWorkspace()
     QString fileName = QFileDialog::getOpenFileName(this, "Open Workspace", QString(),
                                                     "Workspace Files (*.workspace);;All Files (*)");
 
-    if (!fileName.isEmpty()) {
-        // TODO: Implement workspace loading
-        _hasUnsavedChanges = false;
-        emit statusMessage("Workspace opened: " + fileName);
+    if (!fileName.isEmpty())
+        openWorkspaceFile(fileName);
+}
+
+bool MainWidget::openWorkspaceFile(const QString &fileName)
+{
+    if (!_workspaceController)
+        return false;
+
+    // Пространство добавляется в боковую панель, страницы загрузятся при выборе
+    const QString title = _workspaceController->importWorkspaceFile(fileName);
+    if (title.isEmpty()) {
+        ErrorHandler::instance().showError("Ошибка открытия",
+                                           "Не удалось открыть файл пространства: " + fileName);
+        return false;
     }
+    emit statusMessage("Workspace opened: " + title);
+    return true;
+}
+
+void MainWidget::viewWorkspaceFile()
+{
+    QString fileName = QFileDialog::getOpenFileName(this, "View Workspace", QString(),
+                                                    "Workspace Files (*.workspace);;All Files (*)");
+    if (fileName.isEmpty() || !_editorWidget)
+        return;
+
+    auto viewer = std::make_unique<WorkspaceViewer>();
+    if (!viewer->open(fileName)) {
+        ErrorHandler::instance().showError("Ошибка открытия",
+                                           "Не удалось открыть файл пространства: " + fileName);
+        return;
+    }
+
+    // Предыдущий просматриваемый файл закрывается
+    if (_viewer && _viewer->contains(_editorWidget->currentWorkspace()))
+        _editorWidget->setCurrentWorkspace(nullptr);
+    _viewer = std::move(viewer);
+    _editorWidget->setCurrentWorkspace(_viewer->root());
+    emit statusMessage("Viewing workspace: " + fileName);
 }
 
 bool MainWidget::saveCurrentWorkspace()
@@ -350,9 +432,9 @@ bool MainWidget::saveCurrentWorkspace()
     qDebug() << "Saving current workspace:" << currentWorkspace->getTitle();
 
     if (_workspaceController) {
-        _workspaceController->saveWorkspaces();
-        _hasUnsavedChanges = false;
-        emit statusMessage("Workspace saved: " + currentWorkspace->getTitle());
+        // Запись идёт в фоне, итог сообщат сигналы workspaceSaved/workspaceSaveFailed
+        _workspaceController->saveWorkspacesInBackground();
+        emit statusMessage("Saving workspace: " + currentWorkspace->getTitle());
         return true;
     }
 
@@ -365,13 +447,35 @@ bool MainWidget::saveWorkspaceAs()
     QString fileName = QFileDialog::getSaveFileName(this, "Save Workspace As", QString(),
                                                     "Workspace Files (*.workspace);;All Files (*)");
 
-    if (!fileName.isEmpty()) {
-        // TODO: Implement workspace saving
-        _hasUnsavedChanges = false;
-        emit statusMessage("Workspace saved as: " + fileName);
-        return true;
+    if (fileName.isEmpty() || !_workspaceController || !_editorWidget)
+        return false;
+
+    Workspace *currentWorkspace = _editorWidget->currentWorkspace();
+    if (!currentWorkspace) {
+        qWarning() << "No current workspace to save";
+        return false;
     }
-    return false;
+
+    if (QFileInfo(fileName).suffix().isEmpty())
+        fileName += QString(".") + WorkspaceBundle::FileSuffix;
+
+    bool saved = false;
+    if (_viewer && _viewer->contains(currentWorkspace)) {
+        // Просматриваемый файл загружен не целиком - копируем его как есть
+        const QString source = _viewer->filePath();
+        saved = QFileInfo(source) == QFileInfo(fileName)
+                || ((!QFile::exists(fileName) || QFile::remove(fileName))
+                    && QFile::copy(source, fileName));
+    } else {
+        saved = _workspaceController->exportWorkspaceFile(currentWorkspace, fileName);
+    }
+    if (!saved) {
+        ErrorHandler::instance().showError("Ошибка сохранения",
+                                           "Не удалось сохранить файл пространства: " + fileName);
+        return false;
+    }
+    emit statusMessage("Workspace saved as: " + fileName);
+    return true;
 }
 
 // Edit operations
@@ -6,6 +6,7 @@
 #include "api/auth_manager.h"
 #include "editor_widget.h"
 #include "left_panel.h"
+#include "../logic/workspace_viewer.h"
 
 #include <QWidget>
 #include <QPointer>
@@ -26,6 +27,10 @@ public:
     // Workspace operations
     void createNewWorkspace();
     void openWorkspace();
+    // Импорт файла *.workspace без диалога (файл из командной строки)
+    bool openWorkspaceFile(const QString &fileName);
+    // Просмотр большого файла *.workspace без импорта, только для чтения
+    void viewWorkspaceFile();
     bool saveCurrentWorkspace();
     bool saveWorkspaceAs();
     void syncWorkspaces();
@@ -89,6 +94,7 @@ private:
 
     std::unique_ptr<LeftPanel> _leftPanel { nullptr };
     std::unique_ptr<EditorWidget> _editorWidget { nullptr };
+    std::unique_ptr<WorkspaceViewer> _viewer { nullptr };
 
     QPointer<QSettings> _settings;
 
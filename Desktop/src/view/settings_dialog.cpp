@@ -1,5 +1,7 @@
 #include "settings_dialog.h"
 #include "../settings/settings_manager.h"
+#include "../storage/storage_cipher.h"
+#include "../storage/storage_engine.h"
 #include <QVBoxLayout>
 #include <QHBoxLayout>
 #include <QFormLayout>
@@ -160,6 +162,84 @@ void SettingsDialog::initSyncTab()
     syncLayout->addRow("", _autoSyncCheck);
 
     layout->addWidget(syncGroup);
+
+    QGroupBox *storageGroup = new QGroupBox("Локальное хранилище", syncTab);
+    QFormLayout *storageLayout = new QFormLayout(storageGroup);
+
+    _encryptStorageCheck = new QCheckBox("Шифровать пространства на диске", storageGroup);
+    if (!StorageCipher::isSupported()) {
+        _encryptStorageCheck->setEnabled(false);
+        _encryptStorageCheck->setToolTip("Приложение собрано без OpenSSL");
+    }
+    storageLayout->addRow("", _encryptStorageCheck);
+
+    if (StorageCipher::isSupported()) {
+        QLabel *keyNote = new QLabel(
+         QString(StorageCipher::hasKeychain()
+                  ? "Ключ хранится в системном хранилище ключей. Если оно недоступно, "
+                    "ключ лежит в файле settings/storage.key рядом с данными."
+                  : "Ключ хранится в файле settings/storage.key рядом с данными.")
+          + " Ключи всех пользователей выводятся из одного секрета установки: тот, кто "
+            "может прочитать этот секрет, расшифрует данные любого пользователя.",
+         storageGroup);
+        keyNote->setWordWrap(true);
+        storageLayout->addRow("", keyNote);
+    }
+
+    _storageEngineCombo = new QComboBox(storageGroup);
+    _storageEngineCombo->addItem("Каталоги", "directory");
+    _storageEngineCombo->addItem("База SQLite", "sqlite");
+    if (!StorageEngine::isSupported(StorageEngine::Sqlite)) {
+        _storageEngineCombo->setEnabled(false);
+        _storageEngineCombo->setToolTip("Приложение собрано без Qt SQL");
+    } else {
+        _storageEngineCombo->setToolTip("Вступает в силу после перезапуска. Изменения, "
+                                        "сделанные в базе SQLite другим экземпляром "
+                                        "приложения, видны только после перезапуска");
+    }
+    storageLayout->addRow("Формат хранилища:", _storageEngineCombo);
+
+    layout->addWidget(storageGroup);
+
+    QGroupBox *imagesGroup = new QGroupBox("Изображения", syncTab);
+    QFormLayout *imagesLayout = new QFormLayout(imagesGroup);
+
+    _reencodeImagesCheck = new QCheckBox("Перекодировать вставляемые изображения", imagesGroup);
+    _reencodeImagesCheck->setToolTip("Без перекодирования файл хранится без изменений");
+    imagesLayout->addRow("", _reencodeImagesCheck);
+
+    _imageMaxDimensionSpin = new QSpinBox(imagesGroup);
+    _imageMaxDimensionSpin->setRange(256, 16384);
+    _imageMaxDimensionSpin->setSingleStep(256);
+    _imageMaxDimensionSpin->setSuffix(" px");
+    imagesLayout->addRow("Наибольшая сторона:", _imageMaxDimensionSpin);
+
+    _losslessImagesCheck = new QCheckBox("Без потерь (PNG)", imagesGroup);
+    imagesLayout->addRow("", _losslessImagesCheck);
+
+    _imageQualitySpin = new QSpinBox(imagesGroup);
+    _imageQualitySpin->setRange(1, 100);
+    imagesLayout->addRow("Качество JPEG:", _imageQualitySpin);
+
+    auto updateImageControls = [this]() {
+        const bool reencode = _reencodeImagesCheck->isChecked();
+        _imageMaxDimensionSpin->setEnabled(reencode);
+        _losslessImagesCheck->setEnabled(reencode);
+        _imageQualitySpin->setEnabled(reencode && !_losslessImagesCheck->isChecked());
+    };
+    connect(_reencodeImagesCheck, &QCheckBox::toggled, this, updateImageControls);
+    connect(_losslessImagesCheck, &QCheckBox::toggled, this, updateImageControls);
+    updateImageControls();
+
+    _imageMemoryBudgetSpin = new QSpinBox(imagesGroup);
+    _imageMemoryBudgetSpin->setRange(64, 16384);
+    _imageMemoryBudgetSpin->setSingleStep(64);
+    _imageMemoryBudgetSpin->setSuffix(" МБ");
+    _imageMemoryBudgetSpin->setToolTip(
+     "Изображения, которых нет на экране, освобождаются сверх этого предела");
+    imagesLayout->addRow("Память под изображения:", _imageMemoryBudgetSpin);
+
+    layout->addWidget(imagesGroup);
     layout->addStretch();
 
     _tabWidget->addTab(syncTab, "Синхронизация");
@@ -186,6 +266,16 @@ void SettingsDialog::loadSettings()
     // Sync settings
     _syncIntervalSpin->setValue(SettingsManager::instance().syncInterval());
     _autoSyncCheck->setChecked(SettingsManager::instance().autoSync());
+
+    // Storage settings
+    _encryptStorageCheck->setChecked(SettingsManager::instance().encryptStorage());
+    _storageEngineCombo->setCurrentIndex(
+     qMax(0, _storageEngineCombo->findData(SettingsManager::instance().storageEngine())));
+    _reencodeImagesCheck->setChecked(SettingsManager::instance().reencodeImages());
+    _imageMaxDimensionSpin->setValue(SettingsManager::instance().imageMaxDimension());
+    _imageQualitySpin->setValue(SettingsManager::instance().imageQuality());
+    _losslessImagesCheck->setChecked(SettingsManager::instance().losslessImages());
+    _imageMemoryBudgetSpin->setValue(SettingsManager::instance().imageMemoryBudget());
 }
 
 void SettingsDialog::saveSettings()
@@ -207,6 +297,15 @@ void SettingsDialog::saveSettings()
     // Sync settings
     SettingsManager::instance().setSyncInterval(_syncIntervalSpin->value());
     SettingsManager::instance().setAutoSync(_autoSyncCheck->isChecked());
+
+    // Storage settings
+    SettingsManager::instance().setEncryptStorage(_encryptStorageCheck->isChecked());
+    SettingsManager::instance().setStorageEngine(_storageEngineCombo->currentData().toString());
+    SettingsManager::instance().setReencodeImages(_reencodeImagesCheck->isChecked());
+    SettingsManager::instance().setImageMaxDimension(_imageMaxDimensionSpin->value());
+    SettingsManager::instance().setImageQuality(_imageQualitySpin->value());
+    SettingsManager::instance().setLosslessImages(_losslessImagesCheck->isChecked());
+    SettingsManager::instance().setImageMemoryBudget(_imageMemoryBudgetSpin->value());
 }
 
 void SettingsDialog::onApplyClicked()
@@ -51,6 +51,15 @@ private:
     // Sync settings
     QSpinBox* _syncIntervalSpin;
     QCheckBox* _autoSyncCheck;
+
+    // Storage settings
+    QCheckBox* _encryptStorageCheck;
+    QComboBox* _storageEngineCombo;
+    QCheckBox* _reencodeImagesCheck;
+    QSpinBox* _imageMaxDimensionSpin;
+    QSpinBox* _imageQualitySpin;
+    QCheckBox* _losslessImagesCheck;
+    QSpinBox* _imageMemoryBudgetSpin;
 };
 
 #endif // SETTINGS_DIALOG_H 
\ No newline at end of file
@@ -0,0 +1,87 @@
+# middleware.py
+import io
+import json
+import zlib
+
+from django.conf import settings
+from django.core.exceptions import RequestDataTooBig
+from django.http import JsonResponse
+
+# Тела запросов синхронизации от Desktop сжаты deflate с заранее заданным
+# словарём (TextCodec в Desktop/src/storage/text_codec.cpp): разметка
+# QTextEdit повторяется в каждом текстовом элементе. Словари - копии
+# HtmlDictionaries оттуда, в том же порядке; клиент сжимает текущей версией,
+# но в экранировании строки JSON. Версии не правятся и не удаляются: словарь
+# тела выбирается по Adler-32 из заголовка потока zlib (FDICT).
+# Распакованное тело ограничено DATA_UPLOAD_MAX_MEMORY_SIZE, как и несжатое;
+# без этой настройки - INFLATE_LIMIT.
+CONTENT_ENCODING = 'x-text-dictionary'
+INFLATE_LIMIT = 1 << 28
+
+TEXT_DICTIONARY_V1 = r'''<ol style="margin-top: 0px; margin-bottom: 0px; margin-left: 0px; margin-right: 0px; -qt-list-indent: 1;"><li style=" margin-top:0px; margin-bottom:0px; margin-left:0px; margin-right:0px; -qt-block-indent:0; text-indent:0px;">
+<ul style="margin-top: 0px; margin-bottom: 0px; margin-left: 0px; margin-right: 0px; -qt-list-indent: 1;"><li style=" margin-top:12px; margin-bottom:0px; margin-left:0px; margin-right:0px; -qt-block-indent:0; text-indent:0px;">
+<span style=" font-style:italic;"></span><span style=" font-weight:700;"></span><span style=" text-decoration: underline;"></span></li></ul></ol>
+<body style=" font-family:'Sans Serif'; font-size:9pt; font-weight:400; font-style:normal;">
+<body style=" font-family:'Ubuntu'; font-size:11pt; font-weight:400; font-style:normal;">
+<body style=" font-family:'.AppleSystemUIFont'; font-size:13pt; font-weight:400; font-style:normal;">
+<p style="-qt-paragraph-type:empty; margin-top:0px; margin-bottom:0px; margin-left:0px; margin-right:0px; -qt-block-indent:0; text-indent:0px;"><br /></p>
+<!DOCTYPE HTML PUBLIC "-//W3C//DTD HTML 4.0//EN" "http://www.w3.org/TR/REC-html40/strict.dtd">
+<html><head><meta name="qrichtext" content="1" /><meta charset="utf-8" /><style type="text/css">
+p, li { white-space: pre-wrap; }
+hr { height: 1px; border-width: 0; }
+li.unchecked::marker { content: "\2610"; }
+li.checked::marker { content: "\2612"; }
+</style></head><body style=" font-family:'Segoe UI'; font-size:9pt; font-weight:400; font-style:normal;">
+<p style=" margin-top:0px; margin-bottom:0px; margin-left:0px; margin-right:0px; -qt-block-indent:0; text-indent:0px;"></p></body></html>'''
+TEXT_DICTIONARIES = [TEXT_DICTIONARY_V1]
+JSON_DICTIONARIES = {
+    zlib.adler32(dictionary): dictionary
+    for dictionary in (
+        json.dumps(text)[1:-1].encode('ascii') for text in TEXT_DICTIONARIES
+    )
+}
+FDICT = 0x20
+
+
+def inflate_limit():
+    limit = settings.DATA_UPLOAD_MAX_MEMORY_SIZE
+    return INFLATE_LIMIT if limit is None else min(limit, INFLATE_LIMIT)
+
+
+def inflate(body, limit):
+    if len(body) < 6 or not body[1] & FDICT:
+        raise zlib.error('missing dictionary id')
+    dictionary = JSON_DICTIONARIES.get(int.from_bytes(body[2:6], 'big'))
+    if dictionary is None:
+        raise zlib.error('unknown dictionary')
+    inflater = zlib.decompressobj(zdict=dictionary)
+    # Байт сверх лимита отличает слишком большое тело от ровно равного лимиту
+    data = inflater.decompress(body, limit + 1)
+    if len(data) > limit:
+        raise RequestDataTooBig(f'decompressed body exceeds {limit} bytes')
+    if not inflater.eof:
+        raise zlib.error('truncated body')
+    return data
+
+
+class TextDictionaryMiddleware:
+    """Распаковывает тело с Content-Encoding: x-text-dictionary до разбора DRF."""
+
+    def __init__(self, get_response):
+        self.get_response = get_response
+
+    def __call__(self, request):
+        if request.META.get('HTTP_CONTENT_ENCODING') == CONTENT_ENCODING:
+            try:
+                body = inflate(request.body, inflate_limit())
+            except RequestDataTooBig as e:
+                return JsonResponse({'detail': f'Request body too large: {e}'}, status=413)
+            except zlib.error as e:
+                return JsonResponse(
+                    {'detail': f'Invalid compressed body: {e}'}, status=415
+                )
+            request._body = body
+            request._stream = io.BytesIO(body)
+            request.META['CONTENT_LENGTH'] = str(len(body))
+            del request.META['HTTP_CONTENT_ENCODING']
+        return self.get_response(request)
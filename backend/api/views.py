@@ -358,7 +358,13 @@ def create_page_with_elements(page_data, workspace, parent_page=None):
             if image_data:
                 try:
                     img_content = base64.b64decode(image_data)
-                    image_file = ContentFile(img_content, name=f'image_{idx}.png')
+                    # Клиент хранит исходный файл; формат - как определил Qt
+                    image_format = str(el.get('imageFormat') or 'png')
+                    if not image_format.isalnum():
+                        image_format = 'png'
+                    image_file = ContentFile(
+                        img_content, name=f'image_{idx}.{image_format}'
+                    )
                     ImageElement.objects.create(page=page, image=image_file)
                 except Exception as e:
                     pass